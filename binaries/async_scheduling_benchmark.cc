@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Compares the iteration latency of the async_scheduling net with ready
+// chains run in FIFO order against upward rank priority scheduling, on a
+// stack of wide Inception-like modules: every module has many cheap
+// branches and one long branch, joined by a Sum. With fewer threads than
+// branches, starting the long branch first is expected to shorten every
+// module; this binary is the way to check that on a given machine.
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+CAFFE2_DEFINE_int(modules, 4, "Number of stacked modules.");
+CAFFE2_DEFINE_int(branches, 12, "Number of short branches per module.");
+CAFFE2_DEFINE_int(long_branch_depth, 4, "Number of FC ops in the long branch.");
+CAFFE2_DEFINE_int(batch_size, 32, "Batch size of the input.");
+CAFFE2_DEFINE_int(dim, 512, "Width of the FC layers.");
+CAFFE2_DEFINE_int(threads, 4, "Number of threads in the CPU pool.");
+CAFFE2_DEFINE_int(warmup, 5, "The number of iterations to warm up.");
+CAFFE2_DEFINE_int(iter, 50, "The number of iterations to run.");
+
+CAFFE2_DECLARE_int(caffe2_net_async_cpu_pool_size);
+CAFFE2_DECLARE_bool(caffe2_net_async_priority_scheduling);
+
+using std::string;
+using std::vector;
+
+namespace {
+
+void addFC(
+    caffe2::NetDef* init_net,
+    caffe2::NetDef* net,
+    const string& input,
+    const string& output) {
+  const string weight = output + "_w";
+  const string bias = output + "_b";
+  auto* fill = init_net->add_op();
+  fill->set_type("XavierFill");
+  fill->add_output(weight);
+  auto* shape = fill->add_arg();
+  shape->set_name("shape");
+  shape->add_ints(caffe2::FLAGS_dim);
+  shape->add_ints(caffe2::FLAGS_dim);
+  fill = init_net->add_op();
+  fill->set_type("ConstantFill");
+  fill->add_output(bias);
+  shape = fill->add_arg();
+  shape->set_name("shape");
+  shape->add_ints(caffe2::FLAGS_dim);
+
+  auto* fc = net->add_op();
+  fc->set_type("FC");
+  fc->add_input(input);
+  fc->add_input(weight);
+  fc->add_input(bias);
+  fc->add_output(output);
+}
+
+void buildNets(caffe2::NetDef* init_net, caffe2::NetDef* net) {
+  string input = "data";
+  net->add_external_input(input);
+  for (int m = 0; m < caffe2::FLAGS_modules; ++m) {
+    const string prefix = "m" + caffe2::to_string(m) + "_";
+    vector<string> branch_outputs;
+    // Short branches come first, so FIFO order starts them first
+    for (int b = 0; b < caffe2::FLAGS_branches; ++b) {
+      branch_outputs.push_back(prefix + "short" + caffe2::to_string(b));
+      addFC(init_net, net, input, branch_outputs.back());
+    }
+    string long_input = input;
+    for (int d = 0; d < caffe2::FLAGS_long_branch_depth; ++d) {
+      const string output = prefix + "long" + caffe2::to_string(d);
+      addFC(init_net, net, long_input, output);
+      long_input = output;
+    }
+    branch_outputs.push_back(long_input);
+
+    auto* sum = net->add_op();
+    sum->set_type("Sum");
+    for (const auto& branch_output : branch_outputs) {
+      sum->add_input(branch_output);
+    }
+    input = prefix + "out";
+    sum->add_output(input);
+  }
+  net->add_external_output(input);
+}
+
+vector<double> runNet(caffe2::NetBase* net) {
+  for (int i = 0; i < caffe2::FLAGS_warmup; ++i) {
+    CAFFE_ENFORCE(net->Run());
+  }
+  vector<double> latencies;
+  caffe2::Timer timer;
+  for (int i = 0; i < caffe2::FLAGS_iter; ++i) {
+    timer.Start();
+    CAFFE_ENFORCE(net->Run());
+    latencies.push_back(timer.MilliSeconds());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::FLAGS_caffe2_net_async_cpu_pool_size = caffe2::FLAGS_threads;
+
+  caffe2::Workspace workspace;
+  caffe2::NetDef init_net_def;
+  caffe2::NetDef net_def;
+  buildNets(&init_net_def, &net_def);
+  CAFFE_ENFORCE(workspace.RunNetOnce(init_net_def));
+  auto* data = workspace.CreateBlob("data")->GetMutable<caffe2::TensorCPU>();
+  data->Resize(caffe2::FLAGS_batch_size, caffe2::FLAGS_dim);
+  std::fill(
+      data->mutable_data<float>(),
+      data->mutable_data<float>() + data->size(),
+      1.0f);
+
+  net_def.set_type("async_scheduling");
+  std::cout << "scheduling  mean ms    p50 ms    p90 ms" << std::endl;
+  for (bool priority : {false, true}) {
+    caffe2::FLAGS_caffe2_net_async_priority_scheduling = priority;
+    net_def.set_name(priority ? "priority" : "fifo");
+    auto* net = workspace.CreateNet(net_def);
+    CAFFE_ENFORCE(net);
+    auto latencies = runNet(net);
+    double mean = 0;
+    for (auto latency : latencies) {
+      mean += latency;
+    }
+    mean /= latencies.size();
+    std::cout << (priority ? "priority  " : "fifo      ") << std::fixed
+              << std::setprecision(3) << std::setw(9) << mean << std::setw(10)
+              << latencies[latencies.size() / 2] << std::setw(10)
+              << latencies[latencies.size() * 9 / 10] << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Contention benchmark for BlobsQueue: many writer threads (data loaders)
+// and reader threads (dequeue ops) move small tensors through one queue.
+// Reports the throughput of the lock free and the mutex based queue.
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/queue/blobs_queue.h"
+
+CAFFE2_DEFINE_int(readers, 16, "Number of reader threads.");
+CAFFE2_DEFINE_int(writers, 32, "Number of writer threads.");
+CAFFE2_DEFINE_int(capacity, 64, "Capacity of the queue.");
+CAFFE2_DEFINE_int(num_blobs, 2, "Number of blobs in every record.");
+CAFFE2_DEFINE_int(records, 1000000, "Total number of records to move.");
+
+namespace {
+
+double runQueue(bool lock_free) {
+  caffe2::FLAGS_caffe2_blobs_queue_lock_free = lock_free;
+  caffe2::Workspace ws;
+  auto queue = std::make_shared<caffe2::BlobsQueue>(
+      &ws,
+      lock_free ? "lock_free_queue" : "locked_queue",
+      caffe2::FLAGS_capacity,
+      caffe2::FLAGS_num_blobs,
+      true);
+
+  const int records_per_writer =
+      caffe2::FLAGS_records / caffe2::FLAGS_writers;
+  const int total_records = records_per_writer * caffe2::FLAGS_writers;
+  std::atomic<int> read_records(0);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int w = 0; w < caffe2::FLAGS_writers; ++w) {
+    threads.emplace_back([&]() {
+      std::vector<caffe2::Blob> blobs(caffe2::FLAGS_num_blobs);
+      std::vector<caffe2::Blob*> blob_ptrs;
+      for (auto& blob : blobs) {
+        blob_ptrs.push_back(&blob);
+      }
+      for (int i = 0; i < records_per_writer; ++i) {
+        for (auto& blob : blobs) {
+          auto* tensor = blob.GetMutable<caffe2::TensorCPU>();
+          tensor->Resize(16);
+          tensor->mutable_data<float>()[0] = i;
+        }
+        CAFFE_ENFORCE(queue->blockingWrite(blob_ptrs));
+      }
+    });
+  }
+  for (int r = 0; r < caffe2::FLAGS_readers; ++r) {
+    threads.emplace_back([&]() {
+      std::vector<caffe2::Blob> blobs(caffe2::FLAGS_num_blobs);
+      std::vector<caffe2::Blob*> blob_ptrs;
+      for (auto& blob : blobs) {
+        blob_ptrs.push_back(&blob);
+      }
+      while (queue->blockingRead(blob_ptrs)) {
+        if (++read_records == total_records) {
+          queue->close();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return total_records / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  std::cout << "readers " << caffe2::FLAGS_readers << ", writers "
+            << caffe2::FLAGS_writers << ", capacity " << caffe2::FLAGS_capacity
+            << std::endl;
+  for (bool lock_free : {false, true}) {
+    auto records_per_sec = runQueue(lock_free);
+    std::cout << (lock_free ? "lock free: " : "mutex:     ") << std::fixed
+              << std::setprecision(0) << records_per_sec << " records/s"
+              << std::endl;
+  }
+  return 0;
+}
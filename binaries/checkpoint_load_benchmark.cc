@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Cold start benchmark for model loading: saves a set of float tensors with
+// the Save operator for every db type, evicts the files from the page cache
+// and times the Load operator. Since mmap checkpoints are only read on first
+// access, the time to read every loaded value once is reported as well.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/mmap_checkpoint.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(
+    db_types,
+    "minidb,leveldb,mmap",
+    "Comma separated list of db types to compare.");
+CAFFE2_DEFINE_string(folder, "/tmp", "Folder the checkpoints are written to.");
+CAFFE2_DEFINE_int(num_tensors, 100, "Number of tensors in the checkpoint.");
+CAFFE2_DEFINE_int(tensor_size, 1 << 20, "Number of floats per tensor.");
+CAFFE2_DEFINE_bool(
+    drop_cache,
+    true,
+    "Evict the checkpoint from the page cache before loading.");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Evicts a file, or all files of a directory, from the page cache
+void dropCache(const std::string& path) {
+  struct stat st;
+  CAFFE_ENFORCE_EQ(stat(path.c_str(), &st), 0, "Cannot stat ", path);
+  if (S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(path.c_str());
+    CAFFE_ENFORCE(dir, "Cannot open ", path);
+    while (auto* entry = readdir(dir)) {
+      const std::string name = entry->d_name;
+      if (name != "." && name != "..") {
+        dropCache(path + "/" + name);
+      }
+    }
+    closedir(dir);
+    return;
+  }
+  int fd = open(path.c_str(), O_RDONLY);
+  CAFFE_ENFORCE_GE(fd, 0, "Cannot open ", path);
+  // Only clean pages can be dropped
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+caffe2::OperatorDef makeOp(
+    const std::string& type,
+    const std::string& db_type,
+    const std::string& db) {
+  caffe2::OperatorDef def;
+  def.set_type(type);
+  for (int i = 0; i < caffe2::FLAGS_num_tensors; ++i) {
+    const auto name = "tensor_" + caffe2::to_string(i);
+    if (type == "Save") {
+      def.add_input(name);
+    } else {
+      def.add_output(name);
+    }
+  }
+  def.add_arg()->CopyFrom(caffe2::MakeArgument("db", db));
+  def.add_arg()->CopyFrom(caffe2::MakeArgument("db_type", db_type));
+  def.add_arg()->CopyFrom(caffe2::MakeArgument("absolute_path", 1));
+  return def;
+}
+
+void runDBType(const std::string& db_type) {
+  const auto db =
+      caffe2::FLAGS_folder + "/checkpoint_load_benchmark." + db_type;
+  {
+    caffe2::Workspace ws;
+    for (int i = 0; i < caffe2::FLAGS_num_tensors; ++i) {
+      auto* tensor = ws.CreateBlob("tensor_" + caffe2::to_string(i))
+                         ->GetMutable<caffe2::TensorCPU>();
+      tensor->Resize(caffe2::FLAGS_tensor_size);
+      auto* data = tensor->mutable_data<float>();
+      for (int j = 0; j < tensor->size(); ++j) {
+        data[j] = j;
+      }
+    }
+    auto save = caffe2::CreateOperator(makeOp("Save", db_type, db), &ws);
+    CAFFE_ENFORCE(save->Run());
+  }
+  if (caffe2::FLAGS_drop_cache) {
+    dropCache(db);
+  }
+
+  caffe2::Workspace ws;
+  auto start = Clock::now();
+  auto load = caffe2::CreateOperator(makeOp("Load", db_type, db), &ws);
+  CAFFE_ENFORCE(load->Run());
+  std::chrono::duration<double> load_time = Clock::now() - start;
+
+  double sum = 0;
+  for (int i = 0; i < caffe2::FLAGS_num_tensors; ++i) {
+    const auto& tensor =
+        ws.GetBlob("tensor_" + caffe2::to_string(i))->Get<caffe2::TensorCPU>();
+    const auto* data = tensor.data<float>();
+    for (int j = 0; j < tensor.size(); ++j) {
+      sum += data[j];
+    }
+  }
+  std::chrono::duration<double> total_time = Clock::now() - start;
+
+  std::cout << std::setw(8) << db_type << ": load " << std::fixed
+            << std::setprecision(3) << load_time.count()
+            << " s, load and read " << total_time.count() << " s (checksum "
+            << sum << ")" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  std::cout << caffe2::FLAGS_num_tensors << " tensors of "
+            << caffe2::FLAGS_tensor_size << " floats" << std::endl;
+  for (const auto& db_type : caffe2::split(',', caffe2::FLAGS_db_types)) {
+    if (db_type != caffe2::kMmapCheckpointDBType &&
+        !caffe2::db::Caffe2DBRegistry()->Has(db_type)) {
+      std::cout << std::setw(8) << db_type << ": not available" << std::endl;
+      continue;
+    }
+    runDBType(db_type);
+  }
+  return 0;
+}
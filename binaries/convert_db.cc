@@ -16,6 +16,7 @@
 
 #include "caffe2/core/db.h"
 #include "caffe2/core/init.h"
+#include "caffe2/db/parallel_convert.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/core/logging.h"
 
@@ -24,28 +25,44 @@ CAFFE2_DEFINE_string(input_db_type, "", "The input db type.");
 CAFFE2_DEFINE_string(output_db, "", "The output db.");
 CAFFE2_DEFINE_string(output_db_type, "", "The output db type.");
 CAFFE2_DEFINE_int(batch_size, 1000, "The write batch size.");
+CAFFE2_DEFINE_int(
+    num_shards,
+    1,
+    "The number of output dbs. If more than one, they are named "
+    "<output_db>_shard_<i>.");
+CAFFE2_DEFINE_bool(
+    ordered,
+    true,
+    "If true, every output db receives its items in input order.");
+CAFFE2_DEFINE_int(report_interval, 10000, "The progress report interval.");
 
 using caffe2::db::Cursor;
 using caffe2::db::DB;
-using caffe2::db::Transaction;
 
 int main(int argc, char** argv) {
   caffe2::GlobalInit(&argc, &argv);
 
   std::unique_ptr<DB> in_db(caffe2::db::CreateDB(
       caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db, caffe2::db::READ));
-  std::unique_ptr<DB> out_db(caffe2::db::CreateDB(
-      caffe2::FLAGS_output_db_type, caffe2::FLAGS_output_db, caffe2::db::NEW));
-  std::unique_ptr<Cursor> cursor(in_db->NewCursor());
-  std::unique_ptr<Transaction> transaction(out_db->NewTransaction());
-  int count = 0;
-  for (; cursor->Valid(); cursor->Next()) {
-    transaction->Put(cursor->key(), cursor->value());
-    if (++count % caffe2::FLAGS_batch_size == 0) {
-      transaction->Commit();
-      LOG(INFO) << "Converted " << count << " items so far.";
-    }
+  CAFFE_ENFORCE(in_db, "Cannot open input db: ", caffe2::FLAGS_input_db);
+  std::vector<std::unique_ptr<DB>> out_dbs;
+  std::vector<DB*> outputs;
+  for (const auto& name : caffe2::db::ShardedDBNames(
+           caffe2::FLAGS_output_db, caffe2::FLAGS_num_shards)) {
+    out_dbs.emplace_back(caffe2::db::CreateDB(
+        caffe2::FLAGS_output_db_type, name, caffe2::db::NEW));
+    CAFFE_ENFORCE(out_dbs.back(), "Cannot create output db: ", name);
+    outputs.push_back(out_dbs.back().get());
   }
-  LOG(INFO) << "A total of " << count << " items processed.";
+  std::unique_ptr<Cursor> cursor(in_db->NewCursor());
+
+  // Items are copied as they are, one thread reads while every output db
+  // is written by its own thread.
+  caffe2::db::ParallelConvertOptions options;
+  options.ordered = caffe2::FLAGS_ordered;
+  options.batch_size = caffe2::FLAGS_batch_size;
+  options.report_interval = caffe2::FLAGS_report_interval;
+  caffe2::db::ParallelConvert(
+      caffe2::db::CursorSource(cursor.get()), nullptr, outputs, options);
   return 0;
 }
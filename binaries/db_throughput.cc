@@ -14,7 +14,33 @@
  * limitations under the License.
  */
 
+// I/O benchmark for the registered db backends. For every db type and record
+// size, a db of synthetic TensorProtos records is written, and then read once
+// by every combination of reading mode and number of reading threads, with a
+// cold and a warm page cache. An existing db can be benchmarked instead with
+// --input_db.
+//
+// Reading modes:
+//   reader: all the threads share a DBReader, as the data input operators do.
+//   cursor: every thread reads its own shard through its own cursor, with
+//     --zero_copy using the zero-copy accessors if the db supports them.
+//
+// For every run, the throughput and the percentiles of the time spent in the
+// db for each record are reported, separately from the time spent parsing
+// the records as TensorProtos.
+//
+// The synthetic dbs are written to a new temporary directory under --folder,
+// and each is removed once it has been benchmarked.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <random>
 #include <thread>
 #include <vector>
 
@@ -22,77 +48,351 @@
 #include "caffe2/core/init.h"
 #include "caffe2/core/timer.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/utils/string_utils.h"
 
-CAFFE2_DEFINE_string(input_db, "", "The input db.");
-CAFFE2_DEFINE_string(input_db_type, "", "The input db type.");
-CAFFE2_DEFINE_int(report_interval, 1000, "The report interval.");
-CAFFE2_DEFINE_int(repeat, 10, "The number to repeat the throughput test.");
-CAFFE2_DEFINE_bool(use_reader, false, "If true, use the reader interface.");
-CAFFE2_DEFINE_int(num_read_threads, 1,
-                   "The number of concurrent reading threads.");
+CAFFE2_DEFINE_string(input_db, "", "An existing db to benchmark.");
+CAFFE2_DEFINE_string(input_db_type, "", "The type of --input_db.");
+CAFFE2_DEFINE_string(
+    db_types,
+    "minidb,leveldb,lmdb,rocksdb,recorddb",
+    "Comma separated list of db types to compare. The ones not built in "
+    "are skipped.");
+CAFFE2_DEFINE_string(
+    folder,
+    "/tmp",
+    "Folder under which a temporary directory for the synthetic dbs is "
+    "created.");
+CAFFE2_DEFINE_int(num_records, 10000, "Number of records per synthetic db.");
+CAFFE2_DEFINE_string(
+    record_sizes,
+    "1000,10000,100000",
+    "Comma separated list of record sizes in bytes.");
+CAFFE2_DEFINE_string(
+    num_read_threads,
+    "1,4,16",
+    "Comma separated list of numbers of concurrent reading threads.");
+CAFFE2_DEFINE_string(
+    modes,
+    "reader,cursor",
+    "Comma separated list of reading modes, among reader and cursor.");
+CAFFE2_DEFINE_string(
+    caches,
+    "cold,warm",
+    "Comma separated list of page cache states, among cold and warm.");
+CAFFE2_DEFINE_int(
+    read_ahead,
+    0,
+    "Number of records the shared DBReader reads ahead, in reader mode.");
+CAFFE2_DEFINE_bool(parse, true, "If true, parse the records as TensorProtos.");
+CAFFE2_DEFINE_bool(zero_copy, false,
+                   "If true, access the values without copying them when "
+                   "the db supports it.");
 
 using caffe2::db::Cursor;
 using caffe2::db::DB;
 using caffe2::db::DBReader;
 using caffe2::string;
 
-void TestThroughputWithDB() {
-  std::unique_ptr<DB> in_db(caffe2::db::CreateDB(
-      caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db, caffe2::db::READ));
-  std::unique_ptr<Cursor> cursor(in_db->NewCursor());
-  for (int iter_id = 0; iter_id < caffe2::FLAGS_repeat; ++iter_id) {
-    caffe2::Timer timer;
-    for (int i = 0; i < caffe2::FLAGS_report_interval; ++i) {
-      string key = cursor->key();
-      string value = cursor->value();
-      //VLOG(1) << "Key " << key;
-      cursor->Next();
-      if (!cursor->Valid()) {
-        cursor->SeekToFirst();
+namespace {
+
+// Evicts a file, or all files of a directory, from the page cache
+void DropCache(const string& path) {
+  struct stat st;
+  CAFFE_ENFORCE_EQ(stat(path.c_str(), &st), 0, "Cannot stat ", path);
+  if (S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(path.c_str());
+    CAFFE_ENFORCE(dir, "Cannot open ", path);
+    while (auto* entry = readdir(dir)) {
+      const string name = entry->d_name;
+      if (name != "." && name != "..") {
+        DropCache(path + "/" + name);
+      }
+    }
+    closedir(dir);
+    return;
+  }
+  int fd = open(path.c_str(), O_RDONLY);
+  CAFFE_ENFORCE_GE(fd, 0, "Cannot open ", path);
+  // Only clean pages can be dropped
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+// Removes a file, or a directory and all its content
+void RemoveAll(const string& path) {
+  struct stat st;
+  if (lstat(path.c_str(), &st) != 0) {
+    return;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(path.c_str());
+    if (dir) {
+      while (auto* entry = readdir(dir)) {
+        const string name = entry->d_name;
+        if (name != "." && name != "..") {
+          RemoveAll(path + "/" + name);
+        }
+      }
+      closedir(dir);
+    }
+    rmdir(path.c_str());
+  } else {
+    unlink(path.c_str());
+  }
+}
+
+std::vector<int> ParseInts(const string& list) {
+  std::vector<int> values;
+  for (const auto& value : caffe2::split(',', list)) {
+    values.push_back(std::stoi(value));
+  }
+  return values;
+}
+
+// Writes num_records TensorProtos holding a random byte tensor of roughly
+// record_size bytes and a label. Returns false if the db can not be created
+// or can not store them.
+bool WriteSyntheticDB(
+    const string& db_type,
+    const string& path,
+    int record_size) {
+  std::mt19937 gen(record_size);
+  std::uniform_int_distribution<int> byte(0, 255);
+  caffe2::TensorProtos protos;
+  auto* data = protos.add_protos();
+  data->set_data_type(caffe2::TensorProto::BYTE);
+  data->add_dims(record_size);
+  auto* label = protos.add_protos();
+  label->set_data_type(caffe2::TensorProto::INT32);
+  label->add_dims(1);
+  label->add_int32_data(0);
+  string bytes(record_size, '\0');
+  string value;
+  char key[16];
+  try {
+    std::unique_ptr<DB> db(
+        caffe2::db::CreateDB(db_type, path, caffe2::db::NEW));
+    CAFFE_ENFORCE(db, "Cannot create ", db_type, " db ", path);
+    std::unique_ptr<caffe2::db::Transaction> transaction(db->NewTransaction());
+    for (int i = 0; i < caffe2::FLAGS_num_records; ++i) {
+      for (auto& c : bytes) {
+        c = byte(gen);
       }
+      data->set_byte_data(bytes);
+      label->set_int32_data(0, i % 1000);
+      protos.SerializeToString(&value);
+      snprintf(key, sizeof(key), "%010d", i);
+      transaction->Put(key, value);
     }
-    double elapsed_seconds = timer.Seconds();
-    printf("Iteration %03d, took %4.5f seconds, throughput %f items/sec.\n",
-           iter_id, elapsed_seconds,
-           caffe2::FLAGS_report_interval / elapsed_seconds);
+    transaction->Commit();
+  } catch (const std::exception& e) {
+    LOG(WARNING) << db_type << " can not store the records: " << e.what();
+    return false;
+  }
+  return true;
+}
+
+struct ThreadStats {
+  std::vector<float> read_us;
+  double parse_us = 0;
+  size_t bytes = 0;
+  uint64_t checksum = 0;
+};
+
+// Reads every byte of a value accessed without copy, so that the time spent
+// in the db includes faulting in its pages, as it does when copying
+uint64_t Checksum(const char* data, size_t size) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < size; ++i) {
+    sum += static_cast<unsigned char>(data[i]);
   }
+  return sum;
 }
 
-void TestThroughputWithReaderWorker(const DBReader* reader, int thread_id) {
+void Parse(const char* data, size_t size, ThreadStats* stats) {
+  if (!caffe2::FLAGS_parse) {
+    return;
+  }
+  caffe2::Timer timer;
+  caffe2::TensorProtos protos;
+  CAFFE_ENFORCE(protos.ParseFromArray(data, size), "Cannot parse a record.");
+  stats->parse_us += timer.MicroSeconds();
+}
+
+void ReaderWorker(const DBReader* reader, int num_reads, ThreadStats* stats) {
   string key, value;
-  for (int iter_id = 0; iter_id < caffe2::FLAGS_repeat; ++iter_id) {
+  for (int i = 0; i < num_reads; ++i) {
     caffe2::Timer timer;
-    for (int i = 0; i < caffe2::FLAGS_report_interval; ++i) {
-      reader->Read(&key, &value);
+    reader->Read(&key, &value);
+    stats->read_us.push_back(timer.MicroSeconds());
+    stats->bytes += value.size();
+    Parse(value.data(), value.size(), stats);
+  }
+}
+
+// Reads the records i such that i % num_threads == thread_id
+void CursorWorker(DB* db, int thread_id, int num_threads, ThreadStats* stats) {
+  caffe2::Timer timer;
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  for (int i = 0; i < thread_id && cursor->Valid(); ++i) {
+    cursor->Next();
+  }
+  string value;
+  while (cursor->Valid()) {
+    const char* data;
+    size_t size;
+    if (caffe2::FLAGS_zero_copy && cursor->ValueView(&data, &size)) {
+      stats->checksum += Checksum(data, size);
+    } else {
+      value = cursor->value();
+      data = value.data();
+      size = value.size();
     }
-    double elapsed_seconds = timer.Seconds();
-    printf("Thread %03d iteration %03d, took %4.5f seconds, "
-           "throughput %f items/sec.\n",
-           thread_id, iter_id, elapsed_seconds,
-           caffe2::FLAGS_report_interval / elapsed_seconds);
+    for (int i = 0; i < num_threads && cursor->Valid(); ++i) {
+      cursor->Next();
+    }
+    stats->read_us.push_back(timer.MicroSeconds());
+    stats->bytes += size;
+    Parse(data, size, stats);
+    timer.Start();
+  }
+}
+
+int CountRecords(DB* db) {
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  int count = 0;
+  for (; cursor->Valid(); cursor->Next()) {
+    count++;
   }
+  return count;
 }
 
-void TestThroughputWithReader() {
-  caffe2::db::DBReader reader(
-      caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db);
-  std::vector<std::unique_ptr<std::thread>> reading_threads(
-      caffe2::FLAGS_num_read_threads);
-  for (int i = 0; i < reading_threads.size(); ++i) {
-    reading_threads[i].reset(new std::thread(
-        TestThroughputWithReaderWorker, &reader, i));
+void RunBenchmark(
+    const string& db_type,
+    const string& path,
+    int num_records,
+    const string& mode,
+    const string& cache,
+    int num_threads) {
+  if (cache == "cold") {
+    DropCache(path);
+  }
+  std::vector<ThreadStats> stats(num_threads);
+  std::vector<std::thread> threads;
+  caffe2::Timer timer;
+  if (mode == "reader") {
+    DBReader reader(db_type, path);
+    reader.SetReadAhead(caffe2::FLAGS_read_ahead);
+    for (int i = 0; i < num_threads; ++i) {
+      const int num_reads =
+          num_records / num_threads + (i < num_records % num_threads);
+      threads.emplace_back(ReaderWorker, &reader, num_reads, &stats[i]);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  } else {
+    CAFFE_ENFORCE_EQ(mode, "cursor", "Unknown reading mode ", mode);
+    std::unique_ptr<DB> db(
+        caffe2::db::CreateDB(db_type, path, caffe2::db::READ));
+    for (int i = 0; i < num_threads; ++i) {
+      threads.emplace_back(CursorWorker, db.get(), i, num_threads, &stats[i]);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  const double seconds = timer.Seconds();
+
+  std::vector<float> read_us;
+  double parse_us = 0;
+  size_t bytes = 0;
+  for (const auto& s : stats) {
+    read_us.insert(read_us.end(), s.read_us.begin(), s.read_us.end());
+    parse_us += s.parse_us;
+    bytes += s.bytes;
   }
-  for (int i = 0; i < reading_threads.size(); ++i) {
-    reading_threads[i]->join();
+  CAFFE_ENFORCE(!read_us.empty(), "No record read from ", path);
+  std::sort(read_us.begin(), read_us.end());
+  auto percentile = [&read_us](double p) {
+    return read_us[std::min<size_t>(p * read_us.size(), read_us.size() - 1)];
+  };
+  printf(
+      "%-9s %-6s %-5s %3d threads: %10.0f items/s %8.1f MB/s | "
+      "db us p50 %8.1f p90 %8.1f p99 %8.1f max %9.1f | parse us %7.1f\n",
+      db_type.c_str(),
+      mode.c_str(),
+      cache.c_str(),
+      num_threads,
+      read_us.size() / seconds,
+      bytes / seconds / (1 << 20),
+      percentile(0.5),
+      percentile(0.9),
+      percentile(0.99),
+      read_us.back(),
+      parse_us / read_us.size());
+  fflush(stdout);
+}
+
+void RunSweep(const string& db_type, const string& path, int num_records) {
+  for (const auto& mode : caffe2::split(',', caffe2::FLAGS_modes)) {
+    for (int num_threads : ParseInts(caffe2::FLAGS_num_read_threads)) {
+      for (const auto& cache : caffe2::split(',', caffe2::FLAGS_caches)) {
+        RunBenchmark(db_type, path, num_records, mode, cache, num_threads);
+      }
+    }
   }
 }
 
+} // namespace
+
 int main(int argc, char** argv) {
   caffe2::GlobalInit(&argc, &argv);
-  if (caffe2::FLAGS_use_reader) {
-    TestThroughputWithReader();
-  } else {
-    TestThroughputWithDB();
+  if (caffe2::FLAGS_input_db.size()) {
+    std::unique_ptr<DB> db(caffe2::db::CreateDB(
+        caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db, caffe2::db::READ));
+    CAFFE_ENFORCE(db, "Cannot open ", caffe2::FLAGS_input_db);
+    const int num_records = CountRecords(db.get());
+    db.reset();
+    printf("%s: %d records\n", caffe2::FLAGS_input_db.c_str(), num_records);
+    RunSweep(caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db, num_records);
+    return 0;
+  }
+
+  string folder = caffe2::FLAGS_folder + "/db_throughput.XXXXXX";
+  CAFFE_ENFORCE(
+      mkdtemp(&folder[0]),
+      "Cannot create a directory in ",
+      caffe2::FLAGS_folder);
+  // Removes the synthetic dbs however the benchmark ends
+  struct RemoveFolder {
+    ~RemoveFolder() {
+      RemoveAll(path);
+    }
+    string path;
+  } remove_folder{folder};
+
+  try {
+    for (int record_size : ParseInts(caffe2::FLAGS_record_sizes)) {
+      printf(
+          "%d records of %d bytes\n", caffe2::FLAGS_num_records, record_size);
+      for (const auto& db_type : caffe2::split(',', caffe2::FLAGS_db_types)) {
+        if (!caffe2::db::Caffe2DBRegistry()->Has(db_type)) {
+          printf("%-9s not available\n", db_type.c_str());
+          continue;
+        }
+        const auto path =
+            folder + "/" + db_type + "." + caffe2::to_string(record_size);
+        if (WriteSyntheticDB(db_type, path, record_size)) {
+          RunSweep(db_type, path, caffe2::FLAGS_num_records);
+        }
+        RemoveAll(path);
+      }
+    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Benchmark failed: " << e.what();
+    return 1;
   }
   return 0;
 }
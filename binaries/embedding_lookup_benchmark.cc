@@ -0,0 +1,315 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmark of the embedding lookup perfkernels. For every embedding type and
+// block size, the same random lookups are run through the base, avx2 and
+// avx512 implementations the build and the cpu support, and the throughput is
+// reported in GB/s of embedding rows read, with the speedup over avx2. The
+// benchmark fails if the output of avx2 or avx512 differs from the base one.
+//
+// Embedding types:
+//   float, float16: EmbeddingLookup with float and float16 rows.
+//   uint8: Fused8BitRowwiseEmbeddingLookup with 8-bit rows followed by their
+//     scale and bias.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/types.h"
+#include "caffe2/utils/cpuid.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(
+    types,
+    "float,float16,uint8",
+    "Comma separated list of embedding types, among float, float16 and uint8.");
+CAFFE2_DEFINE_string(
+    block_sizes,
+    "16,32,64,128,256,512",
+    "Comma separated list of embedding dimensions.");
+CAFFE2_DEFINE_int(
+    table_mb,
+    512,
+    "Size of the embedding table in MB, larger than the last level cache to "
+    "measure lookups from memory.");
+CAFFE2_DEFINE_int(output_size, 1024, "Number of segments per lookup.");
+CAFFE2_DEFINE_int(pooling, 32, "Number of rows summed per segment.");
+CAFFE2_DEFINE_int(iterations, 20, "Number of timed lookups.");
+CAFFE2_DEFINE_bool(weighted, false, "If true, run weighted sums.");
+CAFFE2_DEFINE_bool(normalize_by_lengths, false, "If true, run means.");
+
+namespace caffe2 {
+
+#define DECLARE_LOOKUP(name, InType) \
+  void name(                         \
+      const TIndex block_size,       \
+      const TIndex output_size,      \
+      const TIndex index_size,       \
+      const TIndex data_size,        \
+      const InType* input,           \
+      const int64_t* indices,        \
+      const int* lengths,            \
+      const float* weights,          \
+      bool normalize_by_lengths,     \
+      float* out);
+
+#define DECLARE_LOOKUPS(name, InType)     \
+  DECLARE_LOOKUP(name##__base, InType)     \
+  DECLARE_LOOKUP(name##__avx2_fma, InType) \
+  DECLARE_LOOKUP(name##__avx512, InType)
+
+DECLARE_LOOKUPS(EmbeddingLookup_int64_t_float_float, float)
+DECLARE_LOOKUPS(EmbeddingLookup_int64_t_float16_float, float16)
+DECLARE_LOOKUPS(
+    Fused8BitRowwiseEmbeddingLookup_int64_t_uint8_t_float_false,
+    uint8_t)
+
+#undef DECLARE_LOOKUPS
+#undef DECLARE_LOOKUP
+
+} // namespace caffe2
+
+using caffe2::string;
+using caffe2::TIndex;
+
+namespace {
+
+template <typename InType>
+using LookupFn = void (*)(
+    const TIndex,
+    const TIndex,
+    const TIndex,
+    const TIndex,
+    const InType*,
+    const int64_t*,
+    const int*,
+    const float*,
+    bool,
+    float*);
+
+template <typename InType>
+struct Kernels {
+  LookupFn<InType> base;
+  LookupFn<InType> avx2;
+  LookupFn<InType> avx512;
+};
+
+std::vector<int> ParseInts(const string& list) {
+  std::vector<int> values;
+  for (const auto& value : caffe2::split(',', list)) {
+    values.push_back(std::stoi(value));
+  }
+  return values;
+}
+
+// Fills a row of block_size elements, followed by scale_bias_size bytes of
+// scale and bias for the fused type
+void FillRow(std::mt19937* gen, int block_size, int, float* row) {
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < block_size; ++i) {
+    row[i] = dist(*gen);
+  }
+}
+
+void FillRow(std::mt19937* gen, int block_size, int, caffe2::float16* row) {
+  // Half floats in [-1, -0.5] U [0.5, 1]
+  std::uniform_int_distribution<uint16_t> dist(0, 0x7ff);
+  for (int i = 0; i < block_size; ++i) {
+    const uint16_t bits = dist(*gen);
+    row[i].x = ((bits & 0x400) << 5) | 0x3800 | (bits & 0x3ff);
+  }
+}
+
+void FillRow(
+    std::mt19937* gen,
+    int block_size,
+    int scale_bias_size,
+    uint8_t* row) {
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (int i = 0; i < block_size; ++i) {
+    row[i] = dist(*gen);
+  }
+  CAFFE_ENFORCE_EQ(scale_bias_size, 2 * sizeof(float));
+  const float scale_bias[2] = {1.f / 255, -0.5f};
+  memcpy(row + block_size, scale_bias, sizeof(scale_bias));
+}
+
+template <typename InType>
+void RunBenchmark(
+    const string& type,
+    int block_size,
+    int scale_bias_size,
+    const Kernels<InType>& kernels) {
+  const size_t row_bytes = block_size * sizeof(InType) + scale_bias_size;
+  const TIndex row_size = row_bytes / sizeof(InType);
+  const TIndex data_size =
+      std::max<TIndex>(1, (size_t(caffe2::FLAGS_table_mb) << 20) / row_bytes);
+  const TIndex output_size = caffe2::FLAGS_output_size;
+  const TIndex index_size = output_size * caffe2::FLAGS_pooling;
+
+  std::mt19937 gen(block_size);
+  std::vector<InType> input(data_size * row_size);
+  for (TIndex i = 0; i < data_size; ++i) {
+    FillRow(&gen, block_size, scale_bias_size, &input[i * row_size]);
+  }
+  std::uniform_int_distribution<int64_t> row(0, data_size - 1);
+  std::vector<int64_t> indices(index_size);
+  for (auto& index : indices) {
+    index = row(gen);
+  }
+  std::vector<int> lengths(output_size, caffe2::FLAGS_pooling);
+  std::vector<float> weights(index_size);
+  std::uniform_real_distribution<float> weight(0.f, 1.f);
+  for (auto& w : weights) {
+    w = weight(gen);
+  }
+  std::vector<float> out(output_size * block_size);
+
+  auto measure = [&](LookupFn<InType> kernel) {
+    std::fill(out.begin(), out.end(), std::numeric_limits<float>::quiet_NaN());
+    auto lookup = [&]() {
+      kernel(
+          block_size,
+          output_size,
+          index_size,
+          data_size,
+          input.data(),
+          indices.data(),
+          lengths.data(),
+          caffe2::FLAGS_weighted ? weights.data() : nullptr,
+          caffe2::FLAGS_normalize_by_lengths,
+          out.data());
+    };
+    // Warm up
+    lookup();
+    caffe2::Timer timer;
+    for (int i = 0; i < caffe2::FLAGS_iterations; ++i) {
+      lookup();
+    }
+    return double(caffe2::FLAGS_iterations) * index_size * row_bytes /
+        timer.Seconds() / 1e9;
+  };
+
+  const auto& cpuid = caffe2::GetCpuId();
+  const double base = measure(kernels.base);
+  const auto expected = out;
+  // The faster implementations are only reported if they match the base one
+  auto check = [&](const char* name) {
+    for (size_t i = 0; i < out.size(); ++i) {
+      CAFFE_ENFORCE(
+          std::fabs(out[i] - expected[i]) <=
+              1e-4f * (1 + std::fabs(expected[i])),
+          name,
+          " output ",
+          out[i],
+          " differs from the base output ",
+          expected[i],
+          " at ",
+          i,
+          " for ",
+          type,
+          " rows of ",
+          block_size);
+    }
+  };
+  double avx2 = 0;
+  if (kernels.avx2 && cpuid.avx2() && cpuid.fma()) {
+    avx2 = measure(kernels.avx2);
+    check("avx2");
+  }
+  double avx512 = 0;
+  if (kernels.avx512 && cpuid.avx512f() && cpuid.avx512bw() &&
+      cpuid.avx512vl()) {
+    avx512 = measure(kernels.avx512);
+    check("avx512");
+  }
+
+  printf("%-7s %4d: base %7.2f GB/s", type.c_str(), block_size, base);
+  if (avx2 > 0) {
+    printf(" | avx2 %7.2f GB/s", avx2);
+  } else {
+    printf(" | avx2 %12s", "n/a");
+  }
+  if (avx512 > 0) {
+    printf(" | avx512 %7.2f GB/s", avx512);
+    if (avx2 > 0) {
+      printf(" %5.2fx avx2", avx512 / avx2);
+    }
+  } else {
+    printf(" | avx512 %12s", "n/a");
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+
+  // The kernels of the instruction sets that are not built are left null
+  Kernels<float> float_kernels = {
+      caffe2::EmbeddingLookup_int64_t_float_float__base, nullptr, nullptr};
+  Kernels<caffe2::float16> float16_kernels = {
+      caffe2::EmbeddingLookup_int64_t_float16_float__base, nullptr, nullptr};
+  Kernels<uint8_t> uint8_kernels = {
+      caffe2::Fused8BitRowwiseEmbeddingLookup_int64_t_uint8_t_float_false__base,
+      nullptr,
+      nullptr};
+#ifdef CAFFE2_PERF_WITH_AVX2
+  float_kernels.avx2 = caffe2::EmbeddingLookup_int64_t_float_float__avx2_fma;
+  float16_kernels.avx2 =
+      caffe2::EmbeddingLookup_int64_t_float16_float__avx2_fma;
+  uint8_kernels.avx2 =
+      caffe2::Fused8BitRowwiseEmbeddingLookup_int64_t_uint8_t_float_false__avx2_fma;
+#endif // CAFFE2_PERF_WITH_AVX2
+#ifdef CAFFE2_PERF_WITH_AVX512
+  float_kernels.avx512 = caffe2::EmbeddingLookup_int64_t_float_float__avx512;
+  float16_kernels.avx512 =
+      caffe2::EmbeddingLookup_int64_t_float16_float__avx512;
+  uint8_kernels.avx512 =
+      caffe2::Fused8BitRowwiseEmbeddingLookup_int64_t_uint8_t_float_false__avx512;
+#endif // CAFFE2_PERF_WITH_AVX512
+
+  printf(
+      "%d segments of %d rows, %d MB tables%s%s\n",
+      caffe2::FLAGS_output_size,
+      caffe2::FLAGS_pooling,
+      caffe2::FLAGS_table_mb,
+      caffe2::FLAGS_weighted ? ", weighted" : "",
+      caffe2::FLAGS_normalize_by_lengths ? ", normalized" : "");
+  for (const auto& type : caffe2::split(',', caffe2::FLAGS_types)) {
+    for (int block_size : ParseInts(caffe2::FLAGS_block_sizes)) {
+      if (type == "float") {
+        RunBenchmark(type, block_size, 0, float_kernels);
+      } else if (type == "float16") {
+        RunBenchmark(type, block_size, 0, float16_kernels);
+      } else {
+        CAFFE_ENFORCE_EQ(type, "uint8", "Unknown embedding type ", type);
+        RunBenchmark(type, block_size, 2 * sizeof(float), uint8_kernels);
+      }
+    }
+  }
+  return 0;
+}
@@ -31,7 +31,6 @@
 
 #include <algorithm>
 #include <fstream>
-#include <queue>
 #include <random>
 #include <string>
 #include <thread>
@@ -39,6 +38,7 @@
 #include "caffe2/core/common.h"
 #include "caffe2/core/db.h"
 #include "caffe2/core/init.h"
+#include "caffe2/db/parallel_convert.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/core/logging.h"
 
@@ -63,140 +63,93 @@ CAFFE2_DEFINE_int(
     num_threads,
     -1,
     "Number of image parsing and conversion threads.");
+CAFFE2_DEFINE_int(
+    num_shards,
+    1,
+    "The number of output dbs. If more than one, they are named "
+    "<output_db_name>_shard_<i>.");
+CAFFE2_DEFINE_bool(
+    ordered,
+    true,
+    "If true, every output db receives its images in list order.");
+CAFFE2_DEFINE_int(batch_size, 1000, "The write batch size.");
 
 namespace caffe2 {
 
-class Converter {
- public:
-  explicit Converter() {
-    data_ = protos_.add_protos();
-    label_ = protos_.add_protos();
-    if (caffe2::FLAGS_raw) {
-      data_->set_data_type(TensorProto::BYTE);
-      data_->add_dims(0);
-      data_->add_dims(0);
-      if (caffe2::FLAGS_color) {
-        data_->add_dims(3);
-      }
-    } else {
-      data_->set_data_type(TensorProto::STRING);
-      data_->add_dims(1);
-      data_->add_string_data("");
+// Serializes the image with the given label as a TensorProtos. Returns false
+// if it can not be read.
+bool ConvertImage(const std::pair<std::string, int>& pair, std::string* value) {
+  const auto& input_folder = caffe2::FLAGS_input_folder;
+  TensorProtos protos;
+  TensorProto* data = protos.add_protos();
+  TensorProto* label = protos.add_protos();
+  label->set_data_type(TensorProto::INT32);
+  label->add_dims(1);
+  label->add_int32_data(pair.second);
+
+  // Add raw file contents to DB if !raw
+  if (!caffe2::FLAGS_raw) {
+    std::ifstream image_file_stream(input_folder + pair.first);
+    if (!image_file_stream) {
+      LOG(ERROR) << "Cannot open " << input_folder << pair.first
+                 << ". Skipping.";
+      return false;
     }
-    label_->set_data_type(TensorProto::INT32);
-    label_->add_dims(1);
-    label_->add_int32_data(0);
-  }
-
-  ~Converter() {
-    if (thread_.joinable()) {
-      thread_.join();
+    data->set_data_type(TensorProto::STRING);
+    data->add_dims(1);
+    data->add_string_data()->assign(
+        std::istreambuf_iterator<char>(image_file_stream),
+        std::istreambuf_iterator<char>());
+  } else {
+    // Load image
+    cv::Mat img = cv::imread(
+        input_folder + pair.first,
+        caffe2::FLAGS_color ? CV_LOAD_IMAGE_COLOR
+                            : CV_LOAD_IMAGE_GRAYSCALE);
+    if (img.empty()) {
+      LOG(ERROR) << "Cannot decode " << input_folder << pair.first
+                 << ". Skipping.";
+      return false;
     }
-  }
-
-  void queue(const std::pair<std::string, int>& pair) {
-    in_.push(pair);
-  }
-
-  void start() {
-    thread_ = std::thread(&Converter::run, this);
-  }
 
-  std::string get() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    while (out_.empty()) {
-      cv_.wait(lock);
+    // Resize image
+    cv::Mat resized_img;
+    int scaled_width, scaled_height;
+    if (caffe2::FLAGS_warp) {
+      scaled_width = caffe2::FLAGS_scale;
+      scaled_height = caffe2::FLAGS_scale;
+    } else if (img.rows > img.cols) {
+      scaled_width = caffe2::FLAGS_scale;
+      scaled_height =
+          static_cast<float>(img.rows) * caffe2::FLAGS_scale / img.cols;
+    } else {
+      scaled_height = caffe2::FLAGS_scale;
+      scaled_width =
+          static_cast<float>(img.cols) * caffe2::FLAGS_scale / img.rows;
     }
-
-    auto value = out_.front();
-    out_.pop();
-    cv_.notify_one();
-    return value;
-  }
-
-  void run() {
-    const auto& input_folder = caffe2::FLAGS_input_folder;
-    std::unique_lock<std::mutex> lock(mutex_);
-    std::string value;
-    while (!in_.empty()) {
-      auto pair = in_.front();
-      in_.pop();
-      lock.unlock();
-
-      label_->set_int32_data(0, pair.second);
-
-      // Add raw file contents to DB if !raw
-      if (!caffe2::FLAGS_raw) {
-        std::ifstream image_file_stream(input_folder + pair.first);
-        if (!image_file_stream) {
-          LOG(ERROR) << "Cannot open " << input_folder << pair.first
-                     << ". Skipping.";
-        } else {
-          data_->mutable_string_data(0)->assign(
-              std::istreambuf_iterator<char>(image_file_stream),
-              std::istreambuf_iterator<char>());
-        }
-      } else {
-        // Load image
-        cv::Mat img = cv::imread(
-            input_folder + pair.first,
-            caffe2::FLAGS_color ? CV_LOAD_IMAGE_COLOR
-                                : CV_LOAD_IMAGE_GRAYSCALE);
-
-        // Resize image
-        cv::Mat resized_img;
-        int scaled_width, scaled_height;
-        if (caffe2::FLAGS_warp) {
-          scaled_width = caffe2::FLAGS_scale;
-          scaled_height = caffe2::FLAGS_scale;
-        } else if (img.rows > img.cols) {
-          scaled_width = caffe2::FLAGS_scale;
-          scaled_height =
-              static_cast<float>(img.rows) * caffe2::FLAGS_scale / img.cols;
-        } else {
-          scaled_height = caffe2::FLAGS_scale;
-          scaled_width =
-              static_cast<float>(img.cols) * caffe2::FLAGS_scale / img.rows;
-        }
-        cv::resize(
-            img,
-            resized_img,
-            cv::Size(scaled_width, scaled_height),
-            0,
-            0,
-            cv::INTER_LINEAR);
-        data_->set_dims(0, scaled_height);
-        data_->set_dims(1, scaled_width);
-
-        // Assert we don't have to deal with alignment
-        DCHECK(resized_img.isContinuous());
-        auto nbytes = resized_img.total() * resized_img.elemSize();
-        data_->set_byte_data(resized_img.ptr(), nbytes);
-      }
-
-      protos_.SerializeToString(&value);
-
-      // Add serialized proto to out queue or wait if it is not empty
-      lock.lock();
-      while (!out_.empty()) {
-        cv_.wait(lock);
-      }
-      out_.push(value);
-      cv_.notify_one();
+    cv::resize(
+        img,
+        resized_img,
+        cv::Size(scaled_width, scaled_height),
+        0,
+        0,
+        cv::INTER_LINEAR);
+    data->set_data_type(TensorProto::BYTE);
+    data->add_dims(scaled_height);
+    data->add_dims(scaled_width);
+    if (caffe2::FLAGS_color) {
+      data->add_dims(3);
     }
-  }
 
- protected:
-  TensorProtos protos_;
-  TensorProto* data_;
-  TensorProto* label_;
-  std::queue<std::pair<std::string, int>> in_;
-  std::queue<std::string> out_;
+    // Assert we don't have to deal with alignment
+    DCHECK(resized_img.isContinuous());
+    auto nbytes = resized_img.total() * resized_img.elemSize();
+    data->set_byte_data(resized_img.ptr(), nbytes);
+  }
 
-  std::mutex mutex_;
-  std::condition_variable cv_;
-  std::thread thread_;
-};
+  protos.SerializeToString(value);
+  return true;
+}
 
 void ConvertImageDataset(
     const string& input_folder,
@@ -222,49 +175,49 @@ void ConvertImageDataset(
   }
 
   LOG(INFO) << "Processing " << lines.size() << " images...";
-  LOG(INFO) << "Opening DB " << output_db_name;
-
-  auto db = db::CreateDB(caffe2::FLAGS_db, output_db_name, db::NEW);
-  auto transaction = db->NewTransaction();
-
-  LOG(INFO) << "Using " << num_threads << " processing threads...";
-  std::vector<Converter> converters(num_threads);
-
-  // Queue entries across converters
-  for (auto i = 0; i < lines.size(); i++) {
-    converters[i % converters.size()].queue(lines[i]);
+  std::vector<std::unique_ptr<db::DB>> dbs;
+  std::vector<db::DB*> outputs;
+  for (const auto& name :
+       db::ShardedDBNames(output_db_name, caffe2::FLAGS_num_shards)) {
+    LOG(INFO) << "Opening DB " << name;
+    dbs.push_back(db::CreateDB(caffe2::FLAGS_db, name, db::NEW));
+    CAFFE_ENFORCE(dbs.back(), "Cannot create db: ", name);
+    outputs.push_back(dbs.back().get());
   }
 
-  // Start all converters
-  for (auto& converter : converters) {
-    converter.start();
-  }
-
-  constexpr auto key_max_length = 256;
-  char key_cstr[key_max_length];
-  string value;
-  int count = 0;
-  for (auto i = 0; i < lines.size(); i++) {
-    // Get serialized proto for this entry
-    auto value = converters[i % converters.size()].get();
-
-    // Synthesize key for this entry
+  // Keys are synthesized while reading the list, images are decoded, resized
+  // and serialized by the worker threads.
+  size_t next_line = 0;
+  auto source = [&](std::string* key, std::string* value) {
+    if (next_line == lines.size()) {
+      return false;
+    }
+    constexpr auto key_max_length = 256;
+    char key_cstr[key_max_length];
     auto key_len = snprintf(
-        key_cstr, sizeof(key_cstr), "%08d_%s", i, lines[i].first.c_str());
+        key_cstr,
+        sizeof(key_cstr),
+        "%08d_%s",
+        static_cast<int>(next_line),
+        lines[next_line].first.c_str());
     DCHECK_LE(key_len, sizeof(key_cstr));
+    key->assign(key_cstr);
+    value->clear();
+    next_line++;
+    return true;
+  };
+  auto transform = [&](int64_t index, std::string* /*key*/,
+                       std::string* value) {
+    return ConvertImage(lines[index], value);
+  };
 
-    // Put in db
-    transaction->Put(string(key_cstr), value);
-
-    if (++count % 1000 == 0) {
-      // Commit the current writes.
-      transaction->Commit();
-      LOG(INFO) << "Processed " << count << " files.";
-    }
-  }
-
-  // Commit final transaction
-  transaction->Commit();
+  LOG(INFO) << "Using " << num_threads << " processing threads...";
+  db::ParallelConvertOptions options;
+  options.num_workers = num_threads;
+  options.ordered = caffe2::FLAGS_ordered;
+  options.batch_size = caffe2::FLAGS_batch_size;
+  options.report_interval = 1000;
+  auto count = db::ParallelConvert(source, transform, outputs, options);
   LOG(INFO) << "Processed " << count << " files.";
 }
 
@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/net_dag_utils.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(net, "", "The net to analyze.");
+CAFFE2_DEFINE_string(
+    init_net,
+    "",
+    "The given net to initialize any parameters.");
+CAFFE2_DEFINE_string(
+    input,
+    "",
+    "Comma separated names of the float input tensors of the net.");
+CAFFE2_DEFINE_string(
+    input_dims,
+    "",
+    "Dimensions of the inputs, comma separated numbers for each input, "
+    "semicolon separated between inputs.");
+CAFFE2_DEFINE_int(warmup, 1, "The number of iterations to warm up.");
+CAFFE2_DEFINE_int(
+    iter,
+    10,
+    "The number of iterations used to measure operator times.");
+CAFFE2_DEFINE_int(
+    max_threads,
+    0,
+    "Largest number of worker threads to predict the speedup for, "
+    "0 means the number of hardware threads.");
+CAFFE2_DEFINE_int(
+    top_ops,
+    10,
+    "Number of the most expensive critical path operators to print.");
+
+using std::string;
+using std::vector;
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::Workspace workspace;
+
+  caffe2::NetDef init_net_def;
+  if (caffe2::FLAGS_init_net.size()) {
+    CAFFE_ENFORCE(ReadProtoFromFile(caffe2::FLAGS_init_net, &init_net_def));
+    CAFFE_ENFORCE(workspace.RunNetOnce(init_net_def));
+  }
+
+  if (caffe2::FLAGS_input.size()) {
+    vector<string> input_names = caffe2::split(',', caffe2::FLAGS_input);
+    vector<string> input_dims_list =
+        caffe2::split(';', caffe2::FLAGS_input_dims);
+    CAFFE_ENFORCE_EQ(
+        input_names.size(),
+        input_dims_list.size(),
+        "Input name and dims should have the same number of items.");
+    for (size_t i = 0; i < input_names.size(); ++i) {
+      vector<int> input_dims;
+      for (const string& s : caffe2::split(',', input_dims_list[i])) {
+        input_dims.push_back(std::stoi(s));
+      }
+      auto* tensor =
+          workspace.CreateBlob(input_names[i])->GetMutable<caffe2::TensorCPU>();
+      tensor->Resize(input_dims);
+      tensor->mutable_data<float>();
+    }
+  }
+
+  auto net_def = std::make_shared<caffe2::NetDef>();
+  CAFFE_ENFORCE(ReadProtoFromFile(caffe2::FLAGS_net, net_def.get()));
+
+  // Measure operator times one by one on a simple net, so that the numbers
+  // are not skewed by other operators running concurrently
+  caffe2::NetDef simple_net_def(*net_def);
+  simple_net_def.set_type("simple");
+  auto* net = workspace.CreateNet(simple_net_def);
+  CAFFE_ENFORCE(net);
+  auto times = net->TEST_Benchmark(
+      caffe2::FLAGS_warmup, caffe2::FLAGS_iter, /* run_individual */ true);
+  // First element is the time of the whole net
+  vector<float> op_times(times.begin() + 1, times.end());
+
+  int max_threads = caffe2::FLAGS_max_threads > 0
+      ? caffe2::FLAGS_max_threads
+      : std::max<int>(std::thread::hardware_concurrency(), 1);
+  auto analysis = caffe2::dag_utils::analyzeParallelism(
+      net_def, &workspace, op_times, max_threads);
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Total operator time:  " << analysis.total_time << " ms"
+            << std::endl;
+  std::cout << "Critical path time:   " << analysis.critical_path_time << " ms"
+            << " (" << analysis.critical_path.size() << " operators)"
+            << std::endl;
+  std::cout << "Average parallelism:  " << analysis.average_parallelism
+            << std::endl;
+
+  std::cout << std::endl << "threads  predicted ms  speedup" << std::endl;
+  int recommended_threads = max_threads;
+  // List scheduling is not monotonic in the number of threads
+  const float best_time = *std::min_element(
+      analysis.predicted_time.begin(), analysis.predicted_time.end());
+  for (int i = 0; i < analysis.predicted_time.size(); ++i) {
+    std::cout << std::setw(7) << i + 1 << std::setw(14)
+              << analysis.predicted_time[i] << std::setw(9)
+              << analysis.predicted_speedup[i] << std::endl;
+    // Smallest pool within 5% of the best achievable time
+    if (recommended_threads == max_threads &&
+        analysis.predicted_time[i] <= best_time * 1.05f) {
+      recommended_threads = i + 1;
+    }
+  }
+  std::cout << "Suggested --caffe2_net_async_cpu_pool_size: "
+            << recommended_threads << std::endl;
+
+  // Speeding up operators on the critical path is what shortens the run
+  vector<int> critical_ops(analysis.critical_path);
+  std::sort(critical_ops.begin(), critical_ops.end(), [&](int a, int b) {
+    return op_times[a] > op_times[b];
+  });
+  if (critical_ops.size() > caffe2::FLAGS_top_ops) {
+    critical_ops.resize(caffe2::FLAGS_top_ops);
+  }
+  std::cout << std::endl
+            << "Most expensive operators on the critical path:" << std::endl;
+  for (auto op_idx : critical_ops) {
+    const auto& op_def = net_def->op(op_idx);
+    std::cout << std::setw(10) << op_times[op_idx] << " ms  #" << op_idx
+              << " " << op_def.type() << " "
+              << (op_def.name().size()
+                      ? op_def.name()
+                      : (op_def.output_size() ? op_def.output(0) : ""))
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Closed-loop load generator for PredictorBatcher: every client thread sends
+// a request, waits for its result and sends the next one. Sweeping the number
+// of clients gives latency percentiles against throughput, with and without
+// request batching.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/predictor_batcher.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(init_net, "", "The given net to initialize parameters.");
+CAFFE2_DEFINE_string(net, "", "The given net to serve.");
+CAFFE2_DEFINE_string(
+    input_dims,
+    "1,1",
+    "Dimensions of the float input of a single request, comma separated. "
+    "The first dimension is the number of rows in a request.");
+CAFFE2_DEFINE_string(
+    clients,
+    "1,2,4,8,16,32",
+    "Comma separated numbers of concurrent clients to sweep.");
+CAFFE2_DEFINE_int(seconds, 5, "Seconds to run for each number of clients.");
+CAFFE2_DEFINE_bool(batching, true, "Whether to batch requests.");
+CAFFE2_DEFINE_int(max_batch_size, 64, "Max number of rows in a batch.");
+CAFFE2_DEFINE_int(max_wait_us, 1000, "Max time a request waits for a batch.");
+
+using std::string;
+using std::vector;
+
+namespace {
+
+struct RunResult {
+  double qps;
+  double p50_us;
+  double p90_us;
+  double p99_us;
+  int errors;
+};
+
+double percentile(vector<double>& latencies, double p) {
+  if (latencies.empty()) {
+    return 0;
+  }
+  size_t idx = std::min(
+      latencies.size() - 1, static_cast<size_t>(p * latencies.size()));
+  std::nth_element(latencies.begin(), latencies.begin() + idx, latencies.end());
+  return latencies[idx];
+}
+
+RunResult runClients(
+    caffe2::Predictor* predictor,
+    caffe2::PredictorBatcher* batcher,
+    const vector<caffe2::TIndex>& dims,
+    int num_clients) {
+  std::mutex predictor_mutex;
+  std::mutex latencies_mutex;
+  vector<double> latencies;
+  std::atomic<int> errors(0);
+  auto end_time = std::chrono::steady_clock::now() +
+      std::chrono::seconds(caffe2::FLAGS_seconds);
+
+  vector<std::thread> threads;
+  for (int c = 0; c < num_clients; ++c) {
+    threads.emplace_back([&]() {
+      caffe2::TensorCPU input(dims);
+      auto* data = input.mutable_data<float>();
+      for (int i = 0; i < input.size(); ++i) {
+        data[i] = static_cast<float>(i % 7) / 7;
+      }
+      vector<double> local_latencies;
+      while (std::chrono::steady_clock::now() < end_time) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok;
+        if (batcher) {
+          caffe2::PredictorBatcher::OutputVector outputs;
+          ok = batcher->run({&input}, &outputs);
+        } else {
+          std::lock_guard<std::mutex> lock(predictor_mutex);
+          caffe2::Predictor::TensorVector outputs;
+          ok = predictor->run({&input}, &outputs);
+        }
+        if (!ok) {
+          ++errors;
+        }
+        local_latencies.push_back(
+            std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start)
+                .count());
+      }
+      std::lock_guard<std::mutex> lock(latencies_mutex);
+      latencies.insert(
+          latencies.end(), local_latencies.begin(), local_latencies.end());
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  RunResult result;
+  result.qps = static_cast<double>(latencies.size()) / caffe2::FLAGS_seconds;
+  result.p50_us = percentile(latencies, 0.5);
+  result.p90_us = percentile(latencies, 0.9);
+  result.p99_us = percentile(latencies, 0.99);
+  result.errors = errors;
+  return result;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+
+  caffe2::NetDef init_net, net;
+  CAFFE_ENFORCE(ReadProtoFromFile(caffe2::FLAGS_init_net, &init_net));
+  CAFFE_ENFORCE(ReadProtoFromFile(caffe2::FLAGS_net, &net));
+  caffe2::Predictor predictor(init_net, net);
+
+  vector<caffe2::TIndex> dims;
+  for (const auto& d : caffe2::split(',', caffe2::FLAGS_input_dims)) {
+    dims.push_back(std::stoi(d));
+  }
+
+  std::unique_ptr<caffe2::PredictorBatcher> batcher;
+  if (caffe2::FLAGS_batching) {
+    caffe2::PredictorBatcher::Options options;
+    options.max_batch_size = caffe2::FLAGS_max_batch_size;
+    options.max_wait = std::chrono::microseconds(caffe2::FLAGS_max_wait_us);
+    batcher.reset(new caffe2::PredictorBatcher(&predictor, options));
+  }
+
+  LOG(INFO) << "clients\tqps\tp50_us\tp90_us\tp99_us\terrors";
+  for (const auto& clients : caffe2::split(',', caffe2::FLAGS_clients)) {
+    int num_clients = std::stoi(clients);
+    auto result = runClients(&predictor, batcher.get(), dims, num_clients);
+    LOG(INFO) << num_clients << "\t" << result.qps << "\t" << result.p50_us
+              << "\t" << result.p90_us << "\t" << result.p99_us << "\t"
+              << result.errors;
+  }
+
+  if (batcher) {
+    for (const auto& stat : caffe2::StatRegistry::get().publish()) {
+      if (stat.key.find("predictor_batcher/") == 0) {
+        LOG(INFO) << stat.key << ": " << stat.value;
+      }
+    }
+  }
+  return 0;
+}
@@ -19,6 +19,7 @@
 
 #include "caffe2/core/db.h"
 #include "caffe2/core/init.h"
+#include "caffe2/db/parallel_convert.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/core/logging.h"
 
@@ -26,6 +27,7 @@ CAFFE2_DEFINE_string(input_db, "", "The input db.");
 CAFFE2_DEFINE_int(splits, 0, "The number of splits.");
 CAFFE2_DEFINE_string(db_type, "", "The db type.");
 CAFFE2_DEFINE_int(batch_size, 1000, "The write batch size.");
+CAFFE2_DEFINE_int(report_interval, 10000, "The progress report interval.");
 
 namespace caffe2 {
 
@@ -45,28 +47,20 @@ static int Split(int argc, char** argv) {
       cursor != nullptr, "Cannot obtain cursor for input db: ", FLAGS_input_db);
 
   vector<unique_ptr<db::DB>> out_dbs;
-  vector<unique_ptr<db::Transaction>> transactions;
+  vector<db::DB*> outputs;
   for (int i = 0; i < FLAGS_splits; ++i) {
     out_dbs.push_back(unique_ptr<db::DB>(db::CreateDB(
         FLAGS_db_type, FLAGS_input_db + "_split_" + to_string(i), db::NEW)));
     CAFFE_ENFORCE(out_dbs.back().get(), "Cannot create output db #", i);
-    transactions.push_back(
-        unique_ptr<db::Transaction>(out_dbs[i]->NewTransaction()));
-    CAFFE_ENFORCE(
-        transactions.back().get(), "Cannot get transaction for output db #", i);
+    outputs.push_back(out_dbs.back().get());
   }
 
-  int count = 0;
-  for (; cursor->Valid(); cursor->Next()) {
-    transactions[count % FLAGS_splits]->Put(cursor->key(), cursor->value());
-    if (++count % FLAGS_batch_size == 0) {
-      for (int i = 0; i < FLAGS_splits; ++i) {
-        transactions[i]->Commit();
-      }
-      LOG(INFO) << "Split " << count << " items so far.";
-    }
-  }
-  LOG(INFO) << "A total of " << count << " items processed.";
+  // Item i goes to split i % splits, each split is written by its own thread
+  db::ParallelConvertOptions options;
+  options.batch_size = FLAGS_batch_size;
+  options.report_interval = FLAGS_report_interval;
+  db::ParallelConvert(
+      db::CursorSource(cursor.get()), nullptr, outputs, options);
   return 0;
 }
 
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/utils/thread_pool.h"
+#include "caffe2/utils/work_stealing_thread_pool.h"
+
+using namespace caffe2;
+
+namespace {
+// Mimics the async net executors: a number of independent chains, each made
+// of tiny tasks where every task schedules its successor from a pool thread.
+template <class Pool>
+void RunChains(benchmark::State& state) {
+  const int kNumChains = 256;
+  const int kChainLength = 16;
+
+  // Everything the workers touch is declared before the pool, and the pool is
+  // torn down explicitly below, so no worker can outlive chain_step.
+  std::function<void(int)> chain_step;
+  std::atomic<int> remaining_chains(0);
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  std::unique_ptr<Pool> pool(new Pool(state.range(0)));
+
+  chain_step = [&](int step) {
+    if (step + 1 < kChainLength) {
+      pool->run([&chain_step, step]() { chain_step(step + 1); });
+    } else if (--remaining_chains == 0) {
+      std::lock_guard<std::mutex> lock(done_mutex);
+      done_cv.notify_one();
+    }
+  };
+
+  while (state.KeepRunning()) {
+    remaining_chains = kNumChains;
+    for (int i = 0; i < kNumChains; ++i) {
+      pool->run([&chain_step]() { chain_step(0); });
+    }
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&remaining_chains]() { return remaining_chains == 0; });
+  }
+  // Joins the workers while chain_step and the counters are still alive.
+  pool.reset();
+  state.SetItemsProcessed(state.iterations() * kNumChains * kChainLength);
+}
+} // namespace
+
+static void BM_ChainDispatchTaskThreadPool(benchmark::State& state) {
+  RunChains<TaskThreadPool>(state);
+}
+BENCHMARK(BM_ChainDispatchTaskThreadPool)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->UseRealTime();
+
+static void BM_ChainDispatchWorkStealingThreadPool(benchmark::State& state) {
+  RunChains<WorkStealingThreadPool>(state);
+}
+BENCHMARK(BM_ChainDispatchWorkStealingThreadPool)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->UseRealTime();
+
+BENCHMARK_MAIN()
@@ -1,6 +1,7 @@
 #ifndef CAFFE2_CORE_BLOB_H_
 #define CAFFE2_CORE_BLOB_H_
 
+#include <atomic>
 #include <cstddef>
 #include <sstream>
 #include <typeinfo>
@@ -15,6 +16,11 @@
 
 namespace caffe2 {
 
+// Rows of a tensor updated in place since its last incremental checkpoints,
+// see tensor_delta.h
+class DirtyRows;
+void DestroyDirtyRows(DirtyRows* rows);
+
 /**
  * @brief Blob is a general container that hosts a typed pointer.
  *
@@ -28,12 +34,18 @@ class Blob {
    * Initializes an empty Blob.
    */
   Blob() : meta_(), pointer_(nullptr) {}
-  ~Blob() { Reset(); }
+  ~Blob() {
+    Reset();
+    if (dirty_rows_.load(std::memory_order_relaxed)) {
+      DestroyDirtyRows(dirty_rows_.load(std::memory_order_relaxed));
+    }
+  }
 
   Blob(Blob&& other) noexcept
       : meta_(std::move(other.meta_)),
         pointer_(std::move(other.pointer_)),
-        destroy_(std::move(other.destroy_)) {
+        destroy_(std::move(other.destroy_)),
+        dirty_rows_(other.dirty_rows_.exchange(nullptr)) {
     other.meta_ = {};
     other.pointer_ = nullptr;
     other.destroy_ = nullptr;
@@ -43,6 +55,11 @@ class Blob {
     meta_ = std::move(other.meta_);
     pointer_ = std::move(other.pointer_);
     destroy_ = std::move(other.destroy_);
+    auto* dirty_rows =
+        dirty_rows_.exchange(other.dirty_rows_.exchange(nullptr));
+    if (dirty_rows) {
+      DestroyDirtyRows(dirty_rows);
+    }
     other.meta_ = {};
     other.pointer_ = nullptr;
     other.destroy_ = nullptr;
@@ -216,6 +233,10 @@ class Blob {
   TypeMeta meta_;
   void* pointer_ = nullptr;
   DestroyCall destroy_ = nullptr;
+  // Owned by the blob so that tracking ends with it, managed by
+  // DirtyRowTracker
+  mutable std::atomic<DirtyRows*> dirty_rows_{nullptr};
+  friend class DirtyRowTracker;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };
@@ -2,8 +2,10 @@
 
 #include <sstream>
 #include <mutex>
+#include <regex>
 
 #include "caffe2/core/blob.h"
+#include "caffe2/perfkernels/fused_8bit_rowwise_conversion.h"
 #include "caffe2/utils/proto_utils.h"
 
 CAFFE2_DEFINE_int(
@@ -16,11 +18,24 @@ CAFFE2_DEFINE_int(
     16,
     "Maximal number of threads that can be used for tensor serialization");
 
+CAFFE2_DEFINE_int(
+    caffe2_max_tensor_deserializer_threads,
+    1,
+    "Maximal number of threads that can be used by the Load operator to "
+    "deserialize tensor chunks of CPU tensors. 1 deserializes on the calling "
+    "thread; above that, threads are started as the loaded data grows");
+
 CAFFE2_DEFINE_bool(
     caffe2_serialize_fp16_as_bytes,
     false,
     "Serialize FLOAT16 tensors using byte_data field");
 
+CAFFE2_DEFINE_string(
+    caffe2_serialize_rowwise_quantized_blobs,
+    "",
+    "Regular expression matching the names of the float CPU matrices to "
+    "serialize with lossy fused 8-bit row-wise quantization");
+
 namespace caffe2 {
 /**
  * @brief StringSerializer is the serializer for String.
@@ -61,12 +76,162 @@ class StringDeserializer : public BlobDeserializerBase {
   }
 };
 
+/**
+ * @brief Fused8BitRowwiseQuantizedSerializer is a lossy serializer for float
+ * matrices.
+ *
+ * Each row is quantized to 8 bits with its own scale and bias, which makes
+ * the serialized tensor about 4 times smaller. Chunks hold whole rows.
+ */
+class Fused8BitRowwiseQuantizedSerializer : public BlobSerializerBase {
+ public:
+  void Serialize(
+      const Blob& blob,
+      const string& name,
+      SerializationAcceptor acceptor) override {
+    SerializeWithChunkSize(blob, name, acceptor, kDefaultChunkSize);
+  }
+
+  void SerializeWithChunkSize(
+      const Blob& blob,
+      const string& name,
+      SerializationAcceptor acceptor,
+      int chunk_size) override {
+    const auto& tensor = blob.Get<TensorCPU>();
+    CAFFE_ENFORCE_EQ(tensor.ndim(), 2, "Expect ", name, " to be a matrix");
+    const auto rows = tensor.dim(0);
+    const auto columns = tensor.dim(1);
+    const auto fused_columns = columns + 8;
+    TIndex rows_per_chunk = std::max<TIndex>(rows, 1);
+    if (chunk_size != kNoChunking) {
+      if (chunk_size == kDefaultChunkSize) {
+        chunk_size = FLAGS_caffe2_tensor_chunk_size;
+      }
+      rows_per_chunk =
+          std::max<TIndex>(chunk_size / std::max<TIndex>(columns, 1), 1);
+    }
+
+    for (TIndex begin = 0; begin < std::max<TIndex>(rows, 1);
+         begin += rows_per_chunk) {
+      const auto end = std::min(begin + rows_per_chunk, rows);
+      BlobProto blob_proto;
+      blob_proto.set_name(name);
+      blob_proto.set_type(kFused8BitRowwiseTensorBlobType);
+      TensorProto& proto = *blob_proto.mutable_tensor();
+      proto.set_name(name);
+      proto.add_dims(rows);
+      proto.add_dims(fused_columns);
+      // BYTE, unlike UINT8, is stored in byte_data
+      proto.set_data_type(TensorProto_DataType_BYTE);
+      proto.mutable_segment()->set_begin(begin * fused_columns);
+      proto.mutable_segment()->set_end(end * fused_columns);
+      auto* bytes = proto.mutable_byte_data();
+      bytes->resize((end - begin) * fused_columns);
+      if (end > begin) {
+        FloatToFused8BitRowwiseQuantized(
+            tensor.data<float>() + begin * columns,
+            end - begin,
+            columns,
+            reinterpret_cast<uint8_t*>(&(*bytes)[0]));
+      }
+      acceptor(
+          MakeString(name, kChunkIdSeparator, begin / rows_per_chunk),
+          blob_proto.SerializeAsString());
+    }
+  }
+};
+
+/**
+ * @brief Fused8BitRowwiseQuantizedDeserializer dequantizes the chunks written
+ * by Fused8BitRowwiseQuantizedSerializer into a float TensorCPU.
+ */
+class Fused8BitRowwiseQuantizedDeserializer : public BlobDeserializerBase {
+ public:
+  void Deserialize(const BlobProto& blob_proto, Blob* blob) override {
+    const auto& proto = blob_proto.tensor();
+    CAFFE_ENFORCE(
+        proto.data_type() == TensorProto_DataType_BYTE &&
+            proto.dims_size() == 2 && proto.dims(1) >= 8,
+        "Invalid row-wise quantized tensor ",
+        blob_proto.name());
+    const auto rows = proto.dims(0);
+    const auto fused_columns = proto.dims(1);
+    auto* tensor = blob->GetMutable<TensorCPU>();
+    tensor->Resize(rows, fused_columns - 8);
+    auto* data = tensor->mutable_data<float>();
+
+    int64_t begin = 0;
+    int64_t end = rows * fused_columns;
+    if (proto.has_segment()) {
+      begin = proto.segment().begin();
+      end = proto.segment().end();
+    }
+    CAFFE_ENFORCE(
+        0 <= begin && begin <= end && end <= rows * fused_columns &&
+            begin % fused_columns == 0 && end % fused_columns == 0,
+        "Invalid chunk ",
+        begin,
+        ' ',
+        end,
+        " of row-wise quantized tensor ",
+        blob_proto.name());
+    CAFFE_ENFORCE_EQ(
+        end - begin, proto.byte_data().size(), "Incorrect proto field size.");
+    if (end > begin) {
+      Fused8BitRowwiseQuantizedToFloat(
+          reinterpret_cast<const uint8_t*>(proto.byte_data().data()),
+          (end - begin) / fused_columns,
+          fused_columns,
+          data + begin / fused_columns * (fused_columns - 8));
+    }
+  }
+};
+
+namespace {
+// The regular expression of --caffe2_serialize_rowwise_quantized_blobs,
+// compiled again only when the flag changes
+class RowwiseQuantizedBlobs {
+ public:
+  bool Match(const string& name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (pattern_ != FLAGS_caffe2_serialize_rowwise_quantized_blobs) {
+      pattern_ = FLAGS_caffe2_serialize_rowwise_quantized_blobs;
+      regex_ = std::regex(pattern_);
+    }
+    return std::regex_match(name, regex_);
+  }
+
+ private:
+  std::mutex mutex_;
+  string pattern_;
+  std::regex regex_;
+};
+
+bool serializeRowwiseQuantized(const Blob& blob, const string& name) {
+  if (FLAGS_caffe2_serialize_rowwise_quantized_blobs.empty() ||
+      !blob.IsType<TensorCPU>()) {
+    return false;
+  }
+  const auto& tensor = blob.Get<TensorCPU>();
+  if (!tensor.IsType<float>() || tensor.ndim() != 2) {
+    return false;
+  }
+  static RowwiseQuantizedBlobs blobs;
+  return blobs.Match(name);
+}
+} // namespace
+
 // The blob serialization member function implementation.
 void Blob::Serialize(
     const string& name,
     BlobSerializerBase::SerializationAcceptor acceptor,
     int chunk_size) const {
-  std::unique_ptr<BlobSerializerBase> serializer(CreateSerializer(meta_.id()));
+  std::unique_ptr<BlobSerializerBase> serializer;
+  if (serializeRowwiseQuantized(*this, name)) {
+    serializer.reset(new Fused8BitRowwiseQuantizedSerializer());
+  } else {
+    serializer = CreateSerializer(meta_.id());
+  }
   CAFFE_ENFORCE(serializer, "No known serializer for ", meta_.name());
   serializer->SerializeWithChunkSize(*this, name, acceptor, chunk_size);
 }
@@ -135,5 +300,9 @@ REGISTER_BLOB_DESERIALIZER(TensorCPU, TensorDeserializer<CPUContext>);
 // Serialize std::string
 REGISTER_BLOB_SERIALIZER((TypeMeta::Id<std::string>()), StringSerializer);
 REGISTER_BLOB_DESERIALIZER(std::string, StringDeserializer);
+// Row-wise quantized float matrices, selected by name when serializing
+REGISTER_BLOB_DESERIALIZER(
+    Fused8BitRowwiseQuantizedTensor,
+    Fused8BitRowwiseQuantizedDeserializer);
 }  // namespace
 }  // namespace caffe2
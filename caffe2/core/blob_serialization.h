@@ -15,11 +15,18 @@
 
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
 CAFFE2_DECLARE_int(caffe2_max_tensor_serializer_threads);
+CAFFE2_DECLARE_int(caffe2_max_tensor_deserializer_threads);
 CAFFE2_DECLARE_bool(caffe2_serialize_fp16_as_bytes);
+CAFFE2_DECLARE_string(caffe2_serialize_rowwise_quantized_blobs);
 
 namespace caffe2 {
 
 constexpr auto kTensorBlobType = "Tensor";
+// Float matrices stored with fused 8-bit row-wise quantization. The tensor of
+// the BlobProto is the BYTE matrix of quantized rows followed by their scale
+// and bias, as produced by FloatToFused8BitRowwiseQuantized.
+constexpr auto kFused8BitRowwiseTensorBlobType =
+    "Fused8BitRowwiseQuantizedTensor";
 // String used to separate chunk id from the blob name when storing in DB
 constexpr auto kChunkIdSeparator = "#%";
 
@@ -102,6 +109,13 @@ class TensorDeserializer : public BlobDeserializerBase {
  public:
   void Deserialize(const BlobProto& proto, Blob* blob) override;
   void Deserialize(const TensorProto& proto, Tensor<Context>* tensor);
+
+  // Allocates tensor with the shape and type of proto without filling it, so
+  // that the chunks of the tensor can then be deserialized concurrently
+  static void Preallocate(const TensorProto& proto, Tensor<Context>* tensor);
+  // Deserializes the chunk in proto into tensor, which has to have the shape
+  // of proto already. Only the data of the chunk is written.
+  void DeserializeChunk(const TensorProto& proto, Tensor<Context>* tensor);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -419,15 +433,38 @@ template <class Context>
 void TensorDeserializer<Context>::Deserialize(
     const TensorProto& proto,
     Tensor<Context>* tensor) {
-  // We create a local context for deserializing. Since Caffe2 contexts are
-  // usually lightweighted, this should not involve too much overhead.
-  Context context(proto.device_detail());
-  context.SwitchToDevice(0);
   vector<TIndex> dims;
   for (const TIndex d : proto.dims()) {
     dims.push_back(d);
   }
   tensor->Resize(dims);
+  DeserializeChunk(proto, tensor);
+}
+
+template <class Context>
+void TensorDeserializer<Context>::Preallocate(
+    const TensorProto& proto,
+    Tensor<Context>* tensor) {
+  vector<TIndex> dims;
+  for (const TIndex d : proto.dims()) {
+    dims.push_back(d);
+  }
+  tensor->Resize(dims);
+  // BYTE is the deprecated name of UINT8
+  tensor->raw_mutable_data(DataTypeToTypeMeta(
+      proto.data_type() == TensorProto_DataType_BYTE
+          ? TensorProto_DataType_UINT8
+          : proto.data_type()));
+}
+
+template <class Context>
+void TensorDeserializer<Context>::DeserializeChunk(
+    const TensorProto& proto,
+    Tensor<Context>* tensor) {
+  // We create a local context for deserializing. Since Caffe2 contexts are
+  // usually lightweighted, this should not involve too much overhead.
+  Context context(proto.device_detail());
+  context.SwitchToDevice(0);
 
   int64_t chunkBegin = 0;
   auto chunkEnd = tensor->size();
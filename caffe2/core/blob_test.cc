@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -12,6 +13,7 @@
 #include "caffe2/core/qtensor.h"
 #include "caffe2/core/qtensor_serialization.h"
 #include "caffe2/core/registry.h"
+#include "caffe2/core/scope_guard.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/core/types.h"
 #include "caffe2/core/workspace.h"
@@ -20,7 +22,9 @@
 
 CAFFE2_DEFINE_int64(caffe2_test_big_tensor_size, 100000000, "");
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
+CAFFE2_DECLARE_int(caffe2_max_tensor_deserializer_threads);
 CAFFE2_DECLARE_bool(caffe2_serialize_fp16_as_bytes);
+CAFFE2_DECLARE_string(caffe2_serialize_rowwise_quantized_blobs);
 
 namespace caffe2 {
 using namespace ::caffe2::db;
@@ -640,6 +644,9 @@ TEST(QTensorTest, QTensorSerialization) {
 
 using StringMap = std::vector<std::pair<string, string>>;
 
+// Reading this key from a VectorCursor throws, like a corrupted DB would
+const char* kCorruptKey = "corrupt_record";
+
 class VectorCursor : public db::Cursor {
  public:
   explicit VectorCursor(StringMap* data) : data_(data) {
@@ -652,6 +659,7 @@ class VectorCursor : public db::Cursor {
     ++pos_;
   }
   string key() override {
+    CAFFE_ENFORCE((*data_)[pos_].first != kCorruptKey, "Corrupted record");
     return (*data_)[pos_].first;
   }
   string value() override {
@@ -883,6 +891,213 @@ TEST(ContentChunks, Serialization) {
   }
 }
 
+TEST(ParallelLoad, ChunkedTensors) {
+  auto old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  auto old_threads = FLAGS_caffe2_max_tensor_deserializer_threads;
+  FLAGS_caffe2_tensor_chunk_size = 100;
+  auto guard = MakeGuard([&]() {
+    FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+    FLAGS_caffe2_max_tensor_deserializer_threads = old_threads;
+  });
+
+  const int kNumTensors = 8;
+  const int kTensorSize = 1050;
+  StringMap data;
+  std::mutex mutex;
+  auto acceptor = [&](const std::string& key, const std::string& value) {
+    std::lock_guard<std::mutex> guard(mutex);
+    data.emplace_back(key, value);
+  };
+  std::vector<string> names;
+  for (int i = 0; i < kNumTensors; ++i) {
+    Blob blob;
+    auto* tensor = blob.GetMutable<TensorCPU>();
+    tensor->Resize(kTensorSize / 10, 10);
+    for (int j = 0; j < kTensorSize; ++j) {
+      tensor->mutable_data<int64_t>()[j] = i * kTensorSize + j;
+    }
+    names.push_back("tensor_" + caffe2::to_string(i));
+    blob.Serialize(names.back(), acceptor);
+  }
+  {
+    Blob blob;
+    auto* tensor = blob.GetMutable<TensorCPU>();
+    tensor->Resize(250);
+    for (int j = 0; j < tensor->size(); ++j) {
+      tensor->mutable_data<string>()[j] = caffe2::to_string(j);
+    }
+    names.push_back("strings");
+    blob.Serialize(names.back(), acceptor);
+  }
+  {
+    Blob blob;
+    blob.GetMutable<DummyType>()->n_chunks = 10;
+    names.push_back("dummy");
+    blob.Serialize(names.back(), acceptor);
+  }
+  // Chunks of the same tensor are not necessarily stored next to each other
+  std::reverse(data.begin(), data.end());
+
+  for (int threads : {1, 4}) {
+    FLAGS_caffe2_max_tensor_deserializer_threads = threads;
+    string db_source = (string)std::tmpnam(nullptr);
+    VectorDB::registerData(db_source, StringMap(data));
+
+    DeviceOption option;
+    option.set_device_type(CPU);
+    auto op_def = CreateOperatorDef(
+        "Load",
+        "",
+        std::vector<string>{},
+        names,
+        std::vector<Argument>{MakeArgument<string>("db_type", "vector_db"),
+                              MakeArgument<string>("db", db_source),
+                              MakeArgument<bool>("absolute_path", true)},
+        option);
+    Workspace ws;
+    auto load_op = CreateOperator(op_def, &ws);
+    EXPECT_TRUE(load_op->Run());
+
+    for (int i = 0; i < kNumTensors; ++i) {
+      const auto& tensor = ws.GetBlob(names[i])->Get<TensorCPU>();
+      EXPECT_EQ(tensor.dims(), (std::vector<TIndex>{kTensorSize / 10, 10}));
+      for (int j = 0; j < kTensorSize; ++j) {
+        EXPECT_EQ(tensor.data<int64_t>()[j], i * kTensorSize + j);
+      }
+    }
+    const auto& strings = ws.GetBlob("strings")->Get<TensorCPU>();
+    EXPECT_EQ(strings.size(), 250);
+    for (int j = 0; j < strings.size(); ++j) {
+      EXPECT_EQ(strings.data<string>()[j], caffe2::to_string(j));
+    }
+    EXPECT_EQ(ws.GetBlob("dummy")->Get<DummyType>().n_chunks, 10);
+  }
+}
+
+TEST(ParallelLoad, CorruptedDBThrows) {
+  auto old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  auto old_threads = FLAGS_caffe2_max_tensor_deserializer_threads;
+  FLAGS_caffe2_tensor_chunk_size = 1000;
+  FLAGS_caffe2_max_tensor_deserializer_threads = 4;
+  auto guard = MakeGuard([&]() {
+    FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+    FLAGS_caffe2_max_tensor_deserializer_threads = old_threads;
+  });
+
+  StringMap data;
+  auto acceptor = [&](const std::string& key, const std::string& value) {
+    data.emplace_back(key, value);
+  };
+  Blob blob;
+  auto* tensor = blob.GetMutable<TensorCPU>();
+  // Large enough to start several deserializer threads
+  tensor->Resize(1 << 20);
+  for (int j = 0; j < tensor->size(); ++j) {
+    tensor->mutable_data<float>()[j] = j;
+  }
+  blob.Serialize("tensor", acceptor);
+  data.insert(data.begin() + data.size() / 2, {kCorruptKey, ""});
+
+  string db_source = (string)std::tmpnam(nullptr);
+  VectorDB::registerData(db_source, std::move(data));
+  DeviceOption option;
+  option.set_device_type(CPU);
+  auto op_def = CreateOperatorDef(
+      "Load",
+      "",
+      std::vector<string>{},
+      std::vector<string>{"tensor"},
+      std::vector<Argument>{MakeArgument<string>("db_type", "vector_db"),
+                            MakeArgument<string>("db", db_source),
+                            MakeArgument<bool>("absolute_path", true)},
+      option);
+  Workspace ws;
+  auto load_op = CreateOperator(op_def, &ws);
+  // Used to wait for the deserializer threads forever
+  EXPECT_THROW(load_op->Run(), EnforceNotMet);
+}
+
+TEST(RowwiseQuantizedSerialization, LoadDequantizedOrFused) {
+  auto old_pattern = FLAGS_caffe2_serialize_rowwise_quantized_blobs;
+  auto old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  FLAGS_caffe2_serialize_rowwise_quantized_blobs = "emb_.*";
+  FLAGS_caffe2_tensor_chunk_size = 400;
+  auto guard = MakeGuard([&]() {
+    FLAGS_caffe2_serialize_rowwise_quantized_blobs = old_pattern;
+    FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+  });
+
+  const int kRows = 50;
+  const int kColumns = 64;
+  Blob blob;
+  auto* tensor = blob.GetMutable<TensorCPU>();
+  tensor->Resize(kRows, kColumns);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = (i % 97) * 0.25f - i / kColumns;
+  }
+
+  StringMap data;
+  size_t quantized_bytes = 0;
+  blob.Serialize(
+      "emb_table", [&](const std::string& key, const std::string& value) {
+        BlobProto proto;
+        EXPECT_TRUE(proto.ParseFromString(value));
+        EXPECT_EQ(proto.type(), kFused8BitRowwiseTensorBlobType);
+        quantized_bytes += value.size();
+        data.emplace_back(key, value);
+      });
+  // Chunks hold whole rows
+  EXPECT_EQ(data.size(), 9);
+  // Other blobs are not quantized
+  size_t dense_bytes = 0;
+  blob.Serialize("dense", [&](const std::string&, const std::string& value) {
+    BlobProto proto;
+    EXPECT_TRUE(proto.ParseFromString(value));
+    EXPECT_EQ(proto.type(), kTensorBlobType);
+    dense_bytes += value.size();
+  });
+  EXPECT_LT(quantized_bytes * 3, dense_bytes);
+
+  for (bool keep_fused : {false, true}) {
+    string db_source = (string)std::tmpnam(nullptr);
+    VectorDB::registerData(db_source, StringMap(data));
+    DeviceOption option;
+    option.set_device_type(CPU);
+    auto op_def = CreateOperatorDef(
+        "Load",
+        "",
+        std::vector<string>{},
+        std::vector<string>{"emb_table"},
+        std::vector<Argument>{
+            MakeArgument<string>("db_type", "vector_db"),
+            MakeArgument<string>("db", db_source),
+            MakeArgument<bool>("absolute_path", true),
+            MakeArgument<bool>("keep_fused_8bit_rowwise", keep_fused)},
+        option);
+    Workspace ws;
+    EXPECT_TRUE(CreateOperator(op_def, &ws)->Run());
+    const auto& loaded = ws.GetBlob("emb_table")->Get<TensorCPU>();
+
+    if (keep_fused) {
+      EXPECT_EQ(loaded.dims(), (std::vector<TIndex>{kRows, kColumns + 8}));
+      EXPECT_TRUE(loaded.IsType<uint8_t>());
+      continue;
+    }
+    EXPECT_EQ(loaded.dims(), tensor->dims());
+    for (int row = 0; row < kRows; ++row) {
+      const float* original = tensor->data<float>() + row * kColumns;
+      const auto minmax = std::minmax_element(original, original + kColumns);
+      const float tolerance = (*minmax.second - *minmax.first) / 255 / 2;
+      for (int j = 0; j < kColumns; ++j) {
+        EXPECT_NEAR(
+            loaded.data<float>()[row * kColumns + j],
+            original[j],
+            tolerance * 1.01);
+      }
+    }
+  }
+}
+
 TEST(CustomChunkSize, BigTensorSerialization) {
   int64_t d1 = 2;
   int64_t d2 = FLAGS_caffe2_test_big_tensor_size
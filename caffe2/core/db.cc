@@ -169,6 +169,76 @@ class MiniDB : public DB {
 REGISTER_CAFFE2_DB(MiniDB, MiniDB);
 REGISTER_CAFFE2_DB(minidb, MiniDB);
 
+void DBReader::StartReadAhead() {
+  if (read_ahead_ == 0) {
+    return;
+  }
+  CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+  buffer_.clear();
+  stop_read_ahead_ = false;
+  read_ahead_error_ = nullptr;
+  read_ahead_thread_ = std::thread(&DBReader::ReadAheadLoop, this);
+}
+
+void DBReader::StopReadAhead() {
+  if (!read_ahead_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    stop_read_ahead_ = true;
+  }
+  buffer_not_full_.notify_all();
+  read_ahead_thread_.join();
+  buffer_.clear();
+}
+
+void DBReader::ReadAheadLoop() {
+  try {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        buffer_not_full_.wait(lock, [this]() {
+          return stop_read_ahead_ || buffer_.size() < read_ahead_;
+        });
+        if (stop_read_ahead_) {
+          return;
+        }
+      }
+      // Consumers only wait for buffer_mutex_, never for the storage
+      std::lock_guard<std::mutex> cursor_lock(reader_mutex_);
+      std::pair<string, string> record;
+      ReadFromCursor(&record.first, &record.second);
+      {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        buffer_.push_back(std::move(record));
+      }
+      buffer_not_empty_.notify_one();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    read_ahead_error_ = std::current_exception();
+    buffer_not_empty_.notify_all();
+  }
+}
+
+void DBReader::TakeReadAhead(size_t n, string* keys, string* values) const {
+  std::unique_lock<std::mutex> lock(buffer_mutex_);
+  for (size_t i = 0; i < n;) {
+    buffer_not_empty_.wait(
+        lock, [this]() { return !buffer_.empty() || read_ahead_error_; });
+    if (buffer_.empty()) {
+      std::rethrow_exception(read_ahead_error_);
+    }
+    for (; i < n && !buffer_.empty(); ++i) {
+      keys[i] = std::move(buffer_.front().first);
+      values[i] = std::move(buffer_.front().second);
+      buffer_.pop_front();
+    }
+    buffer_not_full_.notify_one();
+  }
+}
+
 void DBReaderSerializer::Serialize(
     const Blob& blob,
     const string& name,
@@ -179,8 +249,16 @@ void DBReaderSerializer::Serialize(
   proto.set_name(name);
   proto.set_source(reader.source_);
   proto.set_db_type(reader.db_type_);
-  if (reader.cursor() && reader.cursor()->SupportsSeek()) {
-    proto.set_key(reader.cursor()->key());
+  if (reader.read_ahead_ > 0) {
+    proto.set_read_ahead(reader.read_ahead_);
+  }
+  if (reader.cursor_ && reader.cursor_->SupportsSeek()) {
+    std::lock_guard<std::mutex> cursor_lock(reader.reader_mutex_);
+    std::lock_guard<std::mutex> buffer_lock(reader.buffer_mutex_);
+    // Records read ahead have not been returned by Read() yet
+    proto.set_key(
+        reader.buffer_.empty() ? reader.cursor_->key()
+                               : reader.buffer_.front().first);
   }
   BlobProto blob_proto;
   blob_proto.set_name(name);
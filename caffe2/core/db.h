@@ -1,7 +1,11 @@
 #ifndef CAFFE2_CORE_DB_H_
 #define CAFFE2_CORE_DB_H_
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <mutex>
+#include <thread>
 
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/registry.h"
@@ -46,6 +50,18 @@ class Cursor {
    * Returns the current value.
    */
   virtual string value() = 0;
+  /**
+   * Zero-copy alternatives to key() and value(), for the dbs that keep their
+   * records in memory. If supported, points data and size at the current key
+   * or value, which stay valid as long as the db is open, and returns true.
+   * Otherwise returns false, and key() or value() has to be used.
+   */
+  virtual bool KeyView(const char** /*data*/, size_t* /*size*/) {
+    return false;
+  }
+  virtual bool ValueView(const char** /*data*/, size_t* /*size*/) {
+    return false;
+  }
   /**
    * Returns whether the current location is valid - for example, if we have
    * reached the end of the database, return false.
@@ -165,6 +181,8 @@ class DBReader {
     }
     num_shards_ = 1;
     shard_id_ = 0;
+    // Started after seeking, so that the records read ahead follow the key
+    SetReadAhead(proto.read_ahead());
   }
 
   explicit DBReader(std::unique_ptr<DB> db)
@@ -175,11 +193,16 @@ class DBReader {
     cursor_ = db_->NewCursor();
   }
 
+  ~DBReader() {
+    StopReadAhead();
+  }
+
   void Open(
       const string& db_type,
       const string& source,
       const int32_t num_shards = 1,
       const int32_t shard_id = 0) {
+    StopReadAhead();
     // Note(jiayq): resetting is needed when we re-open e.g. leveldb where no
     // concurrent access is allowed.
     cursor_.reset();
@@ -189,17 +212,43 @@ class DBReader {
     db_ = CreateDB(db_type_, source_, READ);
     CAFFE_ENFORCE(db_, "Cannot open db: ", source_, " of type ", db_type_);
     InitializeCursor(num_shards, shard_id);
+    StartReadAhead();
   }
 
   void Open(
       unique_ptr<DB>&& db,
       const int32_t num_shards = 1,
       const int32_t shard_id = 0) {
+    StopReadAhead();
     cursor_.reset();
     db_.reset();
     db_ = std::move(db);
     CAFFE_ENFORCE(db_.get(), "Passed null db");
     InitializeCursor(num_shards, shard_id);
+    StartReadAhead();
+  }
+
+  /**
+   * Reads up to num_records records ahead of the consumers in a background
+   * thread, so that Read() and ReadMany() do not wait for the storage. The
+   * records are read in the same order, sharding included. 0 disables
+   * read-ahead.
+   *
+   * While reading ahead, the underlying cursor is ahead of the records
+   * returned by Read(), and must not be used directly. Records buffered when
+   * read-ahead is changed or the reader is reopened are dropped, so it is
+   * best set before the first read.
+   */
+  void SetReadAhead(size_t num_records) {
+    StopReadAhead();
+    read_ahead_ = num_records;
+    if (cursor_) {
+      StartReadAhead();
+    }
+  }
+
+  size_t read_ahead() const {
+    return read_ahead_;
   }
 
  public:
@@ -221,17 +270,31 @@ class DBReader {
    */
   void Read(string* key, string* value) const {
     CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    if (read_ahead_ > 0) {
+      TakeReadAhead(1, key, value);
+      return;
+    }
     std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
-    *key = cursor_->key();
-    *value = cursor_->value();
+    ReadFromCursor(key, value);
+  }
 
-    // In sharded mode, each read skips num_shards_ records
-    for (int s = 0; s < num_shards_; s++) {
-      cursor_->Next();
-      if (!cursor_->Valid()) {
-        MoveToBeginning();
-        break;
-      }
+  /**
+   * Reads the next n records into keys and values, which are resized to n.
+   * Thread safe, and cheaper than n calls to Read() since the reader is only
+   * locked once. The records of a batch are consecutive unless other threads
+   * read concurrently while read-ahead is enabled.
+   */
+  void ReadMany(size_t n, vector<string>* keys, vector<string>* values) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    keys->resize(n);
+    values->resize(n);
+    if (read_ahead_ > 0) {
+      TakeReadAhead(n, keys->data(), values->data());
+      return;
+    }
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    for (size_t i = 0; i < n; ++i) {
+      ReadFromCursor(&(*keys)[i], &(*values)[i]);
     }
   }
 
@@ -242,6 +305,13 @@ class DBReader {
     CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
     std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
     MoveToBeginning();
+    if (read_ahead_ > 0) {
+      // The read-ahead thread holds reader_mutex_ while reading, so no record
+      // read before seeking can be buffered after this
+      std::lock_guard<std::mutex> buffer_lock(buffer_mutex_);
+      buffer_.clear();
+      buffer_not_full_.notify_one();
+    }
   }
 
   /**
@@ -258,6 +328,26 @@ class DBReader {
   }
 
  private:
+  void ReadFromCursor(string* key, string* value) const {
+    *key = cursor_->key();
+    *value = cursor_->value();
+
+    // In sharded mode, each read skips num_shards_ records
+    for (int s = 0; s < num_shards_; s++) {
+      cursor_->Next();
+      if (!cursor_->Valid()) {
+        MoveToBeginning();
+        break;
+      }
+    }
+  }
+
+  void StartReadAhead();
+  void StopReadAhead();
+  void ReadAheadLoop();
+  // Moves the next n buffered records into keys and values
+  void TakeReadAhead(size_t n, string* keys, string* values) const;
+
   void InitializeCursor(const int32_t num_shards, const int32_t shard_id) {
     CAFFE_ENFORCE(num_shards >= 1);
     CAFFE_ENFORCE(shard_id >= 0);
@@ -285,6 +375,16 @@ class DBReader {
   uint32_t num_shards_;
   uint32_t shard_id_;
 
+  // Read-ahead state. reader_mutex_ is always acquired before buffer_mutex_.
+  size_t read_ahead_{0};
+  std::thread read_ahead_thread_;
+  mutable std::deque<std::pair<string, string>> buffer_;
+  mutable std::mutex buffer_mutex_;
+  mutable std::condition_variable buffer_not_empty_;
+  mutable std::condition_variable buffer_not_full_;
+  bool stop_read_ahead_{false};
+  std::exception_ptr read_ahead_error_;
+
   DISABLE_COPY_AND_ASSIGN(DBReader);
 };
 
@@ -1,8 +1,12 @@
 #include "caffe2/core/memonger.h"
 
+#include <algorithm>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
+#include "caffe2/core/types.h"
+
 namespace caffe2 {
 namespace memonger {
 
@@ -119,5 +123,181 @@ NetDef optimize_inference_net(
   LOG(INFO) << "optimized net using " << renaming.size() << " shared blobs";
   return optim_net;
 }
+
+namespace {
+
+size_t planned_nbytes(const TensorShape& shape) {
+  if (shape.unknown_shape() || shape.unknown_dims_size() > 0 ||
+      shape.data_type() == TensorProto_DataType_UNDEFINED) {
+    return 0;
+  }
+  const TypeMeta* meta = nullptr;
+  try {
+    meta = &DataTypeToTypeMeta(shape.data_type());
+  } catch (const std::runtime_error&) {
+    return 0;
+  }
+  // Types that need construction can't live in raw arena memory
+  if (meta->ctor()) {
+    return 0;
+  }
+  size_t size = 1;
+  for (auto d : shape.dims()) {
+    if (d < 0) {
+      return 0;
+    }
+    size *= d;
+  }
+  return size * meta->itemsize();
+}
+
+} // namespace
+
+ArenaPlan plan_inference_arena(
+    const NetDef& net,
+    const std::set<string>& static_blobs,
+    const TensorShapes& shapes,
+    size_t alignment) {
+  ArenaPlan plan;
+  if (net.type() != "" && net.type() != "simple") {
+    // Op order is not the execution order for the async executors
+    LOG(INFO) << "Cannot plan memory arena for nets of type: " << net.type();
+    return plan;
+  }
+  CAFFE_ENFORCE_GT(alignment, 0);
+
+  std::unordered_map<std::string, const TensorShape*> shape_map;
+  for (const auto& shape : shapes.shapes()) {
+    shape_map[shape.name()] = &shape;
+  }
+  std::unordered_set<std::string> excluded(
+      static_blobs.begin(), static_blobs.end());
+  for (const auto& input : net.external_input()) {
+    excluded.insert(input);
+  }
+
+  // Step 1: compute lifetime of each activation as an op interval
+  std::unordered_map<std::string, std::pair<int, int>> ranges;
+  std::vector<std::string> order;
+  const int num_ops = net.op_size();
+  for (int i = 0; i < num_ops; i++) {
+    const auto& op = net.op(i);
+    if (op.type() == "RecurrentNetwork") {
+      LOG(INFO) << "Memory arena does not support RecurrentNetwork yet";
+      return plan;
+    }
+    for (const auto& inp : op.input()) {
+      auto it = ranges.find(inp);
+      if (it != ranges.end()) {
+        it->second.second = i;
+      }
+    }
+    for (const auto& outp : op.output()) {
+      if (excluded.count(outp)) {
+        continue;
+      }
+      auto it = ranges.find(outp);
+      if (it == ranges.end()) {
+        ranges[outp] = std::make_pair(i, i);
+        order.push_back(outp);
+      } else {
+        it->second.second = i;
+      }
+    }
+  }
+  // Outputs have to survive until the end of the net
+  for (const auto& outp : net.external_output()) {
+    auto it = ranges.find(outp);
+    if (it != ranges.end()) {
+      it->second.second = num_ops;
+    }
+  }
+  // Alias outputs point into the storage of their input, so the input has
+  // to stay alive for as long as the alias does
+  for (int i = num_ops - 1; i >= 0; i--) {
+    const auto& op = net.op(i);
+    if (op.type() != "Alias" || op.input_size() != 1 ||
+        op.output_size() != 1) {
+      continue;
+    }
+    auto in_it = ranges.find(op.input(0));
+    auto out_it = ranges.find(op.output(0));
+    if (in_it != ranges.end() && out_it != ranges.end()) {
+      in_it->second.second =
+          std::max(in_it->second.second, out_it->second.second);
+    }
+  }
+
+  for (const auto& name : order) {
+    auto shape_it = shape_map.find(name);
+    if (shape_it == shape_map.end()) {
+      continue;
+    }
+    size_t nbytes = planned_nbytes(*shape_it->second);
+    if (nbytes == 0) {
+      continue;
+    }
+    ArenaBlobAssignment assignment;
+    assignment.blob = name;
+    assignment.shape = *shape_it->second;
+    assignment.offset = 0;
+    assignment.nbytes = nbytes;
+    assignment.first_op = ranges[name].first;
+    assignment.last_op = ranges[name].second;
+    plan.blobs.push_back(assignment);
+  }
+
+  // Step 2: greedy by size - place the largest blobs first, each one into
+  // the smallest gap between live blobs it fits in
+  std::vector<int> by_size(plan.blobs.size());
+  for (int i = 0; i < by_size.size(); i++) {
+    by_size[i] = i;
+  }
+  std::stable_sort(by_size.begin(), by_size.end(), [&plan](int a, int b) {
+    return plan.blobs[a].nbytes > plan.blobs[b].nbytes;
+  });
+
+  std::vector<const ArenaBlobAssignment*> placed;
+  for (auto idx : by_size) {
+    auto& blob = plan.blobs[idx];
+    std::vector<const ArenaBlobAssignment*> live;
+    for (auto* other : placed) {
+      if (other->first_op <= blob.last_op && blob.first_op <= other->last_op) {
+        live.push_back(other);
+      }
+    }
+    std::sort(
+        live.begin(),
+        live.end(),
+        [](const ArenaBlobAssignment* a, const ArenaBlobAssignment* b) {
+          return a->offset < b->offset;
+        });
+
+    size_t best_offset = 0;
+    size_t best_gap = std::numeric_limits<size_t>::max();
+    bool found = false;
+    size_t cursor = 0;
+    for (auto* other : live) {
+      if (other->offset >= cursor && other->offset - cursor >= blob.nbytes &&
+          other->offset - cursor < best_gap) {
+        best_gap = other->offset - cursor;
+        best_offset = cursor;
+        found = true;
+      }
+      size_t end = other->offset + other->nbytes;
+      end = (end + alignment - 1) / alignment * alignment;
+      cursor = std::max(cursor, end);
+    }
+    blob.offset = found ? best_offset : cursor;
+    plan.arena_nbytes = std::max(plan.arena_nbytes, blob.offset + blob.nbytes);
+    placed.push_back(&blob);
+  }
+  plan.arena_nbytes =
+      (plan.arena_nbytes + alignment - 1) / alignment * alignment;
+
+  VLOG(1) << "Planned " << plan.blobs.size() << " blobs into an arena of "
+          << plan.arena_nbytes << " bytes";
+  return plan;
+}
 }
 }
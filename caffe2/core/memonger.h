@@ -11,6 +11,33 @@ namespace memonger {
 NetDef optimize_inference_net(
     const NetDef& net,
     const std::set<string>& static_blobs);
+
+struct ArenaBlobAssignment {
+  string blob;
+  TensorShape shape;
+  size_t offset;
+  size_t nbytes;
+  // Index of the first op writing the blob and of the last op reading it
+  int first_op;
+  int last_op;
+};
+
+struct ArenaPlan {
+  size_t arena_nbytes = 0;
+  std::vector<ArenaBlobAssignment> blobs;
+};
+
+// Assigns every activation of a sequentially executed inference net an
+// offset in a single arena, based on the shapes in `shapes` and the op
+// interval during which each blob is alive. Blobs are placed greedily by
+// decreasing size into the tightest gap left by blobs with overlapping
+// lifetimes. Static blobs, net inputs and blobs of unknown size or
+// non-POD type are not planned.
+ArenaPlan plan_inference_arena(
+    const NetDef& net,
+    const std::set<string>& static_blobs,
+    const TensorShapes& shapes,
+    size_t alignment = 64);
 }
 }
 
@@ -0,0 +1,277 @@
+#include "caffe2/core/mmap_checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/types.h"
+
+namespace caffe2 {
+
+namespace {
+
+constexpr char kMagic[8] = {'C', '2', 'M', 'M', 'A', 'P', 'C', 'K'};
+constexpr uint32_t kVersion = 1;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_entries;
+  uint64_t index_offset;
+  uint64_t index_size;
+};
+static_assert(
+    sizeof(FileHeader) <= kMmapCheckpointAlignment,
+    "Checkpoint header does not fit before the first payload");
+
+template <typename T>
+void append(std::string* out, const T& value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Bounds checked reader of the index
+class IndexReader {
+ public:
+  IndexReader(const char* data, size_t size, const std::string& path)
+      : data_(data), size_(size), path_(path) {}
+
+  template <typename T>
+  T read() {
+    T value;
+    memcpy(&value, advance(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string readString(size_t length) {
+    return std::string(advance(length), length);
+  }
+
+ private:
+  const char* advance(size_t nbytes) {
+    CAFFE_ENFORCE_LE(
+        pos_ + nbytes, size_, "Truncated checkpoint index in ", path_);
+    const char* ptr = data_ + pos_;
+    pos_ += nbytes;
+    return ptr;
+  }
+
+  const char* data_;
+  size_t size_;
+  size_t pos_{0};
+  const std::string& path_;
+};
+
+} // namespace
+
+MmapCheckpointWriter::MmapCheckpointWriter(const std::string& path)
+    : path_(path),
+      tmp_path_(path + ".tmp"),
+      file_(fopen(tmp_path_.c_str(), "wb")),
+      offset_(0) {
+  CAFFE_ENFORCE(file_, "Cannot open checkpoint for writing: ", tmp_path_);
+  // The header is rewritten with the final values by Close()
+  char header[kMmapCheckpointAlignment] = {0};
+  write(header, sizeof(header));
+}
+
+MmapCheckpointWriter::~MmapCheckpointWriter() {
+  if (file_) {
+    fclose(file_);
+  }
+  // Only exists if Close() did not complete
+  unlink(tmp_path_.c_str());
+}
+
+void MmapCheckpointWriter::write(const void* data, size_t nbytes) {
+  CAFFE_ENFORCE_EQ(
+      fwrite(data, 1, nbytes, file_), nbytes, "Cannot write to ", tmp_path_);
+  offset_ += nbytes;
+}
+
+void MmapCheckpointWriter::Add(
+    const std::string& name,
+    const TensorCPU& tensor) {
+  CAFFE_ENFORCE(file_, "Checkpoint ", path_, " is already closed");
+  const auto data_type = TypeMetaToDataType(tensor.meta());
+  CAFFE_ENFORCE(
+      data_type != TensorProto_DataType_UNDEFINED &&
+          data_type != TensorProto_DataType_STRING && !tensor.meta().copy(),
+      "Tensor ",
+      name,
+      " of type ",
+      tensor.meta().name(),
+      " can not be stored in an mmap checkpoint");
+
+  static const char padding[kMmapCheckpointAlignment] = {0};
+  const auto misalignment = offset_ % kMmapCheckpointAlignment;
+  if (misalignment) {
+    write(padding, kMmapCheckpointAlignment - misalignment);
+  }
+
+  MmapCheckpointEntry entry;
+  entry.name = name;
+  entry.data_type = data_type;
+  entry.dims = tensor.dims();
+  entry.offset = offset_;
+  entry.nbytes = tensor.nbytes();
+  if (entry.nbytes > 0) {
+    write(tensor.raw_data(), entry.nbytes);
+  }
+  entries_.push_back(std::move(entry));
+}
+
+void MmapCheckpointWriter::Close() {
+  CAFFE_ENFORCE(file_, "Checkpoint ", path_, " is already closed");
+  std::string index;
+  for (const auto& entry : entries_) {
+    append(&index, uint32_t(entry.name.size()));
+    index.append(entry.name);
+    append(&index, int32_t(entry.data_type));
+    append(&index, uint32_t(entry.dims.size()));
+    for (auto dim : entry.dims) {
+      append(&index, int64_t(dim));
+    }
+    append(&index, entry.offset);
+    append(&index, entry.nbytes);
+  }
+
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_entries = entries_.size();
+  header.index_offset = offset_;
+  header.index_size = index.size();
+  write(index.data(), index.size());
+
+  CAFFE_ENFORCE_EQ(
+      fseek(file_, 0, SEEK_SET), 0, "Cannot seek in ", tmp_path_);
+  write(&header, sizeof(header));
+  CAFFE_ENFORCE_EQ(fflush(file_), 0, "Cannot write to ", tmp_path_);
+  CAFFE_ENFORCE_EQ(fsync(fileno(file_)), 0, "Cannot sync ", tmp_path_);
+  auto* file = file_;
+  file_ = nullptr;
+  CAFFE_ENFORCE_EQ(fclose(file), 0, "Cannot close ", tmp_path_);
+  // Replaces the directory entry only: mappings of a previous checkpoint at
+  // this path keep referring to the old file
+  CAFFE_ENFORCE_EQ(
+      rename(tmp_path_.c_str(), path_.c_str()),
+      0,
+      "Cannot move ",
+      tmp_path_,
+      " to ",
+      path_);
+}
+
+std::shared_ptr<MmapCheckpoint> MmapCheckpoint::Open(const std::string& path) {
+  std::shared_ptr<MmapCheckpoint> checkpoint(new MmapCheckpoint(path));
+  checkpoint->self_ = checkpoint;
+  return checkpoint;
+}
+
+MmapCheckpoint::MmapCheckpoint(const std::string& path)
+    : path_(path), data_(nullptr), size_(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  CAFFE_ENFORCE_GE(fd, 0, "Cannot open checkpoint: ", path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    CAFFE_THROW("Cannot stat checkpoint: ", path);
+  }
+  size_ = st.st_size;
+  if (size_ < sizeof(FileHeader)) {
+    close(fd);
+    CAFFE_THROW("Not an mmap checkpoint: ", path);
+  }
+  // A private writable mapping: pages are copied on the first write, the file
+  // itself is never modified
+  void* data =
+      mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CAFFE_ENFORCE(data != MAP_FAILED, "Cannot mmap checkpoint: ", path);
+  data_ = static_cast<char*>(data);
+
+  try {
+    FileHeader header;
+    memcpy(&header, data_, sizeof(header));
+    CAFFE_ENFORCE(
+        memcmp(header.magic, kMagic, sizeof(kMagic)) == 0,
+        "Not an mmap checkpoint: ",
+        path);
+    CAFFE_ENFORCE_EQ(
+        header.version, kVersion, "Unsupported checkpoint version in ", path);
+    CAFFE_ENFORCE(
+        header.index_offset <= size_ &&
+            header.index_size <= size_ - header.index_offset,
+        "Corrupted checkpoint index in ",
+        path);
+
+    IndexReader reader(
+        data_ + header.index_offset, header.index_size, path_);
+    entries_.resize(header.num_entries);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      auto& entry = entries_[i];
+      entry.name = reader.readString(reader.read<uint32_t>());
+      entry.data_type =
+          static_cast<TensorProto::DataType>(reader.read<int32_t>());
+      entry.dims.resize(reader.read<uint32_t>());
+      for (auto& dim : entry.dims) {
+        dim = reader.read<int64_t>();
+      }
+      entry.offset = reader.read<uint64_t>();
+      entry.nbytes = reader.read<uint64_t>();
+      CAFFE_ENFORCE(
+          entry.offset <= header.index_offset &&
+              entry.nbytes <= header.index_offset - entry.offset,
+          "Payload of ",
+          entry.name,
+          " is out of bounds in ",
+          path);
+      CAFFE_ENFORCE(
+          index_.emplace(entry.name, i).second,
+          "Duplicated tensor ",
+          entry.name,
+          " in ",
+          path);
+    }
+  } catch (...) {
+    munmap(data_, size_);
+    throw;
+  }
+}
+
+MmapCheckpoint::~MmapCheckpoint() {
+  munmap(data_, size_);
+}
+
+void MmapCheckpoint::Load(const std::string& name, TensorCPU* tensor) {
+  auto it = index_.find(name);
+  CAFFE_ENFORCE(it != index_.end(), "Tensor ", name, " not found in ", path_);
+  Load(entries_[it->second], tensor);
+}
+
+void MmapCheckpoint::Load(const Entry& entry, TensorCPU* tensor) {
+  const auto& meta = DataTypeToTypeMeta(entry.data_type);
+  tensor->Resize(entry.dims);
+  CAFFE_ENFORCE_EQ(
+      entry.nbytes,
+      tensor->size() * meta.itemsize(),
+      "Payload size mismatch for ",
+      entry.name,
+      " in ",
+      path_);
+  if (entry.nbytes == 0) {
+    tensor->raw_mutable_data(meta);
+    return;
+  }
+  auto self = self_.lock();
+  CAFFE_ENFORCE(self, "MmapCheckpoint must be created with Open()");
+  tensor->ShareExternalPointer(
+      data_ + entry.offset, meta, entry.nbytes, [self](void*) {});
+}
+
+} // namespace caffe2
@@ -0,0 +1,100 @@
+#ifndef CAFFE2_CORE_MMAP_CHECKPOINT_H_
+#define CAFFE2_CORE_MMAP_CHECKPOINT_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "caffe2/core/tensor.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+// db_type under which the Save and Load operators use this format
+constexpr auto kMmapCheckpointDBType = "mmap";
+constexpr size_t kMmapCheckpointAlignment = 64;
+
+/**
+ * A checkpoint format that can be loaded without parsing or copying.
+ *
+ * The file starts with a fixed header, followed by the raw payloads of all
+ * tensors, each aligned to kMmapCheckpointAlignment bytes, and ends with an
+ * index of (name, data type, dims, offset, size) entries. Only tensors of
+ * fixed size types are supported.
+ *
+ * Loading maps the whole file privately and backs every TensorCPU directly
+ * with its region of the mapping: pages are read from disk on first access,
+ * and writing into a loaded tensor copies the page instead of modifying the
+ * file. The mapping stays alive as long as any tensor refers to it.
+ */
+struct MmapCheckpointEntry {
+  std::string name;
+  TensorProto::DataType data_type;
+  std::vector<TIndex> dims;
+  uint64_t offset;
+  uint64_t nbytes;
+};
+
+// Writes the checkpoint to `path` + ".tmp" and only renames it over `path`
+// in Close(), so the file never changes under tensors still mapping a
+// previous checkpoint at the same path, and a failed write never leaves a
+// partial checkpoint behind.
+class MmapCheckpointWriter {
+ public:
+  explicit MmapCheckpointWriter(const std::string& path);
+  // Discards the temporary file if Close() was not called successfully
+  ~MmapCheckpointWriter();
+
+  void Add(const std::string& name, const TensorCPU& tensor);
+
+  // Writes the index, syncs the file and moves it to its final path
+  void Close();
+
+ private:
+  void write(const void* data, size_t nbytes);
+
+  std::string path_;
+  std::string tmp_path_;
+  FILE* file_;
+  uint64_t offset_;
+  std::vector<MmapCheckpointEntry> entries_;
+
+  MmapCheckpointWriter(const MmapCheckpointWriter&) = delete;
+  MmapCheckpointWriter& operator=(const MmapCheckpointWriter&) = delete;
+};
+
+class MmapCheckpoint {
+ public:
+  using Entry = MmapCheckpointEntry;
+
+  static std::shared_ptr<MmapCheckpoint> Open(const std::string& path);
+  ~MmapCheckpoint();
+
+  const std::vector<Entry>& entries() const {
+    return entries_;
+  }
+
+  bool Has(const std::string& name) const {
+    return index_.count(name) > 0;
+  }
+
+  // Makes tensor share the mapped payload of the entry with the given name
+  void Load(const std::string& name, TensorCPU* tensor);
+  void Load(const Entry& entry, TensorCPU* tensor);
+
+ private:
+  explicit MmapCheckpoint(const std::string& path);
+
+  std::string path_;
+  char* data_;
+  size_t size_;
+  std::vector<Entry> entries_;
+  std::unordered_map<std::string, size_t> index_;
+  // Held by every tensor that shares the mapping
+  std::weak_ptr<MmapCheckpoint> self_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_MMAP_CHECKPOINT_H_
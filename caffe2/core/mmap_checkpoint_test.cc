@@ -0,0 +1,161 @@
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/mmap_checkpoint.h"
+
+namespace caffe2 {
+
+namespace {
+
+void writeFilled(const std::string& path, float value) {
+  TensorCPU tensor(std::vector<TIndex>{4096});
+  for (int i = 0; i < tensor.size(); ++i) {
+    tensor.mutable_data<float>()[i] = value;
+  }
+  MmapCheckpointWriter writer(path);
+  writer.Add("tensor", tensor);
+  writer.Close();
+}
+
+std::string tempPath() {
+  char path[] = "/tmp/caffe2_mmap_checkpoint_XXXXXX";
+  int fd = mkstemp(path);
+  CAFFE_ENFORCE_GE(fd, 0);
+  close(fd);
+  return path;
+}
+
+} // namespace
+
+TEST(MmapCheckpointTest, RoundTrip) {
+  const auto path = tempPath();
+  {
+    TensorCPU floats(std::vector<TIndex>{3, 5});
+    for (int i = 0; i < floats.size(); ++i) {
+      floats.mutable_data<float>()[i] = i * 0.5;
+    }
+    TensorCPU ints(std::vector<TIndex>{7});
+    for (int i = 0; i < ints.size(); ++i) {
+      ints.mutable_data<int64_t>()[i] = -i;
+    }
+    TensorCPU empty(std::vector<TIndex>{0, 4});
+    empty.mutable_data<uint8_t>();
+
+    MmapCheckpointWriter writer(path);
+    writer.Add("floats", floats);
+    writer.Add("ints", ints);
+    writer.Add("empty", empty);
+    writer.Close();
+  }
+
+  TensorCPU floats;
+  TensorCPU ints;
+  TensorCPU empty;
+  {
+    auto checkpoint = MmapCheckpoint::Open(path);
+    EXPECT_EQ(checkpoint->entries().size(), 3);
+    EXPECT_TRUE(checkpoint->Has("ints"));
+    EXPECT_FALSE(checkpoint->Has("doubles"));
+    checkpoint->Load("floats", &floats);
+    checkpoint->Load("ints", &ints);
+    checkpoint->Load("empty", &empty);
+    EXPECT_EQ(
+        reinterpret_cast<uintptr_t>(floats.raw_data()) %
+            kMmapCheckpointAlignment,
+        0);
+    EXPECT_EQ(
+        reinterpret_cast<uintptr_t>(ints.raw_data()) % kMmapCheckpointAlignment,
+        0);
+  }
+
+  // The tensors keep the mapping alive
+  EXPECT_EQ(floats.dims(), (std::vector<TIndex>{3, 5}));
+  for (int i = 0; i < floats.size(); ++i) {
+    EXPECT_EQ(floats.data<float>()[i], i * 0.5);
+  }
+  EXPECT_EQ(ints.dims(), (std::vector<TIndex>{7}));
+  for (int i = 0; i < ints.size(); ++i) {
+    EXPECT_EQ(ints.data<int64_t>()[i], -i);
+  }
+  EXPECT_EQ(empty.dims(), (std::vector<TIndex>{0, 4}));
+  EXPECT_TRUE(empty.IsType<uint8_t>());
+
+  // Writes are private to the process
+  floats.mutable_data<float>()[0] = 42;
+  TensorCPU reloaded;
+  MmapCheckpoint::Open(path)->Load("floats", &reloaded);
+  EXPECT_EQ(reloaded.data<float>()[0], 0);
+  EXPECT_EQ(floats.data<float>()[0], 42);
+
+  remove(path.c_str());
+}
+
+TEST(MmapCheckpointTest, RejectsStrings) {
+  const auto path = tempPath();
+  TensorCPU strings(std::vector<TIndex>{2});
+  strings.mutable_data<std::string>();
+  MmapCheckpointWriter writer(path);
+  EXPECT_THROW(writer.Add("strings", strings), EnforceNotMet);
+  writer.Close();
+  remove(path.c_str());
+}
+
+TEST(MmapCheckpointTest, RejectsOtherFiles) {
+  const auto path = tempPath();
+  FILE* file = fopen(path.c_str(), "wb");
+  const std::string content(100, 'x');
+  fwrite(content.data(), 1, content.size(), file);
+  fclose(file);
+  EXPECT_THROW(MmapCheckpoint::Open(path), EnforceNotMet);
+
+  // Truncated checkpoint
+  {
+    TensorCPU tensor(std::vector<TIndex>{1000});
+    tensor.mutable_data<float>();
+    MmapCheckpointWriter writer(path);
+    writer.Add("tensor", tensor);
+    writer.Close();
+  }
+  EXPECT_EQ(truncate(path.c_str(), 2000), 0);
+  EXPECT_THROW(MmapCheckpoint::Open(path), EnforceNotMet);
+  remove(path.c_str());
+}
+
+TEST(MmapCheckpointTest, OverwriteKeepsLoadedTensors) {
+  const auto path = tempPath();
+  writeFilled(path, 1);
+  TensorCPU loaded;
+  MmapCheckpoint::Open(path)->Load("tensor", &loaded);
+
+  // Saving to the same path replaces the file instead of rewriting it
+  writeFilled(path, 2);
+  for (int i = 0; i < loaded.size(); ++i) {
+    ASSERT_EQ(loaded.data<float>()[i], 1);
+  }
+  TensorCPU reloaded;
+  MmapCheckpoint::Open(path)->Load("tensor", &reloaded);
+  EXPECT_EQ(reloaded.data<float>()[0], 2);
+  remove(path.c_str());
+}
+
+TEST(MmapCheckpointTest, UnfinishedWriteLeavesCheckpoint) {
+  const auto path = tempPath();
+  writeFilled(path, 1);
+  {
+    TensorCPU tensor(std::vector<TIndex>{16});
+    tensor.mutable_data<float>();
+    MmapCheckpointWriter writer(path);
+    writer.Add("partial", tensor);
+    // Destroyed without Close(), e.g. while unwinding from an error
+  }
+  EXPECT_NE(access((path + ".tmp").c_str(), F_OK), 0);
+  auto checkpoint = MmapCheckpoint::Open(path);
+  EXPECT_TRUE(checkpoint->Has("tensor"));
+  EXPECT_FALSE(checkpoint->Has("partial"));
+  remove(path.c_str());
+}
+
+} // namespace caffe2
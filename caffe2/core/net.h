@@ -187,6 +187,10 @@ class DAGNetBase : public NetBase {
       const int main_runs,
       const bool run_individual) override;
 
+  const ExecutionChains& execution_chains() const {
+    return execution_chains_;
+  }
+
   const ExecutionChains& TEST_execution_chains() const {
     return execution_chains_;
   }
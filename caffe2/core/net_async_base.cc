@@ -2,6 +2,7 @@
 
 #include "caffe2/core/operator.h"
 #include "caffe2/core/timer.h"
+#include "caffe2/utils/work_stealing_thread_pool.h"
 
 CAFFE2_DEFINE_int(
     caffe2_streams_per_gpu,
@@ -30,6 +31,11 @@ CAFFE2_DEFINE_int(
     0,
     "Number of threads in CPU pool (default - number of cores)");
 
+CAFFE2_DEFINE_bool(
+    caffe2_net_async_work_stealing_cpu_pool,
+    false,
+    "Use a work stealing pool with per-thread task queues as CPU pool");
+
 CAFFE2_DEFINE_bool(
     caffe2_net_async_check_stream_status,
     true,
@@ -70,8 +76,8 @@ AsyncNetBase::AsyncNetBase(
       DeviceTypeName(cpu_option.device_type()), cpu_option);
 }
 
-std::shared_ptr<TaskThreadPool> AsyncNetBase::pool_getter(
-    std::vector<std::shared_ptr<TaskThreadPool>>& pools,
+std::shared_ptr<TaskThreadPoolBase> AsyncNetBase::pool_getter(
+    std::vector<std::shared_ptr<TaskThreadPoolBase>>& pools,
     int pool_idx,
     const DeviceOption& device_option) {
   std::unique_lock<std::mutex> pools_lock(pools_mutex_);
@@ -84,7 +90,7 @@ std::shared_ptr<TaskThreadPool> AsyncNetBase::pool_getter(
   return pool;
 }
 
-std::shared_ptr<TaskThreadPool> AsyncNetBase::pool(
+std::shared_ptr<TaskThreadPoolBase> AsyncNetBase::pool(
     const DeviceOption& device_option) {
   if (device_option.device_type() == CPU) {
     auto numa_node_id = device_option.numa_node_id();
@@ -240,11 +246,11 @@ AsyncNetBase::~AsyncNetBase() {}
 
 CAFFE_DEFINE_SHARED_REGISTRY(
     ThreadPoolRegistry,
-    TaskThreadPool,
+    TaskThreadPoolBase,
     const DeviceOption&);
 
 namespace {
-std::shared_ptr<TaskThreadPool> AsyncNetCPUThreadPoolCreator(
+std::shared_ptr<TaskThreadPoolBase> AsyncNetCPUThreadPoolCreator(
     const DeviceOption& device_option) {
   CAFFE_ENFORCE_EQ(
       device_option.device_type(),
@@ -257,14 +263,21 @@ std::shared_ptr<TaskThreadPool> AsyncNetCPUThreadPoolCreator(
 CAFFE_REGISTER_CREATOR(ThreadPoolRegistry, CPU, AsyncNetCPUThreadPoolCreator);
 
 /* static */
-std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool(int numa_node_id) {
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetCPUThreadPool(int numa_node_id) {
   // Note: numa_node_id = -1 (DeviceOption's default value) corresponds to
   // no NUMA used
-  static std::unordered_map<int, std::weak_ptr<TaskThreadPool>> pools;
+  static std::unordered_map<int, std::weak_ptr<TaskThreadPoolBase>>
+      shared_queue_pools;
+  static std::unordered_map<int, std::weak_ptr<TaskThreadPoolBase>>
+      work_stealing_pools;
   static std::mutex pool_mutex;
   std::lock_guard<std::mutex> lock(pool_mutex);
 
-  std::shared_ptr<TaskThreadPool> shared_pool = nullptr;
+  auto& pools = FLAGS_caffe2_net_async_work_stealing_cpu_pool
+      ? work_stealing_pools
+      : shared_queue_pools;
+
+  std::shared_ptr<TaskThreadPoolBase> shared_pool = nullptr;
   if (pools.count(numa_node_id)) {
     shared_pool = pools.at(numa_node_id).lock();
   }
@@ -275,8 +288,14 @@ std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool(int numa_node_id) {
       CAFFE_ENFORCE(num_cores > 0, "Failed to get number of CPU cores");
       pool_size = num_cores;
     }
-    LOG(INFO) << "Using cpu pool size: " << pool_size;
-    shared_pool = std::make_shared<TaskThreadPool>(pool_size, numa_node_id);
+    if (FLAGS_caffe2_net_async_work_stealing_cpu_pool) {
+      LOG(INFO) << "Using work stealing cpu pool size: " << pool_size;
+      shared_pool =
+          std::make_shared<WorkStealingThreadPool>(pool_size, numa_node_id);
+    } else {
+      LOG(INFO) << "Using cpu pool size: " << pool_size;
+      shared_pool = std::make_shared<TaskThreadPool>(pool_size, numa_node_id);
+    }
     pools[numa_node_id] = shared_pool;
   }
   return shared_pool;
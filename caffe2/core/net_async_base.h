@@ -27,6 +27,12 @@ class AsyncNetBase : public NetBase {
     return operators_;
   }
 
+  // Chains of operator indices, chain ids are the task ids used by
+  // the executors
+  const std::vector<std::vector<int>>& chains() const {
+    return chains_;
+  }
+
  protected:
   bool canSchedule(
       int chain_id,
@@ -43,7 +49,7 @@ class AsyncNetBase : public NetBase {
       const std::vector<int>& wait_task_ids) const;
   void run(int task_id, int stream_id);
   int stream(int task_id);
-  std::shared_ptr<TaskThreadPool> pool(const DeviceOption& device_option);
+  std::shared_ptr<TaskThreadPoolBase> pool(const DeviceOption& device_option);
 
   void finishTasks(const std::unordered_set<int>& task_ids);
   void finalizeEvents();
@@ -58,26 +64,26 @@ class AsyncNetBase : public NetBase {
 
   // Pools and streams
   std::mutex pools_mutex_;
-  std::shared_ptr<TaskThreadPool> cpu_pool_;
-  std::vector<std::shared_ptr<TaskThreadPool>> cpu_pools_;
-  std::vector<std::shared_ptr<TaskThreadPool>> gpu_pools_;
+  std::shared_ptr<TaskThreadPoolBase> cpu_pool_;
+  std::vector<std::shared_ptr<TaskThreadPoolBase>> cpu_pools_;
+  std::vector<std::shared_ptr<TaskThreadPoolBase>> gpu_pools_;
   static thread_local std::vector<int> stream_counters_;
 
   DISABLE_COPY_AND_ASSIGN(AsyncNetBase);
 
  private:
-  std::shared_ptr<TaskThreadPool> pool_getter(
-      std::vector<std::shared_ptr<TaskThreadPool>>& pools,
+  std::shared_ptr<TaskThreadPoolBase> pool_getter(
+      std::vector<std::shared_ptr<TaskThreadPoolBase>>& pools,
       int pool_idx,
       const DeviceOption& device_option);
 };
 
 CAFFE_DECLARE_SHARED_REGISTRY(
     ThreadPoolRegistry,
-    TaskThreadPool,
+    TaskThreadPoolBase,
     const DeviceOption&);
 
-std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool(int numa_node_id);
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetCPUThreadPool(int numa_node_id);
 
 } // namespace caffe2
 
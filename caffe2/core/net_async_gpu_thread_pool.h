@@ -5,7 +5,7 @@
 
 namespace caffe2 {
 
-std::shared_ptr<TaskThreadPool> GetAsyncNetGPUThreadPool(int gpu_id);
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetGPUThreadPool(int gpu_id);
 
 } // namespace caffe2
 
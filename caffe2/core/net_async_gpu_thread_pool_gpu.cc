@@ -7,7 +7,7 @@ CAFFE2_DEFINE_int(caffe2_threads_per_gpu, 1, "Number of CPU threads per GPU");
 namespace caffe2 {
 
 namespace {
-std::shared_ptr<TaskThreadPool> AsyncNetGPUThreadPoolCreator(
+std::shared_ptr<TaskThreadPoolBase> AsyncNetGPUThreadPoolCreator(
     const DeviceOption& device_option) {
   CAFFE_ENFORCE_EQ(
       device_option.device_type(),
@@ -19,12 +19,12 @@ std::shared_ptr<TaskThreadPool> AsyncNetGPUThreadPoolCreator(
 
 CAFFE_REGISTER_CREATOR(ThreadPoolRegistry, CUDA, AsyncNetGPUThreadPoolCreator);
 
-std::shared_ptr<TaskThreadPool> GetAsyncNetGPUThreadPool(int gpu_id) {
-  static std::unordered_map<int, std::weak_ptr<TaskThreadPool>> pools;
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetGPUThreadPool(int gpu_id) {
+  static std::unordered_map<int, std::weak_ptr<TaskThreadPoolBase>> pools;
   static std::mutex pool_mutex;
   std::lock_guard<std::mutex> lock(pool_mutex);
 
-  std::shared_ptr<TaskThreadPool> shared_pool = nullptr;
+  std::shared_ptr<TaskThreadPoolBase> shared_pool = nullptr;
   if (pools.count(gpu_id)) {
     shared_pool = pools.at(gpu_id).lock();
   }
@@ -1,16 +1,41 @@
 #include "caffe2/core/net_async_scheduling.h"
 
+#include <algorithm>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/types.h"
+
 CAFFE2_DEFINE_bool(
     caffe2_net_async_always_schedule_child,
     false,
     "Always schedule child chains from parent chain");
 
+CAFFE2_DEFINE_bool(
+    caffe2_net_async_priority_scheduling,
+    false,
+    "Run ready chains in the order of their upward rank (estimated cost of "
+    "the longest remaining path) instead of the order they became ready");
+
+CAFFE2_DEFINE_double(
+    caffe2_net_async_flops_per_byte,
+    10.0,
+    "Ratio of compute throughput (flops/s) to memory bandwidth (bytes/s) "
+    "used to express bytes moved by an operator in flops when estimating "
+    "operator costs for priority scheduling");
+
 namespace caffe2 {
 
 AsyncSchedulingNet::AsyncSchedulingNet(
     const std::shared_ptr<const NetDef>& net_def,
     Workspace* ws)
-    : AsyncNetBase(net_def, ws), running_(false) {
+    : AsyncNetBase(net_def, ws),
+      running_(false),
+      priority_scheduling_(FLAGS_caffe2_net_async_priority_scheduling),
+      net_def_(net_def),
+      ws_(ws) {
+  ArgumentHelper arg_helper(*net_def);
+  shape_inputs_ = arg_helper.GetRepeatedArgument<std::string>(
+      "priority_scheduling_shape_inputs");
   reset();
 }
 
@@ -36,70 +61,95 @@ void AsyncSchedulingNet::Wait() {
 
 void AsyncSchedulingNet::schedule(int task_id) {
   const auto& device_option = event(task_id).GetDeviceOption();
-  pool(device_option)->run([this, task_id]() {
-    if (success_) {
-      int stream_id = stream(task_id);
-      asyncWait(task_id, stream_id, parents(task_id));
-      try {
-        run(task_id, stream_id);
-      } catch (const std::exception& e) {
-        std::unique_lock<std::mutex> lock(exception_mutex_);
-        exception_messages_.push_back(e.what());
-        success_ = false;
-      }
+  auto task_pool = pool(device_option);
+  if (!priority_scheduling_) {
+    task_pool->run([this, task_id]() { runTask(task_id); });
+    return;
+  }
+
+  // Every submission picks the best ready task of its pool at the time it
+  // starts, so tasks that became ready later can overtake earlier ones
+  auto* pool_ptr = task_pool.get();
+  {
+    std::unique_lock<std::mutex> lock(ready_mutex_);
+    ready_tasks_[pool_ptr].emplace(ranks_[task_id], task_id);
+  }
+  task_pool->run([this, pool_ptr]() {
+    int ready_task_id;
+    {
+      std::unique_lock<std::mutex> lock(ready_mutex_);
+      auto& ready = ready_tasks_[pool_ptr];
+      CAFFE_ENFORCE(!ready.empty(), "No ready task for pool submission");
+      ready_task_id = ready.top().second;
+      ready.pop();
+    }
+    runTask(ready_task_id);
+  });
+}
+
+void AsyncSchedulingNet::runTask(int task_id) {
+  if (success_) {
+    int stream_id = stream(task_id);
+    asyncWait(task_id, stream_id, parents(task_id));
+    try {
+      run(task_id, stream_id);
+    } catch (const std::exception& e) {
+      std::unique_lock<std::mutex> lock(exception_mutex_);
+      exception_messages_.push_back(e.what());
+      success_ = false;
     }
+  }
 
-    auto task_count = ++processed_tasks_num_;
+  auto task_count = ++processed_tasks_num_;
 
-    for (auto child_id : children(task_id)) {
-      int parent_count = updateParentCount(child_id);
-      if (parent_count == 0) {
-        if (cleanup_ || FLAGS_caffe2_net_async_always_schedule_child ||
-            canSchedule(child_id)) {
-          schedule(child_id);
-        } else {
-          const auto& device_option = event(child_id).GetDeviceOption();
-          pool(device_option)
-              ->run(std::bind(
-                  &AsyncSchedulingNet::pollAndSchedule, this, child_id));
-        }
+  for (auto child_id : children(task_id)) {
+    int parent_count = updateParentCount(child_id);
+    if (parent_count == 0) {
+      if (cleanup_ || FLAGS_caffe2_net_async_always_schedule_child ||
+          canSchedule(child_id)) {
+        schedule(child_id);
+      } else {
+        const auto& device_option = event(child_id).GetDeviceOption();
+        pool(device_option)
+            ->run(std::bind(
+                &AsyncSchedulingNet::pollAndSchedule, this, child_id));
       }
     }
+  }
 
-    if (success_) {
-      if (task_count == tasksNum()) {
-        // All tasks are finished, polling thread is sleeping;
-        // only one thread enters here
-        finalizeEvents();
-        finishRun();
+  if (success_) {
+    if (task_count == tasksNum()) {
+      // All tasks are finished, polling thread is sleeping;
+      // only one thread enters here
+      finalizeEvents();
+      finishRun();
+      return;
+    }
+  } else {
+    // Before setting running_ to false and notifying waiters we need to
+    // 1. Ensure that only one thread does the cleanup
+    // 2. Ensure that all other pending tasks in workers and polling threads
+    //    are finished and
+    // 3. Ensure that all tasks that were not scheduled have their events set
+    {
+      std::unique_lock<std::mutex> cleanup_lock(cleanup_mutex_);
+      if (cleanup_) {
         return;
       }
-    } else {
-      // Before setting running_ to false and notifying waiters we need to
-      // 1. Ensure that only one thread does the cleanup
-      // 2. Ensure that all other pending tasks in workers and polling threads
-      //    are finished and
-      // 3. Ensure that all tasks that were not scheduled have their events set
-      {
-        std::unique_lock<std::mutex> cleanup_lock(cleanup_mutex_);
-        if (cleanup_) {
-          return;
-        }
-        cleanup_ = true;
-      }
+      cleanup_ = true;
+    }
 
-      // Errors are not recoverable and happen in exceptional cases,
-      // ok to busy wait
-      while (processed_tasks_num_ != tasksNum()) {
-      }
+    // Errors are not recoverable and happen in exceptional cases,
+    // ok to busy wait
+    while (processed_tasks_num_ != tasksNum()) {
+    }
 
-      // Make sure all events are set, wait for scheduled events
-      finalizeEvents();
+    // Make sure all events are set, wait for scheduled events
+    finalizeEvents();
 
-      // Notify observers and waiters
-      finishRun();
-    }
-  });
+    // Notify observers and waiters
+    finishRun();
+  }
 }
 
 void AsyncSchedulingNet::pollAndSchedule(int task_id) {
@@ -134,6 +184,29 @@ bool AsyncSchedulingNet::DoRunAsync() {
   running_ = true;
   reset();
 
+  if (priority_scheduling_ && !profiled_costs_) {
+    // Estimated lazily, input shapes are known only once the net runs. Nets
+    // listing their shape inputs keep ranks for each of their shapes, the
+    // others are estimated once
+    if (shape_inputs_.empty()) {
+      if (ranks_.empty()) {
+        computeRanks(estimateOperatorCosts());
+      }
+    } else {
+      auto input_dims = shapeInputDims();
+      auto it = cached_ranks_.find(input_dims);
+      if (it == cached_ranks_.end()) {
+        if (cached_ranks_.size() >= kMaxCachedRanks) {
+          cached_ranks_.clear();
+        }
+        computeRanks(estimateOperatorCosts());
+        cached_ranks_.emplace(std::move(input_dims), ranks_);
+      } else {
+        ranks_ = it->second;
+      }
+    }
+  }
+
   StartAllObservers();
 
   for (auto task_id = 0; task_id < tasksNum(); ++task_id) {
@@ -145,6 +218,142 @@ bool AsyncSchedulingNet::DoRunAsync() {
   return true;
 }
 
+void AsyncSchedulingNet::setOperatorCosts(const std::vector<float>& op_costs) {
+  std::unique_lock<std::mutex> lock(running_mutex_);
+  CAFFE_ENFORCE(!running_, "Can't change operator costs of a running net");
+  computeRanks(op_costs);
+  profiled_costs_ = true;
+}
+
+std::vector<std::vector<TIndex>> AsyncSchedulingNet::shapeInputDims() const {
+  std::vector<std::vector<TIndex>> input_dims(shape_inputs_.size());
+  for (int i = 0; i < shape_inputs_.size(); ++i) {
+    const auto* blob = ws_->GetBlob(shape_inputs_[i]);
+    if (!blob) {
+      continue;
+    }
+    auto tensor_info_fun = GetTensorInfoFunction(blob->meta().id());
+    if (tensor_info_fun) {
+      bool shares_data;
+      size_t capacity;
+      DeviceOption device;
+      input_dims[i] = tensor_info_fun(
+          const_cast<Blob*>(blob)->GetRaw(), &shares_data, &capacity, &device);
+    }
+  }
+  return input_dims;
+}
+
+std::vector<float> AsyncSchedulingNet::estimateOperatorCosts() const {
+  // Costs are in flops, bytes moved are converted with the flops per byte
+  // ratio. Operators without a cost inference function are weighted by the
+  // bytes they read and write, operators with unknown shapes get unit cost.
+  const float flops_per_byte = FLAGS_caffe2_net_async_flops_per_byte;
+  std::vector<float> op_costs(operators_.size(), 1.0f);
+  CaffeMap<string, TensorShape> shapes;
+  try {
+    std::vector<std::unique_ptr<NetDef>> nets;
+    nets.emplace_back(new NetDef(*net_def_));
+    auto inferred = InferBlobShapesAndTypesFromWorkspace(ws_, nets);
+    for (const auto& shape : inferred.shapes()) {
+      shapes[shape.name()] = shape;
+    }
+  } catch (const std::exception& e) {
+    VLOG(1) << "Shape inference failed, using unit operator costs: "
+            << e.what();
+    return op_costs;
+  }
+
+  auto num_bytes = [](const TensorShape& shape) {
+    if (shape.unknown_shape()) {
+      return 0.0f;
+    }
+    float size = 1.0f;
+    for (auto dim : shape.dims()) {
+      size *= dim;
+    }
+    try {
+      return size * DataTypeToTypeMeta(shape.data_type()).itemsize();
+    } catch (const std::exception&) {
+      return size * sizeof(float);
+    }
+  };
+  for (int op_id = 0; op_id < net_def_->op_size(); ++op_id) {
+    const auto& op_def = net_def_->op(op_id);
+    std::vector<TensorShape> input_shapes;
+    float bytes = 0.0f;
+    bool known_shapes = true;
+    for (const auto& input : op_def.input()) {
+      auto it = shapes.find(input);
+      if (it == shapes.end()) {
+        known_shapes = false;
+        break;
+      }
+      input_shapes.push_back(it->second);
+      bytes += num_bytes(it->second);
+    }
+    if (!known_shapes) {
+      continue;
+    }
+    for (const auto& output : op_def.output()) {
+      auto it = shapes.find(output);
+      if (it != shapes.end()) {
+        bytes += num_bytes(it->second);
+      }
+    }
+
+    float cost = bytes * flops_per_byte;
+    const auto* schema = OpSchemaRegistry::Schema(op_def.type());
+    if (schema) {
+      try {
+        auto c = schema->InferCost(op_def, input_shapes);
+        cost = c.flops + c.bytes_moved * flops_per_byte;
+      } catch (const std::exception&) {
+        // No cost inference function registered
+      }
+    }
+    op_costs[op_id] = std::max(cost, 1.0f);
+  }
+  return op_costs;
+}
+
+void AsyncSchedulingNet::computeRanks(const std::vector<float>& op_costs) {
+  CAFFE_ENFORCE_EQ(
+      op_costs.size(), operators_.size(), "Expected one cost per operator");
+  std::vector<int> order;
+  order.reserve(tasksNum());
+  std::vector<int> num_parents(tasksNum());
+  for (auto task_id = 0; task_id < tasksNum(); ++task_id) {
+    num_parents[task_id] = parents(task_id).size();
+    if (num_parents[task_id] == 0) {
+      order.push_back(task_id);
+    }
+  }
+  for (int i = 0; i < order.size(); ++i) {
+    for (auto child_id : children(order[i])) {
+      if (--num_parents[child_id] == 0) {
+        order.push_back(child_id);
+      }
+    }
+  }
+  CAFFE_ENFORCE_EQ(order.size(), tasksNum());
+
+  std::vector<float> ranks(tasksNum(), 0.0f);
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    auto task_id = *it;
+    float children_rank = 0.0f;
+    for (auto child_id : children(task_id)) {
+      children_rank = std::max(children_rank, ranks[child_id]);
+    }
+    float cost = 0.0f;
+    for (auto op_id : chains_[task_id]) {
+      cost += op_costs[op_id];
+    }
+    ranks[task_id] = cost + children_rank;
+  }
+  ranks_ = std::move(ranks);
+}
+
 AsyncSchedulingNet::~AsyncSchedulingNet() {}
 
 REGISTER_NET(async_scheduling, AsyncSchedulingNet);
@@ -1,6 +1,10 @@
 #ifndef CAFFE2_CORE_NET_ASYNC_SCHEDULING_H_
 #define CAFFE2_CORE_NET_ASYNC_SCHEDULING_H_
 
+#include <map>
+#include <queue>
+#include <unordered_map>
+
 #include "caffe2/core/net_async_base.h"
 
 namespace caffe2 {
@@ -14,11 +18,17 @@ class AsyncSchedulingNet : public AsyncNetBase {
 
   void Wait() override;
 
+  // Replaces the estimated operator costs used to rank chains (e.g. with
+  // profiled operator times); only used with priority scheduling. Ranks are
+  // then no longer re-estimated for new input shapes.
+  void setOperatorCosts(const std::vector<float>& op_costs);
+
  protected:
   bool DoRunAsync() override;
 
   void pollAndSchedule(int task_id);
   void schedule(int task_id);
+  void runTask(int task_id);
   void reset();
   virtual void finishRun();
   int updateParentCount(int child_id);
@@ -35,6 +45,30 @@ class AsyncSchedulingNet : public AsyncNetBase {
   std::mutex exception_mutex_;
   std::vector<std::string> exception_messages_;
 
+  // Priority scheduling: ready tasks are kept per pool and every pool
+  // submission runs the ready task with the highest upward rank (cost of the
+  // longest path from the task to the end of the net)
+  std::vector<float> estimateOperatorCosts() const;
+  void computeRanks(const std::vector<float>& op_costs);
+  std::vector<std::vector<TIndex>> shapeInputDims() const;
+
+  using ReadyTask = std::pair<float, int>;
+  const bool priority_scheduling_;
+  std::vector<float> ranks_;
+  // Inputs the estimated costs depend on (e.g. the data inputs, and not the
+  // parameters), from the priority_scheduling_shape_inputs net argument, and
+  // the ranks estimated for each of their shapes
+  std::vector<std::string> shape_inputs_;
+  static constexpr size_t kMaxCachedRanks = 16;
+  std::map<std::vector<std::vector<TIndex>>, std::vector<float>>
+      cached_ranks_;
+  bool profiled_costs_ = false;
+  std::mutex ready_mutex_;
+  std::unordered_map<TaskThreadPoolBase*, std::priority_queue<ReadyTask>>
+      ready_tasks_;
+  std::shared_ptr<const NetDef> net_def_;
+  Workspace* ws_;
+
   DISABLE_COPY_AND_ASSIGN(AsyncSchedulingNet);
 };
 
@@ -40,6 +40,10 @@ class DAGNetBase : public NetBase {
       const int main_runs,
       const bool run_individual) override;
 
+  const dag_utils::ExecutionChains& execution_chains() const {
+    return execution_chains_;
+  }
+
   const dag_utils::ExecutionChains& TEST_execution_chains() const {
     return execution_chains_;
   }
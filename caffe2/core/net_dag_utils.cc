@@ -1,5 +1,8 @@
 #include "caffe2/core/net_dag_utils.h"
 
+#include <functional>
+#include <map>
+#include <queue>
 #include <set>
 #include <stack>
 #include <unordered_map>
@@ -425,5 +428,145 @@ std::vector<OpGraphNode> prepareChainGraphNodes(
   return chain_nodes;
 }
 
+ParallelismAnalysis analyzeParallelism(
+    const std::vector<std::vector<int>>& execution_chains,
+    const std::vector<OpGraphNode>& chain_nodes,
+    const std::vector<float>& op_times,
+    int max_threads) {
+  CAFFE_ENFORCE_EQ(execution_chains.size(), chain_nodes.size());
+  CAFFE_ENFORCE_GT(max_threads, 0);
+  const int num_chains = execution_chains.size();
+
+  ParallelismAnalysis analysis;
+  std::vector<float> chain_times(num_chains, 0.0f);
+  for (int chain_idx = 0; chain_idx < num_chains; ++chain_idx) {
+    for (auto op_idx : execution_chains[chain_idx]) {
+      CAFFE_ENFORCE(
+          op_idx >= 0 && op_idx < op_times.size(),
+          "No time given for operator ",
+          op_idx);
+      chain_times[chain_idx] += op_times[op_idx];
+    }
+    analysis.total_time += chain_times[chain_idx];
+  }
+
+  // Topological order of the chains
+  std::vector<int> order;
+  order.reserve(num_chains);
+  std::vector<int> num_parents(num_chains);
+  for (int chain_idx = 0; chain_idx < num_chains; ++chain_idx) {
+    num_parents[chain_idx] = chain_nodes[chain_idx].parents_.size();
+    if (num_parents[chain_idx] == 0) {
+      order.push_back(chain_idx);
+    }
+  }
+  for (int i = 0; i < order.size(); ++i) {
+    for (auto child : chain_nodes[order[i]].children_) {
+      if (--num_parents[child] == 0) {
+        order.push_back(child);
+      }
+    }
+  }
+  CAFFE_ENFORCE_EQ(order.size(), num_chains, "Chain graph has a cycle");
+
+  // Longest path ending at each chain
+  std::vector<float> finish(num_chains, 0.0f);
+  std::vector<int> critical_parent(num_chains, -1);
+  int last_chain = -1;
+  for (auto chain_idx : order) {
+    float start = 0.0f;
+    for (auto parent : chain_nodes[chain_idx].parents_) {
+      if (critical_parent[chain_idx] < 0 || finish[parent] > start) {
+        start = finish[parent];
+        critical_parent[chain_idx] = parent;
+      }
+    }
+    finish[chain_idx] = start + chain_times[chain_idx];
+    if (last_chain < 0 || finish[chain_idx] > finish[last_chain]) {
+      last_chain = chain_idx;
+    }
+  }
+  std::vector<int> critical_chains;
+  for (int chain_idx = last_chain; chain_idx >= 0;
+       chain_idx = critical_parent[chain_idx]) {
+    critical_chains.push_back(chain_idx);
+  }
+  for (auto it = critical_chains.rbegin(); it != critical_chains.rend(); ++it) {
+    const auto& chain = execution_chains[*it];
+    analysis.critical_path.insert(
+        analysis.critical_path.end(), chain.begin(), chain.end());
+  }
+  if (last_chain >= 0) {
+    analysis.critical_path_time = finish[last_chain];
+  }
+  analysis.average_parallelism = analysis.critical_path_time > 0
+      ? analysis.total_time / analysis.critical_path_time
+      : 1.0f;
+
+  // List scheduling simulation: chains become ready once all parents are
+  // done and are picked up by idle threads in the order they became ready
+  for (int num_threads = 1; num_threads <= max_threads; ++num_threads) {
+    for (int chain_idx = 0; chain_idx < num_chains; ++chain_idx) {
+      num_parents[chain_idx] = chain_nodes[chain_idx].parents_.size();
+    }
+    std::queue<int> ready;
+    for (int chain_idx = 0; chain_idx < num_chains; ++chain_idx) {
+      if (num_parents[chain_idx] == 0) {
+        ready.push(chain_idx);
+      }
+    }
+    // (finish time, chain) of the chains being executed
+    using RunningChain = std::pair<float, int>;
+    std::priority_queue<
+        RunningChain,
+        std::vector<RunningChain>,
+        std::greater<RunningChain>>
+        running;
+    float now = 0.0f;
+    while (!ready.empty() || !running.empty()) {
+      while (!ready.empty() && running.size() < num_threads) {
+        auto chain_idx = ready.front();
+        ready.pop();
+        running.emplace(now + chain_times[chain_idx], chain_idx);
+      }
+      auto done = running.top();
+      running.pop();
+      now = done.first;
+      for (auto child : chain_nodes[done.second].children_) {
+        if (--num_parents[child] == 0) {
+          ready.push(child);
+        }
+      }
+    }
+    analysis.predicted_time.push_back(now);
+    analysis.predicted_speedup.push_back(
+        now > 0 ? analysis.total_time / now : 1.0f);
+  }
+  return analysis;
+}
+
+ParallelismAnalysis analyzeParallelism(
+    const std::shared_ptr<const NetDef>& net_def,
+    Workspace* ws,
+    const std::vector<float>& op_times,
+    int max_threads) {
+  CAFFE_ENFORCE_EQ(
+      op_times.size(),
+      net_def->op_size(),
+      "Expected one time per operator");
+  auto operator_nodes = prepareOperatorNodes(net_def, ws);
+  const auto& execution_chains = computeChains(operator_nodes);
+  std::vector<std::vector<int>> chains;
+  chains.reserve(execution_chains.size());
+  // Order chains by their first operator, for a deterministic report
+  std::map<int, std::vector<int>> sorted_chains(
+      execution_chains.begin(), execution_chains.end());
+  for (const auto& kv : sorted_chains) {
+    chains.push_back(kv.second);
+  }
+  const auto chain_nodes = prepareChainGraphNodes(operator_nodes, chains);
+  return analyzeParallelism(chains, chain_nodes, op_times, max_threads);
+}
+
 } // namespace dag_utils
 } // namespace caffe2
@@ -54,6 +54,39 @@ std::vector<OpGraphNode> prepareChainGraphNodes(
     const std::vector<dag_utils::OperatorNode>& operator_nodes,
     const std::vector<std::vector<int>>& execution_chains);
 
+// Estimate of how well a net can use multiple worker threads, given the
+// measured (or estimated) time of each operator. Chains are scheduled as a
+// whole, the same way async executors run them.
+struct ParallelismAnalysis {
+  // Sum of all operator times, i.e. the time of a single threaded run
+  float total_time = 0.0f;
+  // Longest path through the chain graph, a lower bound on the run time
+  // regardless of the number of threads
+  float critical_path_time = 0.0f;
+  // Operators on the critical path, in execution order
+  std::vector<int> critical_path;
+  // total_time / critical_path_time
+  float average_parallelism = 0.0f;
+  // Simulated run time and speedup over total_time with 1..N threads,
+  // element i corresponds to i + 1 threads
+  std::vector<float> predicted_time;
+  std::vector<float> predicted_speedup;
+};
+
+ParallelismAnalysis analyzeParallelism(
+    const std::vector<std::vector<int>>& execution_chains,
+    const std::vector<OpGraphNode>& chain_nodes,
+    const std::vector<float>& op_times,
+    int max_threads);
+
+// Builds the chain graph of the net the same way the async executors do and
+// analyzes it; operators are instantiated in the given workspace
+ParallelismAnalysis analyzeParallelism(
+    const std::shared_ptr<const NetDef>& net_def,
+    Workspace* ws,
+    const std::vector<float>& op_times,
+    int max_threads);
+
 } // namespace dag_utils
 } // namespace caffe2
 
@@ -1,10 +1,13 @@
 #include <google/protobuf/text_format.h>
 #include <gtest/gtest.h>
 #include "caffe2/core/net.h"
+#include "caffe2/core/net_async_scheduling.h"
+#include "caffe2/core/net_dag_utils.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/scope_guard.h"
 
 CAFFE2_DECLARE_bool(caffe2_disable_chaining);
+CAFFE2_DECLARE_bool(caffe2_net_async_priority_scheduling);
 
 namespace caffe2 {
 
@@ -318,6 +321,110 @@ TEST(NetTest, ChainingForForkJoin) {
   checkChainingAndRun(spec, {{0, {0}}, {1, {1}}, {2, {2, 3}}});
 }
 
+TEST(NetTest, ParallelismAnalysisForForkJoin) {
+  const auto spec = R"DOC(
+        name: "example"
+        type: "dag"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "hidden1"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "in"
+          output: "hidden2"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden1"
+          input: "hidden2"
+          output: "out"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "out"
+          output: "out2"
+          type: "NetTestDummy"
+        }
+)DOC";
+  Workspace ws;
+  ws.CreateBlob("in");
+  auto net_def = std::make_shared<NetDef>();
+  CAFFE_ENFORCE(
+      google::protobuf::TextFormat::ParseFromString(spec, net_def.get()));
+  auto old = FLAGS_caffe2_disable_chaining;
+  auto g = MakeGuard([&]() { FLAGS_caffe2_disable_chaining = old; });
+  FLAGS_caffe2_disable_chaining = false;
+
+  // Chains are {0}, {1} and {2, 3}
+  auto analysis =
+      dag_utils::analyzeParallelism(net_def, &ws, {1.0f, 2.0f, 3.0f, 4.0f}, 3);
+  EXPECT_FLOAT_EQ(analysis.total_time, 10.0f);
+  EXPECT_FLOAT_EQ(analysis.critical_path_time, 9.0f);
+  EXPECT_EQ(analysis.critical_path, std::vector<int>({1, 2, 3}));
+  EXPECT_FLOAT_EQ(analysis.average_parallelism, 10.0f / 9.0f);
+  ASSERT_EQ(analysis.predicted_time.size(), 3);
+  EXPECT_FLOAT_EQ(analysis.predicted_time[0], 10.0f);
+  EXPECT_FLOAT_EQ(analysis.predicted_time[1], 9.0f);
+  EXPECT_FLOAT_EQ(analysis.predicted_time[2], 9.0f);
+  EXPECT_FLOAT_EQ(analysis.predicted_speedup[0], 1.0f);
+  EXPECT_FLOAT_EQ(analysis.predicted_speedup[1], 10.0f / 9.0f);
+}
+
+TEST(NetTest, PrioritySchedulingRunsAllOps) {
+  const auto spec = R"DOC(
+        name: "example"
+        type: "async_scheduling"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "short1"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "in"
+          output: "short2"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "in"
+          output: "long1"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "long1"
+          output: "long2"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "short1"
+          input: "short2"
+          input: "long2"
+          output: "out"
+          type: "NetTestDummy"
+        }
+)DOC";
+  Workspace ws;
+  ws.CreateBlob("in");
+  NetDef net_def;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+  auto old = FLAGS_caffe2_net_async_priority_scheduling;
+  auto g = MakeGuard(
+      [&]() { FLAGS_caffe2_net_async_priority_scheduling = old; });
+  FLAGS_caffe2_net_async_priority_scheduling = true;
+
+  std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  testExecution(net, net_def.op().size());
+
+  // Profiled costs replace the estimated ones
+  auto* async_net = dynamic_cast_if_rtti<AsyncSchedulingNet*>(net.get());
+  CHECK_NOTNULL(async_net);
+  async_net->setOperatorCosts({1.0f, 1.0f, 10.0f, 10.0f, 1.0f});
+  testExecution(net, net_def.op().size());
+  EXPECT_THROW(async_net->setOperatorCosts({1.0f}), EnforceNotMet);
+}
+
 TEST(NetTest, ChainingForwardBackward) {
   const auto spec = R"DOC(
   name: "gpu_0"
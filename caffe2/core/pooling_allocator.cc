@@ -0,0 +1,342 @@
+#include "caffe2/core/pooling_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+CAFFE2_DEFINE_int64(
+    caffe2_pooling_allocator_max_block_bytes,
+    1LL << 28,
+    "Allocations larger than this are not pooled by PoolingCPUAllocator");
+CAFFE2_DEFINE_int64(
+    caffe2_pooling_allocator_thread_cache_bytes,
+    16 << 20,
+    "Maximal number of bytes a thread keeps cached in PoolingCPUAllocator "
+    "before moving its cached blocks to the shared arena");
+CAFFE2_DEFINE_int64(
+    caffe2_pooling_allocator_arena_bytes,
+    4LL << 30,
+    "Maximal number of bytes cached by each NUMA arena of "
+    "PoolingCPUAllocator. Blocks freed beyond that go back to the system");
+CAFFE2_DEFINE_bool(
+    caffe2_pooling_allocator_huge_pages,
+    false,
+    "If set, PoolingCPUAllocator backs large blocks with transparent huge "
+    "pages");
+CAFFE2_DEFINE_int64(
+    caffe2_pooling_allocator_huge_page_min_bytes,
+    4 << 20,
+    "Minimal block size backed by transparent huge pages");
+
+namespace caffe2 {
+
+namespace {
+
+constexpr size_t kHugePageSize = 2 << 20;
+constexpr int kMinSizeClass = 6;
+constexpr int kNumSizeClasses = 48;
+constexpr uint64_t kBlockMagic = 0xca2ffe2b10cULL;
+
+// Stored in front of every block, keeps the returned pointer aligned
+struct BlockHeader {
+  uint64_t magic;
+  // Size class of the block, or -1 if the block is not pooled
+  int32_t sizeClass;
+  int32_t arena;
+  uint64_t capacity;
+  uint64_t rawBytes;
+};
+constexpr size_t kHeaderSize = gCaffe2Alignment;
+static_assert(
+    sizeof(BlockHeader) <= kHeaderSize,
+    "Block header does not fit into the alignment padding");
+
+inline BlockHeader* header(void* data) {
+  return reinterpret_cast<BlockHeader*>(
+      static_cast<char*>(data) - kHeaderSize);
+}
+
+struct Arena {
+  std::mutex mutex;
+  std::vector<void*> blocks[kNumSizeClasses];
+  size_t bytes{0};
+};
+
+struct Pool {
+  Pool() : stats("pooling_cpu_allocator") {
+    const int numArenas = IsNUMAEnabled() ? std::max(GetNumNUMANodes(), 1) : 1;
+    for (int i = 0; i < numArenas; ++i) {
+      arenas.emplace_back(new Arena());
+    }
+  }
+
+  // Maps the current NUMA node to an arena
+  int currentArena() const {
+    if (arenas.size() == 1) {
+      return 0;
+    }
+    const int node = GetCurrentNUMANode();
+    return node >= 0 && node < arenas.size() ? node : 0;
+  }
+
+  std::vector<std::unique_ptr<Arena>> arenas;
+  PoolingAllocatorStats stats;
+};
+
+// Intentionally leaked: blocks may be freed by static destructors of other
+// translation units
+Pool& pool() {
+  static Pool* pool = new Pool();
+  return *pool;
+}
+
+void* systemAllocate(size_t capacity, int sizeClass, int arena) {
+  auto& p = pool();
+  size_t rawBytes = capacity + kHeaderSize;
+  size_t alignment = gCaffe2Alignment;
+  const bool hugePages = FLAGS_caffe2_pooling_allocator_huge_pages &&
+      rawBytes >= FLAGS_caffe2_pooling_allocator_huge_page_min_bytes;
+  if (hugePages) {
+    alignment = kHugePageSize;
+    rawBytes = (rawBytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  }
+
+  void* raw = nullptr;
+#ifdef __ANDROID__
+  raw = memalign(alignment, rawBytes);
+#elif defined(_MSC_VER)
+  raw = _aligned_malloc(rawBytes, alignment);
+#else
+  CAFFE_ENFORCE_EQ(posix_memalign(&raw, alignment, rawBytes), 0);
+#endif
+  CAFFE_ENFORCE(raw);
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // Best effort, the kernel may not support transparent huge pages
+  if (hugePages && madvise(raw, rawBytes, MADV_HUGEPAGE) == 0) {
+    CAFFE_EVENT(p.stats, huge_page_allocations);
+  }
+#endif
+  if (p.arenas.size() > 1) {
+    NUMAMove(raw, rawBytes, arena);
+  }
+  CAFFE_EVENT(p.stats, system_allocations);
+  CAFFE_EVENT(p.stats, system_allocated_bytes, rawBytes);
+
+  auto* h = static_cast<BlockHeader*>(raw);
+  h->magic = kBlockMagic;
+  h->sizeClass = sizeClass;
+  h->arena = arena;
+  h->capacity = capacity;
+  h->rawBytes = rawBytes;
+  return static_cast<char*>(raw) + kHeaderSize;
+}
+
+void systemFree(void* data) {
+  auto* h = header(data);
+  auto& p = pool();
+  CAFFE_EVENT(p.stats, system_frees);
+  CAFFE_EVENT(p.stats, system_freed_bytes, h->rawBytes);
+#ifdef _MSC_VER
+  _aligned_free(h);
+#else
+  free(h);
+#endif
+}
+
+size_t arenaLimit() {
+  return std::max<int64_t>(FLAGS_caffe2_pooling_allocator_arena_bytes, 0);
+}
+
+size_t threadCacheLimit() {
+  return std::max<int64_t>(
+      FLAGS_caffe2_pooling_allocator_thread_cache_bytes, 0);
+}
+
+// Moves a block to its arena, or frees it if the arena is full
+void arenaPush(void* data) {
+  auto* h = header(data);
+  auto& arena = *pool().arenas[h->arena];
+  {
+    std::lock_guard<std::mutex> guard(arena.mutex);
+    if (arena.bytes + h->capacity <= arenaLimit()) {
+      arena.blocks[h->sizeClass].push_back(data);
+      arena.bytes += h->capacity;
+      return;
+    }
+  }
+  systemFree(data);
+}
+
+void* arenaPop(int arenaIndex, int sizeClass) {
+  auto& arena = *pool().arenas[arenaIndex];
+  std::lock_guard<std::mutex> guard(arena.mutex);
+  auto& blocks = arena.blocks[sizeClass];
+  if (blocks.empty()) {
+    return nullptr;
+  }
+  void* data = blocks.back();
+  blocks.pop_back();
+  arena.bytes -= header(data)->capacity;
+  return data;
+}
+
+// Set once the cache of the current thread has been destroyed. Blocks freed
+// after that, e.g. by other thread local destructors, go to the arena.
+thread_local bool threadCacheDestroyed = false;
+
+struct ThreadCache {
+  ThreadCache() : arena(pool().currentArena()) {}
+
+  ~ThreadCache() {
+    flush();
+    threadCacheDestroyed = true;
+  }
+
+  void flush() {
+    if (bytes == 0) {
+      return;
+    }
+    auto& a = *pool().arenas[arena];
+    std::vector<void*> overflow;
+    {
+      std::lock_guard<std::mutex> guard(a.mutex);
+      for (int c = 0; c < kNumSizeClasses; ++c) {
+        for (void* data : blocks[c]) {
+          const auto capacity = header(data)->capacity;
+          if (a.bytes + capacity <= arenaLimit()) {
+            a.blocks[c].push_back(data);
+            a.bytes += capacity;
+          } else {
+            overflow.push_back(data);
+          }
+        }
+        blocks[c].clear();
+      }
+    }
+    for (void* data : overflow) {
+      systemFree(data);
+    }
+    bytes = 0;
+    CAFFE_EVENT(pool().stats, thread_cache_flushes);
+  }
+
+  const int arena;
+  size_t bytes{0};
+  std::vector<void*> blocks[kNumSizeClasses];
+};
+
+ThreadCache* threadCache() {
+  if (threadCacheDestroyed) {
+    return nullptr;
+  }
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+// Returns the size class for nbytes, or -1 if it should not be pooled
+int sizeClass(size_t nbytes) {
+  if (int64_t(nbytes) > FLAGS_caffe2_pooling_allocator_max_block_bytes) {
+    return -1;
+  }
+  int c = kMinSizeClass;
+  while ((size_t(1) << c) < nbytes) {
+    ++c;
+  }
+  return c < kNumSizeClasses ? c : -1;
+}
+
+} // namespace
+
+std::pair<void*, MemoryDeleter> PoolingCPUAllocator::New(size_t nbytes) {
+  const int c = sizeClass(nbytes);
+  auto* cache = threadCache();
+  const int arena = cache ? cache->arena : pool().currentArena();
+
+  void* data = nullptr;
+  if (c < 0) {
+    data = systemAllocate(nbytes, -1, arena);
+  } else {
+    if (cache && !cache->blocks[c].empty()) {
+      data = cache->blocks[c].back();
+      cache->blocks[c].pop_back();
+      cache->bytes -= header(data)->capacity;
+    }
+    if (!data) {
+      data = arenaPop(arena, c);
+      if (data) {
+        CAFFE_EVENT(pool().stats, arena_hits);
+      }
+    }
+    if (!data) {
+      data = systemAllocate(size_t(1) << c, c, arena);
+    }
+  }
+
+  if (FLAGS_caffe2_cpu_allocator_do_zero_fill) {
+    memset(data, 0, nbytes);
+  }
+  return {data, Delete};
+}
+
+void PoolingCPUAllocator::Delete(void* data) {
+  if (!data) {
+    return;
+  }
+  auto* h = header(data);
+  CHECK_EQ(h->magic, kBlockMagic) << "Not allocated by PoolingCPUAllocator";
+  if (h->sizeClass < 0) {
+    systemFree(data);
+    return;
+  }
+
+  auto* cache = threadCache();
+  // Blocks of other NUMA nodes go back to their own arena
+  if (cache && cache->arena == h->arena &&
+      h->capacity <= threadCacheLimit()) {
+    cache->blocks[h->sizeClass].push_back(data);
+    cache->bytes += h->capacity;
+    if (cache->bytes > threadCacheLimit()) {
+      cache->flush();
+    }
+    return;
+  }
+  arenaPush(data);
+}
+
+void PoolingCPUAllocator::ReleaseCachedBlocks() {
+  if (auto* cache = threadCache()) {
+    cache->flush();
+  }
+  for (auto& arena : pool().arenas) {
+    std::vector<void*> blocks;
+    {
+      std::lock_guard<std::mutex> guard(arena->mutex);
+      for (auto& sizeClassBlocks : arena->blocks) {
+        blocks.insert(
+            blocks.end(), sizeClassBlocks.begin(), sizeClassBlocks.end());
+        sizeClassBlocks.clear();
+      }
+      arena->bytes = 0;
+    }
+    for (void* data : blocks) {
+      systemFree(data);
+    }
+  }
+}
+
+size_t PoolingCPUAllocator::ArenaCachedBytes() {
+  size_t bytes = 0;
+  for (auto& arena : pool().arenas) {
+    std::lock_guard<std::mutex> guard(arena->mutex);
+    bytes += arena->bytes;
+  }
+  return bytes;
+}
+
+} // namespace caffe2
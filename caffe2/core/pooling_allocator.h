@@ -0,0 +1,70 @@
+#ifndef CAFFE2_CORE_POOLING_ALLOCATOR_H_
+#define CAFFE2_CORE_POOLING_ALLOCATOR_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/numa.h"
+#include "caffe2/core/stats.h"
+
+CAFFE2_DECLARE_bool(caffe2_cpu_allocator_do_zero_fill);
+CAFFE2_DECLARE_int64(caffe2_pooling_allocator_max_block_bytes);
+CAFFE2_DECLARE_int64(caffe2_pooling_allocator_thread_cache_bytes);
+CAFFE2_DECLARE_int64(caffe2_pooling_allocator_arena_bytes);
+CAFFE2_DECLARE_bool(caffe2_pooling_allocator_huge_pages);
+CAFFE2_DECLARE_int64(caffe2_pooling_allocator_huge_page_min_bytes);
+
+namespace caffe2 {
+
+/**
+ * A CPUAllocator that keeps freed blocks around for reuse instead of
+ * returning them to the system.
+ *
+ * Requests are rounded up to a power-of-two size class. Freed blocks first go
+ * to a small cache owned by the freeing thread, which is accessed without any
+ * locking, and from there to a mutex protected arena. There is one arena per
+ * NUMA node, blocks are bound to the node of the thread that first allocated
+ * them and are only reused on that node. Blocks larger than
+ * caffe2_pooling_allocator_max_block_bytes are not pooled.
+ *
+ * The pool itself is global and outlives the allocator object, so it is safe
+ * to replace the allocator with SetCPUAllocator while tensors allocated by the
+ * pool are still alive.
+ *
+ * Usage:
+ *   SetCPUAllocator(new PoolingCPUAllocator());
+ */
+struct PoolingCPUAllocator final : CPUAllocator {
+  PoolingCPUAllocator() {}
+  ~PoolingCPUAllocator() override {}
+
+  std::pair<void*, MemoryDeleter> New(size_t nbytes) override;
+
+  static void Delete(void* data);
+
+  // Returns the blocks cached by the calling thread and by all arenas to the
+  // system. Blocks cached by other threads are kept.
+  static void ReleaseCachedBlocks();
+
+  // Number of bytes held by the arenas, excluding per-thread caches
+  static size_t ArenaCachedBytes();
+};
+
+// Counters of the (slow) arena path of the pool, the thread cache fast path is
+// not instrumented
+struct PoolingAllocatorStats {
+  CAFFE_STAT_CTOR(PoolingAllocatorStats);
+  // Allocations served by an arena
+  CAFFE_EXPORTED_STAT(arena_hits);
+  // Allocations that had to go to the system allocator
+  CAFFE_EXPORTED_STAT(system_allocations);
+  CAFFE_EXPORTED_STAT(system_allocated_bytes);
+  CAFFE_EXPORTED_STAT(system_frees);
+  CAFFE_EXPORTED_STAT(system_freed_bytes);
+  // Blocks backed by transparent huge pages
+  CAFFE_EXPORTED_STAT(huge_page_allocations);
+  // Blocks moved from a thread cache to an arena
+  CAFFE_EXPORTED_STAT(thread_cache_flushes);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_POOLING_ALLOCATOR_H_
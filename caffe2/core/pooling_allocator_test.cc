@@ -0,0 +1,123 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/pooling_allocator.h"
+#include "caffe2/core/scope_guard.h"
+#include "caffe2/core/tensor.h"
+
+namespace caffe2 {
+
+TEST(PoolingCPUAllocatorTest, ReusesFreedBlocks) {
+  PoolingCPUAllocator allocator;
+  auto first = allocator.New(1000);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(first.first) % gCaffe2Alignment, 0);
+  first.second(first.first);
+
+  // Same size class, served from the thread cache
+  auto second = allocator.New(700);
+  EXPECT_EQ(second.first, first.first);
+  second.second(second.first);
+
+  // Different size class
+  auto third = allocator.New(5000);
+  EXPECT_NE(third.first, first.first);
+  third.second(third.first);
+  PoolingCPUAllocator::ReleaseCachedBlocks();
+}
+
+TEST(PoolingCPUAllocatorTest, ZeroFillsReusedBlocks) {
+  auto old = FLAGS_caffe2_cpu_allocator_do_zero_fill;
+  FLAGS_caffe2_cpu_allocator_do_zero_fill = true;
+  auto guard =
+      MakeGuard([&]() { FLAGS_caffe2_cpu_allocator_do_zero_fill = old; });
+
+  PoolingCPUAllocator allocator;
+  auto block = allocator.New(256);
+  memset(block.first, 0xff, 256);
+  block.second(block.first);
+
+  block = allocator.New(256);
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(static_cast<char*>(block.first)[i], 0);
+  }
+  block.second(block.first);
+  PoolingCPUAllocator::ReleaseCachedBlocks();
+}
+
+TEST(PoolingCPUAllocatorTest, DoesNotPoolLargeBlocks) {
+  auto old = FLAGS_caffe2_pooling_allocator_max_block_bytes;
+  FLAGS_caffe2_pooling_allocator_max_block_bytes = 1 << 16;
+  auto guard = MakeGuard(
+      [&]() { FLAGS_caffe2_pooling_allocator_max_block_bytes = old; });
+
+  PoolingCPUAllocator::ReleaseCachedBlocks();
+  PoolingCPUAllocator allocator;
+  auto block = allocator.New(1 << 17);
+  block.second(block.first);
+  EXPECT_EQ(PoolingCPUAllocator::ArenaCachedBytes(), 0);
+}
+
+TEST(PoolingCPUAllocatorTest, MovesBlocksToArena) {
+  auto old = FLAGS_caffe2_pooling_allocator_thread_cache_bytes;
+  FLAGS_caffe2_pooling_allocator_thread_cache_bytes = 4096;
+  auto guard = MakeGuard(
+      [&]() { FLAGS_caffe2_pooling_allocator_thread_cache_bytes = old; });
+
+  PoolingCPUAllocator::ReleaseCachedBlocks();
+  PoolingCPUAllocator allocator;
+  std::vector<std::pair<void*, MemoryDeleter>> blocks;
+  for (int i = 0; i < 4; ++i) {
+    blocks.push_back(allocator.New(2048));
+  }
+  for (auto& block : blocks) {
+    block.second(block.first);
+  }
+  // The thread cache overflowed into the arena
+  EXPECT_GT(PoolingCPUAllocator::ArenaCachedBytes(), 0);
+
+  PoolingCPUAllocator::ReleaseCachedBlocks();
+  EXPECT_EQ(PoolingCPUAllocator::ArenaCachedBytes(), 0);
+}
+
+TEST(PoolingCPUAllocatorTest, FreesFromOtherThreads) {
+  PoolingCPUAllocator::ReleaseCachedBlocks();
+  PoolingCPUAllocator allocator;
+  std::vector<std::pair<void*, MemoryDeleter>> blocks;
+  for (int i = 0; i < 100; ++i) {
+    blocks.push_back(allocator.New(64 * (i + 1)));
+  }
+  std::thread freeing([&blocks]() {
+    for (auto& block : blocks) {
+      block.second(block.first);
+    }
+  });
+  freeing.join();
+  // The freeing thread handed its cache to the arena when it exited
+  EXPECT_GT(PoolingCPUAllocator::ArenaCachedBytes(), 0);
+
+  auto block = allocator.New(64);
+  EXPECT_EQ(block.first, blocks[0].first);
+  block.second(block.first);
+  PoolingCPUAllocator::ReleaseCachedBlocks();
+}
+
+TEST(PoolingCPUAllocatorTest, BacksTensors) {
+  SetCPUAllocator(new PoolingCPUAllocator());
+  auto guard = MakeGuard([]() {
+    SetCPUAllocator(new DefaultCPUAllocator());
+    PoolingCPUAllocator::ReleaseCachedBlocks();
+  });
+
+  TensorCPU tensor(std::vector<TIndex>{16, 16});
+  auto* data = tensor.mutable_data<float>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    data[i] = i;
+  }
+  // Blocks allocated by the pool stay valid after the allocator is replaced
+  SetCPUAllocator(new DefaultCPUAllocator());
+  tensor.Resize(32, 32);
+  tensor.mutable_data<float>();
+}
+
+} // namespace caffe2
@@ -1,5 +1,7 @@
 #include "caffe2/core/predictor.h"
 
+#include "caffe2/core/operator.h"
+
 namespace caffe2 {
 
 namespace {
@@ -37,13 +39,46 @@ Predictor::Predictor(
     Workspace* parent)
     : run_net_(run_net), ws_(parent) {
   CAFFE_ENFORCE(ws_.RunNetOnce(init_net));
+  for (const auto& name : ws_.Blobs()) {
+    init_blobs_.insert(name);
+  }
   CAFFE_ENFORCE(ws_.CreateNet(run_net));
 }
 
-Predictor::~Predictor() {}
+Predictor::Predictor(const NetDef& run_net, Workspace* parent, int num_inputs)
+    : run_net_(run_net), ws_(parent), max_inputs_(num_inputs) {
+  CAFFE_ENFORCE(parent, "Predictor needs an initialized parent workspace");
+  CAFFE_ENFORCE(num_inputs >= 0 && num_inputs <= run_net.external_input_size());
+  std::set<std::string> local_blobs;
+  for (auto i = 0; i < num_inputs; ++i) {
+    ws_.CreateLocalBlob(run_net.external_input(i))->GetMutable<TensorCPU>();
+    local_blobs.insert(run_net.external_input(i));
+  }
+  for (const auto& op : run_net.op()) {
+    local_blobs.insert(op.output().begin(), op.output().end());
+  }
+  for (const auto& name : local_blobs) {
+    ws_.CreateLocalBlob(name);
+  }
+  for (const auto& name : ws_.Blobs()) {
+    if (!local_blobs.count(name)) {
+      init_blobs_.insert(name);
+    }
+  }
+  CAFFE_ENFORCE(ws_.CreateNet(run_net));
+}
+
+Predictor::~Predictor() {
+  releaseArena();
+}
 
 bool Predictor::run(const TensorVector& inputs, TensorVector* outputs) {
   CAFFE_ENFORCE(inputs.size() <= run_net_.external_input_size());
+  CAFFE_ENFORCE(
+      max_inputs_ < 0 || inputs.size() <= static_cast<size_t>(max_inputs_),
+      "Inputs beyond the first ",
+      max_inputs_,
+      " would be written to the shared parent workspace");
   for (auto i = 0; i < inputs.size(); ++i) {
     shareInputTensor(&ws_, run_net_.external_input(i), inputs[i]);
   }
@@ -58,4 +93,63 @@ bool Predictor::run(const TensorVector& inputs, TensorVector* outputs) {
   }
   return true;
 }
+
+size_t Predictor::planMemory(const TensorVector& inputs) {
+  CAFFE_ENFORCE(inputs.size() <= run_net_.external_input_size());
+  for (auto i = 0; i < inputs.size(); ++i) {
+    shareInputTensor(&ws_, run_net_.external_input(i), inputs[i]);
+  }
+
+  vector<std::unique_ptr<NetDef>> nets;
+  nets.emplace_back(new NetDef(run_net_));
+  auto shapes = InferBlobShapesAndTypesFromWorkspace(&ws_, nets);
+
+  releaseArena();
+  arena_plan_ = memonger::plan_inference_arena(run_net_, init_blobs_, shapes);
+  if (arena_plan_.arena_nbytes == 0) {
+    return 0;
+  }
+
+  auto data_and_deleter = CPUContext::New(arena_plan_.arena_nbytes);
+  arena_.reset(data_and_deleter.first, data_and_deleter.second);
+  auto* arena_data = static_cast<char*>(arena_.get());
+  for (const auto& assignment : arena_plan_.blobs) {
+    auto* blob = ws_.GetBlob(assignment.blob);
+    CAFFE_ENFORCE(blob, "Blob: ", assignment.blob, " does not exist");
+    auto* tensor = blob->GetMutable<TensorCPU>();
+    tensor->Resize(std::vector<TIndex>(
+        assignment.shape.dims().begin(), assignment.shape.dims().end()));
+    tensor->ShareExternalPointer(
+        arena_data + assignment.offset,
+        DataTypeToTypeMeta(assignment.shape.data_type()),
+        assignment.nbytes);
+  }
+  LOG(INFO) << "Planned " << arena_plan_.blobs.size()
+            << " blobs into a memory arena of " << arena_plan_.arena_nbytes
+            << " bytes";
+  return arena_plan_.arena_nbytes;
+}
+
+void Predictor::releaseArena() {
+  if (!arena_) {
+    return;
+  }
+  // Make sure no tensor keeps pointing into the arena once it's gone
+  for (const auto& assignment : arena_plan_.blobs) {
+    auto* blob = ws_.GetBlob(assignment.blob);
+    if (blob && blob->IsType<TensorCPU>()) {
+      auto* tensor = blob->GetMutable<TensorCPU>();
+      if (tensor->capacity_nbytes() == 0) {
+        continue;
+      }
+      auto* begin = static_cast<const char*>(arena_.get());
+      auto* data = static_cast<const char*>(tensor->raw_data());
+      if (data >= begin && data < begin + arena_plan_.arena_nbytes) {
+        tensor->FreeMemory();
+      }
+    }
+  }
+  arena_.reset();
+  arena_plan_ = memonger::ArenaPlan();
+}
 }
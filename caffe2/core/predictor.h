@@ -1,5 +1,6 @@
 #pragma once
 
+#include "caffe2/core/memonger.h"
 #include "caffe2/core/net.h"
 #include "caffe2/core/tensor.h"
 
@@ -14,6 +15,12 @@ class Predictor {
       const NetDef& init_net,
       const NetDef& run_net,
       Workspace* parent = nullptr);
+  // Runs `run_net` on top of `parent`, which is expected to be initialized
+  // already and is treated as read-only: the first `num_inputs` external
+  // inputs and every blob written by `run_net` live in the predictor's own
+  // workspace. Several such predictors can therefore run concurrently on top
+  // of the same parent.
+  Predictor(const NetDef& run_net, Workspace* parent, int num_inputs);
   ~Predictor();
 
   // Executes `run_net` on the inputs.
@@ -29,6 +36,16 @@ class Predictor {
   // Returns true on success
   bool run(const TensorVector& inputs, TensorVector* outputs);
 
+  // Runs shape inference for inputs shaped like `inputs` and binds all
+  // activations of `run_net` to offsets of a single preallocated arena
+  // (see memonger::plan_inference_arena). Subsequent runs with the same
+  // input shapes don't go through the allocator for planned blobs; tensors
+  // that end up larger than planned fall back to regular allocation.
+  // Only nets executed in op order ("simple") are planned.
+
+  // Returns the arena size in bytes, 0 if nothing was planned
+  size_t planMemory(const TensorVector& inputs);
+
   const NetDef& def() const {
     return run_net_;
   };
@@ -38,7 +55,14 @@ class Predictor {
   };
 
  private:
+  void releaseArena();
+
   NetDef run_net_;
   Workspace ws_;
+  std::set<std::string> init_blobs_;
+  // Max number of inputs `run` accepts, -1 if not limited
+  int max_inputs_ = -1;
+  memonger::ArenaPlan arena_plan_;
+  std::shared_ptr<void> arena_;
 };
 }
@@ -0,0 +1,251 @@
+#include "caffe2/core/predictor_batcher.h"
+
+#include "caffe2/core/timer.h"
+
+namespace caffe2 {
+
+namespace {
+
+const int kNumHistogramBuckets = 21;
+
+// Power of two bucket of `value`: 0 for [0, 2), 1 for [2, 4), and so on
+size_t histogramBucket(int64_t value) {
+  size_t bucket = 0;
+  while (value > 1 && bucket + 1 < kNumHistogramBuckets) {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+std::vector<std::string> histogramBucketNames() {
+  std::vector<std::string> names;
+  for (int bucket = 0; bucket < kNumHistogramBuckets; ++bucket) {
+    int64_t low = bucket == 0 ? 0 : (int64_t(1) << bucket);
+    if (bucket + 1 == kNumHistogramBuckets) {
+      names.push_back(caffe2::to_string(low) + "+");
+    } else {
+      int64_t high = (int64_t(1) << (bucket + 1)) - 1;
+      names.push_back(caffe2::to_string(low) + "-" + caffe2::to_string(high));
+    }
+  }
+  return names;
+}
+
+TIndex rowsOf(const Predictor::TensorVector& inputs) {
+  CAFFE_ENFORCE(!inputs.empty(), "Batched requests need at least one input");
+  for (const auto* input : inputs) {
+    CAFFE_ENFORCE(input);
+    CAFFE_ENFORCE_GE(input->ndim(), 1, "Batched inputs need a batch dimension");
+    CAFFE_ENFORCE_EQ(
+        input->dim(0),
+        inputs[0]->dim(0),
+        "All inputs of a request need the same batch size");
+  }
+  return inputs[0]->dim(0);
+}
+
+// Whether two requests can be concatenated into one batch: same number of
+// inputs with the same types and inner dimensions
+bool canBatch(
+    const Predictor::TensorVector& a,
+    const Predictor::TensorVector& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i]->meta() != b[i]->meta() || a[i]->ndim() != b[i]->ndim()) {
+      return false;
+    }
+    for (int d = 1; d < a[i]->ndim(); ++d) {
+      if (a[i]->dim(d) != b[i]->dim(d)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+std::string statsName(const Predictor* predictor) {
+  CAFFE_ENFORCE(predictor, "PredictorBatcher needs a predictor");
+  return "predictor_batcher/" + predictor->def().name();
+}
+} // namespace
+
+PredictorBatcher::PredictorBatcher(Predictor* predictor, const Options& options)
+    : predictor_(predictor),
+      options_(options),
+      stats_(statsName(predictor)) {
+  CAFFE_ENFORCE_GT(options_.max_batch_size, 0);
+  stats_.batch_size.setDetails(histogramBucketNames());
+  stats_.queue_wait_us.setDetails(histogramBucketNames());
+  batch_thread_ = std::thread(&PredictorBatcher::batchLoop, this);
+}
+
+PredictorBatcher::~PredictorBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+  }
+  cv_.notify_all();
+  batch_thread_.join();
+}
+
+std::future<PredictorBatcher::OutputVector> PredictorBatcher::runAsync(
+    const Predictor::TensorVector& inputs) {
+  std::unique_ptr<Request> request(new Request());
+  request->inputs = inputs;
+  request->rows = rowsOf(inputs);
+  request->enqueue_time = std::chrono::steady_clock::now();
+  auto future = request->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CAFFE_ENFORCE(!closing_, "PredictorBatcher is shutting down");
+    queued_rows_ += request->rows;
+    queue_.push_back(std::move(request));
+  }
+  CAFFE_EVENT(stats_, requests);
+  cv_.notify_all();
+  return future;
+}
+
+bool PredictorBatcher::run(
+    const Predictor::TensorVector& inputs,
+    OutputVector* outputs) {
+  auto future = runAsync(inputs);
+  try {
+    *outputs = future.get();
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Batched prediction failed: " << e.what();
+    return false;
+  }
+  return true;
+}
+
+void PredictorBatcher::batchLoop() {
+  while (true) {
+    std::vector<std::unique_ptr<Request>> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return closing_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        // Closing and all pending requests are served
+        return;
+      }
+      auto deadline = queue_.front()->enqueue_time + options_.max_wait;
+      bool full = cv_.wait_until(lock, deadline, [this]() {
+        return closing_ || queued_rows_ >= options_.max_batch_size;
+      });
+
+      // Take the oldest request and whatever later requests fit next to it.
+      // Requests that can't be concatenated with it stay queued for the next
+      // batch, so a malformed request only ever fails itself.
+      TIndex rows = queue_.front()->rows;
+      queued_rows_ -= rows;
+      batch.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+      for (auto it = queue_.begin();
+           it != queue_.end() && rows < options_.max_batch_size;) {
+        if (rows + (*it)->rows > options_.max_batch_size ||
+            !canBatch((*it)->inputs, batch[0]->inputs)) {
+          ++it;
+          continue;
+        }
+        rows += (*it)->rows;
+        queued_rows_ -= (*it)->rows;
+        batch.push_back(std::move(*it));
+        it = queue_.erase(it);
+      }
+
+      if (full) {
+        CAFFE_EVENT(stats_, batches_full);
+      } else {
+        CAFFE_EVENT(stats_, batches_on_timeout);
+      }
+      CAFFE_EVENT(stats_, batch_size, rows, histogramBucket(rows));
+    }
+    runBatch(batch);
+  }
+}
+
+void PredictorBatcher::runBatch(std::vector<std::unique_ptr<Request>>& batch) {
+  CAFFE_EVENT(stats_, batches);
+  auto now = std::chrono::steady_clock::now();
+  for (const auto& request : batch) {
+    auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                       now - request->enqueue_time)
+                       .count();
+    CAFFE_EVENT(stats_, queue_wait_us, wait_us, histogramBucket(wait_us));
+  }
+
+  std::vector<OutputVector> results(batch.size());
+  try {
+    TIndex total_rows = 0;
+    for (const auto& request : batch) {
+      total_rows += request->rows;
+    }
+
+    // Concatenate the inputs along the first dimension, a single request is
+    // passed through as is
+    std::vector<std::unique_ptr<TensorCPU>> batch_inputs;
+    Predictor::TensorVector inputs;
+    if (batch.size() == 1) {
+      inputs = batch[0]->inputs;
+    } else {
+      const auto num_inputs = batch[0]->inputs.size();
+      for (size_t i = 0; i < num_inputs; ++i) {
+        const auto* first = batch[0]->inputs[i];
+        auto dims = first->dims();
+        dims[0] = total_rows;
+        auto input = caffe2::make_unique<TensorCPU>(dims);
+        auto* dst = static_cast<char*>(input->raw_mutable_data(first->meta()));
+        for (const auto& request : batch) {
+          const auto* src = request->inputs[i];
+          context_.CopyItems<CPUContext, CPUContext>(
+              src->meta(), src->size(), src->raw_data(), dst);
+          dst += src->nbytes();
+        }
+        inputs.push_back(input.get());
+        batch_inputs.push_back(std::move(input));
+      }
+    }
+
+    Predictor::TensorVector outputs;
+    Timer run_timer;
+    CAFFE_ENFORCE(predictor_->run(inputs, &outputs), "Failed to run the net");
+    CAFFE_EVENT(stats_, run_time_us, run_timer.MicroSeconds());
+
+    // Scatter the rows of every output back to the requests
+    for (const auto* output : outputs) {
+      CAFFE_ENFORCE(
+          output->ndim() >= 1 && output->dim(0) == total_rows,
+          "Batched outputs need one row per input row");
+      const auto row_items = output->size_from_dim(1);
+      const auto row_bytes = row_items * output->itemsize();
+      const auto* src = static_cast<const char*>(output->raw_data());
+      for (size_t r = 0; r < batch.size(); ++r) {
+        auto dims = output->dims();
+        dims[0] = batch[r]->rows;
+        auto result = caffe2::make_unique<TensorCPU>(dims);
+        context_.CopyItems<CPUContext, CPUContext>(
+            output->meta(),
+            result->size(),
+            src,
+            result->raw_mutable_data(output->meta()));
+        src += batch[r]->rows * row_bytes;
+        results[r].push_back(std::move(result));
+      }
+    }
+  } catch (...) {
+    CAFFE_EVENT(stats_, failed_batches);
+    for (auto& request : batch) {
+      request->promise.set_exception(std::current_exception());
+    }
+    return;
+  }
+
+  for (size_t r = 0; r < batch.size(); ++r) {
+    batch[r]->promise.set_value(std::move(results[r]));
+  }
+}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/predictor.h"
+#include "caffe2/core/stats.h"
+
+namespace caffe2 {
+
+// Collects concurrent requests to a Predictor into batches. Inputs of the
+// requests in a batch are concatenated along the first dimension, the net is
+// run once and every output is split back along the first dimension.
+//
+// A batch is closed when it holds `max_batch_size` rows or when its oldest
+// request has waited for `max_wait`, whichever comes first. Only requests that
+// agree on the number, types and inner dimensions of the inputs share a batch,
+// others are run in a later batch. Every output of the net needs to have one
+// row per input row.
+class PredictorBatcher {
+ public:
+  using OutputVector = std::vector<std::unique_ptr<TensorCPU>>;
+
+  struct Options {
+    int max_batch_size = 32;
+    std::chrono::microseconds max_wait{1000};
+  };
+
+  // `predictor` has to outlive the batcher and must not be run by anyone
+  // else while the batcher exists.
+  PredictorBatcher(Predictor* predictor, const Options& options);
+  ~PredictorBatcher();
+
+  // Enqueues a request. The inputs have to stay valid until the returned
+  // future is ready. Throws if the inputs of the request are inconsistent,
+  // errors while running are reported through the future.
+  std::future<OutputVector> runAsync(const Predictor::TensorVector& inputs);
+
+  // Blocking version of runAsync, returns false if the batch failed
+  bool run(const Predictor::TensorVector& inputs, OutputVector* outputs);
+
+ private:
+  struct Request {
+    Predictor::TensorVector inputs;
+    TIndex rows;
+    std::chrono::steady_clock::time_point enqueue_time;
+    std::promise<OutputVector> promise;
+  };
+
+  struct PredictorBatcherStats {
+    CAFFE_STAT_CTOR(PredictorBatcherStats);
+    CAFFE_EXPORTED_STAT(requests);
+    CAFFE_EXPORTED_STAT(batches);
+    CAFFE_EXPORTED_STAT(batches_on_timeout);
+    CAFFE_EXPORTED_STAT(batches_full);
+    CAFFE_EXPORTED_STAT(failed_batches);
+    // Histograms with power of two buckets
+    CAFFE_DETAILED_EXPORTED_STAT(batch_size);
+    CAFFE_DETAILED_EXPORTED_STAT(queue_wait_us);
+    CAFFE_AVG_EXPORTED_STAT(run_time_us);
+  };
+
+  void batchLoop();
+  void runBatch(std::vector<std::unique_ptr<Request>>& batch);
+
+  Predictor* predictor_;
+  Options options_;
+  CPUContext context_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<Request>> queue_;
+  TIndex queued_rows_ = 0;
+  bool closing_ = false;
+
+  PredictorBatcherStats stats_;
+  std::thread batch_thread_;
+
+  DISABLE_COPY_AND_ASSIGN(PredictorBatcher);
+};
+}
@@ -0,0 +1,188 @@
+#include <google/protobuf/text_format.h>
+#include <thread>
+
+#include "caffe2/core/predictor_batcher.h"
+#include "caffe2/core/tensor.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const char* predictSpec = R"DOC(
+        name: "predict"
+        type: "simple"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "y"
+          type: "FC"
+        }
+)DOC";
+
+const char* initSpec = R"DOC(
+        name: "init"
+        op {
+          type: "ConstantFill"
+          output: "data"
+          arg {
+            name: "shape"
+            ints: 1
+            ints: 4
+          }
+          arg {
+            name: "value"
+            f: 0.0
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "W"
+          arg {
+            name: "shape"
+            ints: 2
+            ints: 4
+          }
+          arg {
+            name: "value"
+            f: 1.0
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "b"
+          arg {
+            name: "shape"
+            ints: 2
+          }
+          arg {
+            name: "value"
+            f: 0.5
+          }
+        }
+)DOC";
+
+NetDef parseNetDef(const std::string& value) {
+  NetDef def;
+  CAFFE_ENFORCE(
+      google::protobuf::TextFormat::ParseFromString(value, &def),
+      "Failed to parse NetDef with value: ",
+      value);
+  return def;
+}
+} // namespace
+
+TEST(PredictorBatcherTest, ScattersResultsToCallers) {
+  Predictor predictor(parseNetDef(initSpec), parseNetDef(predictSpec));
+  PredictorBatcher::Options options;
+  options.max_batch_size = 8;
+  options.max_wait = std::chrono::milliseconds(5);
+  PredictorBatcher batcher(&predictor, options);
+
+  const int kNumThreads = 16;
+  std::vector<std::thread> threads;
+  std::vector<int> failures(kNumThreads, 0);
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&batcher, &failures, t]() {
+      TensorCPU input(std::vector<TIndex>{1, 4});
+      for (int i = 0; i < 4; ++i) {
+        input.mutable_data<float>()[i] = t;
+      }
+      PredictorBatcher::OutputVector outputs;
+      if (!batcher.run({&input}, &outputs) || outputs.size() != 1 ||
+          outputs[0]->dim(0) != 1 || outputs[0]->dim(1) != 2) {
+        failures[t]++;
+        return;
+      }
+      // W is all ones and b is 0.5, so each output is 4 * t + 0.5
+      for (int i = 0; i < 2; ++i) {
+        if (outputs[0]->data<float>()[i] != 4 * t + 0.5f) {
+          failures[t]++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kNumThreads; ++t) {
+    EXPECT_EQ(failures[t], 0) << "Request " << t;
+  }
+}
+
+TEST(PredictorBatcherTest, MultiRowRequests) {
+  Predictor predictor(parseNetDef(initSpec), parseNetDef(predictSpec));
+  PredictorBatcher::Options options;
+  options.max_batch_size = 4;
+  PredictorBatcher batcher(&predictor, options);
+
+  TensorCPU first(std::vector<TIndex>{3, 4});
+  TensorCPU second(std::vector<TIndex>{2, 4});
+  for (int i = 0; i < first.size(); ++i) {
+    first.mutable_data<float>()[i] = 1;
+  }
+  for (int i = 0; i < second.size(); ++i) {
+    second.mutable_data<float>()[i] = 2;
+  }
+  auto first_future = batcher.runAsync({&first});
+  auto second_future = batcher.runAsync({&second});
+  auto first_outputs = first_future.get();
+  auto second_outputs = second_future.get();
+  EXPECT_EQ(first_outputs[0]->dim(0), 3);
+  EXPECT_EQ(second_outputs[0]->dim(0), 2);
+  EXPECT_EQ(first_outputs[0]->data<float>()[0], 4.5f);
+  EXPECT_EQ(second_outputs[0]->data<float>()[3], 8.5f);
+}
+
+TEST(PredictorBatcherTest, ReportsErrors) {
+  Predictor predictor(parseNetDef(initSpec), parseNetDef(predictSpec));
+  PredictorBatcher batcher(&predictor, PredictorBatcher::Options());
+  // Inner dimension doesn't match the weights
+  TensorCPU input(std::vector<TIndex>{1, 3});
+  input.mutable_data<float>();
+  PredictorBatcher::OutputVector outputs;
+  EXPECT_FALSE(batcher.run({&input}, &outputs));
+}
+
+TEST(PredictorBatcherTest, MalformedRequestFailsAlone) {
+  Predictor predictor(parseNetDef(initSpec), parseNetDef(predictSpec));
+  PredictorBatcher::Options options;
+  options.max_batch_size = 8;
+  options.max_wait = std::chrono::milliseconds(50);
+  PredictorBatcher batcher(&predictor, options);
+
+  TensorCPU good(std::vector<TIndex>{1, 4});
+  for (int i = 0; i < good.size(); ++i) {
+    good.mutable_data<float>()[i] = 1;
+  }
+  TensorCPU bad(std::vector<TIndex>{1, 3});
+  bad.mutable_data<float>();
+  auto good_future = batcher.runAsync({&good});
+  auto bad_future = batcher.runAsync({&bad});
+  auto other_good_future = batcher.runAsync({&good});
+  EXPECT_EQ(good_future.get()[0]->data<float>()[0], 4.5f);
+  EXPECT_EQ(other_good_future.get()[0]->data<float>()[0], 4.5f);
+  EXPECT_THROW(bad_future.get(), EnforceNotMet);
+}
+
+TEST(PredictorBatcherTest, RejectsInconsistentRequests) {
+  Predictor predictor(parseNetDef(initSpec), parseNetDef(predictSpec));
+  PredictorBatcher batcher(&predictor, PredictorBatcher::Options());
+  TensorCPU first(std::vector<TIndex>{1, 4});
+  TensorCPU second(std::vector<TIndex>{2, 4});
+  EXPECT_THROW(batcher.runAsync({&first, &second}), EnforceNotMet);
+  EXPECT_THROW(batcher.runAsync({}), EnforceNotMet);
+}
+
+TEST(PredictorBatcherTest, NullPredictorThrows) {
+  EXPECT_THROW(
+      PredictorBatcher(nullptr, PredictorBatcher::Options()), EnforceNotMet);
+}
+
+} // namespace caffe2
@@ -0,0 +1,104 @@
+#include "caffe2/core/predictor_pool.h"
+
+#include <set>
+
+namespace caffe2 {
+
+PredictorPool::PredictorPool(
+    const NetDef& init_net,
+    const NetDef& run_net,
+    int num_inputs,
+    size_t max_instances,
+    Workspace* parent)
+    : run_net_(run_net),
+      num_inputs_(num_inputs),
+      max_instances_(max_instances),
+      shared_ws_(parent) {
+  CAFFE_ENFORCE(shared_ws_.RunNetOnce(init_net));
+  // Only blobs written by run_net live in the instance workspaces, any other
+  // external output resolves to a blob of the shared workspace
+  std::set<std::string> written;
+  for (const auto& op : run_net_.op()) {
+    written.insert(op.output().begin(), op.output().end());
+  }
+  for (const auto& name : run_net_.external_output()) {
+    owned_outputs_.push_back(written.count(name) > 0);
+  }
+  // Create the first instance eagerly so that errors in run_net show up here
+  release(acquire());
+}
+
+PredictorPool::~PredictorPool() {}
+
+std::unique_ptr<Predictor> PredictorPool::acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (idle_.empty() && max_instances_ > 0 &&
+         num_instances_ >= max_instances_) {
+    released_.wait(lock);
+  }
+  if (!idle_.empty()) {
+    auto predictor = std::move(idle_.back());
+    idle_.pop_back();
+    return predictor;
+  }
+  ++num_instances_;
+  lock.unlock();
+
+  try {
+    return caffe2::make_unique<Predictor>(run_net_, &shared_ws_, num_inputs_);
+  } catch (...) {
+    lock.lock();
+    --num_instances_;
+    released_.notify_one();
+    throw;
+  }
+}
+
+void PredictorPool::release(std::unique_ptr<Predictor> predictor) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.push_back(std::move(predictor));
+  released_.notify_one();
+}
+
+size_t PredictorPool::numInstances() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_instances_;
+}
+
+bool PredictorPool::run(
+    const Predictor::TensorVector& inputs,
+    OutputVector* outputs) {
+  auto predictor = acquire();
+  Predictor::TensorVector instance_outputs;
+  bool success = false;
+  try {
+    success = predictor->run(inputs, &instance_outputs);
+  } catch (...) {
+    release(std::move(predictor));
+    throw;
+  }
+
+  if (success) {
+    outputs->clear();
+    outputs->reserve(instance_outputs.size());
+    for (size_t i = 0; i < instance_outputs.size(); ++i) {
+      auto* instance_output = instance_outputs[i];
+      auto output = caffe2::make_unique<TensorCPU>();
+      if (!owned_outputs_[i] || instance_output->shares_data()) {
+        // Data belongs to the shared parameters, an input or a memory arena,
+        // it has to be copied
+        output->CopyFrom(*instance_output);
+      } else {
+        // Hand the buffer over to the caller, the predictor allocates a new
+        // one on its next run
+        output->ResizeLike(*instance_output);
+        output->ShareData(*instance_output);
+        instance_output->FreeMemory();
+      }
+      outputs->push_back(std::move(output));
+    }
+  }
+  release(std::move(predictor));
+  return success;
+}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "caffe2/core/predictor.h"
+
+namespace caffe2 {
+
+// A thread-safe front-end for serving one model from many threads. The
+// `init_net` is run once in a shared workspace holding the parameters; every
+// concurrent `run` borrows a Predictor whose workspace only holds the
+// activations and reads the parameters from the shared one.
+class PredictorPool {
+ public:
+  using OutputVector = std::vector<std::unique_ptr<TensorCPU>>;
+
+  // `num_inputs` is the number of leading `run_net` external inputs fed by
+  // callers, the remaining external inputs are parameters. At most
+  // `max_instances` predictors are created (0 - no limit), callers beyond
+  // that wait for a predictor to become free.
+  PredictorPool(
+      const NetDef& init_net,
+      const NetDef& run_net,
+      int num_inputs,
+      size_t max_instances = 0,
+      Workspace* parent = nullptr);
+  ~PredictorPool();
+
+  // Can be called concurrently. Outputs own their data and stay valid
+  // after the call returns.
+  bool run(const Predictor::TensorVector& inputs, OutputVector* outputs);
+
+  const NetDef& def() const {
+    return run_net_;
+  }
+
+  // Workspace holding the shared parameters
+  Workspace* ws() {
+    return &shared_ws_;
+  }
+
+  size_t numInstances();
+
+ private:
+  std::unique_ptr<Predictor> acquire();
+  void release(std::unique_ptr<Predictor> predictor);
+
+  NetDef run_net_;
+  int num_inputs_;
+  size_t max_instances_;
+  Workspace shared_ws_;
+  // Whether each external output is written by run_net, i.e. lives in the
+  // instance workspace rather than in shared_ws_
+  std::vector<bool> owned_outputs_;
+
+  std::mutex mutex_;
+  std::condition_variable released_;
+  std::vector<std::unique_ptr<Predictor>> idle_;
+  size_t num_instances_ = 0;
+
+  DISABLE_COPY_AND_ASSIGN(PredictorPool);
+};
+}
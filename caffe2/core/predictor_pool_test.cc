@@ -0,0 +1,174 @@
+#include <google/protobuf/text_format.h>
+#include <atomic>
+#include <thread>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/predictor_pool.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/utils/math.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const char* predictSpec = R"DOC(
+        name: "predict"
+        type: "simple"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "fc"
+          type: "FC"
+        }
+        op {
+          input: "fc"
+          output: "y"
+          type: "Relu"
+        }
+)DOC";
+
+const char* initSpec = R"DOC(
+        name: "init"
+        op {
+          type: "XavierFill"
+          output: "W"
+          arg {
+            name: "shape"
+            ints: 10
+            ints: 4
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "b"
+          arg {
+            name: "shape"
+            ints: 10
+          }
+          arg {
+            name: "value"
+            f: 0.5
+          }
+        }
+)DOC";
+
+NetDef parseNetDef(const std::string& value) {
+  NetDef def;
+  CAFFE_ENFORCE(
+      google::protobuf::TextFormat::ParseFromString(value, &def),
+      "Failed to parse NetDef with value: ",
+      value);
+  return def;
+}
+
+std::vector<float> computeExpected(
+    Workspace* ws,
+    const TensorCPU& input) {
+  const auto& W = ws->GetBlob("W")->Get<TensorCPU>();
+  const auto& b = ws->GetBlob("b")->Get<TensorCPU>();
+  std::vector<float> result;
+  for (int n = 0; n < input.dim(0); ++n) {
+    for (int o = 0; o < W.dim(0); ++o) {
+      float sum = b.data<float>()[o];
+      for (int k = 0; k < W.dim(1); ++k) {
+        sum += input.data<float>()[n * W.dim(1) + k] *
+            W.data<float>()[o * W.dim(1) + k];
+      }
+      result.push_back(std::max(sum, 0.0f));
+    }
+  }
+  return result;
+}
+} // namespace
+
+TEST(PredictorPoolTest, ConcurrentRuns) {
+  PredictorPool pool(parseNetDef(initSpec), parseNetDef(predictSpec), 1, 4);
+  const int kNumThreads = 8;
+  const int kNumIters = 20;
+  std::vector<std::thread> threads;
+  std::atomic<int> failures(0);
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&pool, &failures, t]() {
+      CPUContext ctx;
+      for (int iter = 0; iter < kNumIters; ++iter) {
+        TensorCPU input(std::vector<TIndex>{t + 1, 4});
+        math::RandUniform<float, CPUContext>(
+            input.size(), -1.0, 1.0, input.mutable_data<float>(), &ctx);
+        PredictorPool::OutputVector outputs;
+        if (!pool.run({&input}, &outputs) || outputs.size() != 1) {
+          ++failures;
+          continue;
+        }
+        auto expected = computeExpected(pool.ws(), input);
+        if (outputs[0]->size() != static_cast<TIndex>(expected.size())) {
+          ++failures;
+          continue;
+        }
+        for (size_t i = 0; i < expected.size(); ++i) {
+          if (std::abs(outputs[0]->data<float>()[i] - expected[i]) > 1e-5) {
+            ++failures;
+            break;
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(failures, 0);
+  EXPECT_LE(pool.numInstances(), 4);
+  // Activations live in the instances, not in the shared workspace
+  EXPECT_FALSE(pool.ws()->HasBlob("fc"));
+}
+
+TEST(PredictorPoolTest, OutputsOutliveNextRun) {
+  PredictorPool pool(parseNetDef(initSpec), parseNetDef(predictSpec), 1, 1);
+  TensorCPU input(std::vector<TIndex>{1, 4});
+  for (int i = 0; i < input.size(); ++i) {
+    input.mutable_data<float>()[i] = 1.0;
+  }
+  PredictorPool::OutputVector first;
+  PredictorPool::OutputVector second;
+  ASSERT_TRUE(pool.run({&input}, &first));
+  for (int i = 0; i < input.size(); ++i) {
+    input.mutable_data<float>()[i] = -1.0;
+  }
+  ASSERT_TRUE(pool.run({&input}, &second));
+  EXPECT_NE(first[0]->raw_data(), second[0]->raw_data());
+}
+
+TEST(PredictorPoolTest, ParameterOutputsAreCopied) {
+  auto run_net = parseNetDef(predictSpec);
+  run_net.add_external_output("W");
+  PredictorPool pool(parseNetDef(initSpec), run_net, 1, 2);
+  const auto& W = pool.ws()->GetBlob("W")->Get<TensorCPU>();
+  const void* W_data = W.raw_data();
+
+  TensorCPU input(std::vector<TIndex>{2, 4});
+  for (int i = 0; i < input.size(); ++i) {
+    input.mutable_data<float>()[i] = 1.0;
+  }
+  PredictorPool::OutputVector outputs;
+  ASSERT_TRUE(pool.run({&input}, &outputs));
+  ASSERT_EQ(outputs.size(), 2);
+  // The shared weights are untouched and the caller got a private copy
+  EXPECT_EQ(W.raw_data(), W_data);
+  ASSERT_EQ(W.size(), 40);
+  EXPECT_NE(outputs[1]->raw_data(), W_data);
+  for (int i = 0; i < W.size(); ++i) {
+    EXPECT_EQ(outputs[1]->data<float>()[i], W.data<float>()[i]);
+  }
+  ASSERT_TRUE(pool.run({&input}, &outputs));
+  EXPECT_EQ(W.raw_data(), W_data);
+}
+
+} // namespace caffe2
@@ -1,7 +1,10 @@
 #include <google/protobuf/text_format.h>
+#include <atomic>
 #include "caffe2/core/context.h"
+#include "caffe2/core/memonger.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/predictor.h"
+#include "caffe2/core/scope_guard.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/utils/math.h"
 
@@ -71,6 +74,32 @@ const char* initSpec = R"DOC(
 
 )DOC";
 
+const char* simplePredictSpec = R"DOC(
+        name: "predict_simple"
+        type: "simple"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "fc1"
+          type: "FC"
+        }
+        op {
+          input: "fc1"
+          output: "relu1"
+          type: "Relu"
+        }
+        op {
+          input: "relu1"
+          output: "y"
+          type: "Softmax"
+        }
+)DOC";
+
 std::unique_ptr<Blob> randomTensor(
     const std::vector<TIndex>& dims,
     CPUContext* ctx) {
@@ -90,6 +119,26 @@ NetDef parseNetDef(const std::string& value) {
       value);
   return def;
 };
+
+TensorShape floatShape(const std::string& name, TIndex size) {
+  TensorShape shape;
+  shape.set_name(name);
+  shape.add_dims(size);
+  shape.set_data_type(TensorProto_DataType_FLOAT);
+  return shape;
+}
+
+struct CountingCPUAllocator final : CPUAllocator {
+  std::pair<void*, MemoryDeleter> New(size_t nbytes) override {
+    ++allocations;
+    return base.New(nbytes);
+  }
+
+  static std::atomic<int> allocations;
+  DefaultCPUAllocator base;
+};
+
+std::atomic<int> CountingCPUAllocator::allocations(0);
 }
 
 class PredictorTest : public testing::Test {
@@ -118,4 +167,123 @@ TEST_F(PredictorTest, SimpleBatchSized) {
   EXPECT_TRUE(output.front()->dim(1) == 10);
   EXPECT_NEAR(output.front()->data<float>()[4], 0.1209, 1E-4);
 }
+
+TEST(PredictorArenaTest, PlannedRunMatchesUnplanned) {
+  DeviceOption option;
+  option.set_random_seed(1701);
+  CPUContext ctx(option);
+  auto inputData = randomTensor({3, 4}, &ctx);
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+
+  Predictor reference(parseNetDef(initSpec), parseNetDef(simplePredictSpec));
+  Predictor::TensorVector expected;
+  ASSERT_TRUE(reference.run(input, &expected));
+
+  Predictor planned(parseNetDef(initSpec), parseNetDef(simplePredictSpec));
+  EXPECT_GT(planned.planMemory(input), 0);
+  Predictor::TensorVector output;
+  ASSERT_TRUE(planned.run(input, &output));
+  const void* first_run_data = output.front()->raw_data();
+  ASSERT_TRUE(planned.run(input, &output));
+  // Steady state runs reuse the arena instead of reallocating
+  EXPECT_EQ(first_run_data, output.front()->raw_data());
+
+  ASSERT_EQ(output.front()->size(), expected.front()->size());
+  for (int i = 0; i < output.front()->size(); ++i) {
+    EXPECT_NEAR(
+        output.front()->data<float>()[i],
+        expected.front()->data<float>()[i],
+        1E-6);
+  }
+}
+
+TEST(PredictorArenaTest, DagNetIsNotPlanned) {
+  DeviceOption option;
+  CPUContext ctx(option);
+  auto inputData = randomTensor({1, 4}, &ctx);
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+  Predictor p(parseNetDef(initSpec), parseNetDef(predictSpec));
+  EXPECT_EQ(p.planMemory(input), 0);
+  Predictor::TensorVector output;
+  EXPECT_TRUE(p.run(input, &output));
+}
+
+TEST(PredictorArenaTest, PlanSeparatesOverlappingLifetimes) {
+  // a: ops [0, 3], b: [1, 2], c: [2, 3], d: [3, end]. d can reuse b's slot,
+  // everything else overlaps somewhere.
+  NetDef net;
+  net.set_type("simple");
+  net.add_external_input("x");
+  net.add_external_output("d");
+  auto addOp = [&net](
+      const std::vector<std::string>& inputs, const std::string& output) {
+    auto* op = net.add_op();
+    op->set_type("Relu");
+    for (const auto& input : inputs) {
+      op->add_input(input);
+    }
+    op->add_output(output);
+  };
+  addOp({"x"}, "a");
+  addOp({"a"}, "b");
+  addOp({"b"}, "c");
+  addOp({"a", "c"}, "d");
+
+  TensorShapes shapes;
+  *shapes.add_shapes() = floatShape("x", 100);
+  *shapes.add_shapes() = floatShape("a", 1000);
+  *shapes.add_shapes() = floatShape("b", 2000);
+  *shapes.add_shapes() = floatShape("c", 500);
+  *shapes.add_shapes() = floatShape("d", 2000);
+
+  const size_t alignment = 64;
+  auto plan = memonger::plan_inference_arena(
+      net, std::set<std::string>(), shapes, alignment);
+  ASSERT_EQ(plan.blobs.size(), 4);
+
+  size_t naive_nbytes = 0;
+  for (const auto& blob : plan.blobs) {
+    EXPECT_NE(blob.blob, "x");
+    EXPECT_EQ(blob.offset % alignment, 0);
+    EXPECT_LE(blob.offset + blob.nbytes, plan.arena_nbytes);
+    naive_nbytes += (blob.nbytes + alignment - 1) / alignment * alignment;
+  }
+  for (size_t i = 0; i < plan.blobs.size(); ++i) {
+    for (size_t j = i + 1; j < plan.blobs.size(); ++j) {
+      const auto& x = plan.blobs[i];
+      const auto& y = plan.blobs[j];
+      if (x.first_op > y.last_op || y.first_op > x.last_op) {
+        continue;
+      }
+      EXPECT_TRUE(
+          x.offset + x.nbytes <= y.offset || y.offset + y.nbytes <= x.offset)
+          << x.blob << " and " << y.blob << " are alive at the same time "
+          << "but their arena slots overlap";
+    }
+  }
+  EXPECT_LE(plan.arena_nbytes, naive_nbytes);
+  // b and d never coexist, so the plan must be smaller than the naive sum
+  EXPECT_LT(plan.arena_nbytes, naive_nbytes);
+}
+
+TEST(PredictorArenaTest, PlannedSteadyStateDoesNotAllocate) {
+  DeviceOption option;
+  option.set_random_seed(1701);
+  CPUContext ctx(option);
+  auto inputData = randomTensor({3, 4}, &ctx);
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+
+  Predictor planned(parseNetDef(initSpec), parseNetDef(simplePredictSpec));
+  ASSERT_GT(planned.planMemory(input), 0);
+  Predictor::TensorVector output;
+  // The first run sets up op-internal scratch tensors
+  ASSERT_TRUE(planned.run(input, &output));
+
+  SetCPUAllocator(new CountingCPUAllocator());
+  auto guard = MakeGuard([]() { SetCPUAllocator(new DefaultCPUAllocator()); });
+  CountingCPUAllocator::allocations = 0;
+  ASSERT_TRUE(planned.run(input, &output));
+  ASSERT_TRUE(planned.run(input, &output));
+  EXPECT_EQ(CountingCPUAllocator::allocations, 0);
+}
 }
@@ -0,0 +1,282 @@
+#include "caffe2/core/tensor_delta.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "caffe2/core/blob_serialization.h"
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+namespace {
+
+void copyRow(
+    const TypeMeta& meta,
+    const char* src,
+    char* dst,
+    TIndex row_size) {
+  if (meta.copy()) {
+    meta.copy()(src, dst, row_size);
+  } else {
+    memcpy(dst, src, row_size * meta.itemsize());
+  }
+}
+
+} // namespace
+
+constexpr int DirtyRows::kMaxSavers;
+
+void DestroyDirtyRows(DirtyRows* rows) {
+  delete rows;
+}
+
+DirtyRows::DirtyRows(const TensorCPU& tensor)
+    : dims_(tensor.dims()),
+      meta_(tensor.meta()),
+      num_rows_(tensor.dim(0)),
+      num_words_((num_rows_ + 63) / 64) {}
+
+DirtyRows::~DirtyRows() {
+  for (auto& saver : savers_) {
+    delete[] saver.bits.load(std::memory_order_relaxed);
+  }
+}
+
+bool DirtyRows::Matches(const TensorCPU& tensor) const {
+  return tensor.dims() == dims_ && tensor.meta() == meta_;
+}
+
+DirtyRows::Saver* DirtyRows::find(const string& name) {
+  for (auto& saver : savers_) {
+    if (saver.active && saver.name == name) {
+      return &saver;
+    }
+  }
+  return nullptr;
+}
+
+DirtyRowTracker& DirtyRowTracker::Get() {
+  static DirtyRowTracker tracker;
+  return tracker;
+}
+
+void DirtyRowTracker::Track(const Blob* blob, const string& saver) {
+  CAFFE_ENFORCE(
+      blob->IsType<TensorCPU>(), "Only CPU tensors can be tracked by rows");
+  const auto& tensor = blob->Get<TensorCPU>();
+  CAFFE_ENFORCE_GT(tensor.ndim(), 0, "Scalars do not have rows");
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto* dirty_rows = blob->dirty_rows_.load(std::memory_order_acquire);
+  if (!dirty_rows || !dirty_rows->Matches(tensor)) {
+    // The rows tracked for the previous tensor are meaningless for all
+    // savers, but MarkRows() may still be setting bits in them
+    auto* replacement = new DirtyRows(tensor);
+    replacement->retired_.reset(dirty_rows);
+    dirty_rows = replacement;
+    blob->dirty_rows_.store(dirty_rows, std::memory_order_release);
+  }
+  auto* state = dirty_rows->find(saver);
+  if (!state) {
+    for (auto& candidate : dirty_rows->savers_) {
+      if (!candidate.active) {
+        state = &candidate;
+        break;
+      }
+    }
+    CAFFE_ENFORCE(
+        state,
+        "A blob can only be saved incrementally by ",
+        DirtyRows::kMaxSavers,
+        " savers");
+    state->name = saver;
+    state->active = true;
+  }
+  auto* bits = state->bits.load(std::memory_order_relaxed);
+  if (bits) {
+    for (size_t i = 0; i < dirty_rows->num_words_; ++i) {
+      bits[i].store(0, std::memory_order_relaxed);
+    }
+  } else {
+    bits = new std::atomic<uint64_t>[dirty_rows->num_words_];
+    for (size_t i = 0; i < dirty_rows->num_words_; ++i) {
+      bits[i].store(0, std::memory_order_relaxed);
+    }
+    state->bits.store(bits, std::memory_order_release);
+  }
+}
+
+void DirtyRowTracker::Untrack(const Blob* blob, const string& saver) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto* dirty_rows = blob->dirty_rows_.load(std::memory_order_acquire);
+  auto* state = dirty_rows ? dirty_rows->find(saver) : nullptr;
+  if (state) {
+    // Its bitmap stays allocated for the next saver using the slot
+    state->active = false;
+    state->name.clear();
+  }
+}
+
+void DirtyRowTracker::Untrack(const Blob* blob) {
+  if (!blob->dirty_rows_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto* dirty_rows = blob->dirty_rows_.load(std::memory_order_acquire);
+  // Kept, since MarkRows() may be setting bits in it. Track() clears the bits
+  // of a saver when it reuses its slot.
+  for (auto& saver : dirty_rows->savers_) {
+    saver.active = false;
+    saver.name.clear();
+  }
+}
+
+bool DirtyRowTracker::TakeRows(
+    const Blob* blob,
+    const string& saver,
+    vector<TIndex>* rows) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto* dirty_rows = blob->dirty_rows_.load(std::memory_order_acquire);
+  if (!dirty_rows || !blob->IsType<TensorCPU>() ||
+      !dirty_rows->Matches(blob->Get<TensorCPU>())) {
+    return false;
+  }
+  auto* state = dirty_rows->find(saver);
+  if (!state) {
+    return false;
+  }
+  auto* bits = state->bits.load(std::memory_order_relaxed);
+  rows->clear();
+  for (size_t i = 0; i < dirty_rows->num_words_; ++i) {
+    // Acquire makes the updates of the taken rows visible before they are
+    // copied; rows marked after the exchange stay set for the next delta
+    uint64_t word = bits[i].exchange(0, std::memory_order_acquire);
+    for (TIndex row = i * 64; word; ++row, word >>= 1) {
+      if (word & 1) {
+        rows->push_back(row);
+      }
+    }
+  }
+  return true;
+}
+
+void DirtyRowTracker::RestoreRows(
+    const Blob* blob,
+    const string& saver,
+    const vector<TIndex>& rows) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto* dirty_rows = blob->dirty_rows_.load(std::memory_order_acquire);
+  auto* state = dirty_rows ? dirty_rows->find(saver) : nullptr;
+  if (!state || !blob->IsType<TensorCPU>() ||
+      !dirty_rows->Matches(blob->Get<TensorCPU>())) {
+    return;
+  }
+  auto* bits = state->bits.load(std::memory_order_relaxed);
+  for (auto row : rows) {
+    bits[row / 64].fetch_or(uint64_t(1) << (row % 64));
+  }
+}
+
+void SerializeTensorDelta(
+    const TensorCPU& tensor,
+    const vector<TIndex>& rows,
+    const string& name,
+    BlobSerializerBase::SerializationAcceptor acceptor,
+    int chunk_size) {
+  CAFFE_ENFORCE_GT(tensor.ndim(), 0, "Scalars do not have rows");
+  const auto& meta = tensor.meta();
+  const TIndex row_size = tensor.size_from_dim(1);
+  const TIndex row_bytes = row_size * meta.itemsize();
+  const auto* data = static_cast<const char*>(tensor.raw_data());
+  const TIndex rows_per_chunk =
+      std::max<TIndex>(chunk_size / std::max<TIndex>(row_size, 1), 1);
+  const TIndex num_chunks = std::max<TIndex>(
+      (rows.size() + rows_per_chunk - 1) / rows_per_chunk, 1);
+
+  TensorSerializer<CPUContext> serializer;
+  for (TIndex chunk = 0; chunk < num_chunks; ++chunk) {
+    const TIndex begin = chunk * rows_per_chunk;
+    const TIndex end = std::min<TIndex>(begin + rows_per_chunk, rows.size());
+
+    auto dims = tensor.dims();
+    dims[0] = end - begin;
+    TensorCPU values(dims);
+    auto* values_data = static_cast<char*>(values.raw_mutable_data(meta));
+    TensorCPU indices(vector<TIndex>{end - begin});
+    auto* indices_data = indices.mutable_data<int64_t>();
+    for (TIndex i = begin; i < end; ++i) {
+      CAFFE_ENFORCE_LT(rows[i], tensor.dim(0), "Row out of range in ", name);
+      copyRow(
+          meta,
+          data + rows[i] * row_bytes,
+          values_data + (i - begin) * row_bytes,
+          row_size);
+      indices_data[i - begin] = rows[i];
+    }
+
+    BlobProto blob_proto;
+    blob_proto.set_name(name);
+    blob_proto.set_type(kTensorDeltaBlobType);
+    blob_proto.set_content_num_chunks(num_chunks);
+    blob_proto.set_content_chunk_id(chunk);
+    serializer.Serialize(
+        values, name, blob_proto.mutable_tensor(), 0, values.size());
+    TensorProto indices_proto;
+    serializer.Serialize(indices, name, &indices_proto, 0, indices.size());
+    blob_proto.set_content(indices_proto.SerializeAsString());
+    acceptor(
+        MakeString(name, kChunkIdSeparator, chunk),
+        blob_proto.SerializeAsString());
+  }
+}
+
+void ApplyTensorDelta(const BlobProto& proto, TensorCPU* tensor) {
+  CAFFE_ENFORCE_EQ(proto.type(), kTensorDeltaBlobType);
+  TensorDeserializer<CPUContext> deserializer;
+  TensorCPU values;
+  deserializer.Deserialize(proto.tensor(), &values);
+  TensorProto indices_proto;
+  CAFFE_ENFORCE(
+      indices_proto.ParseFromString(proto.content()),
+      "Cannot parse the row indices of ",
+      proto.name());
+  TensorCPU indices;
+  deserializer.Deserialize(indices_proto, &indices);
+
+  CAFFE_ENFORCE(
+      values.meta() == tensor->meta(),
+      "Delta of ",
+      proto.name(),
+      " has type ",
+      values.meta().name(),
+      " but the tensor is of type ",
+      tensor->meta().name());
+  CAFFE_ENFORCE_EQ(
+      values.ndim(), tensor->ndim(), "Delta shape mismatch for ", proto.name());
+  for (int i = 1; i < values.ndim(); ++i) {
+    CAFFE_ENFORCE_EQ(
+        values.dim(i),
+        tensor->dim(i),
+        "Delta shape mismatch for ",
+        proto.name());
+  }
+  CAFFE_ENFORCE_EQ(indices.size(), values.dim(0));
+
+  const auto& meta = tensor->meta();
+  const TIndex row_size = tensor->size_from_dim(1);
+  const TIndex row_bytes = row_size * meta.itemsize();
+  const auto* src = static_cast<const char*>(values.raw_data());
+  auto* dst = static_cast<char*>(tensor->raw_mutable_data(meta));
+  const auto* rows = indices.data<int64_t>();
+  for (TIndex i = 0; i < indices.size(); ++i) {
+    CAFFE_ENFORCE(
+        rows[i] >= 0 && rows[i] < tensor->dim(0),
+        "Row ",
+        rows[i],
+        " out of range in the delta of ",
+        proto.name());
+    copyRow(meta, src + i * row_bytes, dst + rows[i] * row_bytes, row_size);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,155 @@
+#ifndef CAFFE2_CORE_TENSOR_DELTA_H_
+#define CAFFE2_CORE_TENSOR_DELTA_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "caffe2/core/blob.h"
+#include "caffe2/core/blob_serializer_base.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+// Type of the BlobProtos holding the updated rows of a tensor
+constexpr auto kTensorDeltaBlobType = "TensorDelta";
+
+/**
+ * Rows of a tracked tensor updated since the last delta of each of its
+ * savers, as one bitmap per saver. Owned by the Blob of the tensor, so
+ * MarkRows() only has to look at the blob and set bits, without any lock.
+ * For the same reason, once published in a blob it is only freed along with
+ * the blob.
+ */
+class DirtyRows {
+ public:
+  // Number of independent checkpoints a blob can be saved incrementally to
+  static constexpr int kMaxSavers = 4;
+
+  explicit DirtyRows(const TensorCPU& tensor);
+  ~DirtyRows();
+
+  // Whether tensor still has the shape and type tracking started with
+  bool Matches(const TensorCPU& tensor) const;
+
+  void Mark(TIndex row) {
+    if (row < 0 || row >= num_rows_) {
+      return;
+    }
+    const uint64_t bit = uint64_t(1) << (row % 64);
+    for (auto& saver : savers_) {
+      auto* bits = saver.bits.load(std::memory_order_acquire);
+      if (bits) {
+        // Release orders the update of the row before the bit, for the
+        // saver which takes the bits with acquire before copying the rows
+        bits[row / 64].fetch_or(bit, std::memory_order_release);
+      }
+    }
+  }
+
+ private:
+  struct Saver {
+    // Guarded by the mutex of the tracker
+    string name;
+    bool active = false;
+    // Allocated once and kept until the blob is destroyed, because Mark()
+    // may be setting bits concurrently
+    std::atomic<std::atomic<uint64_t>*> bits{nullptr};
+  };
+
+  Saver* find(const string& name);
+
+  vector<TIndex> dims_;
+  TypeMeta meta_;
+  TIndex num_rows_;
+  size_t num_words_;
+  Saver savers_[kMaxSavers];
+  // Rows of the previous shape of the tensor, replaced by these ones while
+  // Mark() may still have been setting bits in them
+  std::unique_ptr<DirtyRows> retired_;
+
+  friend class DirtyRowTracker;
+  DISABLE_COPY_AND_ASSIGN(DirtyRows);
+};
+
+/**
+ * Records which rows of CPU tensors were modified in place by sparse updates,
+ * so that they can be checkpointed incrementally.
+ *
+ * Tracking of a blob for a saver starts when an incremental Save writes it in
+ * full. From then on, the operators updating rows in place (SparseAdagrad,
+ * SparseAdam, SparseFtrl and ScatterAssign) report the rows they wrote, and
+ * the next incremental Save of that saver only writes those. Each saver has
+ * its own rows, so several checkpoints of the same blob do not take each
+ * other's rows. A tracked tensor must not be modified by any other operator,
+ * otherwise its deltas are incomplete, and tracking must not start or stop
+ * while its rows are being updated after the tensor was replaced or resized.
+ *
+ * Only MarkRows() is on the training path: it does not take any lock. The
+ * other methods are called when saving or loading and are serialized.
+ */
+class DirtyRowTracker {
+ public:
+  static DirtyRowTracker& Get();
+
+  // Starts tracking the rows of the TensorCPU in blob for saver. Rows marked
+  // for saver before are forgotten.
+  void Track(const Blob* blob, const string& saver);
+  // Stops tracking the rows of blob for saver, or for all savers. The rows
+  // stay allocated until the blob is destroyed.
+  void Untrack(const Blob* blob, const string& saver);
+  void Untrack(const Blob* blob);
+
+  template <typename Index>
+  void MarkRows(const Blob* blob, const Index* rows, size_t n) {
+    auto* dirty_rows = blob->dirty_rows_.load(std::memory_order_acquire);
+    if (!dirty_rows) {
+      return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      dirty_rows->Mark(rows[i]);
+    }
+  }
+
+  // Marks the rows in all the given blobs, typically the outputs of an
+  // operator that updated the same rows of several tensors
+  template <typename Index>
+  void MarkRows(const vector<Blob*>& blobs, const Index* rows, size_t n) {
+    for (const auto* blob : blobs) {
+      MarkRows(blob, rows, n);
+    }
+  }
+
+  // If blob is tracked for saver and its tensor still has the shape and type
+  // it had when tracking started, moves the sorted rows marked since the last
+  // call into rows and returns true. Rows marked while they are being saved
+  // are kept for the next call.
+  bool TakeRows(const Blob* blob, const string& saver, vector<TIndex>* rows);
+  // Marks rows taken by TakeRows() again, when the delta they were taken for
+  // could not be written
+  void RestoreRows(
+      const Blob* blob,
+      const string& saver,
+      const vector<TIndex>& rows);
+
+ private:
+  std::mutex mutex_;
+};
+
+// Serializes the given rows of tensor, along with their indices, as
+// TensorDelta chunks of at most chunk_size elements
+void SerializeTensorDelta(
+    const TensorCPU& tensor,
+    const vector<TIndex>& rows,
+    const string& name,
+    BlobSerializerBase::SerializationAcceptor acceptor,
+    int chunk_size);
+
+// Overwrites the rows of tensor stored in a TensorDelta chunk
+void ApplyTensorDelta(const BlobProto& proto, TensorCPU* tensor);
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_TENSOR_DELTA_H_
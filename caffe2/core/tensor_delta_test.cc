@@ -0,0 +1,434 @@
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/blob_serialization.h"
+#include "caffe2/core/db.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/scope_guard.h"
+#include "caffe2/core/tensor_delta.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+namespace {
+
+std::string tempPath() {
+  char path[] = "/tmp/caffe2_tensor_delta_XXXXXX";
+  int fd = mkstemp(path);
+  CAFFE_ENFORCE_GE(fd, 0);
+  close(fd);
+  return path;
+}
+
+void fillTable(TensorCPU* table) {
+  auto* data = table->mutable_data<float>();
+  for (int i = 0; i < table->size(); ++i) {
+    data[i] = i;
+  }
+}
+
+// Overwrites the given rows and reports them the way sparse optimizers do
+void updateRows(
+    Blob* blob,
+    const std::vector<int64_t>& rows,
+    float value) {
+  auto* table = blob->GetMutable<TensorCPU>();
+  const auto row_size = table->size_from_dim(1);
+  for (auto row : rows) {
+    for (int j = 0; j < row_size; ++j) {
+      table->mutable_data<float>()[row * row_size + j] = value;
+    }
+  }
+  DirtyRowTracker::Get().MarkRows(blob, rows.data(), rows.size());
+}
+
+void runSave(
+    Workspace* ws,
+    const std::string& db,
+    const std::vector<std::string>& incremental,
+    const std::vector<std::string>& inputs = {"table", "counter"},
+    const std::string& saver = "") {
+  OperatorDef def;
+  def.set_type("Save");
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_arg()->CopyFrom(MakeArgument("db", db));
+  def.add_arg()->CopyFrom(MakeArgument<std::string>("db_type", "minidb"));
+  def.add_arg()->CopyFrom(MakeArgument("absolute_path", 1));
+  def.add_arg()->CopyFrom(MakeArgument("incremental_blobs", incremental));
+  def.add_arg()->CopyFrom(MakeArgument("incremental_saver", saver));
+  EXPECT_TRUE(CreateOperator(def, ws)->Run());
+}
+
+// Returns the rows of name stored as a delta in db
+std::vector<int64_t> deltaRows(
+    const std::string& db,
+    const std::string& name) {
+  std::unique_ptr<db::DB> delta(db::CreateDB("minidb", db, db::READ));
+  std::unique_ptr<db::Cursor> cursor(delta->NewCursor());
+  std::vector<int64_t> rows;
+  for (; cursor->Valid(); cursor->Next()) {
+    BlobProto proto;
+    EXPECT_TRUE(proto.ParseFromString(cursor->value()));
+    if (proto.name() != name) {
+      continue;
+    }
+    EXPECT_EQ(proto.type(), kTensorDeltaBlobType);
+    TensorProto indices;
+    EXPECT_TRUE(indices.ParseFromString(proto.content()));
+    rows.insert(
+        rows.end(), indices.int64_data().begin(), indices.int64_data().end());
+  }
+  return rows;
+}
+
+struct Unserializable {};
+
+} // namespace
+
+CAFFE_KNOWN_TYPE(Unserializable);
+
+TEST(DirtyRowTrackerTest, TakesMarkedRows) {
+  Blob blob;
+  blob.GetMutable<TensorCPU>()->Resize(100, 3);
+  blob.GetMutable<TensorCPU>()->mutable_data<float>();
+  auto& tracker = DirtyRowTracker::Get();
+
+  std::vector<TIndex> rows;
+  EXPECT_FALSE(tracker.TakeRows(&blob, "", &rows));
+  const int32_t untracked[] = {1};
+  tracker.MarkRows(&blob, untracked, 1);
+
+  tracker.Track(&blob, "");
+  const int32_t marked[] = {70, 2, 70, 99, -1, 100};
+  tracker.MarkRows(&blob, marked, 6);
+  EXPECT_TRUE(tracker.TakeRows(&blob, "", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{2, 70, 99}));
+
+  // Taking the rows clears them
+  tracker.MarkRows(&blob, marked, 1);
+  EXPECT_TRUE(tracker.TakeRows(&blob, "", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{70}));
+
+  // Restored rows are taken again
+  tracker.MarkRows(&blob, marked + 1, 1);
+  tracker.RestoreRows(&blob, "", rows);
+  EXPECT_TRUE(tracker.TakeRows(&blob, "", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{2, 70}));
+
+  // A resized tensor has to be saved in full
+  blob.GetMutable<TensorCPU>()->Resize(101, 3);
+  EXPECT_FALSE(tracker.TakeRows(&blob, "", &rows));
+
+  tracker.Untrack(&blob);
+  EXPECT_FALSE(tracker.TakeRows(&blob, "", &rows));
+}
+
+TEST(DirtyRowTrackerTest, SaversTakeTheirOwnRows) {
+  Blob blob;
+  blob.GetMutable<TensorCPU>()->Resize(10, 3);
+  blob.GetMutable<TensorCPU>()->mutable_data<float>();
+  auto& tracker = DirtyRowTracker::Get();
+
+  tracker.Track(&blob, "checkpoint");
+  const int32_t first[] = {3};
+  tracker.MarkRows(&blob, first, 1);
+  tracker.Track(&blob, "export");
+  const int32_t second[] = {5};
+  tracker.MarkRows(&blob, second, 1);
+
+  std::vector<TIndex> rows;
+  EXPECT_TRUE(tracker.TakeRows(&blob, "checkpoint", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{3, 5}));
+  EXPECT_TRUE(tracker.TakeRows(&blob, "export", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{5}));
+
+  tracker.Untrack(&blob, "export");
+  EXPECT_FALSE(tracker.TakeRows(&blob, "export", &rows));
+  tracker.MarkRows(&blob, first, 1);
+  EXPECT_TRUE(tracker.TakeRows(&blob, "checkpoint", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{3}));
+
+  for (int i = 0; i < DirtyRows::kMaxSavers - 1; ++i) {
+    tracker.Track(&blob, MakeString("saver", i));
+  }
+  EXPECT_THROW(tracker.Track(&blob, "one too many"), EnforceNotMet);
+}
+
+TEST(DirtyRowTrackerTest, TrackingEndsWithBlob) {
+  auto& tracker = DirtyRowTracker::Get();
+  std::unique_ptr<Blob> blob(new Blob());
+  blob->GetMutable<TensorCPU>()->Resize(10, 3);
+  blob->GetMutable<TensorCPU>()->mutable_data<float>();
+  tracker.Track(blob.get(), "");
+
+  // Moving a blob moves its tracked rows
+  Blob moved(std::move(*blob));
+  const int32_t marked[] = {4};
+  tracker.MarkRows(&moved, marked, 1);
+  std::vector<TIndex> rows;
+  EXPECT_FALSE(tracker.TakeRows(blob.get(), "", &rows));
+  EXPECT_TRUE(tracker.TakeRows(&moved, "", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{4}));
+
+  // A blob allocated where a tracked one was is not tracked
+  blob.reset();
+  blob.reset(new Blob());
+  blob->GetMutable<TensorCPU>()->Resize(10, 3);
+  blob->GetMutable<TensorCPU>()->mutable_data<float>();
+  EXPECT_FALSE(tracker.TakeRows(blob.get(), "", &rows));
+}
+
+TEST(DirtyRowTrackerTest, ConcurrentMarksAreNotLost) {
+  const int kNumRows = 4096;
+  const int kNumThreads = 4;
+  Blob blob;
+  blob.GetMutable<TensorCPU>()->Resize(kNumRows, 1);
+  blob.GetMutable<TensorCPU>()->mutable_data<float>();
+  auto& tracker = DirtyRowTracker::Get();
+  tracker.Track(&blob, "");
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&blob, t]() {
+      for (int64_t row = t; row < kNumRows; row += kNumThreads) {
+        DirtyRowTracker::Get().MarkRows(&blob, &row, 1);
+      }
+    });
+  }
+  std::vector<bool> taken(kNumRows, false);
+  std::vector<TIndex> rows;
+  auto take = [&]() {
+    EXPECT_TRUE(tracker.TakeRows(&blob, "", &rows));
+    for (auto row : rows) {
+      taken[row] = true;
+    }
+  };
+  for (int i = 0; i < 100; ++i) {
+    take();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  take();
+  for (int row = 0; row < kNumRows; ++row) {
+    EXPECT_TRUE(taken[row]) << row;
+  }
+}
+
+// Marking rows races with untracking and with tracking a resized tensor,
+// the way sparse updates race with Load and incremental Save
+TEST(DirtyRowTrackerTest, MarksDuringRetracking) {
+  const int kNumThreads = 4;
+  Blob blob;
+  blob.GetMutable<TensorCPU>()->Resize(64, 1);
+  blob.GetMutable<TensorCPU>()->mutable_data<float>();
+  auto& tracker = DirtyRowTracker::Get();
+  tracker.Track(&blob, "");
+
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&blob, &done, t]() {
+      for (int64_t row = t; !done; row = (row + kNumThreads) % 1024) {
+        DirtyRowTracker::Get().MarkRows(&blob, &row, 1);
+      }
+    });
+  }
+  for (int i = 0; i < 1000; ++i) {
+    tracker.Untrack(&blob);
+    blob.GetMutable<TensorCPU>()->Resize(64 * (1 + i % 16), 1);
+    blob.GetMutable<TensorCPU>()->mutable_data<float>();
+    tracker.Track(&blob, "");
+  }
+  done = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<TIndex> rows;
+  EXPECT_TRUE(tracker.TakeRows(&blob, "", &rows));
+  const int64_t marked[] = {7};
+  tracker.MarkRows(&blob, marked, 1);
+  EXPECT_TRUE(tracker.TakeRows(&blob, "", &rows));
+  EXPECT_EQ(rows, (std::vector<TIndex>{7}));
+}
+
+TEST(TensorDeltaTest, SerializesRows) {
+  TensorCPU table(std::vector<TIndex>{6, 2});
+  fillTable(&table);
+  std::vector<BlobProto> chunks;
+  SerializeTensorDelta(
+      table,
+      {1, 3, 4},
+      "table",
+      [&](const std::string& /*key*/, const std::string& value) {
+        chunks.emplace_back();
+        EXPECT_TRUE(chunks.back().ParseFromString(value));
+      },
+      4);
+  // Two rows per chunk
+  ASSERT_EQ(chunks.size(), 2);
+  EXPECT_EQ(chunks[0].type(), kTensorDeltaBlobType);
+  EXPECT_EQ(chunks[0].content_num_chunks(), 2);
+  EXPECT_EQ(chunks[0].tensor().dims(0), 2);
+  EXPECT_EQ(chunks[1].tensor().dims(0), 1);
+
+  TensorCPU restored(std::vector<TIndex>{6, 2});
+  restored.mutable_data<float>();
+  memset(restored.raw_mutable_data(), 0, restored.nbytes());
+  for (const auto& chunk : chunks) {
+    ApplyTensorDelta(chunk, &restored);
+  }
+  for (int i = 0; i < 6; ++i) {
+    bool dirty = i == 1 || i == 3 || i == 4;
+    for (int j = 0; j < 2; ++j) {
+      EXPECT_EQ(restored.data<float>()[i * 2 + j], dirty ? i * 2 + j : 0);
+    }
+  }
+
+  TensorCPU other(std::vector<TIndex>{6, 3});
+  other.mutable_data<float>();
+  EXPECT_THROW(ApplyTensorDelta(chunks[0], &other), EnforceNotMet);
+}
+
+TEST(TensorDeltaTest, SaveAndLoadIncrementally) {
+  std::vector<std::string> dbs = {tempPath(), tempPath(), tempPath()};
+  auto guard = MakeGuard([&]() {
+    for (const auto& db : dbs) {
+      remove(db.c_str());
+    }
+  });
+
+  Workspace ws;
+  auto* table_blob = ws.CreateBlob("table");
+  auto* table = table_blob->GetMutable<TensorCPU>();
+  table->Resize(100, 8);
+  fillTable(table);
+  auto* counter = ws.CreateBlob("counter")->GetMutable<TensorCPU>();
+  counter->Resize(1);
+  counter->mutable_data<int64_t>()[0] = 0;
+
+  runSave(&ws, dbs[0], {"table"});
+  updateRows(table_blob, {42, 3, 42}, -1);
+  counter->mutable_data<int64_t>()[0] = 1;
+  runSave(&ws, dbs[1], {"table"});
+  updateRows(table_blob, {3, 99}, -2);
+  counter->mutable_data<int64_t>()[0] = 2;
+  runSave(&ws, dbs[2], {"table"});
+
+  // Only the updated rows are written after the first checkpoint
+  std::unique_ptr<db::DB> delta(db::CreateDB("minidb", dbs[1], db::READ));
+  std::unique_ptr<db::Cursor> cursor(delta->NewCursor());
+  int num_delta_chunks = 0;
+  for (; cursor->Valid(); cursor->Next()) {
+    BlobProto proto;
+    EXPECT_TRUE(proto.ParseFromString(cursor->value()));
+    if (proto.name() == "table") {
+      EXPECT_EQ(proto.type(), kTensorDeltaBlobType);
+      EXPECT_EQ(proto.tensor().dims(0), 2);
+      num_delta_chunks++;
+    }
+  }
+  EXPECT_EQ(num_delta_chunks, 1);
+
+  Workspace loaded;
+  OperatorDef def;
+  def.set_type("Load");
+  def.add_output("table");
+  def.add_output("counter");
+  def.add_arg()->CopyFrom(MakeArgument("db", dbs[0]));
+  def.add_arg()->CopyFrom(MakeArgument<std::string>("db_type", "minidb"));
+  def.add_arg()->CopyFrom(MakeArgument("absolute_path", 1));
+  def.add_arg()->CopyFrom(MakeArgument(
+      "delta_dbs", std::vector<std::string>{dbs[1], dbs[2]}));
+  EXPECT_TRUE(CreateOperator(def, &loaded)->Run());
+
+  const auto& restored = loaded.GetBlob("table")->Get<TensorCPU>();
+  EXPECT_EQ(restored.dims(), table->dims());
+  for (int i = 0; i < table->size(); ++i) {
+    EXPECT_EQ(restored.data<float>()[i], table->data<float>()[i]);
+  }
+  EXPECT_EQ(restored.data<float>()[3 * 8], -2);
+  EXPECT_EQ(restored.data<float>()[42 * 8], -1);
+  EXPECT_EQ(
+      loaded.GetBlob("counter")->Get<TensorCPU>().data<int64_t>()[0], 2);
+
+  // A delta alone can not be loaded
+  Workspace empty;
+  def.clear_arg();
+  def.add_arg()->CopyFrom(MakeArgument("db", dbs[1]));
+  def.add_arg()->CopyFrom(MakeArgument<std::string>("db_type", "minidb"));
+  def.add_arg()->CopyFrom(MakeArgument("absolute_path", 1));
+  EXPECT_THROW(CreateOperator(def, &empty)->Run(), EnforceNotMet);
+}
+
+TEST(TensorDeltaTest, FailedSaveKeepsRows) {
+  std::vector<std::string> dbs = {tempPath(), tempPath(), tempPath()};
+  auto guard = MakeGuard([&]() {
+    for (const auto& db : dbs) {
+      remove(db.c_str());
+    }
+  });
+
+  Workspace ws;
+  auto* table_blob = ws.CreateBlob("table");
+  auto* table = table_blob->GetMutable<TensorCPU>();
+  table->Resize(10, 2);
+  fillTable(table);
+  ws.CreateBlob("broken")->GetMutable<Unserializable>();
+
+  runSave(&ws, dbs[0], {"table"}, {"table"});
+  updateRows(table_blob, {4}, -1);
+
+  // The delta of table is written before broken fails to serialize
+  OperatorDef def;
+  def.set_type("Save");
+  def.add_input("table");
+  def.add_input("broken");
+  def.add_arg()->CopyFrom(MakeArgument("db", dbs[1]));
+  def.add_arg()->CopyFrom(MakeArgument<std::string>("db_type", "minidb"));
+  def.add_arg()->CopyFrom(MakeArgument("absolute_path", 1));
+  def.add_arg()->CopyFrom(
+      MakeArgument("incremental_blobs", std::vector<std::string>{"table"}));
+  EXPECT_THROW(CreateOperator(def, &ws)->Run(), EnforceNotMet);
+
+  updateRows(table_blob, {7}, -2);
+  runSave(&ws, dbs[2], {"table"}, {"table"});
+  EXPECT_EQ(deltaRows(dbs[2], "table"), (std::vector<int64_t>{4, 7}));
+}
+
+TEST(TensorDeltaTest, SaversWriteSeparateDeltas) {
+  std::vector<std::string> dbs = {
+      tempPath(), tempPath(), tempPath(), tempPath()};
+  auto guard = MakeGuard([&]() {
+    for (const auto& db : dbs) {
+      remove(db.c_str());
+    }
+  });
+
+  Workspace ws;
+  auto* table_blob = ws.CreateBlob("table");
+  auto* table = table_blob->GetMutable<TensorCPU>();
+  table->Resize(10, 2);
+  fillTable(table);
+
+  runSave(&ws, dbs[0], {"table"}, {"table"}, "checkpoint");
+  runSave(&ws, dbs[1], {"table"}, {"table"}, "export");
+  updateRows(table_blob, {1, 8}, -1);
+  runSave(&ws, dbs[2], {"table"}, {"table"}, "checkpoint");
+  runSave(&ws, dbs[3], {"table"}, {"table"}, "export");
+  EXPECT_EQ(deltaRows(dbs[2], "table"), (std::vector<int64_t>{1, 8}));
+  EXPECT_EQ(deltaRows(dbs[3], "table"), (std::vector<int64_t>{1, 8}));
+}
+
+} // namespace caffe2
@@ -1,8 +1,10 @@
 #include "caffe2/core/workspace.h"
 
 #include <algorithm>
+#include <atomic>
 #include <ctime>
 #include <mutex>
+#include <unordered_map>
 
 #include "caffe2/core/logging.h"
 #include "caffe2/core/net.h"
@@ -18,6 +20,123 @@ CAFFE2_DEFINE_bool(
 
 namespace caffe2 {
 
+namespace {
+// Interned names are stored in chunks that are never moved or freed, so an
+// id can be resolved back to its name without taking the lock
+constexpr int kBlobNameChunkBits = 12;
+constexpr size_t kBlobNameChunkSize = size_t(1) << kBlobNameChunkBits;
+constexpr size_t kMaxBlobNameChunks = size_t(1) << 16;
+
+struct BlobNameTable {
+  BlobNameTable() {
+    for (auto& chunk : chunks) {
+      chunk.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  // Only taken to intern new names
+  std::mutex mutex;
+  std::unordered_map<string, BlobId> ids;
+  std::atomic<string*> chunks[kMaxBlobNameChunks];
+  std::atomic<size_t> size{0};
+};
+
+BlobNameTable& blobNameTable() {
+  static BlobNameTable table;
+  return table;
+}
+} // namespace
+
+BlobId Workspace::InternBlobName(const string& name) {
+  auto& table = blobNameTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  auto it = table.ids.find(name);
+  if (it != table.ids.end()) {
+    return it->second;
+  }
+  auto index = table.size.load(std::memory_order_relaxed);
+  CAFFE_ENFORCE_LT(
+      index,
+      kMaxBlobNameChunks * kBlobNameChunkSize,
+      "Too many interned blob names");
+  auto& chunk = table.chunks[index >> kBlobNameChunkBits];
+  auto* names = chunk.load(std::memory_order_relaxed);
+  if (!names) {
+    names = new string[kBlobNameChunkSize];
+    chunk.store(names, std::memory_order_release);
+  }
+  names[index & (kBlobNameChunkSize - 1)] = name;
+  BlobId id = index;
+  table.ids.emplace(name, id);
+  table.size.store(index + 1, std::memory_order_release);
+  return id;
+}
+
+const string& Workspace::BlobName(BlobId id) {
+  auto& table = blobNameTable();
+  CAFFE_ENFORCE(
+      id >= 0 &&
+          static_cast<size_t>(id) < table.size.load(std::memory_order_acquire),
+      "Invalid blob id ",
+      id);
+  auto* names = table.chunks[id >> kBlobNameChunkBits].load(
+      std::memory_order_acquire);
+  return names[id & (kBlobNameChunkSize - 1)];
+}
+
+Blob* Workspace::IndexedBlob(BlobId id) const {
+  return static_cast<size_t>(id) < blobs_by_id_.size() ? blobs_by_id_[id]
+                                                        : nullptr;
+}
+
+const Blob* Workspace::FindBlob(BlobId id) const {
+  if (auto* blob = IndexedBlob(id)) {
+    return blob;
+  }
+  auto it = blob_map_.find(BlobName(id));
+  if (it != blob_map_.end()) {
+    return it->second.get();
+  }
+  return shared_ ? shared_->FindBlob(id) : nullptr;
+}
+
+bool Workspace::HasBlob(BlobId id) const {
+  return FindBlob(id) != nullptr;
+}
+
+Blob* Workspace::CreateBlob(BlobId id) {
+  if (auto* blob = IndexedBlob(id)) {
+    return blob;
+  }
+  const auto& name = BlobName(id);
+  auto it = blob_map_.find(name);
+  if (it == blob_map_.end()) {
+    if (auto* blob = shared_ ? shared_->FindBlob(id) : nullptr) {
+      // Not indexed, the shared workspace may remove it
+      return const_cast<Blob*>(blob);
+    }
+    VLOG(1) << "Creating blob " << name;
+    it = blob_map_.emplace(name, unique_ptr<Blob>(new Blob())).first;
+  }
+  if (blobs_by_id_.size() <= static_cast<size_t>(id)) {
+    blobs_by_id_.resize(id + 1, nullptr);
+  }
+  blobs_by_id_[id] = it->second.get();
+  return it->second.get();
+}
+
+const Blob* Workspace::GetBlob(BlobId id) const {
+  auto* blob = FindBlob(id);
+  if (!blob) {
+    LOG(WARNING) << "Blob " << BlobName(id) << " not in the workspace.";
+  }
+  return blob;
+}
+
+Blob* Workspace::GetBlob(BlobId id) {
+  return const_cast<Blob*>(static_cast<const Workspace*>(this)->GetBlob(id));
+}
+
 void Workspace::PrintBlobSizes() {
   vector<string> blobs = LocalBlobs();
   size_t cumtotal = 0;
@@ -102,10 +221,27 @@ Blob* Workspace::CreateBlob(const string& name) {
   return GetBlob(name);
 }
 
+Blob* Workspace::CreateLocalBlob(const string& name) {
+  auto it = blob_map_.find(name);
+  if (it != blob_map_.end()) {
+    VLOG(1) << "Blob " << name << " already exists. Skipping.";
+    return it->second.get();
+  }
+  VLOG(1) << "Creating local blob " << name;
+  auto* blob = new Blob();
+  blob_map_[name] = unique_ptr<Blob>(blob);
+  return blob;
+}
+
 bool Workspace::RemoveBlob(const string& name) {
   auto it = blob_map_.find(name);
   if (it != blob_map_.end()) {
     VLOG(1) << "Removing blob " << name << " from this workspace.";
+    for (auto& blob : blobs_by_id_) {
+      if (blob == it->second.get()) {
+        blob = nullptr;
+      }
+    }
     blob_map_.erase(it);
     return true;
   }
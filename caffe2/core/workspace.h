@@ -29,6 +29,14 @@ namespace caffe2 {
 
 class NetBase;
 
+/**
+ * Interned blob name. Ids are dense, process-wide and never reused, so they
+ * can be resolved once (e.g. at operator construction) and then used to look
+ * up the blob of that name in any workspace.
+ */
+typedef int32_t BlobId;
+constexpr BlobId kInvalidBlobId = -1;
+
 struct StopOnSignal {
   StopOnSignal()
       : handler_(std::make_shared<SignalHandler>(
@@ -58,8 +66,7 @@ class Workspace {
   /**
    * Initializes an empty workspace.
    */
-  Workspace() {
-  }
+  Workspace() {}
   /**
    * Initializes an empty workspace with the given root folder.
    *
@@ -131,6 +138,12 @@ class Workspace {
    * already exists, the creation is skipped and the existing blob is returned.
    */
   Blob* CreateBlob(const string& name);
+  /**
+   * Similar to CreateBlob(), but only checks the local workspace: if the
+   * blob exists only in the shared workspace, a local blob shadowing it is
+   * created.
+   */
+  Blob* CreateLocalBlob(const string& name);
   /**
    * Remove the blob of the given name. Return true if removed and false if
    * not exist.
@@ -148,6 +161,30 @@ class Workspace {
    */
   Blob* GetBlob(const string& name);
 
+  /**
+   * Returns the id of the given blob name, interning it if needed. Ids are
+   * shared by all workspaces and never freed. Interning takes a process-wide
+   * lock, so only intern the names an operator looks up repeatedly, once
+   * when it is created.
+   */
+  static BlobId InternBlobName(const string& name);
+  /**
+   * Returns the name of an interned blob id. Does not take any lock.
+   */
+  static const string& BlobName(BlobId id);
+
+  /**
+   * Id based versions of HasBlob(), CreateBlob() and GetBlob(). CreateBlob()
+   * adds the local blob of the id to an index of this workspace, after which
+   * all of them return it without hashing the name. Ids not in the index fall
+   * back to the lookup by name. Like the versions taking names, only the
+   * const lookups are safe to call concurrently.
+   */
+  bool HasBlob(BlobId id) const;
+  Blob* CreateBlob(BlobId id);
+  const Blob* GetBlob(BlobId id) const;
+  Blob* GetBlob(BlobId id);
+
   /**
    * Creates a network with the given NetDef, and returns the pointer to the
    * network. If there is anything wrong during the creation of the network, a
@@ -215,7 +252,15 @@ class Workspace {
   std::atomic<int> last_failed_op_net_position;
 
  private:
+  // Local blob of the id in the index, nullptr if it is not indexed
+  Blob* IndexedBlob(BlobId id) const;
+  // Like GetBlob(BlobId), without logging missing blobs
+  const Blob* FindBlob(BlobId id) const;
+
   BlobMap blob_map_;
+  // Local blobs created or looked up with CreateBlob(BlobId), indexed by id.
+  // Entries are cleared when their blob is removed.
+  std::vector<Blob*> blobs_by_id_;
   NetMap net_map_;
   string root_folder_ = ".";
   Workspace* shared_ = nullptr;
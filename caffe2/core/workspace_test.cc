@@ -79,4 +79,56 @@ TEST(WorkspaceTest, Sharing) {
   }
 }
 
+TEST(WorkspaceTest, BlobIds) {
+  Workspace parent;
+  auto* a = parent.CreateBlob("blob_id_test_a");
+  // Interned after the blob was created
+  auto a_id = Workspace::InternBlobName("blob_id_test_a");
+  auto b_id = Workspace::InternBlobName("blob_id_test_b");
+  EXPECT_EQ(a_id, Workspace::InternBlobName("blob_id_test_a"));
+  EXPECT_NE(a_id, b_id);
+  EXPECT_EQ(Workspace::BlobName(b_id), "blob_id_test_b");
+
+  EXPECT_TRUE(parent.HasBlob(a_id));
+  EXPECT_EQ(parent.GetBlob(a_id), a);
+  EXPECT_EQ(parent.CreateBlob(a_id), a);
+  EXPECT_EQ(parent.GetBlob(a_id), a);
+  EXPECT_FALSE(parent.HasBlob(b_id));
+  EXPECT_EQ(parent.GetBlob(b_id), nullptr);
+
+  {
+    Workspace child(&parent);
+    // Parent blobs are found through the parent
+    EXPECT_EQ(child.GetBlob(a_id), a);
+    EXPECT_EQ(child.CreateBlob(a_id), a);
+    // Blobs created by id are visible by name and vice versa
+    auto* b = child.CreateBlob(b_id);
+    EXPECT_EQ(child.GetBlob("blob_id_test_b"), b);
+    EXPECT_EQ(child.GetBlob(b_id), b);
+    EXPECT_EQ(child.CreateBlob(b_id), b);
+    EXPECT_FALSE(parent.HasBlob(b_id));
+    // Local blobs shadow parent blobs
+    auto* local_a = child.CreateLocalBlob("blob_id_test_a");
+    EXPECT_NE(local_a, a);
+    EXPECT_EQ(child.GetBlob(a_id), local_a);
+    EXPECT_EQ(child.CreateBlob(a_id), local_a);
+    EXPECT_TRUE(child.RemoveBlob("blob_id_test_a"));
+    EXPECT_EQ(child.GetBlob(a_id), a);
+    EXPECT_EQ(child.CreateBlob(a_id), a);
+    // Removed blobs are dropped from the index
+    EXPECT_TRUE(child.RemoveBlob("blob_id_test_b"));
+    EXPECT_FALSE(child.HasBlob(b_id));
+    EXPECT_NE(child.CreateBlob(b_id), nullptr);
+  }
+
+  // Ids interned after the workspace was created work as well
+  Workspace ws;
+  auto c_id = Workspace::InternBlobName("blob_id_test_c");
+  EXPECT_FALSE(ws.HasBlob(c_id));
+  auto* c = ws.CreateBlob("blob_id_test_c");
+  EXPECT_EQ(ws.GetBlob(c_id), c);
+  EXPECT_TRUE(parent.RemoveBlob("blob_id_test_a"));
+  EXPECT_FALSE(parent.HasBlob(a_id));
+}
+
 }  // namespace caffe2
@@ -3,7 +3,13 @@
 namespace caffe2 {
 REGISTER_CPU_OPERATOR(CreateDB, CreateDBOp<CPUContext>);
 
-OPERATOR_SCHEMA(CreateDB).NumInputs(0).NumOutputs(1);
+OPERATOR_SCHEMA(CreateDB)
+    .NumInputs(0)
+    .NumOutputs(1)
+    .Arg(
+        "read_ahead",
+        "(int, default 0) number of records the DBReader reads ahead in a "
+        "background thread, 0 to read synchronously.");
 
 NO_GRADIENT(CreateDB);
 }  // namespace caffe2
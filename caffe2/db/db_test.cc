@@ -1,11 +1,14 @@
+#include <algorithm>
 #include <cstdio>
 #include <iomanip>
+#include <set>
 #include <sstream>
 #include <thread>
 
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/db.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/db/parallel_convert.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include <gtest/gtest.h>
 
@@ -86,6 +89,209 @@ TEST(DBSeekTest, LMDB) {
   DBSeekTestWrapper("lmdb");
 }
 
+TEST(DBSeekTest, RecordDB) {
+  DBSeekTestWrapper("recorddb");
+}
+
+static string RecordKey(int i) {
+  std::stringstream ss;
+  ss << std::setw(5) << std::setfill('0') << i;
+  return ss.str();
+}
+
+TEST(RecordDBTest, ReadWriteAndAppend) {
+  // Enough records to go through several sparse index entries.
+  constexpr int kNumRecords = 1000;
+  std::string name = std::tmpnam(nullptr);
+  {
+    std::unique_ptr<DB> db(CreateDB("recorddb", name, NEW));
+    std::unique_ptr<Transaction> trans(db->NewTransaction());
+    for (int i = 0; i < kNumRecords / 2; i += 2) {
+      trans->Put(RecordKey(i), string(i % 7, 'v') + RecordKey(i));
+    }
+  }
+  {
+    std::unique_ptr<DB> db(CreateDB("recorddb", name, WRITE));
+    std::unique_ptr<Transaction> trans(db->NewTransaction());
+    for (int i = kNumRecords / 2; i < kNumRecords; i += 2) {
+      trans->Put(RecordKey(i), string(i % 7, 'v') + RecordKey(i));
+    }
+  }
+
+  std::unique_ptr<DB> db(CreateDB("recorddb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  EXPECT_TRUE(cursor->SupportsSeek());
+  for (int i = 0; i < kNumRecords; i += 2) {
+    ASSERT_TRUE(cursor->Valid());
+    EXPECT_EQ(cursor->key(), RecordKey(i));
+    const char* data;
+    size_t size;
+    EXPECT_TRUE(cursor->ValueView(&data, &size));
+    EXPECT_EQ(string(data, size), string(i % 7, 'v') + RecordKey(i));
+    cursor->Next();
+  }
+  EXPECT_FALSE(cursor->Valid());
+
+  for (int i : {0, 1, 2, 127, 128, 129, 500, 998}) {
+    cursor->Seek(RecordKey(i));
+    ASSERT_TRUE(cursor->Valid());
+    EXPECT_EQ(cursor->key(), RecordKey(i + i % 2));
+  }
+  cursor->Seek(RecordKey(kNumRecords));
+  EXPECT_FALSE(cursor->Valid());
+
+  // Cursors are independent and can be used from several threads.
+  vector<std::thread> threads;
+  vector<int> counts(4);
+  for (int t = 0; t < counts.size(); ++t) {
+    threads.emplace_back([&db, &counts, t]() {
+      std::unique_ptr<Cursor> thread_cursor(db->NewCursor());
+      for (; thread_cursor->Valid(); thread_cursor->Next()) {
+        counts[t]++;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counts, vector<int>(counts.size(), kNumRecords / 2));
+  cursor.reset();
+  db.reset();
+  std::remove(name.c_str());
+}
+
+TEST(RecordDBTest, UnsortedKeys) {
+  std::string name = std::tmpnam(nullptr);
+  {
+    std::unique_ptr<DB> db(CreateDB("recorddb", name, NEW));
+    std::unique_ptr<Transaction> trans(db->NewTransaction());
+    trans->Put("b", "1");
+    trans->Put("a", "2");
+  }
+  std::unique_ptr<DB> db(CreateDB("recorddb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  // Records are still returned in the order they were written.
+  EXPECT_FALSE(cursor->SupportsSeek());
+  EXPECT_THROW(cursor->Seek("a"), EnforceNotMet);
+  cursor->SeekToFirst();
+  EXPECT_EQ(cursor->key(), "b");
+  cursor->Next();
+  EXPECT_EQ(cursor->value(), "2");
+  cursor->Next();
+  EXPECT_FALSE(cursor->Valid());
+  cursor.reset();
+  db.reset();
+  std::remove(name.c_str());
+}
+
+static vector<std::pair<string, string>> ReadAll(const string& name) {
+  std::unique_ptr<DB> db(CreateDB("recorddb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  vector<std::pair<string, string>> records;
+  for (; cursor->Valid(); cursor->Next()) {
+    records.emplace_back(cursor->key(), cursor->value());
+  }
+  return records;
+}
+
+static void TestParallelConvert(bool ordered) {
+  constexpr int kNumRecords = 1000;
+  constexpr int kNumShards = 3;
+  std::string input = std::tmpnam(nullptr);
+  {
+    std::unique_ptr<DB> db(CreateDB("minidb", input, NEW));
+    std::unique_ptr<Transaction> trans(db->NewTransaction());
+    for (int i = 0; i < kNumRecords; ++i) {
+      trans->Put(RecordKey(i), to_string(i));
+    }
+  }
+
+  auto names = ShardedDBNames(std::tmpnam(nullptr), kNumShards);
+  vector<std::unique_ptr<DB>> out_dbs;
+  vector<DB*> outputs;
+  for (const auto& name : names) {
+    // minidb transactions can not be used after a commit.
+    out_dbs.emplace_back(CreateDB("recorddb", name, NEW));
+    outputs.push_back(out_dbs.back().get());
+  }
+  std::unique_ptr<DB> in_db(CreateDB("minidb", input, READ));
+  std::unique_ptr<Cursor> cursor(in_db->NewCursor());
+  ParallelConvertOptions options;
+  options.num_workers = 4;
+  options.ordered = ordered;
+  options.batch_size = 7;
+  options.max_in_flight = 16;
+  // Every tenth record is dropped, the others are doubled.
+  auto written = ParallelConvert(
+      CursorSource(cursor.get()),
+      [](int64_t index, string* key, string* value) {
+        EXPECT_EQ(*key, RecordKey(index));
+        *value = to_string(2 * std::stoi(*value));
+        return index % 10 != 0;
+      },
+      outputs,
+      options);
+  EXPECT_EQ(written, kNumRecords - kNumRecords / 10);
+  cursor.reset();
+  in_db.reset();
+  out_dbs.clear();
+
+  for (int shard = 0; shard < kNumShards; ++shard) {
+    auto records = ReadAll(names[shard]);
+    vector<string> keys;
+    for (const auto& record : records) {
+      keys.push_back(record.first);
+      EXPECT_EQ(record.second, to_string(2 * std::stoi(record.first)));
+    }
+    vector<string> expected;
+    for (int i = shard; i < kNumRecords; i += kNumShards) {
+      if (i % 10 != 0) {
+        expected.push_back(RecordKey(i));
+      }
+    }
+    if (!ordered) {
+      std::sort(keys.begin(), keys.end());
+    }
+    EXPECT_EQ(keys, expected);
+    std::remove(names[shard].c_str());
+  }
+  std::remove(input.c_str());
+}
+
+TEST(ParallelConvertTest, Ordered) {
+  TestParallelConvert(true);
+}
+
+TEST(ParallelConvertTest, Unordered) {
+  TestParallelConvert(false);
+}
+
+TEST(ParallelConvertTest, PropagatesErrors) {
+  std::string name = std::tmpnam(nullptr);
+  std::unique_ptr<DB> out_db(CreateDB("recorddb", name, NEW));
+  int count = 0;
+  ParallelConvertOptions options;
+  options.num_workers = 2;
+  options.max_in_flight = 4;
+  EXPECT_THROW(
+      ParallelConvert(
+          [&count](string* key, string* value) {
+            *key = *value = to_string(count);
+            return ++count < 1000000;
+          },
+          [](int64_t index, string* /*key*/, string* /*value*/) {
+            CAFFE_ENFORCE_LT(index, 100);
+            return true;
+          },
+          {out_db.get()},
+          options),
+      EnforceNotMet);
+  // The reader stops soon after the failure.
+  EXPECT_LT(count, 1000);
+  out_db.reset();
+  std::remove(name.c_str());
+}
+
 TEST(DBReaderTest, Reader) {
   std::string name = std::tmpnam(nullptr);
   CreateAndFill("leveldb", name);
@@ -196,5 +402,95 @@ TEST(DBReaderShardedTest, Reader) {
   EXPECT_EQ(value, "05");
 }
 
+TEST(DBReaderReadAheadTest, Reader) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("minidb", name);
+  std::unique_ptr<DBReader> reader(new DBReader("minidb", name, 3, 1));
+  reader->SetReadAhead(4);
+  EXPECT_EQ(reader->read_ahead(), 4);
+  // Records come in the same order as without read-ahead.
+  string key;
+  string value;
+  reader->Read(&key, &value);
+  EXPECT_EQ(key, "01");
+  EXPECT_EQ(value, "01");
+  vector<string> keys;
+  vector<string> values;
+  reader->ReadMany(5, &keys, &values);
+  EXPECT_EQ(keys, (vector<string>{"04", "07", "01", "04", "07"}));
+  EXPECT_EQ(values, keys);
+  reader->SeekToFirst();
+  reader->ReadMany(2, &keys, &values);
+  EXPECT_EQ(keys, (vector<string>{"01", "04"}));
+
+  // Reopening keeps reading ahead.
+  reader->Open("minidb", name);
+  EXPECT_EQ(reader->read_ahead(), 4);
+  reader->ReadMany(kMaxItems + 1, &keys, &values);
+  for (int i = 0; i < kMaxItems; ++i) {
+    EXPECT_EQ(keys[i], values[i]);
+    EXPECT_EQ(std::stoi(keys[i]), i);
+  }
+  EXPECT_EQ(keys[kMaxItems], "00");
+
+  // Test Reader's multi-threading capability.
+  reader->SeekToFirst();
+  const DBReader& shared_reader = *reader;
+  vector<unique_ptr<std::thread>> threads(kMaxItems / 2);
+  vector<vector<string>> thread_keys(threads.size());
+  vector<vector<string>> thread_values(threads.size());
+  for (int i = 0; i < threads.size(); ++i) {
+    threads[i].reset(new std::thread(
+        [&shared_reader](vector<string>* keys, vector<string>* values) {
+          shared_reader.ReadMany(2, keys, values);
+        },
+        &thread_keys[i], &thread_values[i]));
+  }
+  std::set<string> keys_set;
+  for (int i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+    keys_set.insert(thread_keys[i].begin(), thread_keys[i].end());
+  }
+  EXPECT_EQ(keys_set.size(), kMaxItems);
+
+  reader->SetReadAhead(0);
+  reader->SeekToFirst();
+  reader->Read(&key, &value);
+  EXPECT_EQ(key, "00");
+  reader.reset();
+  std::remove(name.c_str());
+}
+
+TEST(DBReaderReadAheadTest, Serialization) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("leveldb", name);
+  Blob reader_blob;
+  auto* reader = new DBReader("leveldb", name);
+  reader_blob.Reset(reader);
+  reader->SetReadAhead(4);
+  string key;
+  string value;
+  reader->Read(&key, &value);
+  EXPECT_EQ(key, "00");
+
+  std::string str = reader_blob.Serialize("saved_reader");
+  reader_blob.Reset();
+  BlobProto blob_proto;
+  CHECK(blob_proto.ParseFromString(str));
+  DBReaderProto proto;
+  CHECK(proto.ParseFromString(blob_proto.content()));
+  EXPECT_EQ(proto.read_ahead(), 4);
+  EXPECT_EQ(proto.key(), "01");
+
+  // The restored reader keeps reading ahead from the saved key
+  reader_blob.Deserialize(str);
+  const DBReader& new_reader = reader_blob.Get<DBReader>();
+  EXPECT_EQ(new_reader.read_ahead(), 4);
+  new_reader.Read(&key, &value);
+  EXPECT_EQ(key, "01");
+  reader_blob.Reset();
+  std::remove(name.c_str());
+}
+
 }  // namespace db
 }  // namespace caffe2
@@ -0,0 +1,241 @@
+#include "caffe2/db/parallel_convert.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/utils/simple_queue.h"
+
+namespace caffe2 {
+namespace db {
+
+namespace {
+
+struct Record {
+  int64_t index;
+  string key;
+  string value;
+  // Skipped records still go through the writers to keep the order
+  bool skipped;
+};
+
+class Pipeline {
+ public:
+  Pipeline(
+      const RecordTransform& transform,
+      const vector<DB*>& outputs,
+      const ParallelConvertOptions& options)
+      : transform_(transform),
+        outputs_(outputs),
+        options_(options),
+        input_(options.max_in_flight) {
+    for (int i = 0; i < outputs_.size(); ++i) {
+      shards_.emplace_back(new SimpleQueue<Record>(options.max_in_flight));
+    }
+  }
+
+  int64_t Run(const RecordSource& source) {
+    vector<std::thread> workers;
+    for (int i = 0; i < options_.num_workers; ++i) {
+      workers.emplace_back(&Pipeline::transformLoop, this);
+    }
+    vector<std::thread> writers;
+    for (int i = 0; i < outputs_.size(); ++i) {
+      writers.emplace_back(&Pipeline::writeLoop, this, i);
+    }
+
+    guarded([&]() { readLoop(source); });
+    input_.NoMoreJobs();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    for (auto& shard : shards_) {
+      shard->NoMoreJobs();
+    }
+    for (auto& writer : writers) {
+      writer.join();
+    }
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    LOG(INFO) << "A total of " << num_read_ << " items processed, "
+              << num_written_ << " written in " << timer_.Seconds()
+              << " seconds.";
+    return num_written_;
+  }
+
+ private:
+  // Runs one stage, and stops the whole pipeline if it fails
+  template <typename F>
+  void guarded(F f) {
+    try {
+      f();
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+        aborted_ = true;
+      }
+      in_flight_cv_.notify_all();
+      input_.NoMoreJobs();
+      for (auto& shard : shards_) {
+        shard->NoMoreJobs();
+      }
+    }
+  }
+
+  void readLoop(const RecordSource& source) {
+    Record record;
+    record.skipped = false;
+    while (source(&record.key, &record.value)) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        in_flight_cv_.wait(lock, [this]() {
+          return aborted_ || in_flight_ < options_.max_in_flight;
+        });
+        if (aborted_) {
+          return;
+        }
+        in_flight_++;
+      }
+      record.index = num_read_++;
+      input_.Push(std::move(record));
+    }
+  }
+
+  void transformLoop() {
+    guarded([this]() {
+      Record record;
+      while (input_.Pop(&record)) {
+        if (transform_) {
+          record.skipped =
+              !transform_(record.index, &record.key, &record.value);
+        }
+        const auto shard = record.index % shards_.size();
+        shards_[shard]->Push(std::move(record));
+      }
+    });
+  }
+
+  void writeLoop(int shard) {
+    guarded([this, shard]() {
+      std::unique_ptr<Transaction> transaction(
+          outputs_[shard]->NewTransaction());
+      CAFFE_ENFORCE(
+          transaction, "Cannot get transaction for output db #", shard);
+      // Records transformed ahead of the next one in order
+      std::map<int64_t, Record> pending;
+      int64_t next_index = shard;
+      int uncommitted = 0;
+      Record record;
+      while (shards_[shard]->Pop(&record)) {
+        if (!options_.ordered) {
+          write(transaction.get(), record, &uncommitted);
+          continue;
+        }
+        const auto index = record.index;
+        pending.emplace(index, std::move(record));
+        for (auto it = pending.begin();
+             it != pending.end() && it->first == next_index;
+             it = pending.erase(it)) {
+          write(transaction.get(), it->second, &uncommitted);
+          next_index += shards_.size();
+        }
+      }
+      CAFFE_ENFORCE(
+          pending.empty() || aborted(), "Records missing in output #", shard);
+      transaction->Commit();
+    });
+  }
+
+  bool aborted() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return aborted_;
+  }
+
+  void write(Transaction* transaction, const Record& record, int* uncommitted) {
+    if (!record.skipped) {
+      transaction->Put(record.key, record.value);
+      if (++*uncommitted == options_.batch_size) {
+        transaction->Commit();
+        *uncommitted = 0;
+      }
+      const auto written = ++num_written_;
+      if (options_.report_interval > 0 &&
+          written % options_.report_interval == 0) {
+        LOG(INFO) << "Converted " << written << " items so far, "
+                  << written / timer_.Seconds() << " items/sec.";
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_flight_--;
+    }
+    in_flight_cv_.notify_one();
+  }
+
+  const RecordTransform& transform_;
+  const vector<DB*>& outputs_;
+  const ParallelConvertOptions& options_;
+  Timer timer_;
+
+  SimpleQueue<Record> input_;
+  vector<std::unique_ptr<SimpleQueue<Record>>> shards_;
+
+  std::mutex mutex_;
+  std::condition_variable in_flight_cv_;
+  int in_flight_ = 0;
+  bool aborted_ = false;
+  std::exception_ptr error_;
+
+  int64_t num_read_ = 0;
+  std::atomic<int64_t> num_written_{0};
+};
+
+} // namespace
+
+int64_t ParallelConvert(
+    const RecordSource& source,
+    const RecordTransform& transform,
+    const vector<DB*>& outputs,
+    const ParallelConvertOptions& options) {
+  CAFFE_ENFORCE(!outputs.empty(), "No output db to convert to.");
+  CAFFE_ENFORCE_GT(options.num_workers, 0);
+  CAFFE_ENFORCE_GT(options.batch_size, 0);
+  CAFFE_ENFORCE_GT(options.max_in_flight, 0);
+  return Pipeline(transform, outputs, options).Run(source);
+}
+
+RecordSource CursorSource(Cursor* cursor) {
+  return [cursor](string* key, string* value) {
+    if (!cursor->Valid()) {
+      return false;
+    }
+    *key = cursor->key();
+    *value = cursor->value();
+    cursor->Next();
+    return true;
+  };
+}
+
+vector<string> ShardedDBNames(const string& name, int num_shards) {
+  CAFFE_ENFORCE_GT(num_shards, 0);
+  if (num_shards == 1) {
+    return {name};
+  }
+  vector<string> names;
+  for (int i = 0; i < num_shards; ++i) {
+    names.push_back(name + "_shard_" + caffe2::to_string(i));
+  }
+  return names;
+}
+
+} // namespace db
+} // namespace caffe2
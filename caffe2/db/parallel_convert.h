@@ -0,0 +1,61 @@
+#ifndef CAFFE2_DB_PARALLEL_CONVERT_H_
+#define CAFFE2_DB_PARALLEL_CONVERT_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/db.h"
+
+namespace caffe2 {
+namespace db {
+
+// Produces the next record to convert. Returns false when there are no more
+// records. Always called from a single thread.
+using RecordSource = std::function<bool(string* key, string* value)>;
+// Transforms a record in place, given its position in the source. Returns
+// false if the record should be skipped. Called from several threads at once.
+using RecordTransform =
+    std::function<bool(int64_t index, string* key, string* value)>;
+
+struct ParallelConvertOptions {
+  // Number of threads running the transform
+  int num_workers = 1;
+  // If true, every output db receives its records in source order. Otherwise
+  // records are written as soon as they are transformed.
+  bool ordered = true;
+  // Number of records written to an output db between two commits
+  int batch_size = 1000;
+  // Number of records written between two progress reports, 0 to disable
+  int report_interval = 10000;
+  // Maximum number of records read but not written yet
+  int max_in_flight = 4096;
+};
+
+/**
+ * Converts records with a pipeline of one reading thread (the calling one),
+ * num_workers transforming threads and one writing thread per output db,
+ * each with its own transaction. The i-th record of the source is written to
+ * outputs[i % outputs.size()], so the outputs are sharded the same way as
+ * by a DBReader with as many shards. A null transform copies the records as
+ * they are.
+ *
+ * Errors raised by any stage stop the pipeline and are rethrown. Returns the
+ * number of records written.
+ */
+int64_t ParallelConvert(
+    const RecordSource& source,
+    const RecordTransform& transform,
+    const vector<DB*>& outputs,
+    const ParallelConvertOptions& options);
+
+// Convenience to read all the records of a db
+RecordSource CursorSource(Cursor* cursor);
+
+// Names of the output dbs of a conversion into num_shards shards
+vector<string> ShardedDBNames(const string& name, int num_shards);
+
+} // namespace db
+} // namespace caffe2
+
+#endif // CAFFE2_DB_PARALLEL_CONVERT_H_
@@ -0,0 +1,474 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+namespace db {
+
+// RecordDB stores write-once datasets in a single append-only file that is
+// read through mmap, so that many readers can share the page cache without
+// any copy or lock. The file is laid out as:
+//
+//   FileHeader
+//   records: uint32 key size, uint64 value size, key bytes, value bytes
+//   sparse index: for every kIndexInterval-th record, uint32 key size, key
+//     bytes and the uint64 offset of the record
+//   FileTrailer
+//
+// Records are returned in the order they were written. Seeking is supported
+// if the keys were written in ascending order, and goes through the sparse
+// index before scanning at most kIndexInterval records. The index and
+// trailer are written when the db is closed, so a file can only be read once
+// its writer is closed.
+
+namespace {
+
+constexpr char kMagic[8] = {'C', '2', 'R', 'E', 'C', 'D', 'B', '\0'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kIndexInterval = 64;
+constexpr size_t kRecordHeaderSize = sizeof(uint32_t) + sizeof(uint64_t);
+constexpr size_t kWriteBufferSize = 1 << 22;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct FileTrailer {
+  uint64_t index_offset;
+  uint64_t num_records;
+  uint64_t num_index_entries;
+  uint32_t sorted;
+  uint32_t reserved;
+  char magic[8];
+};
+
+struct IndexEntry {
+  string key;
+  uint64_t offset;
+};
+
+template <typename T>
+T readAt(const char* data) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+// Reads the trailer and index of a complete file held in [data, data + size)
+void readIndex(
+    const char* data,
+    uint64_t size,
+    const string& source,
+    FileTrailer* trailer,
+    vector<IndexEntry>* index) {
+  CAFFE_ENFORCE(
+      size >= sizeof(FileHeader) + sizeof(FileTrailer),
+      "Not a recorddb file: ",
+      source);
+  const auto header = readAt<FileHeader>(data);
+  *trailer = readAt<FileTrailer>(data + size - sizeof(FileTrailer));
+  CAFFE_ENFORCE(
+      memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+          memcmp(trailer->magic, kMagic, sizeof(kMagic)) == 0,
+      "Not a recorddb file, or its writer was not closed: ",
+      source);
+  CAFFE_ENFORCE_EQ(
+      header.version, kVersion, "Unsupported recorddb version in ", source);
+  const uint64_t index_end = size - sizeof(FileTrailer);
+  CAFFE_ENFORCE(
+      trailer->index_offset >= sizeof(FileHeader) &&
+          trailer->index_offset <= index_end,
+      "Corrupted recorddb index in ",
+      source);
+
+  index->clear();
+  index->reserve(trailer->num_index_entries);
+  uint64_t pos = trailer->index_offset;
+  for (uint64_t i = 0; i < trailer->num_index_entries; ++i) {
+    CAFFE_ENFORCE_LE(
+        pos + sizeof(uint32_t),
+        index_end,
+        "Corrupted recorddb index in ",
+        source);
+    const auto key_size = readAt<uint32_t>(data + pos);
+    pos += sizeof(uint32_t);
+    CAFFE_ENFORCE_LE(
+        pos + key_size + sizeof(uint64_t),
+        index_end,
+        "Corrupted recorddb index in ",
+        source);
+    IndexEntry entry;
+    entry.key.assign(data + pos, key_size);
+    pos += key_size;
+    entry.offset = readAt<uint64_t>(data + pos);
+    pos += sizeof(uint64_t);
+    CAFFE_ENFORCE_LT(
+        entry.offset,
+        trailer->index_offset,
+        "Corrupted recorddb index in ",
+        source);
+    index->push_back(std::move(entry));
+  }
+}
+
+} // namespace
+
+class RecordDBCursor : public Cursor {
+ public:
+  RecordDBCursor(
+      const char* data,
+      uint64_t end,
+      bool sorted,
+      const vector<IndexEntry>* index)
+      : data_(data), end_(end), sorted_(sorted), index_(index) {
+    SeekToFirst();
+  }
+  ~RecordDBCursor() {}
+
+  void Seek(const string& key) override {
+    CAFFE_ENFORCE(
+        sorted_, "RecordDB can only seek if the keys were written in order.");
+    // The last indexed record whose key is not greater than key
+    auto it = std::upper_bound(
+        index_->begin(),
+        index_->end(),
+        key,
+        [](const string& k, const IndexEntry& entry) { return k < entry.key; });
+    if (it == index_->begin()) {
+      SeekToFirst();
+    } else {
+      moveTo((it - 1)->offset);
+    }
+    while (Valid() && compareKey(key) < 0) {
+      Next();
+    }
+  }
+
+  bool SupportsSeek() override {
+    return sorted_;
+  }
+
+  void SeekToFirst() override {
+    moveTo(sizeof(FileHeader));
+  }
+
+  void Next() override {
+    CAFFE_ENFORCE(Valid(), "Cursor is at invalid location!");
+    moveTo(value_offset_ + value_size_);
+  }
+
+  string key() override {
+    CAFFE_ENFORCE(Valid(), "Cursor is at invalid location!");
+    return string(data_ + key_offset_, key_size_);
+  }
+
+  string value() override {
+    CAFFE_ENFORCE(Valid(), "Cursor is at invalid location!");
+    return string(data_ + value_offset_, value_size_);
+  }
+
+  bool KeyView(const char** data, size_t* size) override {
+    CAFFE_ENFORCE(Valid(), "Cursor is at invalid location!");
+    *data = data_ + key_offset_;
+    *size = key_size_;
+    return true;
+  }
+
+  bool ValueView(const char** data, size_t* size) override {
+    CAFFE_ENFORCE(Valid(), "Cursor is at invalid location!");
+    *data = data_ + value_offset_;
+    *size = value_size_;
+    return true;
+  }
+
+  bool Valid() override {
+    return offset_ < end_;
+  }
+
+ private:
+  void moveTo(uint64_t offset) {
+    offset_ = offset;
+    if (offset_ >= end_) {
+      return;
+    }
+    CAFFE_ENFORCE_LE(
+        offset_ + kRecordHeaderSize, end_, "Truncated record in recorddb.");
+    key_size_ = readAt<uint32_t>(data_ + offset_);
+    const auto value_size =
+        readAt<uint64_t>(data_ + offset_ + sizeof(uint32_t));
+    key_offset_ = offset_ + kRecordHeaderSize;
+    value_offset_ = key_offset_ + key_size_;
+    CAFFE_ENFORCE(
+        value_offset_ <= end_ && value_size <= end_ - value_offset_,
+        "Truncated record in recorddb.");
+    value_size_ = value_size;
+  }
+
+  int compareKey(const string& key) const {
+    const int cmp = memcmp(
+        data_ + key_offset_,
+        key.data(),
+        std::min<size_t>(key_size_, key.size()));
+    if (cmp != 0) {
+      return cmp;
+    }
+    return key_size_ < key.size() ? -1 : (key_size_ > key.size() ? 1 : 0);
+  }
+
+  const char* data_;
+  const uint64_t end_;
+  const bool sorted_;
+  const vector<IndexEntry>* index_;
+  uint64_t offset_;
+  uint64_t key_offset_;
+  uint32_t key_size_;
+  uint64_t value_offset_;
+  uint64_t value_size_;
+};
+
+class RecordDB;
+
+class RecordDBTransaction : public Transaction {
+ public:
+  explicit RecordDBTransaction(RecordDB* db);
+  ~RecordDBTransaction() {
+    // Failures are only thrown by an explicit Commit()
+    try {
+      Commit();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Cannot commit recorddb transaction: " << e.what();
+    }
+  }
+
+  void Put(const string& key, const string& value) override;
+  void Commit() override;
+
+ private:
+  RecordDB* db_;
+  std::lock_guard<std::mutex> lock_;
+
+  DISABLE_COPY_AND_ASSIGN(RecordDBTransaction);
+};
+
+class RecordDB : public DB {
+ public:
+  RecordDB(const string& source, Mode mode)
+      : DB(source, mode), source_(source) {
+    switch (mode) {
+      case NEW:
+        openForWriting(false);
+        break;
+      case WRITE:
+        openForWriting(true);
+        break;
+      case READ:
+        openForReading();
+        break;
+    }
+    VLOG(1) << "Opened RecordDB " << source;
+  }
+  ~RecordDB() {
+    // Destructors must not throw: failures are only reported by an explicit
+    // Close(), here they are logged and the file is released anyway
+    try {
+      Close();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Cannot close recorddb " << source_ << ": " << e.what();
+    }
+    if (file_) {
+      fclose(file_);
+    }
+  }
+
+  void Close() override {
+    if (file_) {
+      writeIndexAndTrailer();
+      FILE* file = file_;
+      file_ = nullptr;
+      CAFFE_ENFORCE_EQ(fclose(file), 0, "Cannot close ", source_);
+    }
+    if (data_) {
+      munmap(data_, size_);
+      data_ = nullptr;
+    }
+  }
+
+  unique_ptr<Cursor> NewCursor() override {
+    CAFFE_ENFORCE_EQ(this->mode_, READ);
+    CAFFE_ENFORCE(data_, "RecordDB ", source_, " is closed.");
+    return make_unique<RecordDBCursor>(
+        data_, trailer_.index_offset, trailer_.sorted, &index_);
+  }
+
+  unique_ptr<Transaction> NewTransaction() override {
+    CAFFE_ENFORCE(this->mode_ == NEW || this->mode_ == WRITE);
+    CAFFE_ENFORCE(file_, "RecordDB ", source_, " is closed.");
+    return make_unique<RecordDBTransaction>(this);
+  }
+
+ private:
+  friend class RecordDBTransaction;
+
+  void openForReading() {
+    int fd = open(source_.c_str(), O_RDONLY);
+    CAFFE_ENFORCE_GE(fd, 0, "Cannot open file: ", source_);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      CAFFE_THROW("Cannot stat file: ", source_);
+    }
+    size_ = st.st_size;
+    if (size_ < sizeof(FileHeader) + sizeof(FileTrailer)) {
+      close(fd);
+      CAFFE_THROW("Not a recorddb file: ", source_);
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    CAFFE_ENFORCE(data != MAP_FAILED, "Cannot mmap file: ", source_);
+    data_ = static_cast<char*>(data);
+    try {
+      readIndex(data_, size_, source_, &trailer_, &index_);
+    } catch (...) {
+      munmap(data_, size_);
+      data_ = nullptr;
+      throw;
+    }
+    // Cursors mostly scan the records in order
+    madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+
+  void openForWriting(bool append) {
+    if (append && access(source_.c_str(), F_OK) == 0) {
+      // Drop the index and trailer of the existing file, they are written
+      // again when closing
+      openForReading();
+      num_records_ = trailer_.num_records;
+      sorted_ = trailer_.sorted;
+      offset_ = trailer_.index_offset;
+      index_written_ = std::move(index_);
+      if (!index_written_.empty()) {
+        // The last key is needed to check that keys are still in order
+        uint64_t pos = index_written_.back().offset;
+        while (true) {
+          const auto key_size = readAt<uint32_t>(data_ + pos);
+          const auto value_size =
+              readAt<uint64_t>(data_ + pos + sizeof(uint32_t));
+          const uint64_t next = pos + kRecordHeaderSize + key_size + value_size;
+          if (next >= offset_) {
+            last_key_.assign(data_ + pos + kRecordHeaderSize, key_size);
+            break;
+          }
+          pos = next;
+        }
+      }
+      munmap(data_, size_);
+      data_ = nullptr;
+      CAFFE_ENFORCE_EQ(
+          truncate(source_.c_str(), offset_), 0, "Cannot truncate ", source_);
+      file_ = fopen(source_.c_str(), "ab");
+      CAFFE_ENFORCE(file_, "Cannot open file: ", source_);
+    } else {
+      file_ = fopen(source_.c_str(), "wb");
+      CAFFE_ENFORCE(file_, "Cannot open file: ", source_);
+      FileHeader header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, kMagic, sizeof(kMagic));
+      header.version = kVersion;
+      write(&header, sizeof(header));
+    }
+    setvbuf(file_, nullptr, _IOFBF, kWriteBufferSize);
+  }
+
+  void write(const void* data, size_t size) {
+    CAFFE_ENFORCE_EQ(
+        fwrite(data, 1, size, file_), size, "Cannot write to ", source_);
+    offset_ += size;
+  }
+
+  void put(const string& key, const string& value) {
+    CAFFE_ENFORCE(file_, "RecordDB ", source_, " is closed.");
+    if (num_records_ > 0 && key <= last_key_) {
+      sorted_ = false;
+    }
+    if (num_records_ % kIndexInterval == 0) {
+      index_written_.push_back(IndexEntry{key, offset_});
+    }
+    const uint32_t key_size = key.size();
+    CAFFE_ENFORCE_EQ(key_size, key.size(), "Key too long.");
+    const uint64_t value_size = value.size();
+    write(&key_size, sizeof(key_size));
+    write(&value_size, sizeof(value_size));
+    write(key.data(), key.size());
+    write(value.data(), value.size());
+    last_key_ = key;
+    num_records_++;
+  }
+
+  void flush() {
+    if (file_) {
+      CAFFE_ENFORCE_EQ(fflush(file_), 0, "Cannot write to ", source_);
+    }
+  }
+
+  void writeIndexAndTrailer() {
+    FileTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.index_offset = offset_;
+    trailer.num_records = num_records_;
+    trailer.num_index_entries = index_written_.size();
+    trailer.sorted = sorted_;
+    memcpy(trailer.magic, kMagic, sizeof(kMagic));
+    for (const auto& entry : index_written_) {
+      const uint32_t key_size = entry.key.size();
+      write(&key_size, sizeof(key_size));
+      write(entry.key.data(), entry.key.size());
+      write(&entry.offset, sizeof(entry.offset));
+    }
+    write(&trailer, sizeof(trailer));
+  }
+
+  const string source_;
+
+  // Reading state
+  char* data_{nullptr};
+  uint64_t size_{0};
+  FileTrailer trailer_;
+  vector<IndexEntry> index_;
+
+  // Writing state
+  FILE* file_{nullptr};
+  uint64_t offset_{0};
+  uint64_t num_records_{0};
+  bool sorted_{true};
+  string last_key_;
+  vector<IndexEntry> index_written_;
+  // Only one transaction writes at a time
+  std::mutex write_mutex_;
+};
+
+RecordDBTransaction::RecordDBTransaction(RecordDB* db)
+    : db_(db), lock_(db->write_mutex_) {}
+
+void RecordDBTransaction::Put(const string& key, const string& value) {
+  db_->put(key, value);
+}
+
+void RecordDBTransaction::Commit() {
+  db_->flush();
+}
+
+REGISTER_CAFFE2_DB(RecordDB, RecordDB);
+REGISTER_CAFFE2_DB(recorddb, RecordDB);
+
+} // namespace db
+} // namespace caffe2
@@ -0,0 +1,114 @@
+#ifndef CAFFE2_IMAGE_IMAGE_CACHE_H_
+#define CAFFE2_IMAGE_IMAGE_CACHE_H_
+
+#include <opencv2/opencv.hpp>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/stats.h"
+
+namespace caffe2 {
+
+/**
+ * A thread safe cache of decoded images, keyed by their db key and bounded
+ * by the total size of the images. The least recently used images are
+ * evicted first.
+ */
+class DecodedImageCache {
+ public:
+  DecodedImageCache(size_t capacity_bytes, const std::string& name)
+      : capacity_bytes_(capacity_bytes), stats_(name) {}
+
+  // Returns false if the image is not cached
+  bool Get(const std::string& key, cv::Mat* img) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      misses_++;
+      CAFFE_EVENT(stats_, image_cache_misses);
+      return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    *img = it->second->second;
+    hits_++;
+    CAFFE_EVENT(stats_, image_cache_hits);
+    return true;
+  }
+
+  // Images larger than the whole cache are not stored
+  void Put(const std::string& key, const cv::Mat& img) {
+    const size_t nbytes = img.total() * img.elemSize();
+    if (nbytes > capacity_bytes_) {
+      return;
+    }
+    // Do not keep alive the rest of the buffer img is a view of, e.g. when a
+    // bounding box was applied without scaling
+    const bool owns_buffer = img.isContinuous() && img.data == img.datastart &&
+        img.dataend == img.datastart + nbytes;
+    cv::Mat stored = owns_buffer ? img : img.clone();
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (index_.count(key)) {
+      return;
+    }
+    while (bytes_ + nbytes > capacity_bytes_) {
+      const auto& oldest = lru_.back();
+      bytes_ -= oldest.second.total() * oldest.second.elemSize();
+      index_.erase(oldest.first);
+      lru_.pop_back();
+      CAFFE_EVENT(stats_, image_cache_evictions);
+    }
+    lru_.emplace_front(key, stored);
+    index_.emplace(key, lru_.begin());
+    bytes_ += nbytes;
+  }
+
+  // Number and total size in bytes of the cached images
+  size_t size() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return lru_.size();
+  }
+  size_t bytes() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return bytes_;
+  }
+
+  // Logs the hit rate since the last call
+  void LogHitRate() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    const auto lookups = hits_ + misses_;
+    if (lookups > 0) {
+      LOG(INFO) << stats_.groupName << ": " << lookups << " lookups, hit rate "
+                << 100. * hits_ / lookups << "%, " << lru_.size()
+                << " images cached in " << (bytes_ >> 20) << " MB";
+    }
+    hits_ = misses_ = 0;
+  }
+
+ private:
+  using Entry = std::pair<std::string, cv::Mat>;
+
+  const size_t capacity_bytes_;
+  std::mutex mutex_;
+  // Most recently used first
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  size_t bytes_ = 0;
+  int64_t hits_ = 0;
+  int64_t misses_ = 0;
+
+  struct ImageCacheStats {
+    CAFFE_STAT_CTOR(ImageCacheStats);
+    CAFFE_EXPORTED_STAT(image_cache_hits);
+    CAFFE_EXPORTED_STAT(image_cache_misses);
+    CAFFE_EXPORTED_STAT(image_cache_evictions);
+  } stats_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_IMAGE_IMAGE_CACHE_H_
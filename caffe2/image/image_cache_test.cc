@@ -0,0 +1,107 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/image/image_cache.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A single row, single channel image of width bytes filled with value
+cv::Mat makeImage(int width, int value) {
+  return cv::Mat(1, width, CV_8UC1, cv::Scalar(value));
+}
+
+} // namespace
+
+TEST(DecodedImageCacheTest, EvictsLeastRecentlyUsed) {
+  DecodedImageCache cache(300, "image_cache_test");
+  cache.Put("a", makeImage(100, 1));
+  cache.Put("b", makeImage(100, 2));
+  cache.Put("c", makeImage(100, 3));
+  EXPECT_EQ(cache.size(), 3);
+
+  // Looking a up makes b the least recently used image
+  cv::Mat img;
+  EXPECT_TRUE(cache.Get("a", &img));
+  EXPECT_EQ(img.at<uint8_t>(0, 0), 1);
+  cache.Put("d", makeImage(100, 4));
+  EXPECT_FALSE(cache.Get("b", &img));
+  EXPECT_TRUE(cache.Get("c", &img));
+  EXPECT_EQ(img.at<uint8_t>(0, 0), 3);
+  EXPECT_TRUE(cache.Get("d", &img));
+  EXPECT_EQ(img.at<uint8_t>(0, 0), 4);
+
+  // a and c are now the least recently used, and both are evicted for an
+  // image twice as large as the others
+  cache.Put("e", makeImage(200, 5));
+  EXPECT_FALSE(cache.Get("a", &img));
+  EXPECT_FALSE(cache.Get("c", &img));
+  EXPECT_TRUE(cache.Get("d", &img));
+  EXPECT_TRUE(cache.Get("e", &img));
+  EXPECT_EQ(img.total(), 200);
+
+  // Putting a cached key again does not replace it
+  cache.Put("e", makeImage(10, 6));
+  EXPECT_TRUE(cache.Get("e", &img));
+  EXPECT_EQ(img.at<uint8_t>(0, 0), 5);
+}
+
+TEST(DecodedImageCacheTest, StaysWithinCapacity) {
+  const size_t kCapacity = 1000;
+  DecodedImageCache cache(kCapacity, "image_cache_test");
+  for (int i = 0; i < 100; ++i) {
+    cache.Put(std::to_string(i), makeImage(30 + i % 7 * 50, i));
+    EXPECT_LE(cache.bytes(), kCapacity);
+  }
+
+  // Images larger than the whole cache are not stored and evict nothing
+  const auto cached = cache.size();
+  const auto bytes = cache.bytes();
+  cache.Put("large", makeImage(kCapacity + 1, 0));
+  cv::Mat img;
+  EXPECT_FALSE(cache.Get("large", &img));
+  EXPECT_EQ(cache.size(), cached);
+  EXPECT_EQ(cache.bytes(), bytes);
+
+  // A view of a larger image only stores, and counts, its own pixels
+  cv::Mat full(100, 100, CV_8UC1, cv::Scalar(7));
+  cache.Put("view", full(cv::Rect(10, 10, 20, 20)));
+  EXPECT_TRUE(cache.Get("view", &img));
+  EXPECT_EQ(img.total(), 400);
+  EXPECT_TRUE(img.isContinuous());
+  EXPECT_EQ(img.dataend - img.datastart, 400);
+  EXPECT_LE(cache.bytes(), kCapacity);
+}
+
+TEST(DecodedImageCacheTest, ConcurrentAccess) {
+  const int kNumKeys = 100;
+  const int kImageBytes = 64;
+  const int kNumThreads = 8;
+  DecodedImageCache cache(kNumKeys / 2 * kImageBytes, "image_cache_test");
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      cv::Mat img;
+      for (int i = 0; i < 2000; ++i) {
+        const int key = (i * 7 + t * 13) % kNumKeys;
+        if (cache.Get(std::to_string(key), &img)) {
+          EXPECT_EQ(img.total(), kImageBytes);
+          EXPECT_EQ(img.at<uint8_t>(0, kImageBytes - 1), key);
+        } else {
+          cache.Put(std::to_string(key), makeImage(kImageBytes, key));
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(cache.bytes(), kNumKeys / 2 * kImageBytes);
+  EXPECT_EQ(cache.bytes(), cache.size() * kImageBytes);
+}
+
+} // namespace caffe2
@@ -72,6 +72,11 @@ The dimension of the output image will always be cropxcrop
     .Arg("decode_threads", "Number of CPU decode/transform threads."
          " Defaults to 4")
     .Arg("output_type", "If gpu_transform, can set to FLOAT or FLOAT16.")
+    .Arg("image_cache_size_mb", "If positive, keep up to this many MB of "
+         "decoded images in memory, keyed by their db key, so they are only "
+         "decoded once. Images are cached after the bounding box and scaling, "
+         "cropping and mirroring are still applied on every read. Defaults "
+         "to 0")
     .Arg("db", "Name of the database (if not passed as input)")
     .Arg("db_type", "Type of database (if not passed as input)."
          " Defaults to leveldb")
@@ -13,6 +13,7 @@
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/thread_pool.h"
 #include "caffe2/operators/prefetch_op.h"
+#include "caffe2/image/image_cache.h"
 #include "caffe2/image/transform_gpu.h"
 
 namespace caffe2 {
@@ -38,6 +39,9 @@ class ImageInputOp final
                                     Workspace* ws);
   ~ImageInputOp() {
     PrefetchOperator<Context>::Finalize();
+    if (image_cache_) {
+      image_cache_->LogHitRate();
+    }
   }
 
   bool Prefetch() override;
@@ -59,14 +63,20 @@ class ImageInputOp final
     BoundingBox bounding_params;
   };
 
+  // If decode is false, only the labels and additional outputs are read
   bool GetImageAndLabelAndInfoFromDBValue(
-      const string& value, cv::Mat* img, PerImageArg& info, int item_id);
+      const string& value, cv::Mat* img, PerImageArg& info, int item_id,
+      bool decode = true);
+  // Decodes the image, or gets it from the cache
+  void GetImage(
+      const std::string& key, const std::string& value, cv::Mat* img,
+      int item_id);
   void DecodeAndTransform(
-      const std::string& value, float *image_data, int item_id,
-      const int channels, std::size_t thread_index);
+      const std::string& key, const std::string& value, float *image_data,
+      int item_id, const int channels, std::size_t thread_index);
   void DecodeAndTransposeOnly(
-      const std::string& value, uint8_t *image_data, int item_id,
-      const int channels, std::size_t thread_index);
+      const std::string& key, const std::string& value, uint8_t *image_data,
+      int item_id, const int channels, std::size_t thread_index);
 
   unique_ptr<db::DBReader> owned_reader_;
   const db::DBReader* reader_;
@@ -109,6 +119,10 @@ class ImageInputOp final
 
   // Working variables
   std::vector<std::mt19937> randgen_per_thread_;
+
+  // Decoded and scaled images, only cropped and mirrored on every epoch
+  std::unique_ptr<DecodedImageCache> image_cache_;
+  int num_prefetched_batches_ = 0;
 };
 
 template <class Context>
@@ -215,6 +229,14 @@ ImageInputOp<Context>::ImageInputOp(
     default_arg_.bounding_params.valid = true;
   }
 
+  const int image_cache_size_mb =
+      OperatorBase::template GetSingleArgument<int>("image_cache_size_mb", 0);
+  if (image_cache_size_mb > 0) {
+    image_cache_.reset(new DecodedImageCache(
+        size_t(image_cache_size_mb) << 20,
+        "image_cache/" + operator_def.name()));
+  }
+
   if (mean_.size() == 1) {
     // We are going to extend to 3 using the first value
     mean_.resize(3, mean_[0]);
@@ -251,6 +273,10 @@ ImageInputOp<Context>::ImageInputOp(
   LOG(INFO) << "    " << (is_test_ ? "Central" : "Random")
             << " cropping image to " << crop_
             << (mirror_ ? " with " : " without ") << "random mirroring;";
+  if (image_cache_) {
+    LOG(INFO) << "    Caching up to " << image_cache_size_mb
+              << " MB of scaled images;";
+  }
 
   auto mit = mean_.begin();
   auto sit = std_.begin();
@@ -292,7 +318,8 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     const string& value,
     cv::Mat* img,
     PerImageArg& info,
-    int item_id) {
+    int item_id,
+    bool decode) {
   //
   // recommend using --caffe2_use_fatal_for_enforce=1 when using ImageInputOp
   // as this function runs on a worker thread and the exceptions from
@@ -308,7 +335,9 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     CAFFE_ENFORCE(datum.ParseFromString(value));
 
     prefetched_label_.mutable_data<int>()[item_id] = datum.label();
-    if (datum.encoded()) {
+    if (!decode) {
+      // The image is not needed
+    } else if (datum.encoded()) {
       // encoded image in datum.
       src = cv::imdecode(
           cv::Mat(
@@ -367,7 +396,9 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
       info.bounding_params.width = bounding_proto.int32_data(3);
     }
 
-    if (image_proto.data_type() == TensorProto::STRING) {
+    if (!decode) {
+      // The image is not needed
+    } else if (image_proto.data_type() == TensorProto::STRING) {
       // encoded image string.
       DCHECK_EQ(image_proto.string_data_size(), 1);
       const string& encoded_image_str = image_proto.string_data(0);
@@ -470,6 +501,10 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     }
   }
 
+  if (!decode) {
+    return true;
+  }
+
   //
   // convert source to the color format requested from Op
   //
@@ -655,12 +690,31 @@ void CropTransposeImage(const cv::Mat& scaled_img, const int channels,
   }
 }
 
+template <class Context>
+void ImageInputOp<Context>::GetImage(
+    const std::string& key,
+    const std::string& value,
+    cv::Mat* img,
+    int item_id) {
+  PerImageArg info;
+  if (image_cache_ && image_cache_->Get(key, img)) {
+    // Only the labels need to be parsed
+    CHECK(GetImageAndLabelAndInfoFromDBValue(
+        value, img, info, item_id, false /* decode */));
+    return;
+  }
+  CHECK(GetImageAndLabelAndInfoFromDBValue(value, img, info, item_id));
+  if (image_cache_) {
+    image_cache_->Put(key, *img);
+  }
+}
+
 // Parse datum, decode image, perform transform
 // Intended as entry point for binding to thread pool
 template <class Context>
 void ImageInputOp<Context>::DecodeAndTransform(
-      const std::string& value, float *image_data, int item_id,
-      const int channels, std::size_t thread_index) {
+      const std::string& key, const std::string& value, float *image_data,
+      int item_id, const int channels, std::size_t thread_index) {
 
   CAFFE_ENFORCE((int)thread_index < num_decode_threads_);
 
@@ -669,8 +723,7 @@ void ImageInputOp<Context>::DecodeAndTransform(
 
   cv::Mat img;
   // Decode the image
-  PerImageArg info;
-  CHECK(GetImageAndLabelAndInfoFromDBValue(value, &img, info, item_id));
+  GetImage(key, value, &img, item_id);
 
   // Factor out the image transformation
   TransformImage<Context>(img, channels, image_data, crop_, mirror_,
@@ -679,8 +732,8 @@ void ImageInputOp<Context>::DecodeAndTransform(
 
 template <class Context>
 void ImageInputOp<Context>::DecodeAndTransposeOnly(
-    const std::string& value, uint8_t *image_data, int item_id,
-    const int channels, std::size_t thread_index) {
+    const std::string& key, const std::string& value, uint8_t *image_data,
+    int item_id, const int channels, std::size_t thread_index) {
 
   CAFFE_ENFORCE((int)thread_index < num_decode_threads_);
 
@@ -689,8 +742,7 @@ void ImageInputOp<Context>::DecodeAndTransposeOnly(
 
   cv::Mat img;
   // Decode the image
-  PerImageArg info;
-  CHECK(GetImageAndLabelAndInfoFromDBValue(value, &img, info, item_id));
+  GetImage(key, value, &img, item_id);
 
   // Factor out the image transformation
   CropTransposeImage<Context>(img, channels, image_data, crop_, mirror_,
@@ -718,13 +770,14 @@ bool ImageInputOp<Context>::Prefetch() {
   prefetched_label_.mutable_data<int>();
   // Prefetching handled with a thread pool of "decode_threads" threads.
 
+  // read data
+  std::vector<std::string> keys, values;
+  reader_->ReadMany(batch_size_, &keys, &values);
+
   for (int item_id = 0; item_id < batch_size_; ++item_id) {
-    std::string key, value;
+    std::string& value = values[item_id];
     cv::Mat img;
 
-    // read data
-    reader_->Read(&key, &value);
-
     // determine label type based on first item
     if( item_id == 0 ) {
       if( use_caffe_datum_ ) {
@@ -765,7 +818,8 @@ bool ImageInputOp<Context>::Prefetch() {
       thread_pool_->runTaskWithID(std::bind(
           &ImageInputOp<Context>::DecodeAndTransposeOnly,
           this,
-          std::string(value),
+          std::move(keys[item_id]),
+          std::move(value),
           image_data,
           item_id,
           channels,
@@ -776,7 +830,8 @@ bool ImageInputOp<Context>::Prefetch() {
       thread_pool_->runTaskWithID(std::bind(
           &ImageInputOp<Context>::DecodeAndTransform,
           this,
-          std::string(value),
+          std::move(keys[item_id]),
+          std::move(value),
           image_data,
           item_id,
           channels,
@@ -784,6 +839,9 @@ bool ImageInputOp<Context>::Prefetch() {
     }
   }
   thread_pool_->waitWorkComplete();
+  if (image_cache_ && ++num_prefetched_batches_ % 1000 == 0) {
+    image_cache_->LogHitRate();
+  }
 
   // If the context is not CPUContext, we will need to do a copy in the
   // prefetch function as well.
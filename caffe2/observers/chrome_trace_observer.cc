@@ -0,0 +1,252 @@
+#include "chrome_trace_observer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "caffe2/core/net_async_base.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_chrome_trace_sample_every,
+    100,
+    "ChromeTraceNetObserver records one out of this many net iterations");
+CAFFE2_DEFINE_int(
+    caffe2_chrome_trace_buffer_size,
+    1 << 16,
+    "Number of trace events kept per thread, older events are overwritten");
+
+namespace caffe2 {
+
+namespace {
+thread_local void* tls_trace_buffer = nullptr;
+
+void writeEscaped(std::ostream& os, const char* str) {
+  for (; *str; ++str) {
+    if (*str == '"' || *str == '\\') {
+      os << '\\' << *str;
+    } else if (static_cast<unsigned char>(*str) >= 0x20) {
+      os << *str;
+    }
+  }
+}
+} // namespace
+
+constexpr uint64_t TraceEventCollector::kNoEvent;
+
+TraceEventCollector& TraceEventCollector::get() {
+  static TraceEventCollector collector;
+  return collector;
+}
+
+TraceEventCollector::TraceEventCollector()
+    : epoch_(std::chrono::steady_clock::now()) {}
+
+int64_t TraceEventCollector::now() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - epoch_)
+      .count();
+}
+
+int TraceEventCollector::registerNet(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  net_names_.push_back(name);
+  return net_names_.size() - 1;
+}
+
+TraceEventCollector::ThreadBuffer* TraceEventCollector::threadBuffer() {
+  // There is a single collector, so the thread local pointer always refers
+  // to one of its buffers
+  auto* buffer = static_cast<ThreadBuffer*>(tls_trace_buffer);
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.emplace_back(new ThreadBuffer(
+        std::max(FLAGS_caffe2_chrome_trace_buffer_size, 1), buffers_.size()));
+    buffer = buffers_.back().get();
+    tls_trace_buffer = buffer;
+  }
+  return buffer;
+}
+
+void TraceEventCollector::record(const TraceEvent& event) {
+  auto* buffer = threadBuffer();
+  // Single producer: only the owning thread writes head
+  auto head = buffer->head.load(std::memory_order_relaxed);
+  auto& slot = buffer->slots[head % buffer->slots.size()];
+  // Invalidate the slot before overwriting it so that a concurrent dump
+  // never takes a half written event
+  slot.seq.store(kNoEvent, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.event = event;
+  slot.seq.store(head, std::memory_order_release);
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceEventCollector::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& buffer : buffers_) {
+    buffer->cleared.store(
+        buffer->head.load(std::memory_order_acquire),
+        std::memory_order_release);
+  }
+}
+
+void TraceEventCollector::dumpJSON(std::ostream& os) {
+  std::vector<std::pair<int, TraceEvent>> events;
+  std::vector<std::string> net_names;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    net_names = net_names_;
+    for (auto& buffer : buffers_) {
+      auto capacity = buffer->slots.size();
+      auto head = buffer->head.load(std::memory_order_acquire);
+      auto begin = std::max(
+          buffer->cleared.load(std::memory_order_acquire),
+          head > capacity ? head - capacity : 0);
+      for (auto i = begin; i < head; ++i) {
+        // The owning thread keeps writing while we copy; skip the events it
+        // has overwritten or is overwriting in the meantime
+        const auto& slot = buffer->slots[i % capacity];
+        if (slot.seq.load(std::memory_order_acquire) != i) {
+          continue;
+        }
+        TraceEvent event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != i) {
+          continue;
+        }
+        events.emplace_back(buffer->tid, event);
+      }
+    }
+  }
+
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& tid_event : events) {
+    const auto& event = tid_event.second;
+    os << (first ? "\n" : ",\n");
+    first = false;
+    os << "{\"name\":\"";
+    writeEscaped(os, event.name);
+    os << "\",\"cat\":\"" << (event.op_index < 0 ? "net" : "op")
+       << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid_event.first
+       << ",\"ts\":" << event.begin_us
+       << ",\"dur\":" << (event.end_us - event.begin_us) << ",\"args\":{";
+    os << "\"net\":\"";
+    if (event.net_id >= 0 && event.net_id < net_names.size()) {
+      writeEscaped(os, net_names[event.net_id].c_str());
+    }
+    os << "\",\"op\":" << event.op_index << ",\"chain\":" << event.chain_id
+       << "}}";
+  }
+  os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool TraceEventCollector::dumpToFile(const std::string& filename) {
+  std::ofstream out(filename);
+  if (!out) {
+    LOG(ERROR) << "Can't open " << filename << " to write the trace";
+    return false;
+  }
+  dumpJSON(out);
+  return out.good();
+}
+
+ChromeTraceOperatorObserver::ChromeTraceOperatorObserver(
+    OperatorBase* op,
+    ChromeTraceNetObserver* netObserver)
+    : RNNCapableOperatorObserver(op), netObserver_(netObserver) {
+  CAFFE_ENFORCE(netObserver_, "Observers can't operate outside of the net");
+}
+
+void ChromeTraceOperatorObserver::Start() {
+  recording_ = netObserver_->sampling_.load(std::memory_order_relaxed);
+  if (recording_) {
+    begin_us_ = TraceEventCollector::get().now();
+  }
+}
+
+void ChromeTraceOperatorObserver::Stop() {
+  if (!recording_) {
+    return;
+  }
+  auto& collector = TraceEventCollector::get();
+  TraceEvent event;
+  const auto* op = subject();
+  const auto& type =
+      op->has_debug_def() ? op->debug_def().type() : std::string("unknown");
+  strncpy(event.name, type.c_str(), TraceEvent::kMaxNameLength - 1);
+  event.name[TraceEvent::kMaxNameLength - 1] = '\0';
+  event.net_id = netObserver_->net_id_;
+  event.op_index = op->net_position();
+  event.chain_id = netObserver_->chainOf(event.op_index);
+  event.begin_us = begin_us_;
+  event.end_us = collector.now();
+  collector.record(event);
+  recording_ = false;
+}
+
+std::unique_ptr<ObserverBase<OperatorBase>>
+ChromeTraceOperatorObserver::rnnCopy(OperatorBase* subject, int rnn_order)
+    const {
+  return std::unique_ptr<ObserverBase<OperatorBase>>(
+      new ChromeTraceOperatorObserver(subject, netObserver_));
+}
+
+ChromeTraceNetObserver::ChromeTraceNetObserver(
+    NetBase* subject_,
+    int sample_every)
+    : OperatorAttachingNetObserver<
+          ChromeTraceOperatorObserver,
+          ChromeTraceNetObserver>(subject_, this),
+      sample_every_(std::max(sample_every, 1)),
+      net_id_(TraceEventCollector::get().registerNet(subject_->Name())),
+      chain_ids_(subject_->GetOperators().size(), 0),
+      iteration_(0),
+      sampling_(false) {
+  if (auto* async_net = dynamic_cast<AsyncNetBase*>(subject_)) {
+    const auto& chains = async_net->chains();
+    for (int chain_id = 0; chain_id < chains.size(); ++chain_id) {
+      for (auto op_index : chains[chain_id]) {
+        chain_ids_[op_index] = chain_id;
+      }
+    }
+  } else if (auto* dag_net = dynamic_cast<DAGNetBase*>(subject_)) {
+    for (const auto& chain : dag_net->execution_chains()) {
+      for (auto op_index : chain.second) {
+        chain_ids_[op_index] = chain.first;
+      }
+    }
+  }
+}
+
+std::string ChromeTraceNetObserver::debugInfo() {
+  return "Recording one out of " + caffe2::to_string(sample_every_) +
+      " iterations";
+}
+
+void ChromeTraceNetObserver::Start() {
+  bool sample = iteration_++ % sample_every_ == 0;
+  if (sample) {
+    begin_us_ = TraceEventCollector::get().now();
+  }
+  sampling_.store(sample, std::memory_order_relaxed);
+}
+
+void ChromeTraceNetObserver::Stop() {
+  if (!sampling_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  sampling_.store(false, std::memory_order_relaxed);
+  auto& collector = TraceEventCollector::get();
+  TraceEvent event;
+  strncpy(event.name, subject()->Name().c_str(), TraceEvent::kMaxNameLength - 1);
+  event.name[TraceEvent::kMaxNameLength - 1] = '\0';
+  event.net_id = net_id_;
+  event.op_index = -1;
+  event.chain_id = -1;
+  event.begin_us = begin_us_;
+  event.end_us = collector.now();
+  collector.record(event);
+}
+
+} // namespace caffe2
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/net.h"
+#include "caffe2/core/observer.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/observers/operator_attaching_net_observer.h"
+#include "caffe2/operators/rnn/rnn_capable_operator_observer.h"
+
+CAFFE2_DECLARE_int(caffe2_chrome_trace_sample_every);
+CAFFE2_DECLARE_int(caffe2_chrome_trace_buffer_size);
+
+namespace caffe2 {
+
+// A complete ("X" phase) event of the Chrome trace event format. Names are
+// copied and truncated so that events stay valid after the net is destroyed.
+struct TraceEvent {
+  static constexpr int kMaxNameLength = 48;
+  char name[kMaxNameLength];
+  int net_id;
+  int op_index;
+  int chain_id;
+  int64_t begin_us;
+  int64_t end_us;
+};
+
+// Collects trace events of all threads. Every thread writes into its own
+// fixed size ring buffer without taking locks, the oldest events are
+// overwritten when the buffer is full. Dumping can happen at any time;
+// events overwritten while being dumped are dropped.
+class TraceEventCollector {
+ public:
+  static TraceEventCollector& get();
+
+  int registerNet(const std::string& name);
+
+  // Microseconds since the collector was created
+  int64_t now() const;
+
+  void record(const TraceEvent& event);
+
+  // Drops all events recorded so far
+  void clear();
+
+  // Writes the recorded events as a Chrome trace JSON object, which can be
+  // loaded by chrome://tracing
+  void dumpJSON(std::ostream& os);
+  bool dumpToFile(const std::string& filename);
+
+ private:
+  static constexpr uint64_t kNoEvent = ~uint64_t(0);
+
+  struct Slot {
+    // Index of the event stored in the slot, kNoEvent while it is empty or
+    // being written
+    std::atomic<uint64_t> seq{kNoEvent};
+    TraceEvent event;
+  };
+
+  struct ThreadBuffer {
+    ThreadBuffer(size_t capacity, int tid)
+        : slots(capacity), head(0), cleared(0), tid(tid) {}
+    std::vector<Slot> slots;
+    // Number of events ever written to the buffer
+    std::atomic<uint64_t> head;
+    // Events before this index were cleared
+    std::atomic<uint64_t> cleared;
+    const int tid;
+  };
+
+  TraceEventCollector();
+  ThreadBuffer* threadBuffer();
+
+  std::mutex mutex_;
+  // Buffers are never released: threads may exit before events are dumped
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  std::vector<std::string> net_names_;
+  const std::chrono::steady_clock::time_point epoch_;
+};
+
+class ChromeTraceNetObserver;
+class ChromeTraceOperatorObserver final : public RNNCapableOperatorObserver {
+ public:
+  explicit ChromeTraceOperatorObserver(OperatorBase* op) = delete;
+  ChromeTraceOperatorObserver(
+      OperatorBase* op,
+      ChromeTraceNetObserver* netObserver);
+  ~ChromeTraceOperatorObserver() {}
+  std::unique_ptr<ObserverBase<OperatorBase>> rnnCopy(
+      OperatorBase* subject,
+      int rnn_order) const override;
+
+ private:
+  void Start() override;
+  void Stop() override;
+
+  ChromeTraceNetObserver* netObserver_;
+  bool recording_ = false;
+  int64_t begin_us_ = 0;
+};
+
+// Records begin/end time, thread and chain of every op for one out of
+// `sample_every` iterations of the net. Works with simple, dag and async
+// nets; for async nets the chain id is the task id of the executor, for dag
+// nets it's the index of the first op of the chain.
+class ChromeTraceNetObserver final
+    : public OperatorAttachingNetObserver<
+          ChromeTraceOperatorObserver,
+          ChromeTraceNetObserver> {
+ public:
+  explicit ChromeTraceNetObserver(
+      NetBase* subject_,
+      int sample_every = FLAGS_caffe2_chrome_trace_sample_every);
+  ~ChromeTraceNetObserver() {}
+
+  std::string debugInfo() override;
+
+  friend class ChromeTraceOperatorObserver;
+
+ private:
+  void Start() override;
+  void Stop() override;
+
+  int chainOf(int op_index) const {
+    return op_index >= 0 && op_index < chain_ids_.size() ? chain_ids_[op_index]
+                                                         : -1;
+  }
+
+  const int sample_every_;
+  const int net_id_;
+  std::vector<int> chain_ids_;
+  std::atomic<int64_t> iteration_;
+  std::atomic<bool> sampling_;
+  int64_t begin_us_ = 0;
+};
+
+} // namespace caffe2
@@ -0,0 +1,115 @@
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/observer.h"
+#include "caffe2/core/operator.h"
+#include "chrome_trace_observer.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+namespace caffe2 {
+
+namespace {
+
+int countOccurrences(const std::string& str, const std::string& pattern) {
+  int count = 0;
+  for (auto pos = str.find(pattern); pos != std::string::npos;
+       pos = str.find(pattern, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+TraceEvent makeEvent(const char* name, int op_index) {
+  TraceEvent event;
+  strncpy(event.name, name, TraceEvent::kMaxNameLength - 1);
+  event.name[TraceEvent::kMaxNameLength - 1] = '\0';
+  event.net_id = -1;
+  event.op_index = op_index;
+  event.chain_id = 0;
+  event.begin_us = 0;
+  event.end_us = 1;
+  return event;
+}
+
+unique_ptr<NetBase> CreateNetTestHelper(Workspace* ws, const string& type) {
+  NetDef net_def;
+  net_def.set_name("trace_test_net");
+  net_def.set_type(type);
+  {
+    auto& op = *(net_def.add_op());
+    op.set_type("ConstantFill");
+    op.add_output("a");
+    op.add_arg()->CopyFrom(MakeArgument<vector<int64_t>>("shape", {4}));
+  }
+  {
+    auto& op = *(net_def.add_op());
+    op.set_type("Relu");
+    op.add_input("a");
+    op.add_output("b");
+  }
+  net_def.add_external_output("b");
+  return CreateNet(net_def, ws);
+}
+} // namespace
+
+TEST(ChromeTraceObserverTest, CollectorKeepsLatestEvents) {
+  auto& collector = TraceEventCollector::get();
+  collector.clear();
+  auto capacity = FLAGS_caffe2_chrome_trace_buffer_size;
+  std::thread([&]() {
+    for (int i = 0; i < capacity + 10; ++i) {
+      collector.record(makeEvent("TraceTestOp", i));
+    }
+  }).join();
+
+  std::ostringstream out;
+  collector.dumpJSON(out);
+  auto json = out.str();
+  EXPECT_EQ(countOccurrences(json, "\"TraceTestOp\""), capacity);
+  EXPECT_EQ(json.find("\"op\":9,"), std::string::npos);
+  EXPECT_NE(json.find("\"op\":10,"), std::string::npos);
+
+  collector.clear();
+  std::ostringstream cleared;
+  collector.dumpJSON(cleared);
+  EXPECT_EQ(countOccurrences(cleared.str(), "\"TraceTestOp\""), 0);
+}
+
+TEST(ChromeTraceObserverTest, EscapesNames) {
+  auto& collector = TraceEventCollector::get();
+  collector.clear();
+  collector.record(makeEvent("quote\"back\\slash", 0));
+  std::ostringstream out;
+  collector.dumpJSON(out);
+  EXPECT_NE(out.str().find("quote\\\"back\\\\slash"), std::string::npos);
+  collector.clear();
+}
+
+TEST(ChromeTraceObserverTest, SamplesIterations) {
+  for (const auto& type : {"simple", "dag", "async_scheduling"}) {
+    Workspace ws;
+    auto net = CreateNetTestHelper(&ws, type);
+    auto* observer = net->AttachObserver(
+        caffe2::make_unique<ChromeTraceNetObserver>(net.get(), 2));
+    EXPECT_TRUE(observer);
+
+    auto& collector = TraceEventCollector::get();
+    collector.clear();
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_TRUE(net->Run());
+    }
+    std::ostringstream out;
+    collector.dumpJSON(out);
+    auto json = out.str();
+    // Two out of four iterations are sampled
+    EXPECT_EQ(countOccurrences(json, "\"cat\":\"net\""), 2);
+    EXPECT_EQ(countOccurrences(json, "\"name\":\"ConstantFill\""), 2);
+    EXPECT_EQ(countOccurrences(json, "\"name\":\"Relu\""), 2);
+    EXPECT_NE(json.find("\"net\":\"trace_test_net\""), std::string::npos);
+    net->DetachObserver(observer);
+  }
+}
+
+} // namespace caffe2
@@ -1,5 +1,9 @@
 #include "caffe2/operators/dataset_ops.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -8,6 +12,13 @@
 #include "caffe2/core/operator.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/utils/string_utils.h"
+#include "caffe2/utils/thread_pool.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_dataset_gather_threads,
+    4,
+    "Maximal number of threads, including the calling one, that can be used "
+    "by ReadNextBatch and ReadRandomBatch to copy a batch");
 
 namespace caffe2 {
 
@@ -190,6 +201,180 @@ void TreeWalker::gatherSizeLimits() {
 
 namespace {
 
+// Minimal size of the tasks of a batch copied by several threads
+const size_t kGatherTaskBytes = 1 << 20;
+// Number of copies ahead whose source is prefetched
+const int kGatherPrefetchDistance = 4;
+
+/**
+ * Copies the slices of the records of a batch into the outputs. All the
+ * copies are planned before any of them runs, and a copy whose source and
+ * destination directly follow the ones of the previous copy is merged into
+ * it, so that consecutive records are copied at once. Large batches are split
+ * into tasks of about kGatherTaskBytes that are run by the calling thread and
+ * a shared pool of threads.
+ */
+class BatchGather {
+ public:
+  void add(const TypeMeta& meta, const void* src, void* dst, size_t items) {
+    if (items == 0) {
+      return;
+    }
+    const size_t bytes = items * meta.itemsize();
+    totalBytes_ += bytes;
+    if (!runs_.empty()) {
+      auto& last = runs_.back();
+      if (last.meta == meta && last.src + last.bytes == src &&
+          last.dst + last.bytes == dst) {
+        last.bytes += bytes;
+        return;
+      }
+    }
+    runs_.push_back(
+        {meta, static_cast<const char*>(src), static_cast<char*>(dst), bytes});
+  }
+
+  void run() {
+    const int numThreads = FLAGS_caffe2_dataset_gather_threads;
+    const size_t numTasks = std::min<size_t>(
+        4 * numThreads,
+        (totalBytes_ + kGatherTaskBytes - 1) / kGatherTaskBytes);
+    if (numThreads <= 1 || numTasks <= 1) {
+      copy(runs_.data(), runs_.data() + runs_.size());
+      return;
+    }
+
+    // Shared with the pool threads, which may start after the batch is done
+    auto state = std::make_shared<ParallelState>();
+    split((totalBytes_ + numTasks - 1) / numTasks, state.get());
+    // Never throws, so that every task is counted as done and the outputs are
+    // no longer written once run() returns, even if a copy failed. The tasks
+    // left after a failure are skipped.
+    auto worker = [state]() {
+      const size_t numTasks = state->taskBegin.size() - 1;
+      for (size_t task = state->nextTask++; task < numTasks;
+           task = state->nextTask++) {
+        if (!state->failed) {
+          try {
+            copy(
+                state->runs.data() + state->taskBegin[task],
+                state->runs.data() + state->taskBegin[task + 1]);
+          } catch (...) {
+            state->fail(std::current_exception());
+          }
+        }
+        if (++state->doneTasks == numTasks) {
+          std::lock_guard<std::mutex> guard(state->mutex);
+          state->done.notify_all();
+        }
+      }
+    };
+    const size_t numHelpers =
+        std::min<size_t>(numThreads - 1, state->taskBegin.size() - 2);
+    try {
+      for (size_t i = 0; i < numHelpers; ++i) {
+        pool().run(worker);
+      }
+    } catch (...) {
+      // The calling thread runs the tasks the helpers would have
+      state->fail(std::current_exception());
+    }
+    worker();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() {
+      return state->doneTasks == state->taskBegin.size() - 1;
+    });
+    if (state->error) {
+      std::rethrow_exception(state->error);
+    }
+  }
+
+ private:
+  struct Run {
+    TypeMeta meta;
+    const char* src;
+    char* dst;
+    size_t bytes;
+  };
+
+  struct ParallelState {
+    std::vector<Run> runs;
+    // Runs of task i are [taskBegin[i], taskBegin[i + 1])
+    std::vector<size_t> taskBegin;
+    std::atomic<size_t> nextTask{0};
+    std::atomic<size_t> doneTasks{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    // The first error of a task, rethrown by the calling thread
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    void fail(std::exception_ptr e) {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (!error) {
+        error = e;
+      }
+      failed = true;
+    }
+  };
+
+  static TaskThreadPool& pool() {
+    static TaskThreadPool pool(
+        std::max(FLAGS_caffe2_dataset_gather_threads - 1, 1));
+    return pool;
+  }
+
+  static void copy(const Run* begin, const Run* end) {
+    for (const Run* run = begin; run < end; ++run) {
+#ifdef __GNUC__
+      if (run + kGatherPrefetchDistance < end) {
+        __builtin_prefetch(run[kGatherPrefetchDistance].src);
+      }
+#endif
+      if (run->meta.copy()) {
+        const size_t items = run->bytes / run->meta.itemsize();
+        run->meta.copy()(run->src, run->dst, items);
+      } else {
+        std::memcpy(run->dst, run->src, run->bytes);
+      }
+    }
+  }
+
+  // Splits the runs at item boundaries into tasks of about taskBytes
+  void split(size_t taskBytes, ParallelState* state) const {
+    state->taskBegin.push_back(0);
+    size_t currentBytes = 0;
+    for (Run run : runs_) {
+      const size_t itemsize = run.meta.itemsize();
+      while (currentBytes + run.bytes > taskBytes) {
+        const size_t room =
+            taskBytes > currentBytes ? taskBytes - currentBytes : 0;
+        const size_t items =
+            std::max<size_t>(room / itemsize, currentBytes == 0);
+        if (items * itemsize >= run.bytes) {
+          break;
+        }
+        if (items > 0) {
+          state->runs.push_back({run.meta, run.src, run.dst, items * itemsize});
+          run.src += items * itemsize;
+          run.dst += items * itemsize;
+          run.bytes -= items * itemsize;
+        }
+        state->taskBegin.push_back(state->runs.size());
+        currentBytes = 0;
+      }
+      state->runs.push_back(run);
+      currentBytes += run.bytes;
+    }
+    if (state->taskBegin.back() < state->runs.size()) {
+      state->taskBegin.push_back(state->runs.size());
+    }
+  }
+
+  std::vector<Run> runs_;
+  size_t totalBytes_ = 0;
+};
+
 class CreateTreeCursorOp : public Operator<CPUContext> {
  public:
   CreateTreeCursorOp(const OperatorDef& operator_def, Workspace* ws)
@@ -484,6 +669,7 @@ class ReadNextBatchOp : public Operator<CPUContext> {
     }
     // gather data
     std::vector<TIndex> outDim;
+    BatchGather gather;
     for (int i = 0; i < cursor->it.fields().size(); ++i) {
       auto lengthIdx = cursor->it.fields()[i].lengthFieldId + 1;
       auto size = sizes[lengthIdx];
@@ -497,12 +683,9 @@ class ReadNextBatchOp : public Operator<CPUContext> {
       void* src =
           (char*)in.raw_data() + offset * innerSize * in.meta().itemsize();
       void* dst = out->raw_mutable_data(in.meta()); // create the tensor
-      if (out->size() == 0) {
-        continue;
-      }
-      context_.template CopyItems<CPUContext, CPUContext>(
-          in.meta(), out->size(), src, dst);
+      gather.add(in.meta(), src, dst, out->size());
     }
+    gather.run();
     return true;
   }
   int batchSize_;
@@ -677,6 +860,7 @@ class ReadRandomBatchOp : public Operator<CPUContext> {
       cursor->offsets.at(0) += batchSize_;
     }
 
+    BatchGather gather;
     for (int i = 0; i < cursor->it.fields().size(); ++i) {
       auto lengthIdx = cursor->it.fields()[i].lengthFieldId + 1;
       auto& in = Input(i + 3);
@@ -721,13 +905,14 @@ class ReadRandomBatchOp : public Operator<CPUContext> {
         auto size = *(offsetptr + offsetdim[1]) - offset;
         // copy data
         auto src = src_base + offset * block_bytesize;
-        context_.template CopyItems<CPUContext, CPUContext>(
-            in.meta(), size * block_size, src, dst + start * block_bytesize);
+        gather.add(
+            in.meta(), src, dst + start * block_bytesize, size * block_size);
         start += size;
         idx++;
       }
       idx = idxbegin; // reSet
     }
+    gather.run();
     return true;
   }
   int batchSize_;
@@ -0,0 +1,101 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+
+CAFFE2_DECLARE_int(caffe2_dataset_gather_threads);
+
+namespace caffe2 {
+
+namespace {
+
+struct ThrowingCopy {
+  ThrowingCopy() {}
+  ThrowingCopy(const ThrowingCopy&) = default;
+  ThrowingCopy& operator=(const ThrowingCopy&) {
+    throw std::runtime_error("Cannot copy");
+  }
+  char value = 0;
+};
+
+void createCursor(Workspace* ws, const std::vector<std::string>& fields) {
+  OperatorDef def;
+  def.set_type("CreateTreeCursor");
+  def.add_output("cursor");
+  def.add_arg()->CopyFrom(MakeArgument("fields", fields));
+  EXPECT_TRUE(CreateOperator(def, ws)->Run());
+}
+
+std::unique_ptr<OperatorBase> readNextBatch(
+    Workspace* ws,
+    const std::vector<std::string>& fields,
+    int batch_size) {
+  OperatorDef def;
+  def.set_type("ReadNextBatch");
+  def.add_input("cursor");
+  for (const auto& field : fields) {
+    def.add_input(field);
+    def.add_output(field + "_batch");
+  }
+  def.add_arg()->CopyFrom(MakeArgument("batch_size", batch_size));
+  return CreateOperator(def, ws);
+}
+
+} // namespace
+
+CAFFE_KNOWN_TYPE(ThrowingCopy);
+
+// Batches of several MB are copied by the pool of gather threads
+TEST(DatasetOpsTest, ParallelGather) {
+  ASSERT_GT(FLAGS_caffe2_dataset_gather_threads, 1);
+  const int kRows = 300000;
+  const int kBatchSize = 100000;
+  Workspace ws;
+  auto* x = ws.CreateBlob("x")->GetMutable<TensorCPU>();
+  x->Resize(kRows, 4);
+  for (int i = 0; i < x->size(); ++i) {
+    x->mutable_data<float>()[i] = i;
+  }
+  auto* y = ws.CreateBlob("y")->GetMutable<TensorCPU>();
+  y->Resize(kRows);
+  for (int i = 0; i < kRows; ++i) {
+    y->mutable_data<int64_t>()[i] = -i;
+  }
+  const std::vector<std::string> fields = {"x", "y"};
+  createCursor(&ws, fields);
+  auto op = readNextBatch(&ws, fields, kBatchSize);
+
+  for (int batch = 0; batch < kRows / kBatchSize; ++batch) {
+    EXPECT_TRUE(op->Run());
+    const auto& x_batch = ws.GetBlob("x_batch")->Get<TensorCPU>();
+    const auto& y_batch = ws.GetBlob("y_batch")->Get<TensorCPU>();
+    ASSERT_EQ(x_batch.dims(), (std::vector<TIndex>{kBatchSize, 4}));
+    ASSERT_EQ(y_batch.size(), kBatchSize);
+    for (int i = 0; i < x_batch.size(); ++i) {
+      ASSERT_EQ(x_batch.data<float>()[i], batch * kBatchSize * 4 + i);
+    }
+    for (int i = 0; i < kBatchSize; ++i) {
+      ASSERT_EQ(y_batch.data<int64_t>()[i], -(batch * kBatchSize + i));
+    }
+  }
+  EXPECT_TRUE(op->Run());
+  EXPECT_EQ(ws.GetBlob("x_batch")->Get<TensorCPU>().size(), 0);
+}
+
+// A failed copy is rethrown once all the gather threads are done
+TEST(DatasetOpsTest, ParallelGatherFailure) {
+  const int kRows = 4 << 20;
+  Workspace ws;
+  auto* x = ws.CreateBlob("x")->GetMutable<TensorCPU>();
+  x->Resize(kRows);
+  x->mutable_data<ThrowingCopy>();
+  createCursor(&ws, {"x"});
+  auto op = readNextBatch(&ws, {"x"}, kRows);
+  EXPECT_THROW(op->Run(), std::runtime_error);
+}
+
+} // namespace caffe2
@@ -0,0 +1,96 @@
+#include "caffe2/operators/fused_rowwise_nbit_conversion_ops.h"
+#include "caffe2/core/registry.h"
+
+namespace caffe2 {
+
+namespace {
+const char kFloatToFusedNBitDoc[] = R"DOC(
+Applies {bits}-bit row-wise quantization by determining the range
+(maximum - minimum) and offset (minimum value) of each row in the input
+matrix, and then scaling each element to a {bits}-bit number between 0 and
+{max}. To later de-quantize values, the scale (range / {max}) and offset
+(bias) are stored alongside the data as 16-bit floats. More precisely, each
+row in the output matrix starts with the quantized values, packed {per_byte}
+per byte starting from the least significant bits, followed by 2 bytes
+storing the scale and 2 bytes storing the bias. Compared to
+FloatToFused8BitRowwiseQuantized, rows take about {per_byte} times less memory.
+Fails on rows whose minimum or scale exceed the range of 16-bit floats
+(65504 in absolute value).
+)DOC";
+
+const char kFusedNBitToFloatDoc[] = R"DOC(
+De-quantizes the result of the FloatToFused{bits}BitRowwiseQuantized
+operator. The input is expected to encode the scale as a 16-bit float in the
+second to the last 2 bytes of each row, followed by the bias as a 16-bit
+float in the last 2 bytes, and the quantized values packed {per_byte} per
+byte in the preceding bytes of the row. The output is a matrix containing
+only the values, but de-quantized. Rows whose number of values was not a
+multiple of {per_byte} come back with extra values, equal to the bias.
+De-quantization is performed by multiplying each value by its row's scale
+and adding its bias. The de-quantized values will thus not be exactly equal
+to the original, un-quantized floating point values.
+)DOC";
+
+std::function<void(OpSchema&)> FusedNBitDocGenerator(
+    const char* doc_template,
+    int bit_rate) {
+  return [=](OpSchema& schema) {
+    string doc = doc_template;
+    ReplaceAll(doc, "{bits}", caffe2::to_string(bit_rate).c_str());
+    ReplaceAll(doc, "{max}", caffe2::to_string((1 << bit_rate) - 1).c_str());
+    ReplaceAll(doc, "{per_byte}", caffe2::to_string(8 / bit_rate).c_str());
+    schema.SetDoc(doc);
+  };
+}
+} // namespace
+
+REGISTER_CPU_OPERATOR(
+    FloatToFused4BitRowwiseQuantized,
+    FloatToFusedNBitRowwiseQuantizedOp<4, CPUContext>);
+OPERATOR_SCHEMA(FloatToFused4BitRowwiseQuantized)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .FillUsing(FusedNBitDocGenerator(kFloatToFusedNBitDoc, 4))
+    .Input(0, "input", "Float32 input data")
+    .Output(0, "output", "Fused scale, bias and quantized data");
+NO_GRADIENT(FloatToFused4BitRowwiseQuantized);
+
+REGISTER_CPU_OPERATOR(
+    Fused4BitRowwiseQuantizedToFloat,
+    FusedNBitRowwiseQuantizedToFloatOp<4, CPUContext>);
+OPERATOR_SCHEMA(Fused4BitRowwiseQuantizedToFloat)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .FillUsing(FusedNBitDocGenerator(kFusedNBitToFloatDoc, 4))
+    .Input(
+        0,
+        "scale_bias_quantized_input",
+        "Fused scale, bias and quantized data")
+    .Output(0, "float_input", "Float32 data");
+NO_GRADIENT(Fused4BitRowwiseQuantizedToFloat);
+
+REGISTER_CPU_OPERATOR(
+    FloatToFused2BitRowwiseQuantized,
+    FloatToFusedNBitRowwiseQuantizedOp<2, CPUContext>);
+OPERATOR_SCHEMA(FloatToFused2BitRowwiseQuantized)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .FillUsing(FusedNBitDocGenerator(kFloatToFusedNBitDoc, 2))
+    .Input(0, "input", "Float32 input data")
+    .Output(0, "output", "Fused scale, bias and quantized data");
+NO_GRADIENT(FloatToFused2BitRowwiseQuantized);
+
+REGISTER_CPU_OPERATOR(
+    Fused2BitRowwiseQuantizedToFloat,
+    FusedNBitRowwiseQuantizedToFloatOp<2, CPUContext>);
+OPERATOR_SCHEMA(Fused2BitRowwiseQuantizedToFloat)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .FillUsing(FusedNBitDocGenerator(kFusedNBitToFloatDoc, 2))
+    .Input(
+        0,
+        "scale_bias_quantized_input",
+        "Fused scale, bias and quantized data")
+    .Output(0, "float_input", "Float32 data");
+NO_GRADIENT(Fused2BitRowwiseQuantizedToFloat);
+} // namespace caffe2
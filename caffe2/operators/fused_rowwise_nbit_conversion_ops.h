@@ -0,0 +1,83 @@
+#ifndef CAFFE2_OPERATORS_FUSED_ROWWISE_NBIT_CONVERSION_OPS_H_
+#define CAFFE2_OPERATORS_FUSED_ROWWISE_NBIT_CONVERSION_OPS_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/perfkernels/fused_nbit_rowwise_conversion.h"
+
+namespace caffe2 {
+
+template <int BIT_RATE, class Context>
+class FloatToFusedNBitRowwiseQuantizedOp : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(FloatToFusedNBitRowwiseQuantizedOp)
+
+  bool RunOnDevice() override {
+    const auto& input = Input(DATA_FLOAT);
+    auto* output = Output(DATA_FUSED_SCALE_BIAS);
+
+    CAFFE_ENFORCE_EQ(input.ndim(), 2, "Expect input to be a matrix");
+    const auto input_rows = input.dim(0);
+    const auto input_columns = input.dim(1);
+
+    // The "fused" representation stores the scale and bias with the row-wise
+    // quantized data in one tensor, see FloatToFusedNBitRowwiseQuantizedSBHalf.
+    const std::vector<TIndex> output_dimensions = {
+        input_rows, FusedNBitRowwiseColumns(BIT_RATE, input_columns)};
+    output->Resize(output_dimensions);
+
+    FloatToFusedNBitRowwiseQuantizedSBHalf(
+        BIT_RATE,
+        input.template data<float>(),
+        input_rows,
+        input_columns,
+        output->template mutable_data<uint8_t>());
+    return true;
+  }
+
+ private:
+  INPUT_TAGS(DATA_FLOAT);
+  OUTPUT_TAGS(DATA_FUSED_SCALE_BIAS);
+};
+
+template <int BIT_RATE, class Context>
+class FusedNBitRowwiseQuantizedToFloatOp : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(FusedNBitRowwiseQuantizedToFloatOp)
+
+  bool RunOnDevice() override {
+    const auto& input = Input(DATA_FUSED_SCALE_BIAS);
+    auto* output = Output(DATA_FLOAT);
+
+    CAFFE_ENFORCE_EQ(input.ndim(), 2, "Expect input to be a matrix");
+    const auto input_rows = input.dim(0);
+    const auto input_columns = input.dim(1);
+    CAFFE_ENFORCE_GE(input_columns, 4, "Rows must include scale and bias");
+
+    // The last 4 bytes per row are the scale and the bias. The rest of
+    // input_columns packs the values of the original row, rounded up to a
+    // multiple of 8 / BIT_RATE.
+    const std::vector<TIndex> output_dimensions = {
+        input_rows, FusedNBitRowwiseValues(BIT_RATE, input_columns)};
+    output->Resize(output_dimensions);
+
+    FusedNBitRowwiseQuantizedSBHalfToFloat(
+        BIT_RATE,
+        input.template data<uint8_t>(),
+        input_rows,
+        input_columns,
+        output->template mutable_data<float>());
+    return true;
+  }
+
+ private:
+  INPUT_TAGS(DATA_FUSED_SCALE_BIAS);
+  OUTPUT_TAGS(DATA_FLOAT);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_FUSED_ROWWISE_NBIT_CONVERSION_OPS_H_
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+template <typename T>
+void AddInput(
+    const vector<TIndex>& shape,
+    const vector<T>& values,
+    const string& name,
+    Workspace* ws) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(shape);
+  CAFFE_ENFORCE_EQ(tensor->size(), values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<T>());
+}
+
+void RunOp(
+    const string& type,
+    const vector<string>& inputs,
+    const string& output,
+    Workspace* ws) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output(output);
+  unique_ptr<OperatorBase> op(CreateOperator(def, ws));
+  ASSERT_NE(nullptr, op.get());
+  EXPECT_TRUE(op->Run());
+}
+
+const TensorCPU& GetOutput(const string& name, Workspace* ws) {
+  return ws->GetBlob(name)->Get<TensorCPU>();
+}
+
+vector<float> RandomMatrix(int rows, int columns, std::mt19937* gen) {
+  std::uniform_real_distribution<float> dist(-2.f, 3.f);
+  vector<float> values(rows * columns);
+  for (auto& value : values) {
+    value = dist(*gen);
+  }
+  // A constant row
+  std::fill(values.begin(), values.begin() + columns, 0.5f);
+  return values;
+}
+
+// Quantizes a random matrix into the "data" blob and dequantizes it back into
+// the "dequantized" blob. The original values are returned in values.
+void Quantize(
+    int bits,
+    int rows,
+    int columns,
+    std::mt19937* gen,
+    vector<float>* values,
+    Workspace* ws) {
+  const string bits_str = caffe2::to_string(bits);
+  *values = RandomMatrix(rows, columns, gen);
+  AddInput<float>({rows, columns}, *values, "float", ws);
+  RunOp(
+      "FloatToFused" + bits_str + "BitRowwiseQuantized",
+      {"float"},
+      "data",
+      ws);
+  RunOp(
+      "Fused" + bits_str + "BitRowwiseQuantizedToFloat",
+      {"data"},
+      "dequantized",
+      ws);
+}
+
+} // namespace
+
+TEST(FusedNBitRowwiseOpsTest, RoundTrip) {
+  std::mt19937 gen(0);
+  for (int bits : {4, 2}) {
+    for (int columns : {1, 13, 16, 64}) {
+      Workspace ws;
+      const int rows = 5;
+      vector<float> values;
+      Quantize(bits, rows, columns, &gen, &values, &ws);
+
+      const int per_byte = 8 / bits;
+      const int padded_columns = (columns + per_byte - 1) / per_byte * per_byte;
+      const auto& data = GetOutput("data", &ws);
+      EXPECT_EQ(data.dim(1), padded_columns / per_byte + 4);
+      const auto& dequantized = GetOutput("dequantized", &ws);
+      ASSERT_EQ(dequantized.dim(0), rows);
+      ASSERT_EQ(dequantized.dim(1), padded_columns);
+
+      for (int row = 0; row < rows; ++row) {
+        const float* begin = values.data() + row * columns;
+        const auto minmax = std::minmax_element(begin, begin + columns);
+        // Half a quantization step, plus the rounding of the fp16 scale and
+        // bias
+        const float tolerance =
+            (*minmax.second - *minmax.first) / ((1 << bits) - 1) / 2 +
+            1e-2f * std::max(std::fabs(*minmax.first), 1.f);
+        for (int col = 0; col < columns; ++col) {
+          EXPECT_NEAR(
+              dequantized.data<float>()[row * padded_columns + col],
+              begin[col],
+              tolerance)
+              << bits << " bits, row " << row << " column " << col;
+        }
+      }
+    }
+  }
+}
+
+// The scale and bias are 16-bit floats, whose largest value is 65504
+TEST(FusedNBitRowwiseOpsTest, RangeOverflow) {
+  const vector<vector<float>> overflowing = {
+      {0.f, 1e6f}, {-7e4f, -6.9e4f}, {-1e38f, 1e38f}};
+  for (const auto& row : overflowing) {
+    Workspace ws;
+    AddInput<float>({1, 2}, row, "float", &ws);
+    OperatorDef def;
+    def.set_type("FloatToFused4BitRowwiseQuantized");
+    def.add_input("float");
+    def.add_output("data");
+    EXPECT_THROW(CreateOperator(def, &ws)->Run(), EnforceNotMet);
+  }
+
+  // A range of 15 * 60000 still fits with 4 bits
+  Workspace ws;
+  AddInput<float>({1, 3}, {-6e4f, 0.f, 8.4e5f}, "float", &ws);
+  RunOp("FloatToFused4BitRowwiseQuantized", {"float"}, "data", &ws);
+  RunOp("Fused4BitRowwiseQuantizedToFloat", {"data"}, "dequantized", &ws);
+  const auto& dequantized = GetOutput("dequantized", &ws);
+  EXPECT_NEAR(dequantized.data<float>()[0], -6e4f, 1e2f);
+  EXPECT_NEAR(dequantized.data<float>()[2], 8.4e5f, 1e3f);
+}
+
+TEST(FusedNBitRowwiseOpsTest, SparseLengthsReducers) {
+  std::mt19937 gen(1);
+  for (int bits : {4, 2}) {
+    for (int columns : {3, 16, 40, 128}) {
+      Workspace ws;
+      const int rows = 20;
+      vector<float> values;
+      Quantize(bits, rows, columns, &gen, &values, &ws);
+      const auto& dequantized = GetOutput("dequantized", &ws);
+      const int block_size = dequantized.dim(1);
+
+      const vector<int> lengths = {3, 0, 1, 6, 2};
+      vector<int64_t> indices;
+      vector<float> weights;
+      std::uniform_int_distribution<int64_t> row(0, rows - 1);
+      std::uniform_real_distribution<float> weight(-1.f, 1.f);
+      for (int i = 0; i < 12; ++i) {
+        indices.push_back(row(gen));
+        weights.push_back(weight(gen));
+      }
+      AddInput<int>({5}, lengths, "lengths", &ws);
+      AddInput<int64_t>({12}, indices, "indices", &ws);
+      AddInput<int32_t>(
+          {12},
+          vector<int32_t>(indices.begin(), indices.end()),
+          "indices32",
+          &ws);
+      AddInput<float>({12}, weights, "weights", &ws);
+
+      for (const string reducer : {"Sum", "WeightedSum", "Mean"}) {
+        for (const string index_blob : {"indices", "indices32"}) {
+          const string op = "SparseLengths" + reducer + "Fused" +
+              caffe2::to_string(bits) + "BitRowwise";
+          if (reducer == "WeightedSum") {
+            RunOp(op, {"data", "weights", index_blob, "lengths"}, "out", &ws);
+          } else {
+            RunOp(op, {"data", index_blob, "lengths"}, "out", &ws);
+          }
+          const auto& out = GetOutput("out", &ws);
+          ASSERT_EQ(out.dim(0), lengths.size());
+          ASSERT_EQ(out.dim(1), block_size);
+
+          int pos = 0;
+          for (int segment = 0; segment < lengths.size(); ++segment) {
+            vector<float> expected(block_size, 0.f);
+            for (int i = 0; i < lengths[segment]; ++i, ++pos) {
+              const float w = reducer == "WeightedSum" ? weights[pos] : 1.f;
+              for (int k = 0; k < block_size; ++k) {
+                expected[k] += w *
+                    dequantized.data<float>()[indices[pos] * block_size + k];
+              }
+            }
+            for (int k = 0; k < block_size; ++k) {
+              if (reducer == "Mean" && lengths[segment]) {
+                expected[k] /= lengths[segment];
+              }
+              EXPECT_NEAR(
+                  out.data<float>()[segment * block_size + k],
+                  expected[k],
+                  1e-4f * (1 + std::fabs(expected[k])))
+                  << op << " " << index_blob << ", segment " << segment
+                  << " column " << k;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(FusedNBitRowwiseOpsTest, Gather) {
+  std::mt19937 gen(2);
+  for (int bits : {4, 2}) {
+    Workspace ws;
+    const int rows = 10;
+    const int columns = 21;
+    vector<float> values;
+    Quantize(bits, rows, columns, &gen, &values, &ws);
+    const auto& dequantized = GetOutput("dequantized", &ws);
+    const int block_size = dequantized.dim(1);
+
+    const vector<int32_t> indices = {9, 0, 3, 3};
+    AddInput<int32_t>({4}, indices, "indices", &ws);
+    RunOp(
+        "GatherFused" + caffe2::to_string(bits) + "BitRowwise",
+        {"data", "indices"},
+        "out",
+        &ws);
+    const auto& out = GetOutput("out", &ws);
+    ASSERT_EQ(out.dim(0), indices.size());
+    ASSERT_EQ(out.dim(1), block_size);
+    for (int i = 0; i < indices.size(); ++i) {
+      for (int k = 0; k < block_size; ++k) {
+        EXPECT_EQ(
+            out.data<float>()[i * block_size + k],
+            dequantized.data<float>()[indices[i] * block_size + k]);
+      }
+    }
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,77 @@
+#include "caffe2/operators/gather_fused_nbit_rowwise_op.h"
+
+namespace caffe2 {
+
+OPERATOR_SCHEMA(GatherFused4BitRowwise)
+    .NumInputs(2)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+Perform the same operation as Gather, but operating on 4-bit rowwise quantized
+matrices with fused storage (where each row stores quantized values, and then
+the scale and offset as 16-bit floats). The gathered rows are de-quantized.
+DATA needs to have rank 2 and INDICES needs to have rank 1.
+)DOC")
+    .Input(
+        0,
+        "DATA",
+        "uint8 tensor with rank 2 obtained with operator "
+        "FloatToFused4BitRowwiseQuantized")
+    .Input(
+        1,
+        "INDICES",
+        "Integer vector containing indices of the first dimension of DATA for "
+        "the rows that are being gathered")
+    .Output(0, "OUTPUT", "output")
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(1);
+      for (auto d : in[1].dims()) {
+        out[0].add_dims(d);
+      }
+      out[0].add_dims(FusedNBitRowwiseValues(4, in[0].dims(1)));
+      out[0].set_data_type(TensorProto::FLOAT);
+      return out;
+    });
+NO_GRADIENT(GatherFused4BitRowwise);
+
+REGISTER_CPU_OPERATOR(
+    GatherFused4BitRowwise,
+    GatherFusedNBitRowwiseOp<4, CPUContext>);
+
+OPERATOR_SCHEMA(GatherFused2BitRowwise)
+    .NumInputs(2)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+Perform the same operation as Gather, but operating on 2-bit rowwise quantized
+matrices with fused storage (where each row stores quantized values, and then
+the scale and offset as 16-bit floats). The gathered rows are de-quantized.
+DATA needs to have rank 2 and INDICES needs to have rank 1.
+)DOC")
+    .Input(
+        0,
+        "DATA",
+        "uint8 tensor with rank 2 obtained with operator "
+        "FloatToFused2BitRowwiseQuantized")
+    .Input(
+        1,
+        "INDICES",
+        "Integer vector containing indices of the first dimension of DATA for "
+        "the rows that are being gathered")
+    .Output(0, "OUTPUT", "output")
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(1);
+      for (auto d : in[1].dims()) {
+        out[0].add_dims(d);
+      }
+      out[0].add_dims(FusedNBitRowwiseValues(2, in[0].dims(1)));
+      out[0].set_data_type(TensorProto::FLOAT);
+      return out;
+    });
+NO_GRADIENT(GatherFused2BitRowwise);
+
+REGISTER_CPU_OPERATOR(
+    GatherFused2BitRowwise,
+    GatherFusedNBitRowwiseOp<2, CPUContext>);
+
+} // namespace caffe2
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "caffe2/core/operator.h"
+#include "caffe2/perfkernels/fused_nbit_rowwise_conversion.h"
+
+namespace caffe2 {
+
+template <int BIT_RATE, class Context>
+class GatherFusedNBitRowwiseOp : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(GatherFusedNBitRowwiseOp);
+
+  bool RunOnDevice() override {
+    return DispatchHelper<TensorTypes<int32_t, int64_t>>::call(
+        this, OperatorBase::Input<TensorCPU>(INDICES));
+  }
+
+  template <typename Index>
+  bool DoRunWithType() {
+    const auto& data = Input(DATA);
+    const auto& indices = Input(INDICES);
+    auto* output = Output(0);
+
+    CAFFE_ENFORCE_EQ(data.ndim(), 2, "DATA must be a matrix");
+    CAFFE_ENFORCE_EQ(indices.ndim(), 1, "INDICES must be a vector");
+    CAFFE_ENFORCE_GT(data.dim(1), 4, "DATA must have more than 4 columns");
+    // The packed values are followed by 2 bytes for scale and 2 bytes for
+    // bias in the fused representation (per row).
+    const std::vector<TIndex> shape = {
+        indices.dim(0), FusedNBitRowwiseValues(BIT_RATE, data.dim(1))};
+    output->Resize(shape);
+
+    const auto block_bytesize = data.dim(1);
+    const int N = indices.size();
+
+    const uint8_t* src_base = data.template data<uint8_t>();
+    const Index* idxs = indices.template data<Index>();
+    auto out = output->template mutable_data<float>();
+
+    for (int i = 0; i < N; ++i) {
+      auto idx = idxs[i];
+      CAFFE_ENFORCE(
+          0 <= idx && idx < data.dim(0),
+          "INDICES element is out of DATA bounds, id=",
+          idx,
+          " data_dim=",
+          data.dim(0));
+      FusedNBitRowwiseQuantizedSBHalfToFloat(
+          BIT_RATE,
+          src_base + idx * block_bytesize,
+          1,
+          block_bytesize,
+          out + i * shape[1]);
+    }
+    return true;
+  }
+
+  INPUT_TAGS(DATA, INDICES);
+};
+
+} // namespace caffe2
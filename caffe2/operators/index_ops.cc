@@ -2,7 +2,7 @@
 #include <limits>
 #include <mutex>
 #include <sstream>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/operator.h"
@@ -12,6 +12,28 @@ namespace caffe2 {
 namespace {
 using IndexKeyTypes = TensorTypes<int32_t, int64_t, std::string>;
 using TIndexValue = int64_t;
+
+// Number of keys ahead whose slot is prefetched by batched lookups
+const size_t kIndexPrefetchDistance = 8;
+
+// std::hash is the identity for integers, so its bits are mixed to avoid
+// long probe sequences for ids sharing their low bits
+template <typename T>
+inline size_t IndexHash(const T& key) {
+  uint64_t h = std::hash<T>()(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+inline void IndexPrefetch(const void* p) {
+#ifdef __GNUC__
+  __builtin_prefetch(p);
+#endif
+}
 }  // namespace
 
 struct IndexBase {
@@ -21,7 +43,7 @@ struct IndexBase {
     , meta_(type)
     , frozen_{false} {}
 
-  void Freeze() { frozen_ = true; }
+  virtual void Freeze() { frozen_ = true; }
 
   bool isFrozen() const {
     return frozen_;
@@ -36,40 +58,73 @@ struct IndexBase {
   const TypeMeta& Type() const { return meta_; }
 
   TIndexValue Size() {
-    std::lock_guard<std::mutex> guard(dictMutex_);
     return nextId_;
   }
 
  protected:
   int64_t maxElements_;
   TypeMeta meta_;
-  TIndexValue nextId_{1}; // guarded by dictMutex_
+  std::atomic<TIndexValue> nextId_{1};
   std::atomic<bool> frozen_{false};
-  std::mutex dictMutex_;
 };
 
+/**
+ * Open addressing hash table with linear probing. Lookups of existing keys
+ * never lock. Misses insert the key concurrently with other inserts by
+ * claiming an empty slot with a compare-and-swap. The table doubles in size
+ * when half full, while inserts are blocked.
+ *
+ * Freezing the index moves the keys to a plain read-only table, and frees
+ * the concurrent one.
+ *
+ * Instead of locking, lookups register in the current reader epoch. A table
+ * replaced by a resize, a freeze or a load is freed once the lookups of the
+ * epoch it was replaced in are done, since they may still be reading it.
+ */
 template<typename T>
 struct Index: IndexBase {
   explicit Index(TIndexValue maxElements)
-    : IndexBase(maxElements, TypeMeta::Make<T>()) {}
+    : IndexBase(maxElements, TypeMeta::Make<T>()),
+      table_(new Table(kMinCapacity)) {
+    readers_[0] = 0;
+    readers_[1] = 0;
+  }
+
+  ~Index() override {
+    delete table_.load();
+    delete frozenTable_.load();
+  }
 
   void Get(const T* keys, TIndexValue* values, size_t numKeys) {
-    if (frozen_) {
-      FrozenGet(keys, values, numKeys);
-      return;
+    ReadGuard read(this);
+    // Hashes of the next keys, whose slots are being prefetched
+    size_t hashes[kIndexPrefetchDistance];
+    for (size_t i = 0; i < std::min(numKeys, kIndexPrefetchDistance); ++i) {
+      hashes[i] = IndexHash(keys[i]);
+      IndexPrefetch(HomeSlot(hashes[i]));
     }
-    std::lock_guard<std::mutex> lock(dictMutex_);
-    for (int i = 0; i < numKeys; ++i) {
-      auto it = dict_.find(keys[i]);
-      if (it != dict_.end()) {
-        values[i] = it->second;
-      } else if (nextId_ < maxElements_) {
-        auto newValue = nextId_++;
-        dict_.insert({keys[i], newValue});
-        values[i] = newValue;
-      } else {
-        CAFFE_THROW("Dict max size reached");
+    for (size_t i = 0; i < numKeys; ++i) {
+      const size_t hash = hashes[i % kIndexPrefetchDistance];
+      if (i + kIndexPrefetchDistance < numKeys) {
+        const size_t next = IndexHash(keys[i + kIndexPrefetchDistance]);
+        hashes[i % kIndexPrefetchDistance] = next;
+        IndexPrefetch(HomeSlot(next));
+      }
+      const FrozenTable* frozen = frozenTable_.load(std::memory_order_acquire);
+      if (frozen) {
+        values[i] = FrozenFind(*frozen, keys[i], hash);
+        continue;
+      }
+      const auto value =
+          Find(*table_.load(std::memory_order_acquire), keys[i], hash);
+      if (value > 0) {
+        values[i] = value;
+        continue;
       }
+      // The insert may wait for a resize, which waits for the readers
+      read.Leave();
+      values[i] = Insert(keys[i], hash);
+      read.Enter();
     }
   }
 
@@ -77,44 +132,359 @@ struct Index: IndexBase {
     CAFFE_ENFORCE(
         numKeys <= maxElements_,
         "Cannot load index: Tensor is larger than max_elements.");
-    decltype(dict_) dict;
+    std::unique_ptr<Table> table(new Table(CapacityFor(numKeys)));
     for (int i = 0; i < numKeys; ++i) {
       CAFFE_ENFORCE(
-          dict.insert({keys[i], i + 1}).second,
+          InsertInto(*table, keys[i], IndexHash(keys[i]), i + 1) == i + 1,
           "Repeated elements found: cannot load into dictionary.");
     }
-    // assume no `get` is inflight while this happens
-    {
-      std::lock_guard<std::mutex> lock(dictMutex_);
-      // let the old dict get destructed outside of the lock
-      dict_.swap(dict);
-      nextId_ = numKeys + 1;
+    ExclusiveGuard guard(this);
+    std::unique_ptr<Table> oldTable;
+    std::unique_ptr<FrozenTable> oldFrozen;
+    if (frozen_) {
+      oldFrozen.reset(
+          frozenTable_.exchange(BuildFrozen(*table, numKeys).release()));
+    } else {
+      oldTable.reset(table_.exchange(table.release()));
     }
+    nextId_ = numKeys + 1;
+    WaitForReaders();
     return true;
   }
 
   template<typename Ctx>
   bool Store(Tensor<Ctx>* out) {
-    std::lock_guard<std::mutex> lock(dictMutex_);
+    ExclusiveGuard guard(this);
     out->Resize(nextId_ - 1);
     auto outData = out->template mutable_data<T>();
-    for (const auto& entry : dict_) {
-      outData[entry.second - 1] = entry.first;
+    if (frozen_) {
+      for (const auto& slot : frozenTable_.load()->slots) {
+        if (slot.value > 0) {
+          outData[slot.value - 1] = slot.key;
+        }
+      }
+      return true;
+    }
+    const Table& table = *table_;
+    for (size_t i = 0; i < table.capacity(); ++i) {
+      const auto value = table.slots[i].value.load();
+      if (value > 0) {
+        outData[value - 1] = table.slots[i].key;
+      }
     }
     return true;
   }
 
+  void Freeze() override {
+    ExclusiveGuard guard(this);
+    if (frozen_) {
+      return;
+    }
+    // Lookups switch to the frozen table as soon as it is published, and
+    // inserts waiting for the guard find the concurrent one gone
+    frozenTable_.store(BuildFrozen(*table_, nextId_ - 1).release());
+    frozen_ = true;
+    WaitForReaders();
+    delete table_.exchange(nullptr);
+  }
+
  private:
-  void FrozenGet(const T* keys, TIndexValue* values, size_t numKeys) {
-    for (int i = 0; i < numKeys; ++i) {
-      auto it = dict_.find(keys[i]);
-      values[i] = it != dict_.end() ? it->second : 0;
+  // Value of the slots whose key is being written
+  static constexpr TIndexValue kBusySlot = -1;
+  static constexpr size_t kMinCapacity = 64;
+
+  struct Slot {
+    T key;
+    // 0 while the slot is empty
+    std::atomic<TIndexValue> value{0};
+  };
+
+  struct Table {
+    explicit Table(size_t capacity)
+        : slots(new Slot[capacity]), mask(capacity - 1) {}
+
+    size_t capacity() const {
+      return mask + 1;
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    const size_t mask;
+  };
+
+  struct FrozenSlot {
+    T key;
+    TIndexValue value{0};
+  };
+
+  struct FrozenTable {
+    explicit FrozenTable(size_t capacity)
+        : slots(capacity), mask(capacity - 1) {}
+
+    std::vector<FrozenSlot> slots;
+    const size_t mask;
+  };
+
+  // Registers a lookup in the current reader epoch, so that the tables it
+  // reads are not freed until it leaves
+  struct ReadGuard {
+    explicit ReadGuard(Index* index) : index_(index) {
+      Enter();
+    }
+    ~ReadGuard() {
+      if (entered_) {
+        Leave();
+      }
+    }
+
+    void Enter() {
+      while (true) {
+        epoch_ = index_->epoch_.load();
+        ++index_->readers_[epoch_ & 1];
+        // If the epoch changed meanwhile, the lookup may not be waited for
+        if (index_->epoch_.load() == epoch_) {
+          break;
+        }
+        --index_->readers_[epoch_ & 1];
+      }
+      entered_ = true;
+    }
+
+    void Leave() {
+      --index_->readers_[epoch_ & 1];
+      entered_ = false;
+    }
+
+   private:
+    Index* index_;
+    size_t epoch_;
+    bool entered_{false};
+  };
+
+  // Registers an insert, after waiting for the end of any resize
+  struct InsertGuard {
+    explicit InsertGuard(Index* index) : index_(index) {
+      while (true) {
+        ++index_->inserters_;
+        if (!index_->resizing_) {
+          break;
+        }
+        --index_->inserters_;
+        std::lock_guard<std::mutex> wait(index_->resizeMutex_);
+      }
+      table = index_->table_;
+    }
+    ~InsertGuard() {
+      --index_->inserters_;
+    }
+
+    // nullptr once the index is frozen
+    Table* table;
+
+   private:
+    Index* index_;
+  };
+
+  // Blocks inserts, after waiting for the end of the running ones. Lookups
+  // are not blocked.
+  struct ExclusiveGuard {
+    explicit ExclusiveGuard(Index* index)
+        : index_(index), lock_(index->resizeMutex_) {
+      index_->resizing_ = true;
+      while (index_->inserters_ > 0) {
+        std::this_thread::yield();
+      }
+    }
+    ~ExclusiveGuard() {
+      index_->resizing_ = false;
+    }
+
+   private:
+    Index* index_;
+    std::lock_guard<std::mutex> lock_;
+  };
+
+  // Called under an ExclusiveGuard after replacing a table. Lookups entering
+  // from now on are counted in the next epoch and see the new table, so the
+  // replaced one can be freed once those of the current epoch are done.
+  void WaitForReaders() {
+    const size_t epoch = epoch_++;
+    while (readers_[epoch & 1] > 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Smallest capacity keeping the table at most half full
+  static size_t CapacityFor(size_t numKeys) {
+    size_t capacity = kMinCapacity;
+    while (capacity <= 2 * numKeys) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  const void* HomeSlot(size_t hash) const {
+    const FrozenTable* frozen = frozenTable_.load(std::memory_order_acquire);
+    if (frozen) {
+      return &frozen->slots[hash & frozen->mask];
+    }
+    const Table* table = table_.load(std::memory_order_acquire);
+    return &table->slots[hash & table->mask];
+  }
+
+  // Returns 0 if the key is not in the table
+  static TIndexValue Find(const Table& table, const T& key, size_t hash) {
+    size_t i = hash & table.mask;
+    for (size_t probes = 0; probes < table.capacity(); ++probes) {
+      const Slot& slot = table.slots[i];
+      auto value = slot.value.load(std::memory_order_acquire);
+      while (value == kBusySlot) {
+        std::this_thread::yield();
+        value = slot.value.load(std::memory_order_acquire);
+      }
+      if (value == 0) {
+        return 0;
+      }
+      if (slot.key == key) {
+        return value;
+      }
+      i = (i + 1) & table.mask;
+    }
+    return 0;
+  }
+
+  static TIndexValue
+  FrozenFind(const FrozenTable& table, const T& key, size_t hash) {
+    for (size_t i = hash & table.mask;; i = (i + 1) & table.mask) {
+      const FrozenSlot& slot = table.slots[i];
+      if (slot.value == 0 || slot.key == key) {
+        return slot.value;
+      }
+    }
+  }
+
+  TIndexValue Insert(const T& key, size_t hash) {
+    while (true) {
+      Table* full;
+      {
+        InsertGuard guard(this);
+        full = guard.table;
+        if (!full) {
+          // Frozen meanwhile. The frozen table is only replaced by Load,
+          // which waits for the inserts.
+          return FrozenFind(*frozenTable_.load(), key, hash);
+        }
+        if (2 * nextId_ < full->capacity()) {
+          const auto value = InsertInto(*full, key, hash, 0);
+          CAFFE_ENFORCE(value != kBusySlot, "Dict max size reached");
+          if (value > 0) {
+            return value;
+          }
+        }
+      }
+      Grow(full);
     }
   }
 
-  std::unordered_map<T, TIndexValue> dict_;
+  // Returns the value of the key, inserting it with the given value, or a
+  // new id if 0, when missing. Returns kBusySlot if no new id is left, and 0
+  // if the table is full.
+  TIndexValue
+  InsertInto(Table& table, const T& key, size_t hash, TIndexValue id) {
+    size_t i = hash & table.mask;
+    for (size_t probes = 0; probes < table.capacity(); ++probes) {
+      Slot& slot = table.slots[i];
+      auto value = slot.value.load(std::memory_order_acquire);
+      while (value == 0 || value == kBusySlot) {
+        if (value == kBusySlot) {
+          std::this_thread::yield();
+          value = slot.value.load(std::memory_order_acquire);
+        } else if (slot.value.compare_exchange_weak(value, kBusySlot)) {
+          value = id ? id : NextId();
+          if (value == 0) {
+            slot.value.store(0, std::memory_order_release);
+            return kBusySlot;
+          }
+          slot.key = key;
+          slot.value.store(value, std::memory_order_release);
+          return value;
+        }
+      }
+      if (slot.key == key) {
+        return value;
+      }
+      i = (i + 1) & table.mask;
+    }
+    return 0;
+  }
+
+  // Returns 0 if max_elements is reached
+  TIndexValue NextId() {
+    auto id = nextId_.load();
+    do {
+      if (id >= maxElements_) {
+        return 0;
+      }
+    } while (!nextId_.compare_exchange_weak(id, id + 1));
+    return id;
+  }
+
+  void Grow(Table* full) {
+    ExclusiveGuard guard(this);
+    if (table_ != full) {
+      // Another thread grew it already, or the index was frozen or loaded
+      return;
+    }
+    std::unique_ptr<Table> table(new Table(2 * full->capacity()));
+    for (size_t i = 0; i < full->capacity(); ++i) {
+      const auto& slot = full->slots[i];
+      const auto value = slot.value.load();
+      if (value > 0) {
+        InsertInto(*table, slot.key, IndexHash(slot.key), value);
+      }
+    }
+    table_.store(table.release(), std::memory_order_release);
+    WaitForReaders();
+    delete full;
+  }
+
+  std::unique_ptr<FrozenTable> BuildFrozen(
+      const Table& table,
+      size_t numKeys) {
+    std::unique_ptr<FrozenTable> frozen(
+        new FrozenTable(CapacityFor(numKeys)));
+    for (size_t i = 0; i < table.capacity(); ++i) {
+      const auto& slot = table.slots[i];
+      const auto value = slot.value.load();
+      if (value > 0) {
+        size_t j = IndexHash(slot.key) & frozen->mask;
+        while (frozen->slots[j].value != 0) {
+          j = (j + 1) & frozen->mask;
+        }
+        frozen->slots[j].key = slot.key;
+        frozen->slots[j].value = value;
+      }
+    }
+    return frozen;
+  }
+
+  // Exactly one of them is set, depending on whether the index is frozen
+  std::atomic<Table*> table_;
+  std::atomic<FrozenTable*> frozenTable_{nullptr};
+
+  std::mutex resizeMutex_;
+  std::atomic<bool> resizing_{false};
+  std::atomic<int> inserters_{0};
+
+  // Lookups running in the even and odd reader epochs
+  std::atomic<size_t> epoch_{0};
+  std::atomic<int> readers_[2];
 };
 
+template <typename T>
+constexpr TIndexValue Index<T>::kBusySlot;
+template <typename T>
+constexpr size_t Index<T>::kMinCapacity;
+
 // TODO(azzolini): support sizes larger than int32
 template<class T>
 class IndexCreateOp: public Operator<CPUContext> {
@@ -289,7 +659,7 @@ OPERATOR_SCHEMA(IndexFreeze)
     .NumOutputs(1)
     .SetDoc(R"DOC(
 Freezes the given index, disallowing creation of new index entries.
-Should not be called concurrently with IndexGet.
+Can run concurrently with IndexGet: no entry is added once it returns.
 )DOC")
     .Input(0, "handle", "Pointer to an Index instance.")
     .Output(0, "handle", "The input handle.")
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+
+namespace caffe2 {
+
+namespace {
+
+const int kThreads = 8;
+
+void runOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  EXPECT_TRUE(CreateOperator(def, ws)->Run());
+}
+
+// Op looking up the keys of blob name in the index into name + "_ids"
+std::unique_ptr<OperatorBase> indexGet(Workspace* ws, const std::string& name) {
+  ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  OperatorDef def;
+  def.set_type("IndexGet");
+  def.add_input("index");
+  def.add_input(name);
+  def.add_output(name + "_ids");
+  return CreateOperator(def, ws);
+}
+
+std::vector<int64_t> get(
+    Workspace* ws,
+    OperatorBase* op,
+    const std::string& name,
+    const std::vector<int64_t>& keys) {
+  auto* tensor = ws->GetBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(keys.size());
+  std::copy(keys.begin(), keys.end(), tensor->mutable_data<int64_t>());
+  EXPECT_TRUE(op->Run());
+  const auto& ids = ws->GetBlob(name + "_ids")->Get<TensorCPU>();
+  return std::vector<int64_t>(
+      ids.data<int64_t>(), ids.data<int64_t>() + ids.size());
+}
+
+int64_t indexSize(Workspace* ws) {
+  runOp(ws, "IndexSize", {"index"}, {"size"});
+  return *ws->GetBlob("size")->Get<TensorCPU>().data<int64_t>();
+}
+
+} // namespace
+
+// Threads inserting the same keys in different orders, growing the table
+// from its minimum capacity, agree on one id per key
+TEST(IndexOpsTest, ConcurrentGetGrowsTable) {
+  const int kKeys = 200000;
+  const int kBatchSize = 1000;
+  Workspace ws;
+  runOp(&ws, "LongIndexCreate", {}, {"index"});
+  std::vector<std::unique_ptr<OperatorBase>> ops;
+  for (int t = 0; t < kThreads; ++t) {
+    ops.push_back(indexGet(&ws, "keys_" + caffe2::to_string(t)));
+  }
+
+  std::vector<std::vector<int64_t>> ids(
+      kThreads, std::vector<int64_t>(kKeys));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      const auto name = "keys_" + caffe2::to_string(t);
+      for (int begin = 0; begin < kKeys; begin += kBatchSize) {
+        std::vector<int64_t> keys;
+        for (int i = begin; i < begin + kBatchSize; ++i) {
+          // Threads walk the keys in opposite directions from shifted starts
+          const int64_t offset = (i + t * (kKeys / kThreads)) % kKeys;
+          keys.push_back(t % 2 ? kKeys - 1 - offset : offset);
+        }
+        const auto batch = get(&ws, ops[t].get(), name, keys);
+        for (int i = 0; i < kBatchSize; ++i) {
+          ids[t][keys[i]] = batch[i];
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int t = 1; t < kThreads; ++t) {
+    EXPECT_EQ(ids[0], ids[t]);
+  }
+  auto sorted = ids[0];
+  std::sort(sorted.begin(), sorted.end());
+  for (int i = 0; i < kKeys; ++i) {
+    ASSERT_EQ(i + 1, sorted[i]);
+  }
+  EXPECT_EQ(kKeys + 1, indexSize(&ws));
+}
+
+// Lookups running while the index is frozen keep finding the known keys, and
+// no key is added once the freeze returned
+TEST(IndexOpsTest, ConcurrentGetAndFreeze) {
+  const int kKnownKeys = 50000;
+  const int kBatchSize = 512;
+  Workspace ws;
+  runOp(&ws, "LongIndexCreate", {}, {"index"});
+  std::vector<int64_t> known(kKnownKeys);
+  for (int i = 0; i < kKnownKeys; ++i) {
+    known[i] = i;
+  }
+  auto load = indexGet(&ws, "known");
+  const auto knownIds = get(&ws, load.get(), "known", known);
+  std::vector<std::unique_ptr<OperatorBase>> ops;
+  for (int t = 0; t < kThreads; ++t) {
+    ops.push_back(indexGet(&ws, "keys_" + caffe2::to_string(t)));
+  }
+
+  std::atomic<bool> frozen{false};
+  std::atomic<int> running{0};
+  std::vector<std::vector<int64_t>> addedAfterFreeze(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      const auto name = "keys_" + caffe2::to_string(t);
+      ++running;
+      int64_t next = kKnownKeys + t;
+      // Keep looking up for a few batches after the freeze
+      for (int after = 0; after < 20;) {
+        const bool wasFrozen = frozen;
+        std::vector<int64_t> keys;
+        for (int i = 0; i < kBatchSize; ++i) {
+          // Known keys interleaved with new ones
+          if (i % 2) {
+            keys.push_back((next * 7 + i) % kKnownKeys);
+          } else {
+            keys.push_back(next);
+            next += kThreads;
+          }
+        }
+        const auto batch = get(&ws, ops[t].get(), name, keys);
+        for (int i = 0; i < kBatchSize; ++i) {
+          if (keys[i] < kKnownKeys) {
+            EXPECT_EQ(knownIds[keys[i]], batch[i]);
+          } else if (wasFrozen && batch[i] != 0) {
+            addedAfterFreeze[t].push_back(keys[i]);
+          }
+        }
+        if (wasFrozen) {
+          ++after;
+        }
+      }
+    });
+  }
+  while (running < kThreads) {
+    std::this_thread::yield();
+  }
+  runOp(&ws, "IndexFreeze", {"index"}, {"index"});
+  frozen = true;
+  const auto size = indexSize(&ws);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int t = 0; t < kThreads; ++t) {
+    EXPECT_TRUE(addedAfterFreeze[t].empty());
+  }
+  EXPECT_EQ(size, indexSize(&ws));
+  runOp(&ws, "IndexStore", {"index"}, {"stored"});
+  const auto& stored = ws.GetBlob("stored")->Get<TensorCPU>();
+  EXPECT_EQ(size - 1, stored.size());
+  for (int i = 0; i < kKnownKeys; ++i) {
+    EXPECT_EQ(known[i], stored.data<int64_t>()[knownIds[i] - 1]);
+  }
+}
+
+} // namespace caffe2
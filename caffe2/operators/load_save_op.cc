@@ -41,6 +41,15 @@ entries with the outputs.
 If an input is passed, then it is assumed that that input blob is a
 DBReader to load from, and we ignore the db and db_type arguments.
 
+If db_type is "mmap", the db is a checkpoint written by Save with the same
+db_type. It is memory mapped and the loaded CPU tensors share the mapping
+instead of being deserialized; writing into them does not modify the file.
+
+Incremental checkpoints written by Save with incremental_blobs are loaded by
+passing the full checkpoint as db and the following ones, in order, as
+delta_dbs. The updated rows stored in each delta are written in place into the
+tensors loaded before.
+
 )DOC")
     .Arg(
         "absolute_path",
@@ -76,7 +85,17 @@ DBReader to load from, and we ignore the db and db_type arguments.
         "source_blob_names",
         "(list of strings) if set, used instead of output "
         "blob names, to specify which blobs in the db shall be loaded. Must be "
-        "the same length as number of output blobs.");
+        "the same length as number of output blobs.")
+    .Arg(
+        "delta_dbs",
+        "(list of strings) dbs of the same db_type that are applied in order "
+        "after loading db, typically incremental checkpoints saved after it.")
+    .Arg(
+        "keep_fused_8bit_rowwise",
+        "(bool, default false) if true, float matrices saved with row-wise "
+        "quantization are loaded as fused uint8 tensors of quantized rows "
+        "followed by scale and bias, as used by "
+        "SparseLengthsSumFused8BitRowwise, instead of being dequantized.");
 
 OPERATOR_SCHEMA(Save)
     .NumInputs(1, INT_MAX)
@@ -85,6 +104,21 @@ OPERATOR_SCHEMA(Save)
 The Save operator saves a set of blobs to a db. It takes [1, infinity) number
 of inputs and has no output. The contents of the inputs are written into the
 db specified by the arguments.
+
+The inputs listed in incremental_blobs are CPU tensors that are only modified
+by sparse updates, e.g. embedding tables trained with SparseAdagrad,
+SparseAdam, SparseFtrl or ScatterAssign. The first time such a blob is saved it
+is written in full, afterwards the rows touched by these operators are tracked
+and each Save only writes the rows updated since the previous one along with
+their indices. Loading a checkpoint then requires all the previous ones, see
+the delta_dbs argument of Load. Save operators writing separate series of
+checkpoints of the same blobs must use different incremental_saver names, each
+series then gets all the rows updated since its own previous checkpoint. If a
+save fails, its rows are written again by the next one.
+
+Float matrices whose name matches the regular expression given by
+--caffe2_serialize_rowwise_quantized_blobs are saved with lossy fused 8-bit
+row-wise quantization, see FloatToFused8BitRowwiseQuantized.
 )DOC")
     .Arg(
         "absolute_path",
@@ -101,7 +135,17 @@ db specified by the arguments.
         "(list of strings) if set, used instead of original "
         "blob names. Must be the same length as number of blobs.")
     .Arg("db", "(string) the path to the db to load.")
-    .Arg("db_type", "(string) the type of the db.");
+    .Arg(
+        "db_type",
+        "(string) the type of the db. \"mmap\" writes raw CPU tensors that "
+        "Load can memory map.")
+    .Arg(
+        "incremental_blobs",
+        "(list of strings) names of the inputs to save incrementally.")
+    .Arg(
+        "incremental_saver",
+        "(string, default \"\") name of the series of incremental "
+        "checkpoints this operator writes.");
 
 OPERATOR_SCHEMA(Checkpoint)
     .NumInputs(1, INT_MAX)
@@ -2,20 +2,28 @@
 #define CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 
 #include <cstdio>
+#include <exception>
+#include <future>
 #include <map>
+#include <mutex>
 #include <unordered_set>
 
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/context.h"
 #include "caffe2/core/db.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/mmap_checkpoint.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/scope_guard.h"
+#include "caffe2/core/tensor_delta.h"
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/simple_queue.h"
 
 namespace caffe2 {
 
-namespace {
+namespace detail {
+// Loading progress of a blob, possibly split in chunks
 struct BlobState {
   int64_t total_size;
   int64_t current_size;
@@ -30,7 +38,7 @@ struct BlobState {
         current_size(current_size),
         is_tensor(is_tensor) {}
 };
-} // namespace
+} // namespace detail
 
 using db::Cursor;
 using db::DB;
@@ -84,12 +92,24 @@ class LoadOp final : public Operator<Context> {
         load_all_(OperatorBase::GetSingleArgument<int>("load_all", 0)),
         allow_incomplete_(
             OperatorBase::GetSingleArgument<bool>("allow_incomplete", false)),
+        keep_fused_8bit_rowwise_(OperatorBase::GetSingleArgument<bool>(
+            "keep_fused_8bit_rowwise",
+            false)),
         blob_names_(OperatorBase::GetRepeatedArgument<string>(
-            "source_blob_names")) {
+            "source_blob_names")),
+        delta_db_names_(
+            OperatorBase::GetRepeatedArgument<string>("delta_dbs")) {
     if (InputSize() == 0) {
       CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
       CAFFE_ENFORCE_GT(db_type_.size(), 0, "Must specify a db type.");
     }
+    CAFFE_ENFORCE(
+        delta_db_names_.empty() ||
+            (InputSize() == 0 && db_type_ != kMmapCheckpointDBType),
+        "delta_dbs can only be applied on top of a db of a record db_type.");
+    CAFFE_ENFORCE(
+        !keep_fused_8bit_rowwise_ || (std::is_same<Context, CPUContext>::value),
+        "Row-wise quantized tensors can only be kept quantized on CPU.");
     CAFFE_ENFORCE(blob_names_.empty() || blob_names_.size() == OutputSize(),
       "Number of output blobs and source_blob_names mismatch.");
     CAFFE_ENFORCE(blob_names_.empty() || strip_prefix_.empty(),
@@ -121,21 +141,39 @@ class LoadOp final : public Operator<Context> {
     if (InputSize() == 1) {
       const db::DBReader& reader = OperatorBase::Input<db::DBReader>(0);
       extract(reader.cursor());
+    } else if (db_type_ == kMmapCheckpointDBType) {
+      extractMmap(
+          absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_));
     } else {
-      string full_db_name =
-          absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_);
-      std::unique_ptr<DB> in_db(
-          caffe2::db::CreateDB(db_type_, full_db_name, caffe2::db::READ));
-      CAFFE_ENFORCE(in_db.get(), "Cannot open db: ", db_name_);
-      std::unique_ptr<Cursor> cursor(in_db->NewCursor());
-      extract(cursor.get());
+      extractDB(db_name_);
+      // Each delta overwrites the rows updated since the previous checkpoint
+      for (const auto& delta_db_name : delta_db_names_) {
+        extractDB(delta_db_name);
+      }
     }
 
     return true;
   }
 
  private:
+  void extractDB(const string& db_name) {
+    string full_db_name =
+        absolute_path_ ? db_name : (ws_->RootFolder() + "/" + db_name);
+    std::unique_ptr<DB> in_db(
+        caffe2::db::CreateDB(db_type_, full_db_name, caffe2::db::READ));
+    CAFFE_ENFORCE(in_db.get(), "Cannot open db: ", db_name);
+    std::unique_ptr<Cursor> cursor(in_db->NewCursor());
+    extract(cursor.get());
+  }
+
   void extract(Cursor* cursor) {
+#ifndef __ANDROID__
+    if (std::is_same<Context, CPUContext>::value &&
+        FLAGS_caffe2_max_tensor_deserializer_threads > 1) {
+      extractParallel(cursor);
+      return;
+    }
+#endif
     if (load_all_) {
       extractAll(cursor);
     } else {
@@ -143,9 +181,159 @@ class LoadOp final : public Operator<Context> {
     }
   }
 
+#ifndef __ANDROID__
+  struct Record {
+    Blob* blob;
+    string key;
+    string value;
+  };
+
+  // Same as extractAll and extractFrom, but while the calling thread reads
+  // the records from the cursor, a pool of threads parses them and decodes
+  // the chunks of CPU tensors concurrently, straight into the tensors
+  // preallocated when their first chunk was seen. Threads are started as
+  // the data read grows, one per kBytesPerDeserializerThread bytes, up to
+  // --caffe2_max_tensor_deserializer_threads.
+  static constexpr size_t kBytesPerDeserializerThread = 1 << 20;
+
+  void extractParallel(Cursor* cursor) {
+    CAFFE_ENFORCE(cursor, "cursor is not valid");
+    const size_t max_threads = FLAGS_caffe2_max_tensor_deserializer_threads;
+    SimpleQueue<Record> records(2 * max_threads);
+    std::mutex mutex;
+    std::unordered_map<string, detail::BlobState> blob_states;
+    int loaded_blobs = 0;
+    std::exception_ptr error;
+
+    auto allLoaded = [&]() {
+      return !load_all_ && loaded_blobs == OutputSize();
+    };
+
+    auto task = [&]() {
+      TensorDeserializer<CPUContext> deserializer;
+      Record record;
+      while (records.Pop(&record)) {
+        try {
+          BlobProto proto;
+          CAFFE_ENFORCE(
+              proto.ParseFromString(record.value), "Couldn't parse Proto");
+          record.value.clear();
+          if (!keep_device_) {
+            SetCurrentDevice(&proto);
+          }
+          const bool cpu_tensor = isPlainTensor(proto) && proto.has_tensor() &&
+              !proto.has_content_num_chunks() &&
+              proto.tensor().device_detail().device_type() == CPU;
+
+          TensorCPU* tensor = nullptr;
+          {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (error || allLoaded()) {
+              continue;
+            }
+            if (!cpu_tensor) {
+              ProcessBlob(
+                  record.blob, proto, &blob_states, record.key, &loaded_blobs);
+              continue;
+            }
+            if (blob_states.count(record.key) == 0) {
+              record.blob->Reset();
+              DirtyRowTracker::Get().Untrack(record.blob);
+              TensorDeserializer<CPUContext>::Preallocate(
+                  proto.tensor(),
+                  record.blob->template GetMutable<TensorCPU>());
+            }
+            tensor = record.blob->template GetMutable<TensorCPU>();
+            checkChunkMatches(proto.tensor(), *tensor, record.key);
+            updateBlobState(proto, &blob_states, record.key, &loaded_blobs);
+          }
+          deserializer.DeserializeChunk(proto.tensor(), tensor);
+        } catch (...) {
+          std::lock_guard<std::mutex> guard(mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+      }
+    };
+
+    std::vector<std::future<void>> futures;
+    // Destroyed before futures: closes the queue so that the threads finish
+    // even if reading the cursor throws, then the futures wait for them
+    auto close_records = MakeGuard([&records]() { records.NoMoreJobs(); });
+    size_t read_bytes = 0;
+    for (; cursor->Valid(); cursor->Next()) {
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (error || allLoaded()) {
+          break;
+        }
+      }
+      Record record;
+      record.key = buildBlobNameFromDbKey(cursor->key());
+      if (load_all_) {
+        record.blob = ws_->CreateBlob(record.key);
+      } else if (output_indices_.count(record.key)) {
+        record.blob = OperatorBase::Outputs().at(output_indices_[record.key]);
+      } else {
+        VLOG(1) << "Key " << record.key << " not used. Skipping.";
+        continue;
+      }
+      record.value = cursor->value();
+      read_bytes += record.value.size();
+      if (futures.size() < max_threads &&
+          futures.size() * kBytesPerDeserializerThread <= read_bytes) {
+        futures.emplace_back(std::async(std::launch::async, task));
+      }
+      records.Push(std::move(record));
+    }
+    records.NoMoreJobs();
+    for (auto& future : futures) {
+      future.get();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+
+    validateBlobStates(blob_states);
+    VLOG(1) << "Loaded " << loaded_blobs << " blobs from db";
+    if (!load_all_) {
+      checkAllLoaded(blob_states, loaded_blobs);
+    }
+  }
+
+  // Whether proto is deserialized as a regular tensor
+  bool isPlainTensor(const BlobProto& proto) const {
+    return proto.type() == kTensorBlobType ||
+        (keep_fused_8bit_rowwise_ &&
+         proto.type() == kFused8BitRowwiseTensorBlobType);
+  }
+
+  // A chunk of an already preallocated tensor must not change its shape or
+  // type, since other threads are writing into the same storage
+  void checkChunkMatches(
+      const TensorProto& proto,
+      const TensorCPU& tensor,
+      const string& key) {
+    CAFFE_ENFORCE_EQ(
+        proto.dims_size(), tensor.ndim(), "Inconsistent chunks for ", key);
+    for (int i = 0; i < proto.dims_size(); ++i) {
+      CAFFE_ENFORCE_EQ(
+          proto.dims(i), tensor.dim(i), "Inconsistent chunks for ", key);
+    }
+    const auto data_type = proto.data_type() == TensorProto_DataType_BYTE
+        ? TensorProto_DataType_UINT8
+        : proto.data_type();
+    CAFFE_ENFORCE(
+        DataTypeToTypeMeta(data_type) == tensor.meta(),
+        "Inconsistent chunks for ",
+        key);
+  }
+#endif
+
   void extractAll(Cursor* cursor) {
     CAFFE_ENFORCE(cursor, "cursor is not valid");
-    std::unordered_map<string, BlobState> blob_states;
+    std::unordered_map<string, detail::BlobState> blob_states;
     int loaded_blobs = 0;
     for (; cursor->Valid(); cursor->Next()) {
       const auto key = buildBlobNameFromDbKey(cursor->key());
@@ -168,7 +356,7 @@ class LoadOp final : public Operator<Context> {
 
   void extractFrom(Cursor* cursor, const vector<Blob*>& outputs) {
     CAFFE_ENFORCE(cursor);
-    std::unordered_map<string, BlobState> blob_states;
+    std::unordered_map<string, detail::BlobState> blob_states;
     int loaded_blobs = 0;
     for (; cursor->Valid(); cursor->Next()) {
       const auto key = buildBlobNameFromDbKey(cursor->key());
@@ -196,7 +384,12 @@ class LoadOp final : public Operator<Context> {
 
     validateBlobStates(blob_states);
     VLOG(1) << "Fully loaded " << blob_states.size() << " blobs";
+    checkAllLoaded(blob_states, loaded_blobs);
+  }
 
+  void checkAllLoaded(
+      const std::unordered_map<string, detail::BlobState>& blob_states,
+      int loaded_blobs) {
     if (loaded_blobs != OutputSize()) {
       if (allow_incomplete_ && loaded_blobs < OutputSize()) {
         VLOG(1) << "Loaded " << loaded_blobs << " blobs out of " << OutputSize()
@@ -217,6 +410,51 @@ class LoadOp final : public Operator<Context> {
     }
   }
 
+  // Tensors of mmap checkpoints are not deserialized, the output tensors share
+  // the mapped file instead
+  void extractMmap(const string& path) {
+    CAFFE_ENFORCE(
+        (std::is_same<Context, CPUContext>::value),
+        "Checkpoints of db_type ",
+        kMmapCheckpointDBType,
+        " can only be loaded on CPU");
+    auto checkpoint = MmapCheckpoint::Open(path);
+    int loaded_blobs = 0;
+    for (const auto& entry : checkpoint->entries()) {
+      const auto key = buildBlobNameFromDbKey(entry.name);
+      Blob* blob = nullptr;
+      if (load_all_) {
+        blob = ws_->CreateBlob(key);
+      } else {
+        auto it = output_indices_.find(key);
+        if (it == output_indices_.end()) {
+          VLOG(1) << "Key " << key << " not used. Skipping.";
+          continue;
+        }
+        blob = OperatorBase::Outputs().at(it->second);
+      }
+      blob->Reset();
+      DirtyRowTracker::Get().Untrack(blob);
+      checkpoint->Load(entry, blob->template GetMutable<TensorCPU>());
+      loaded_blobs++;
+    }
+    VLOG(1) << "Loaded " << loaded_blobs << " blobs from " << path;
+
+    if (!load_all_ && loaded_blobs != OutputSize() && !allow_incomplete_) {
+      for (const string& output_name : this->debug_def().output()) {
+        if (!checkpoint->Has(output_name)) {
+          LOG(ERROR) << "Failed to load blob: " << output_name;
+        }
+      }
+      CAFFE_THROW(
+          "Expected to load ",
+          OutputSize(),
+          " blobs, got ",
+          loaded_blobs,
+          " only.\n");
+    }
+  }
+
   string buildBlobNameFromDbKey(const string& dbKey) {
     string key = dbKey.substr(0, dbKey.find(kChunkIdSeparator));
     if (!strip_prefix_.empty()) {
@@ -235,10 +473,21 @@ class LoadOp final : public Operator<Context> {
   void ProcessBlob(
       Blob* blob,
       const BlobProto& proto,
-      std::unordered_map<string, BlobState>* blob_states_ptr,
+      std::unordered_map<string, detail::BlobState>* blob_states_ptr,
       const string& key,
       int* loaded_blobs) {
     auto& blob_states = *blob_states_ptr;
+    if (proto.type() == kTensorDeltaBlobType) {
+      // Deltas are applied in place on top of the previously loaded tensor
+      CAFFE_ENFORCE(
+          blob->template IsType<TensorCPU>(),
+          "The checkpoint ",
+          key,
+          " is a delta of a CPU tensor, its base must be loaded first");
+      ApplyTensorDelta(proto, blob->template GetMutable<TensorCPU>());
+      updateBlobState(proto, blob_states_ptr, key, loaded_blobs);
+      return;
+    }
     if (blob_states.count(key) == 0) {
       // We reset the blob so that any existing content is destroyed. This
       // is to guaranee correct device placement: if we are deserializing
@@ -246,11 +495,29 @@ class LoadOp final : public Operator<Context> {
       // into an existing TensorCUDA that has pre-allocated memory on a
       // different GPU.
       blob->Reset();
+      // Rows updated before the load are not relative to the loaded tensor
+      DirtyRowTracker::Get().Untrack(blob);
     }
-    blob->Deserialize(proto);
+    if (keep_fused_8bit_rowwise_ &&
+        proto.type() == kFused8BitRowwiseTensorBlobType) {
+      // The quantized rows with their scale and bias are a BYTE tensor
+      TensorDeserializer<CPUContext>().Deserialize(
+          proto.tensor(), blob->template GetMutable<TensorCPU>());
+    } else {
+      blob->Deserialize(proto);
+    }
+    updateBlobState(proto, blob_states_ptr, key, loaded_blobs);
+  }
+
+  void updateBlobState(
+      const BlobProto& proto,
+      std::unordered_map<string, detail::BlobState>* blob_states_ptr,
+      const string& key,
+      int* loaded_blobs) {
+    auto& blob_states = *blob_states_ptr;
     if (proto.has_content_num_chunks()) {
       if (!blob_states.count(key)) {
-        blob_states[key] = BlobState(proto.content_num_chunks());
+        blob_states[key] = detail::BlobState(proto.content_num_chunks());
       }
       CAFFE_ENFORCE(
           blob_states[key]
@@ -282,7 +549,7 @@ class LoadOp final : public Operator<Context> {
       // If blob is divided into chunks the field content_chunks has to be set,
       // otherwise only tensors can be seen multiple times as chunks.
       CAFFE_ENFORCE(blob_states.count(key) == 0, "Blob duplicated: ", key);
-      blob_states[key] = BlobState();
+      blob_states[key] = detail::BlobState();
       (*loaded_blobs)++;
       return;
     }
@@ -315,7 +582,7 @@ class LoadOp final : public Operator<Context> {
             proto.tensor().segment().end() - proto.tensor().segment().begin();
       }
       blob_states[key] =
-          BlobState(total_size, current_size, true /* is_tensor */);
+          detail::BlobState(total_size, current_size, true /* is_tensor */);
     }
 
     if (blob_states[key].current_size == blob_states[key].total_size) {
@@ -324,9 +591,9 @@ class LoadOp final : public Operator<Context> {
   }
 
   void validateBlobStates(
-      const std::unordered_map<string, BlobState>& blob_states) {
+      const std::unordered_map<string, detail::BlobState>& blob_states) {
     for (const auto& iter : blob_states) {
-      const BlobState& blob_state = iter.second;
+      const detail::BlobState& blob_state = iter.second;
       CAFFE_ENFORCE(
           blob_state.current_size == blob_state.total_size,
           "Data size mismatch for blob ",
@@ -347,8 +614,10 @@ class LoadOp final : public Operator<Context> {
   bool keep_device_;
   bool load_all_;
   bool allow_incomplete_;
+  bool keep_fused_8bit_rowwise_;
   std::map<string, int> output_indices_;
   std::vector<std::string> blob_names_;
+  std::vector<std::string> delta_db_names_;
 };
 
 template <class Context>
@@ -365,7 +634,10 @@ class SaveOp final : public Operator<Context> {
         db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
         db_type_(OperatorBase::GetSingleArgument<string>("db_type", "")),
         blob_names_(
-            OperatorBase::GetRepeatedArgument<string>("blob_name_overrides")) {
+            OperatorBase::GetRepeatedArgument<string>("blob_name_overrides")),
+        incremental_saver_(OperatorBase::GetSingleArgument<string>(
+            "incremental_saver",
+            "")) {
     CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
     CAFFE_ENFORCE_GT(db_type_.size(), 0, "Must specify a db type.");
     CAFFE_ENFORCE(
@@ -397,11 +669,31 @@ class SaveOp final : public Operator<Context> {
         blob_names_[i] = name;
       }
     }
+
+    const auto incremental_blobs =
+        OperatorBase::GetRepeatedArgument<string>("incremental_blobs");
+    CAFFE_ENFORCE(
+        incremental_blobs.empty() || db_type_ != kMmapCheckpointDBType,
+        "Incremental checkpoints are not supported with db_type ",
+        kMmapCheckpointDBType);
+    std::set<string> incremental_names(
+        incremental_blobs.begin(), incremental_blobs.end());
+    incremental_.resize(OperatorBase::Inputs().size());
+    for (int i = 0; i < incremental_.size(); ++i) {
+      incremental_[i] = incremental_names.erase(operator_def.input(i)) > 0;
+    }
+    CAFFE_ENFORCE(
+        incremental_names.empty(),
+        "incremental_blobs must be inputs of the operator, got: ",
+        *incremental_names.begin());
   }
 
   bool RunOnDevice() override {
     string full_db_name =
         absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_);
+    if (db_type_ == kMmapCheckpointDBType) {
+      return saveMmap(full_db_name);
+    }
     std::unique_ptr<DB> out_db(
         caffe2::db::CreateDB(db_type_, full_db_name, caffe2::db::NEW));
     CAFFE_ENFORCE(out_db.get(), "Cannot open db for writing: ", full_db_name);
@@ -416,21 +708,103 @@ class SaveOp final : public Operator<Context> {
       transaction->Commit();
     };
 
+    // The rows of the incremental blobs are only committed once the db is
+    // closed: if saving fails, the rows taken are marked again and the blobs
+    // saved in full are not tracked, so the next save writes them again
+    IncrementalRows taken;
+    vector<const Blob*> tracked;
+    auto rollback = MakeGuard([&]() {
+      auto& tracker = DirtyRowTracker::Get();
+      for (const auto& blob_rows : taken) {
+        tracker.RestoreRows(
+            blob_rows.first, incremental_saver_, blob_rows.second);
+      }
+      for (const auto* blob : tracked) {
+        tracker.Untrack(blob, incremental_saver_);
+      }
+    });
+
     const vector<const Blob*>& inputs = OperatorBase::Inputs();
     for (int i = 0; i < inputs.size(); ++i) {
-      inputs[i]->Serialize(blob_names_[i], acceptor);
+      if (incremental_[i]) {
+        saveIncremental(
+            inputs[i], blob_names_[i], acceptor, &taken, &tracked);
+      } else {
+        inputs[i]->Serialize(blob_names_[i], acceptor);
+      }
     }
     out_db->Close();
+    rollback.dismiss();
     return true;
   }
 
  private:
+  using IncrementalRows = vector<std::pair<const Blob*, vector<TIndex>>>;
+
+  // The first time a blob is saved incrementally by a saver, it is written in
+  // full and its dirty rows are tracked for that saver from then on. The
+  // following saves only write the rows updated since the previous one, which
+  // LoadOp applies in place. The rows taken and the blobs tracked are added to
+  // taken and tracked, to be rolled back if the save fails.
+  void saveIncremental(
+      const Blob* blob,
+      const string& name,
+      BlobSerializerBase::SerializationAcceptor acceptor,
+      IncrementalRows* taken,
+      vector<const Blob*>* tracked) {
+    CAFFE_ENFORCE(
+        blob->template IsType<TensorCPU>(),
+        "Only CPU tensors can be saved incrementally, got ",
+        blob->TypeName(),
+        " for ",
+        name);
+    auto& tracker = DirtyRowTracker::Get();
+    vector<TIndex> rows;
+    if (tracker.TakeRows(blob, incremental_saver_, &rows)) {
+      taken->emplace_back(blob, std::move(rows));
+      const auto& taken_rows = taken->back().second;
+      VLOG(1) << "Saving " << taken_rows.size() << " updated rows of " << name;
+      SerializeTensorDelta(
+          blob->template Get<TensorCPU>(),
+          taken_rows,
+          name,
+          acceptor,
+          FLAGS_caffe2_tensor_chunk_size);
+    } else {
+      // Tracking starts before serializing, so that rows updated
+      // concurrently are written again by the next delta
+      tracker.Track(blob, incremental_saver_);
+      tracked->push_back(blob);
+      blob->Serialize(name, acceptor);
+    }
+  }
+
+  bool saveMmap(const string& path) {
+    MmapCheckpointWriter writer(path);
+    const vector<const Blob*>& inputs = OperatorBase::Inputs();
+    for (int i = 0; i < inputs.size(); ++i) {
+      CAFFE_ENFORCE(
+          inputs[i]->template IsType<TensorCPU>(),
+          "Only CPU tensors can be saved with db_type ",
+          kMmapCheckpointDBType,
+          ", got ",
+          inputs[i]->TypeName(),
+          " for ",
+          blob_names_[i]);
+      writer.Add(blob_names_[i], inputs[i]->template Get<TensorCPU>());
+    }
+    writer.Close();
+    return true;
+  }
+
   Workspace* ws_;
   bool absolute_path_;
   string strip_prefix_;
   string db_name_;
   string db_type_;
   std::vector<std::string> blob_names_;
+  std::vector<bool> incremental_;
+  string incremental_saver_;
 };
 
 template <typename... Ts>
@@ -58,6 +58,13 @@ inline void UpdateTimestepBlob(Workspace* ws, std::string blob_name, int t) {
   timestepBlob->GetMutable<TensorCPU>()->mutable_data<int32_t>()[0] = t;
 }
 
+// Same as above without hashing the blob name, called on every timestep
+inline void UpdateTimestepBlob(Workspace* ws, BlobId blob_id, int t) {
+  auto* timestep = ws->CreateBlob(blob_id)->GetMutable<TensorCPU>();
+  timestep->Resize(1);
+  timestep->mutable_data<int32_t>()[0] = t;
+}
+
 std::map<string, string> GetRecurrentMapping(
   const std::vector<detail::Link>& links, bool backward);
 
@@ -181,7 +188,8 @@ class RecurrentNetworkOp final : public Operator<Context> {
             false)),
         timestep_(OperatorBase::template GetSingleArgument<std::string>(
             "timestep",
-            "timestep")) {
+            "timestep")),
+        timestepBlobId_(Workspace::InternBlobName(timestep_)) {
     CAFFE_ENFORCE(ws);
 
     stepNetDef_ = detail::extractNetDef(operator_def, "step_net");
@@ -357,7 +365,8 @@ class RecurrentNetworkOp final : public Operator<Context> {
             t, currentStepWorkspace.get(), this->observers_list_);
       } else {
         // Use plain Caffe2 nets
-        detail::UpdateTimestepBlob(currentStepWorkspace.get(), timestep_, t);
+        detail::UpdateTimestepBlob(
+            currentStepWorkspace.get(), timestepBlobId_, t);
         auto* stepNet = currentStepWorkspace->GetNet(stepNetDef_.name());
         if (stepNet == nullptr) {
           stepNet = currentStepWorkspace->CreateNet(stepNetDef_);
@@ -393,6 +402,7 @@ class RecurrentNetworkOp final : public Operator<Context> {
   std::vector<detail::OffsetAlias> aliases_;
   std::vector<detail::RecurrentInput> recurrentInputs_;
   std::string timestep_;
+  BlobId timestepBlobId_;
 };
 
 template <class Context>
@@ -29,6 +29,8 @@ class TensorProtosDBInput final : public PrefetchOperator<Context> {
   bool shape_inferred_ = false;
   string key_;
   string value_;
+  vector<string> batch_keys_;
+  vector<string> batch_values_;
 };
 
 template <class Context>
@@ -61,10 +63,10 @@ bool TensorProtosDBInput<Context>::Prefetch() {
     }
   } else {
     vector<TensorCPU> temp_tensors(OutputSize());
+    reader.ReadMany(batch_size_, &batch_keys_, &batch_values_);
     for (int item_id = 0; item_id < batch_size_; ++item_id) {
-      reader.Read(&key_, &value_);
       TensorProtos protos;
-      CAFFE_ENFORCE(protos.ParseFromString(value_));
+      CAFFE_ENFORCE(protos.ParseFromString(batch_values_[item_id]));
       CAFFE_ENFORCE(protos.protos_size() == OutputSize());
       if (!shape_inferred_) {
         // First, set the shape of all the blobs.
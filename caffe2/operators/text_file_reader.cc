@@ -1,3 +1,6 @@
+#include <atomic>
+#include <mutex>
+
 #include "caffe2/core/context.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/tensor.h"
@@ -6,6 +9,12 @@
 
 namespace caffe2 {
 
+// The file is memory mapped and split into ranges of whole rows. Reading ops
+// claim the ranges one at a time and tokenize them on their own, so several
+// of them can read the same instance concurrently without locking.
+//
+// Files that can not be mapped, e.g. FIFOs or procfs files, are read through
+// a single buffered tokenizer instead, which reading ops share under a lock.
 struct TextFileReaderInstance {
   TextFileReaderInstance(
       const std::vector<char>& delims,
@@ -13,9 +22,17 @@ struct TextFileReaderInstance {
       const std::string& filename,
       int numPasses,
       const std::vector<int>& types)
-      : fileReader(filename),
-        tokenizer(Tokenizer(delims, escape), &fileReader, numPasses),
-        fieldTypes(types) {
+      : tokenizer(delims, escape),
+        numPasses(numPasses),
+        fieldTypes(types),
+        id(nextId_++) {
+    if (MmapFileRanges::CanMap(filename)) {
+      ranges.reset(new MmapFileRanges(filename, delims.at(0), escape));
+    } else {
+      fileReader.reset(new FileReader(filename));
+      streamTokenizer.reset(
+          new BufferedTokenizer(tokenizer, fileReader.get(), numPasses));
+    }
     for (const auto dt : fieldTypes) {
       fieldMetas.push_back(
           DataTypeToTypeMeta(static_cast<TensorProto_DataType>(dt)));
@@ -23,18 +40,40 @@ struct TextFileReaderInstance {
     }
   }
 
-  FileReader fileReader;
-  BufferedTokenizer tokenizer;
+  // Claims the next range to read. Returns false after the last pass.
+  bool nextRange(CharRange& range) {
+    const size_t i = nextRange_++;
+    if (i >= ranges->size() * numPasses) {
+      return false;
+    }
+    range = ranges->range(i % ranges->size());
+    return true;
+  }
+
+  // Set if the file is mapped
+  std::unique_ptr<MmapFileRanges> ranges;
+  // Copied by every reading op
+  const Tokenizer tokenizer;
+  const int numPasses;
   std::vector<int> fieldTypes;
   std::vector<TypeMeta> fieldMetas;
   std::vector<size_t> fieldByteSizes;
-  size_t rowsRead{0};
+  std::atomic<size_t> rowsRead{0};
+  // Unique among all instances, unlike their address
+  const uint64_t id;
 
-  // hack to guarantee thread-safeness of the read op
-  // TODO(azzolini): support multi-threaded reading.
-  std::mutex globalMutex_;
+  // Set if the file is streamed, guarded by streamMutex
+  std::unique_ptr<FileReader> fileReader;
+  std::unique_ptr<BufferedTokenizer> streamTokenizer;
+  std::mutex streamMutex;
+
+ private:
+  std::atomic<size_t> nextRange_{0};
+  static std::atomic<uint64_t> nextId_;
 };
 
+std::atomic<uint64_t> TextFileReaderInstance::nextId_{0};
+
 class CreateTextFileReaderOp : public Operator<CPUContext> {
  public:
   CreateTextFileReaderOp(const OperatorDef& operator_def, Workspace* ws)
@@ -111,42 +150,56 @@ class TextFileReaderReadOp : public Operator<CPUContext> {
       datas[i] = (char*)Output(i)->raw_mutable_data(instance->fieldMetas[i]);
     }
 
+    if (!instance->ranges) {
+      const int rowsRead = readStreamed(instance, datas);
+      for (int i = 0; i < numFields; ++i) {
+        Output(i)->Shrink(rowsRead);
+      }
+      return true;
+    }
+
+    if (!tokenizer_ || instanceId_ != instance->id) {
+      // Rows left from another instance are dropped
+      tokenizer_.reset(new Tokenizer(instance->tokenizer));
+      instanceId_ = instance->id;
+      tokenIndex_ = tokenized_.tokens().size();
+    }
+
     int rowsRead = 0;
-    {
-      // TODO(azzolini): support multi-threaded reading
-      std::lock_guard<std::mutex> guard(instance->globalMutex_);
-
-      bool finished = false;
-      Token token;
-      while (!finished && (rowsRead < batchSize_)) {
-        int field;
-        for (field = 0; field < numFields; ++field) {
-          finished = !instance->tokenizer.next(token);
-          if (finished) {
-            CAFFE_ENFORCE(
-                field == 0, "Invalid number of fields at end of file.");
-            break;
-          }
-          CAFFE_ENFORCE(
-              (field == 0 && token.startDelimId == 0) ||
-                  (field > 0 && token.startDelimId == 1),
-              "Invalid number of columns at row ",
-              instance->rowsRead + rowsRead + 1);
-          const auto& meta = instance->fieldMetas[field];
-          char*& data = datas[field];
-          convert(
-              (TensorProto_DataType)instance->fieldTypes[field],
-              token.start,
-              token.end,
-              data);
-          data += instance->fieldByteSizes[field];
-        }
-        if (!finished) {
-          ++rowsRead;
+    while (rowsRead < batchSize_) {
+      const auto& tokens = tokenized_.tokens();
+      if (tokenIndex_ == tokens.size()) {
+        CharRange range;
+        if (!instance->nextRange(range)) {
+          break;
         }
+        // Ranges start at the beginning of a row
+        tokenizer_->reset();
+        tokenizer_->next(range.start, range.end, tokenized_);
+        tokenIndex_ = 0;
+        continue;
       }
-      instance->rowsRead += rowsRead;
+      CAFFE_ENFORCE(
+          tokens.size() - tokenIndex_ >= numFields,
+          "Invalid number of fields at end of file.");
+      for (int field = 0; field < numFields; ++field) {
+        const auto& token = tokens[tokenIndex_++];
+        CAFFE_ENFORCE(
+            (field == 0 && token.startDelimId == 0) ||
+                (field > 0 && token.startDelimId == 1),
+            "Invalid number of columns at row ",
+            instance->rowsRead + rowsRead + 1);
+        char*& data = datas[field];
+        convert(
+            (TensorProto_DataType)instance->fieldTypes[field],
+            token.start,
+            token.end,
+            data);
+        data += instance->fieldByteSizes[field];
+      }
+      ++rowsRead;
     }
+    instance->rowsRead += rowsRead;
 
     for (int i = 0; i < numFields; ++i) {
       Output(i)->Shrink(rowsRead);
@@ -155,7 +208,47 @@ class TextFileReaderReadOp : public Operator<CPUContext> {
   }
 
  private:
+  // Reads up to batchSize_ rows from a file that is not mapped
+  int readStreamed(
+      TextFileReaderInstance* instance,
+      std::vector<char*>& datas) {
+    const int numFields = datas.size();
+    std::lock_guard<std::mutex> guard(instance->streamMutex);
+    int rowsRead = 0;
+    Token token;
+    while (rowsRead < batchSize_) {
+      for (int field = 0; field < numFields; ++field) {
+        if (!instance->streamTokenizer->next(token)) {
+          CAFFE_ENFORCE(field == 0, "Invalid number of fields at end of file.");
+          instance->rowsRead += rowsRead;
+          return rowsRead;
+        }
+        CAFFE_ENFORCE(
+            (field == 0 && token.startDelimId == 0) ||
+                (field > 0 && token.startDelimId == 1),
+            "Invalid number of columns at row ",
+            instance->rowsRead + rowsRead + 1);
+        char*& data = datas[field];
+        convert(
+            (TensorProto_DataType)instance->fieldTypes[field],
+            token.start,
+            token.end,
+            data);
+        data += instance->fieldByteSizes[field];
+      }
+      ++rowsRead;
+    }
+    instance->rowsRead += rowsRead;
+    return rowsRead;
+  }
+
   TIndex batchSize_;
+
+  // Rows of the last range claimed by this op that were not returned yet
+  uint64_t instanceId_{0};
+  std::unique_ptr<Tokenizer> tokenizer_;
+  TokenizedString tokenized_;
+  size_t tokenIndex_{0};
 };
 
 CAFFE_KNOWN_TYPE(std::unique_ptr<TextFileReaderInstance>);
@@ -181,7 +274,9 @@ OPERATOR_SCHEMA(TextFileReaderRead)
         "Read a batch of rows from the given text file reader instance. "
         "Expects the number of fields to be equal to the number of outputs. "
         "Each output is a 1D tensor containing the values for the given field "
-        "for each row. When end of file is reached, returns empty tensors.")
+        "for each row. When end of file is reached, returns empty tensors. "
+        "Several ops can read the same instance concurrently, in which case "
+        "the rows are not returned in file order across them.")
     .Input(0, "handler", "Pointer to an existing TextFileReaderInstance.")
     .Arg("batch_size", "Maximum number of rows to read.");
 
@@ -1,6 +1,9 @@
 #include "caffe2/operators/text_file_reader_utils.h"
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cstring>
 #include <sstream>
 
@@ -13,6 +16,35 @@ Tokenizer::Tokenizer(const std::vector<char>& delims, char escape)
   for (int i = 0; i < delims.size(); ++i) {
     delimTable_[(unsigned char)delims.at(i)] = i + 1;
   }
+  std::vector<char> specials(delims);
+  specials.push_back(escape);
+  for (const char c : specials) {
+    specialWords_.push_back(0x0101010101010101ULL * (unsigned char)c);
+  }
+}
+
+char* Tokenizer::findSpecial(char* start, char* end) const {
+  constexpr uint64_t kLow = 0x0101010101010101ULL;
+  constexpr uint64_t kHigh = 0x8080808080808080ULL;
+  char* ch = start;
+  // Skip 8 characters at a time while none of them is special: a byte of
+  // word ^ special is zero where the character is special.
+  for (; ch + sizeof(uint64_t) <= end; ch += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, ch, sizeof(word));
+    bool found = false;
+    for (const auto special : specialWords_) {
+      const uint64_t x = word ^ special;
+      found |= ((x - kLow) & ~x & kHigh) != 0;
+    }
+    if (found) {
+      break;
+    }
+  }
+  while (ch < end && *ch != escape_ && !delimTable_[(unsigned char)*ch]) {
+    ++ch;
+  }
+  return ch;
 }
 
 void Tokenizer::reset() {
@@ -35,6 +67,10 @@ void Tokenizer::next(char* start, char* end, TokenizedString& tokenized) {
 
   char* ch;
   for (ch = start + toBeSkipped_; ch < end; ++ch) {
+    ch = findSpecial(ch, end);
+    if (ch == end) {
+      break;
+    }
     if (*ch == escape_) {
       if (!copied) {
         tokenized.modifiedStrings_.emplace_back(new std::string());
@@ -77,6 +113,78 @@ void Tokenizer::next(char* start, char* end, TokenizedString& tokenized) {
   }
 }
 
+bool MmapFileRanges::CanMap(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_size > 0;
+}
+
+MmapFileRanges::MmapFileRanges(
+    const std::string& path,
+    char rowDelim,
+    char escape,
+    size_t rangeSize) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(
+        "Error opening file for reading: " + std::string(std::strerror(errno)) +
+        " Path=" + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error(
+        "Error reading file size: " + std::string(std::strerror(errno)));
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error(
+          "Error mapping file: " + std::string(std::strerror(errno)));
+    }
+    data_ = static_cast<char*>(data);
+    madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  offsets_.push_back(0);
+  size_t offset = 0;
+  while (size_ - offset > rangeSize) {
+    // Find the first row starting after offset + rangeSize
+    char* ch = data_ + offset + rangeSize - 1;
+    char* end = data_ + size_;
+    while (true) {
+      ch = static_cast<char*>(memchr(ch, rowDelim, end - ch));
+      if (ch == nullptr) {
+        break;
+      }
+      // The delimiter is escaped if preceded by an odd number of escapes
+      size_t numEscapes = 0;
+      while (ch - numEscapes > data_ && *(ch - numEscapes - 1) == escape) {
+        ++numEscapes;
+      }
+      if (numEscapes % 2 == 0) {
+        break;
+      }
+      ++ch;
+    }
+    if (ch == nullptr || ch + 1 == end) {
+      break;
+    }
+    offset = ch + 1 - data_;
+    offsets_.push_back(offset);
+  }
+  offsets_.push_back(size_);
+}
+
+MmapFileRanges::~MmapFileRanges() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
 FileReader::FileReader(const std::string& path, size_t bufferSize)
     : bufferSize_(bufferSize), buffer_(new char[bufferSize]) {
   fd_ = open(path.c_str(), O_RDONLY, 0777);
@@ -41,6 +41,11 @@ class Tokenizer {
   int toBeSkipped_;
   int delimTable_[256];
   const char escape_;
+  // Delimiters and escape character, each repeated in the 8 bytes of a word
+  std::vector<uint64_t> specialWords_;
+
+  // Returns the first delimiter or escape character in [start, end), or end
+  char* findSpecial(char* start, char* end) const;
 
  public:
   Tokenizer(const std::vector<char>& delimiters, char escape);
@@ -104,6 +109,42 @@ class BufferedTokenizer {
   int pass_{0};
 };
 
+/**
+ * Maps a file in memory and splits it into ranges of about rangeSize bytes
+ * that start at the beginning of a row, so that they can be tokenized
+ * independently, e.g. by several threads. A row starts after every rowDelim
+ * that is not escaped.
+ */
+class MmapFileRanges {
+ public:
+  // Only regular files of known size can be mapped: FIFOs, character devices
+  // or procfs files must be read with FileReader instead
+  static bool CanMap(const std::string& path);
+
+  MmapFileRanges(
+      const std::string& path,
+      char rowDelim,
+      char escape,
+      size_t rangeSize = 1 << 20);
+  ~MmapFileRanges();
+
+  size_t size() const {
+    return offsets_.size() - 1;
+  }
+  CharRange range(size_t i) const {
+    return {data_ + offsets_[i], data_ + offsets_[i + 1]};
+  }
+
+ private:
+  char* data_{nullptr};
+  size_t size_{0};
+  // Start of every range, and the end of the file
+  std::vector<size_t> offsets_;
+
+  MmapFileRanges(const MmapFileRanges&) = delete;
+  MmapFileRanges& operator=(const MmapFileRanges&) = delete;
+};
+
 class FileReader : public StringProvider {
  public:
   explicit FileReader(const std::string& path, size_t bufferSize = 65536);
@@ -12,6 +12,9 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace caffe2 {
 
 TEST(TextFileReaderUtilsTest, TokenizeTest) {
@@ -119,4 +122,76 @@ TEST(TextFileReaderUtilsTest, TokenizeTest) {
   std::remove(tmpname);
 }
 
+TEST(TextFileReaderUtilsTest, MmapFileRangesTest) {
+  const std::string row =
+      "label\1text\nlabel2\\\nTest\1tex\\\\t2\n"
+      "Two\\\\Escapes\\\1\1Second\n";
+  const std::vector<std::string> rowTokens = {"label",
+                                             "text",
+                                             "label2\nTest",
+                                             "tex\\t2",
+                                             "Two\\Escapes\1",
+                                             "Second"};
+  const int numRows = 50;
+  std::string ch;
+  for (int i = 0; i < numRows; ++i) {
+    ch += row;
+  }
+  char* tmpname = std::tmpnam(nullptr);
+  std::ofstream outFile;
+  outFile.open(tmpname);
+  outFile << ch;
+  outFile.close();
+
+  Tokenizer tokenizer({'\n', '\1'}, '\\');
+  for (const size_t rangeSize : {1, 7, 64, 1 << 20}) {
+    MmapFileRanges ranges(tmpname, '\n', '\\', rangeSize);
+    EXPECT_LE(1, ranges.size());
+    std::vector<std::string> tokens;
+    size_t totalSize = 0;
+    for (int i = 0; i < ranges.size(); ++i) {
+      // Every range can be tokenized on its own
+      const auto range = ranges.range(i);
+      totalSize += range.end - range.start;
+      TokenizedString tokenized;
+      tokenizer.reset();
+      tokenizer.next(range.start, range.end, tokenized);
+      EXPECT_EQ(0, tokenized.lastDelim());
+      EXPECT_LT(0, tokenized.tokens().size());
+      EXPECT_EQ(0, tokenized.tokens().at(0).startDelimId);
+      for (const auto& token : tokenized.tokens()) {
+        tokens.emplace_back(token.start, token.end);
+      }
+    }
+    EXPECT_EQ(ch.size(), totalSize);
+    EXPECT_EQ(rowTokens.size() * numRows, tokens.size());
+    for (int i = 0; i < tokens.size(); ++i) {
+      EXPECT_EQ(rowTokens.at(i % rowTokens.size()), tokens.at(i));
+    }
+  }
+  std::remove(tmpname);
+}
+
+TEST(TextFileReaderUtilsTest, CanMapTest) {
+  char* tmpname = std::tmpnam(nullptr);
+  std::ofstream outFile(tmpname);
+  outFile.close();
+  // An empty file has nothing to map
+  EXPECT_FALSE(MmapFileRanges::CanMap(tmpname));
+  outFile.open(tmpname);
+  outFile << "a\tb\n";
+  outFile.close();
+  EXPECT_TRUE(MmapFileRanges::CanMap(tmpname));
+  std::remove(tmpname);
+
+  // FIFOs and procfs files are read with FileReader instead
+  ASSERT_EQ(0, mkfifo(tmpname, 0600));
+  EXPECT_FALSE(MmapFileRanges::CanMap(tmpname));
+  std::remove(tmpname);
+  if (access("/proc/self/status", R_OK) == 0) {
+    EXPECT_FALSE(MmapFileRanges::CanMap("/proc/self/status"));
+  }
+  EXPECT_FALSE(MmapFileRanges::CanMap(tmpname));
+}
+
 } // namespace caffe2
@@ -5,6 +5,7 @@
 #include "caffe2/core/context.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/tensor_delta.h"
 #include "caffe2/utils/math.h"
 
 namespace caffe2 {
@@ -614,6 +615,7 @@ class ScatterAssignOp : public Operator<Context> {
       context_.template Copy<T, Context, Context>(
           block_size, slicesData + block_size * i, data + block_size * idx);
     }
+    DirtyRowTracker::Get().MarkRows(OperatorBase::Outputs(), idxs, K);
   }
 
   INPUT_TAGS(DATA, INDICES, SLICES);
@@ -99,6 +99,18 @@ static void EmbeddingLookupGenericSlow(
       const float* weights,                                        \
       bool normalize_by_lengths,                                   \
       OutType* out) {                                              \
+    AVX512_DO(                                                     \
+        EmbeddingLookup_##IndexType##_##InType##_##OutType,        \
+        block_size,                                                \
+        output_size,                                               \
+        index_size,                                                \
+        data_size,                                                 \
+        input,                                                     \
+        indices,                                                   \
+        lengths,                                                   \
+        weights,                                                   \
+        normalize_by_lengths,                                      \
+        out);                                                      \
     AVX2_FMA_DO(                                                   \
         EmbeddingLookup_##IndexType##_##InType##_##OutType,        \
         block_size,                                                \
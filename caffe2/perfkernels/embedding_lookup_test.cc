@@ -0,0 +1,248 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/types.h"
+#include "caffe2/perfkernels/embedding_lookup.h"
+#include "caffe2/perfkernels/fused_8bit_rowwise_embedding_lookup.h"
+#include "caffe2/utils/cpuid.h"
+
+namespace caffe2 {
+
+#define DECLARE_LOOKUP(name, IndexType, InType) \
+  void name(                                    \
+      const TIndex block_size,                  \
+      const TIndex output_size,                 \
+      const TIndex index_size,                  \
+      const TIndex data_size,                   \
+      const InType* input,                      \
+      const IndexType* indices,                 \
+      const int* lengths,                       \
+      const float* weights,                     \
+      bool normalize_by_lengths,                \
+      float* out);
+
+#define DECLARE_LOOKUPS(name, IndexType, InType)     \
+  DECLARE_LOOKUP(name##__base, IndexType, InType)     \
+  DECLARE_LOOKUP(name##__avx2_fma, IndexType, InType) \
+  DECLARE_LOOKUP(name##__avx512, IndexType, InType)
+
+DECLARE_LOOKUPS(EmbeddingLookup_int32_t_float_float, int32_t, float)
+DECLARE_LOOKUPS(EmbeddingLookup_int64_t_float_float, int64_t, float)
+DECLARE_LOOKUPS(EmbeddingLookup_int32_t_float16_float, int32_t, float16)
+DECLARE_LOOKUPS(EmbeddingLookup_int64_t_float16_float, int64_t, float16)
+DECLARE_LOOKUPS(
+    Fused8BitRowwiseEmbeddingLookup_int32_t_uint8_t_float_false,
+    int32_t,
+    uint8_t)
+DECLARE_LOOKUPS(
+    Fused8BitRowwiseEmbeddingLookup_int64_t_uint8_t_float_false,
+    int64_t,
+    uint8_t)
+
+#undef DECLARE_LOOKUPS
+#undef DECLARE_LOOKUP
+
+namespace {
+
+template <typename IndexType, typename InType>
+using LookupFn = void (*)(
+    const TIndex,
+    const TIndex,
+    const TIndex,
+    const TIndex,
+    const InType*,
+    const IndexType*,
+    const int*,
+    const float*,
+    bool,
+    float*);
+
+template <typename IndexType, typename InType>
+struct Kernels {
+  LookupFn<IndexType, InType> base;
+  LookupFn<IndexType, InType> avx2;
+  LookupFn<IndexType, InType> avx512;
+  // The entry point, which picks one of the above at run time
+  LookupFn<IndexType, InType> dispatch;
+};
+
+// The kernels of the instruction sets that are not built are left null
+#ifdef CAFFE2_PERF_WITH_AVX2
+#define AVX2_KERNEL(name) name##__avx2_fma
+#else
+#define AVX2_KERNEL(name) nullptr
+#endif
+#ifdef CAFFE2_PERF_WITH_AVX512
+#define AVX512_KERNEL(name) name##__avx512
+#else
+#define AVX512_KERNEL(name) nullptr
+#endif
+#define KERNELS(name, dispatch) \
+  { name##__base, AVX2_KERNEL(name), AVX512_KERNEL(name), dispatch }
+
+// The kernels to check against the base one, among those the cpu can run
+template <typename IndexType, typename InType>
+std::vector<std::pair<std::string, LookupFn<IndexType, InType>>> Candidates(
+    const Kernels<IndexType, InType>& kernels) {
+  const auto& cpuid = GetCpuId();
+  std::vector<std::pair<std::string, LookupFn<IndexType, InType>>> candidates;
+  if (kernels.avx2 && cpuid.avx2() && cpuid.fma()) {
+    candidates.emplace_back("avx2", kernels.avx2);
+  }
+  if (kernels.avx512 && cpuid.avx512f() && cpuid.avx512bw() &&
+      cpuid.avx512vl()) {
+    candidates.emplace_back("avx512", kernels.avx512);
+  }
+  candidates.emplace_back("dispatch", kernels.dispatch);
+  return candidates;
+}
+
+void FillRow(std::mt19937* gen, int block_size, float* row) {
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < block_size; ++i) {
+    row[i] = dist(*gen);
+  }
+}
+
+void FillRow(std::mt19937* gen, int block_size, float16* row) {
+  // Half floats in [-1, -0.5] U [0.5, 1]
+  std::uniform_int_distribution<uint16_t> dist(0, 0x7ff);
+  for (int i = 0; i < block_size; ++i) {
+    const uint16_t bits = dist(*gen);
+    row[i].x = ((bits & 0x400) << 5) | 0x3800 | (bits & 0x3ff);
+  }
+}
+
+// Fused rows end with their float scale and bias
+void FillRow(std::mt19937* gen, int block_size, uint8_t* row) {
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (int i = 0; i < block_size; ++i) {
+    row[i] = dist(*gen);
+  }
+  std::uniform_real_distribution<float> scale(0.001f, 0.01f);
+  std::uniform_real_distribution<float> bias(-1.f, 1.f);
+  const float scale_bias[2] = {scale(*gen), bias(*gen)};
+  memcpy(row + block_size, scale_bias, sizeof(scale_bias));
+}
+
+// Checks the kernels against the base implementation, for block sizes with
+// and without a tail, with and without weights and normalization. Some of
+// the segments are empty.
+template <typename IndexType, typename InType>
+void CheckLookups(
+    const Kernels<IndexType, InType>& kernels,
+    int scale_bias_size) {
+  const int data_size = 40;
+  const std::vector<int> lengths = {0, 3, 1, 0, 0, 9, 2, 0};
+  const int output_size = lengths.size();
+  const int index_size = std::accumulate(lengths.begin(), lengths.end(), 0);
+  std::mt19937 gen(0);
+
+  for (int block_size : {1, 7, 8, 15, 16, 17, 31, 32, 33, 48, 64, 100,
+                         128, 129, 200, 255, 256, 257, 300}) {
+    const TIndex row_size = block_size + scale_bias_size / sizeof(InType);
+    std::vector<InType> input(data_size * row_size);
+    for (int i = 0; i < data_size; ++i) {
+      FillRow(&gen, block_size, &input[i * row_size]);
+    }
+    std::uniform_int_distribution<IndexType> row(0, data_size - 1);
+    std::vector<IndexType> indices(index_size);
+    for (auto& index : indices) {
+      index = row(gen);
+    }
+    std::uniform_real_distribution<float> weight(-1.f, 1.f);
+    std::vector<float> weights(index_size);
+    for (auto& w : weights) {
+      w = weight(gen);
+    }
+
+    for (bool weighted : {false, true}) {
+      for (bool normalize : {false, true}) {
+        auto lookup = [&](LookupFn<IndexType, InType> kernel) {
+          // Empty segments must be written as well
+          std::vector<float> out(
+              output_size * block_size,
+              std::numeric_limits<float>::quiet_NaN());
+          kernel(
+              block_size,
+              output_size,
+              index_size,
+              data_size,
+              input.data(),
+              indices.data(),
+              lengths.data(),
+              weighted ? weights.data() : nullptr,
+              normalize,
+              out.data());
+          return out;
+        };
+        const auto expected = lookup(kernels.base);
+        for (const auto& candidate : Candidates(kernels)) {
+          const auto out = lookup(candidate.second);
+          for (int i = 0; i < out.size(); ++i) {
+            ASSERT_NEAR(
+                expected[i], out[i], 1e-5f * (1 + std::fabs(expected[i])))
+                << candidate.first << ", block size " << block_size
+                << (weighted ? ", weighted" : "")
+                << (normalize ? ", normalized" : "") << ", segment "
+                << i / block_size << " column " << i % block_size;
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST(EmbeddingLookupTest, Float) {
+  CheckLookups<int32_t, float>(
+      KERNELS(
+          EmbeddingLookup_int32_t_float_float,
+          (EmbeddingLookup<int32_t, float, float>)),
+      0);
+  CheckLookups<int64_t, float>(
+      KERNELS(
+          EmbeddingLookup_int64_t_float_float,
+          (EmbeddingLookup<int64_t, float, float>)),
+      0);
+}
+
+TEST(EmbeddingLookupTest, Float16) {
+  CheckLookups<int32_t, float16>(
+      KERNELS(
+          EmbeddingLookup_int32_t_float16_float,
+          (EmbeddingLookup<int32_t, float16, float>)),
+      0);
+  CheckLookups<int64_t, float16>(
+      KERNELS(
+          EmbeddingLookup_int64_t_float16_float,
+          (EmbeddingLookup<int64_t, float16, float>)),
+      0);
+}
+
+TEST(EmbeddingLookupTest, Fused8BitRowwise) {
+  CheckLookups<int32_t, uint8_t>(
+      KERNELS(
+          Fused8BitRowwiseEmbeddingLookup_int32_t_uint8_t_float_false,
+          (Fused8BitRowwiseEmbeddingLookup<int32_t, uint8_t, float, false>)),
+      2 * sizeof(float));
+  CheckLookups<int64_t, uint8_t>(
+      KERNELS(
+          Fused8BitRowwiseEmbeddingLookup_int64_t_uint8_t_float_false,
+          (Fused8BitRowwiseEmbeddingLookup<int64_t, uint8_t, float, false>)),
+      2 * sizeof(float));
+}
+
+#undef KERNELS
+#undef AVX512_KERNEL
+#undef AVX2_KERNEL
+
+} // namespace caffe2
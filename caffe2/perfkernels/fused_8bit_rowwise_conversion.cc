@@ -0,0 +1,76 @@
+#include "caffe2/perfkernels/fused_8bit_rowwise_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+constexpr float kEpsilon = 1e-8f;
+
+bool isLittleEndian() {
+  const int32_t kValue = 1;
+  return reinterpret_cast<const uint8_t*>(&kValue)[0] == 1;
+}
+} // namespace
+
+// The 8-bit conversions use the Eigen expressions the conversion operators
+// always had, which vectorize the whole row
+void FloatToFused8BitRowwiseQuantized(
+    const float* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    std::uint8_t* output) {
+  CAFFE_ENFORCE(isLittleEndian(), "Unsupported endianness");
+  const auto output_columns = input_columns + 8;
+  for (TIndex row = 0; row < input_rows; ++row) {
+    ConstEigenVectorArrayMap<float> input_row(
+        input + row * input_columns, input_columns);
+
+    std::uint8_t* output_row = output + row * output_columns;
+    EigenVectorArrayMap<std::uint8_t> output_row_values(
+        output_row, input_columns);
+
+    float minimum_element = 0;
+    float maximum_element = 0;
+    if (input_columns > 0) {
+      minimum_element = input_row.minCoeff();
+      maximum_element = input_row.maxCoeff();
+    }
+    const float range = maximum_element - minimum_element;
+
+    const float scale_bias[2] = {range / 255.0f, minimum_element};
+    memcpy(output_row + input_columns, scale_bias, sizeof(scale_bias));
+    const auto inverse_scale = 255.0f / (range + kEpsilon);
+    output_row_values = ((input_row - minimum_element) * inverse_scale)
+                            .round()
+                            .cast<std::uint8_t>();
+  }
+}
+
+void Fused8BitRowwiseQuantizedToFloat(
+    const std::uint8_t* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    float* output) {
+  CAFFE_ENFORCE(isLittleEndian(), "Unsupported endianness");
+  const auto output_columns = input_columns - 8;
+  for (TIndex row = 0; row < input_rows; ++row) {
+    const std::uint8_t* input_row = input + row * input_columns;
+    ConstEigenVectorArrayMap<std::uint8_t> input_row_values(
+        input_row, output_columns);
+    float scale_bias[2];
+    memcpy(scale_bias, input_row + output_columns, sizeof(scale_bias));
+
+    EigenVectorArrayMap<float> output_row(
+        output + row * output_columns, output_columns);
+    output_row =
+        input_row_values.cast<float>() * scale_bias[0] + scale_bias[1];
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "caffe2/core/common.h"
+
+namespace caffe2 {
+
+/**
+ * Row-wise 8-bit quantization of a input_rows x input_columns float matrix.
+ *
+ * Each row of `output` has input_columns + 8 bytes: the quantized values,
+ * followed by the scale and the bias of the row as 32-bit floats.
+ * | ... uint8 data ... | scale | bias |
+ * | input_columns      |  4B   |  4B  |
+ * A value is dequantized as data * scale + bias, where bias is the minimum of
+ * the row and scale is its range divided by 255.
+ */
+void FloatToFused8BitRowwiseQuantized(
+    const float* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    std::uint8_t* output);
+
+/**
+ * Inverse of FloatToFused8BitRowwiseQuantized: `input` has input_rows rows of
+ * input_columns bytes, including the 8 bytes of scale and bias, and `output`
+ * gets input_rows x (input_columns - 8) floats.
+ */
+void Fused8BitRowwiseQuantizedToFloat(
+    const std::uint8_t* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    float* output);
+
+} // namespace caffe2
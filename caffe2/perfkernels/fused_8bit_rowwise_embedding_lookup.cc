@@ -131,6 +131,18 @@ static void Fused8BitRowwiseEmbeddingLookupGenericSlow(
         reinterpret_cast<const uint8_t*>(&one)[0],                                      \
         1,                                                                              \
         "Fused8BitRowwiseEmbeddingLookup is not supported on this platform");           \
+    AVX512_DO(                                                                          \
+        Fused8BitRowwiseEmbeddingLookup_##IndexType##_##InType##_##OutType##_false,     \
+        block_size,                                                                     \
+        output_size,                                                                    \
+        index_size,                                                                     \
+        data_size,                                                                      \
+        input,                                                                          \
+        indices,                                                                        \
+        lengths,                                                                        \
+        weights,                                                                        \
+        normalize_by_lengths,                                                           \
+        out);                                                                           \
     AVX2_FMA_DO(                                                                        \
         Fused8BitRowwiseEmbeddingLookup_##IndexType##_##InType##_##OutType##_false,     \
         block_size,                                                                     \
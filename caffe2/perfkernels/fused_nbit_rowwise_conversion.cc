@@ -0,0 +1,114 @@
+#include "caffe2/perfkernels/fused_nbit_rowwise_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/conversions.h"
+
+namespace caffe2 {
+
+namespace {
+bool isLittleEndian() {
+  const int32_t kValue = 1;
+  return reinterpret_cast<const uint8_t*>(&kValue)[0] == 1;
+}
+
+void enforceBitRate(int bit_rate) {
+  CAFFE_ENFORCE(
+      bit_rate == 1 || bit_rate == 2 || bit_rate == 4 || bit_rate == 8,
+      "Unsupported bit rate ",
+      bit_rate);
+}
+} // namespace
+
+void FloatToFusedNBitRowwiseQuantizedSBHalf(
+    int bit_rate,
+    const float* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    std::uint8_t* output) {
+  CAFFE_ENFORCE(isLittleEndian(), "Unsupported endianness");
+  enforceBitRate(bit_rate);
+  const int values_per_byte = 8 / bit_rate;
+  const int max_value = (1 << bit_rate) - 1;
+  const auto output_columns = FusedNBitRowwiseColumns(bit_rate, input_columns);
+  const auto data_columns = output_columns - 4;
+  for (TIndex row = 0; row < input_rows; ++row) {
+    const float* input_row = input + row * input_columns;
+    std::uint8_t* output_row = output + row * output_columns;
+
+    float minimum_element = 0;
+    float maximum_element = 0;
+    if (input_columns > 0) {
+      const auto minmax =
+          std::minmax_element(input_row, input_row + input_columns);
+      minimum_element = *minmax.first;
+      maximum_element = *minmax.second;
+    }
+    // Quantize against the scale and bias as they are stored, so that the
+    // rounding of the 16-bit floats does not add up to the quantization error
+    const float16 bias = convert::cpu_float2half_rn(minimum_element);
+    const float bias_float = convert::cpu_half2float(bias);
+    float16 scale =
+        convert::cpu_float2half_rn((maximum_element - bias_float) / max_value);
+    float scale_float = convert::cpu_half2float(scale);
+    CAFFE_ENFORCE(
+        std::isfinite(bias_float) && std::isfinite(scale_float),
+        "Row ",
+        row,
+        " has values from ",
+        minimum_element,
+        " to ",
+        maximum_element,
+        ", whose bias or scale overflows a 16-bit float");
+    if (scale_float == 0 || std::isinf(1.0f / scale_float)) {
+      // Constant row, or a range too small for a 16-bit float
+      scale = convert::cpu_float2half_rn(1.0f);
+      scale_float = 1.0f;
+    }
+    const float inverse_scale = 1.0f / scale_float;
+
+    memset(output_row, 0, data_columns);
+    for (TIndex col = 0; col < input_columns; ++col) {
+      const float value =
+          std::round((input_row[col] - bias_float) * inverse_scale);
+      const int quantized = std::max(0, std::min<int>(value, max_value));
+      output_row[col / values_per_byte] |=
+          quantized << ((col % values_per_byte) * bit_rate);
+    }
+    const float16 scale_bias[2] = {scale, bias};
+    memcpy(output_row + data_columns, scale_bias, sizeof(scale_bias));
+  }
+}
+
+void FusedNBitRowwiseQuantizedSBHalfToFloat(
+    int bit_rate,
+    const std::uint8_t* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    float* output) {
+  CAFFE_ENFORCE(isLittleEndian(), "Unsupported endianness");
+  enforceBitRate(bit_rate);
+  const int values_per_byte = 8 / bit_rate;
+  const int mask = (1 << bit_rate) - 1;
+  const auto output_columns = FusedNBitRowwiseValues(bit_rate, input_columns);
+  for (TIndex row = 0; row < input_rows; ++row) {
+    const std::uint8_t* input_row = input + row * input_columns;
+    float16 scale_bias[2];
+    memcpy(scale_bias, input_row + input_columns - 4, sizeof(scale_bias));
+    const float scale = convert::cpu_half2float(scale_bias[0]);
+    const float bias = convert::cpu_half2float(scale_bias[1]);
+
+    float* output_row = output + row * output_columns;
+    for (TIndex col = 0; col < output_columns; ++col) {
+      const int quantized = (input_row[col / values_per_byte] >>
+                             ((col % values_per_byte) * bit_rate)) &
+          mask;
+      output_row[col] = quantized * scale + bias;
+    }
+  }
+}
+
+} // namespace caffe2
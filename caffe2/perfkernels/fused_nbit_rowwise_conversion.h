@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include "caffe2/core/common.h"
+
+namespace caffe2 {
+
+/**
+ * Row-wise quantization of a input_rows x input_columns float matrix to
+ * bit_rate bits per value, with bit_rate among 1, 2, 4 and 8.
+ *
+ * Each row of `output` has FusedNBitRowwiseColumns(bit_rate, input_columns)
+ * bytes: the quantized values packed 8 / bit_rate per byte, starting from the
+ * least significant bits, followed by the scale and the bias of the row as
+ * 16-bit floats.
+ * | ... packed data ...                       | scale | bias |
+ * | ceil(input_columns * bit_rate / 8) bytes  |  2B   |  2B  |
+ * A value is dequantized as data * scale + bias, where bias is the minimum of
+ * the row and scale is its range divided by 2^bit_rate - 1, both rounded to
+ * 16-bit floats. Throws if they overflow 16-bit floats, whose largest value
+ * is 65504.
+ */
+void FloatToFusedNBitRowwiseQuantizedSBHalf(
+    int bit_rate,
+    const float* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    std::uint8_t* output);
+
+/**
+ * Inverse of FloatToFusedNBitRowwiseQuantizedSBHalf: `input` has input_rows
+ * rows of input_columns bytes, including the 4 bytes of scale and bias, and
+ * `output` gets input_rows x FusedNBitRowwiseValues(bit_rate, input_columns)
+ * floats. Rows whose number of values is not a multiple of 8 / bit_rate are
+ * padded with zeros, which come back as extra values equal to the bias.
+ */
+void FusedNBitRowwiseQuantizedSBHalfToFloat(
+    int bit_rate,
+    const std::uint8_t* input,
+    TIndex input_rows,
+    TIndex input_columns,
+    float* output);
+
+// Number of bytes of a fused row of `values` values at bit_rate bits
+inline TIndex FusedNBitRowwiseColumns(int bit_rate, TIndex values) {
+  const int values_per_byte = 8 / bit_rate;
+  return (values + values_per_byte - 1) / values_per_byte + 4;
+}
+
+// Number of values of a fused row of `columns` bytes at bit_rate bits
+inline TIndex FusedNBitRowwiseValues(int bit_rate, TIndex columns) {
+  return (columns - 4) * (8 / bit_rate);
+}
+
+} // namespace caffe2
@@ -0,0 +1,163 @@
+#include "caffe2/perfkernels/fused_nbit_rowwise_embedding_lookup.h"
+
+#include "caffe2/core/types.h"
+#include "caffe2/perfkernels/common.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/utils/cpuid.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Base implementation unpacks the values one at a time
+template <typename IndexType, typename OutType>
+static void FusedNBitRowwiseEmbeddingLookupGenericSlow(
+    const int bit_rate,
+    const TIndex block_size,
+    const TIndex output_size,
+    const TIndex index_size,
+    const TIndex data_size,
+    const uint8_t* input,
+    const IndexType* indices,
+    const int* lengths,
+    const float* weights, // optional, can be null for sum reducer
+    bool normalize_by_lengths,
+    OutType* out) {
+  const int values_per_byte = 8 / bit_rate;
+  const int mask = (1 << bit_rate) - 1;
+  // block_size is the number of elements and fused_block_size is the size of
+  // an entire row, including scale and bias.
+  const TIndex fused_block_size =
+      (block_size + values_per_byte - 1) / values_per_byte + 4;
+  TIndex current = 0;
+  for (int m = 0; m < output_size; ++m) {
+    memset(out, 0, sizeof(OutType) * block_size);
+    for (int i = 0; i < lengths[m]; ++i) {
+      CAFFE_ENFORCE_LT(current, index_size);
+      TIndex idx = indices[current];
+      CAFFE_ENFORCE(
+          0 <= idx && idx < data_size,
+          "Index ",
+          current,
+          " is out of bounds: ",
+          idx,
+          ", range 0 to ",
+          data_size);
+#ifdef __GNUC__
+      if (current + 1 < index_size) {
+        __builtin_prefetch(
+            input + fused_block_size * indices[current + 1], 0, 1);
+      }
+#endif // __GNUC__
+
+      const uint8_t* row = input + fused_block_size * idx;
+      float16 scale_bias[2];
+      memcpy(scale_bias, row + fused_block_size - 4, sizeof(scale_bias));
+
+      const float weight = weights ? weights[current] : 1.0f;
+      const float scale = weight * convert::cpu_half2float(scale_bias[0]);
+      const float bias = weight * convert::cpu_half2float(scale_bias[1]);
+
+      for (TIndex k = 0; k < block_size; ++k) {
+        const int quantized =
+            (row[k / values_per_byte] >> ((k % values_per_byte) * bit_rate)) &
+            mask;
+        out[k] += quantized * scale + bias;
+      }
+
+      ++current;
+    }
+    if (normalize_by_lengths && lengths[m]) {
+      // hack: context is not really used
+      math::Scale<OutType, CPUContext>(
+          block_size, 1.f / lengths[m], out, out, nullptr);
+    }
+    out += block_size;
+  }
+  CAFFE_ENFORCE_EQ(
+      current,
+      index_size,
+      "Your input seems to be incorrect: the sum of lengths values should be "
+      "the size of the indices tensor, but it appears not.");
+}
+
+// Proxy back to generic implementation
+#define FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION(IndexType, OutType)         \
+  void FusedNBitRowwiseEmbeddingLookup_##IndexType##_uint8_t_##OutType##__base( \
+      const int bit_rate,                                                       \
+      const TIndex block_size,                                                  \
+      const TIndex output_size,                                                 \
+      const TIndex index_size,                                                  \
+      const TIndex data_size,                                                   \
+      const uint8_t* input,                                                     \
+      const IndexType* indices,                                                 \
+      const int* lengths,                                                       \
+      const float* weights,                                                     \
+      bool normalize_by_lengths,                                                \
+      OutType* out) {                                                           \
+    FusedNBitRowwiseEmbeddingLookupGenericSlow<IndexType, OutType>(             \
+        bit_rate,                                                               \
+        block_size,                                                             \
+        output_size,                                                            \
+        index_size,                                                             \
+        data_size,                                                              \
+        input,                                                                  \
+        indices,                                                                \
+        lengths,                                                                \
+        weights,                                                                \
+        normalize_by_lengths,                                                   \
+        out);                                                                   \
+  }                                                                             \
+  template <>                                                                   \
+  void FusedNBitRowwiseEmbeddingLookup<IndexType, OutType>(                     \
+      const int bit_rate,                                                       \
+      const TIndex block_size,                                                  \
+      const TIndex output_size,                                                 \
+      const TIndex index_size,                                                  \
+      const TIndex data_size,                                                   \
+      const uint8_t* input,                                                     \
+      const IndexType* indices,                                                 \
+      const int* lengths,                                                       \
+      const float* weights,                                                     \
+      bool normalize_by_lengths,                                                \
+      OutType* out) {                                                           \
+    const int32_t one = 1;                                                      \
+    CAFFE_ENFORCE_EQ(                                                           \
+        reinterpret_cast<const uint8_t*>(&one)[0],                              \
+        1,                                                                      \
+        "FusedNBitRowwiseEmbeddingLookup is not supported on this platform");   \
+    CAFFE_ENFORCE(                                                              \
+        bit_rate == 2 || bit_rate == 4, "Unsupported bit rate ", bit_rate);     \
+    AVX2_FMA_DO(                                                                \
+        FusedNBitRowwiseEmbeddingLookup_##IndexType##_uint8_t_##OutType,        \
+        bit_rate,                                                               \
+        block_size,                                                             \
+        output_size,                                                            \
+        index_size,                                                             \
+        data_size,                                                              \
+        input,                                                                  \
+        indices,                                                                \
+        lengths,                                                                \
+        weights,                                                                \
+        normalize_by_lengths,                                                   \
+        out);                                                                   \
+    BASE_DO(                                                                    \
+        FusedNBitRowwiseEmbeddingLookup_##IndexType##_uint8_t_##OutType,        \
+        bit_rate,                                                               \
+        block_size,                                                             \
+        output_size,                                                            \
+        index_size,                                                             \
+        data_size,                                                              \
+        input,                                                                  \
+        indices,                                                                \
+        lengths,                                                                \
+        weights,                                                                \
+        normalize_by_lengths,                                                   \
+        out);                                                                   \
+  }
+
+FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION(int32_t, float);
+FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION(int64_t, float);
+
+#undef FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION
+
+} // namespace caffe2
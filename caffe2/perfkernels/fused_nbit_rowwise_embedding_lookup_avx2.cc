@@ -0,0 +1,192 @@
+#include "caffe2/core/common.h"
+#include "caffe2/core/types.h"
+#include "caffe2/perfkernels/cvtsh_ss_bugfix.h"
+
+#include <immintrin.h>
+
+namespace caffe2 {
+
+namespace {
+
+// Loads the BIT_RATE bytes packing 8 values
+template <int BIT_RATE>
+inline uint32_t LoadPacked8(const uint8_t* ip);
+
+template <>
+inline uint32_t LoadPacked8<4>(const uint8_t* ip) {
+  uint32_t packed;
+  memcpy(&packed, ip, sizeof(packed));
+  return packed;
+}
+
+template <>
+inline uint32_t LoadPacked8<2>(const uint8_t* ip) {
+  uint16_t packed;
+  memcpy(&packed, ip, sizeof(packed));
+  return packed;
+}
+
+// The values are unpacked 8 at a time in registers: the BIT_RATE bytes
+// holding them are broadcast to the 8 lanes, and every lane shifts its value
+// down to the least significant bits. The biases of a segment are summed and
+// added once at the end.
+template <typename IndexType, int BIT_RATE>
+void FusedNBitRowwiseEmbeddingLookupAvx2(
+    const TIndex block_size,
+    const TIndex output_size,
+    const TIndex index_size,
+    const TIndex data_size,
+    const uint8_t* input,
+    const IndexType* indices,
+    const int* lengths,
+    const float* weights,
+    bool normalize_by_lengths,
+    float* out) {
+  constexpr int kValuesPerByte = 8 / BIT_RATE;
+  const IndexType prefdist_T0 = 16;
+  // block_size is the number of elements and fused_block_size is the size of
+  // an entire row, including scale and bias.
+  const TIndex fused_block_size =
+      (block_size + kValuesPerByte - 1) / kValuesPerByte + 4;
+  const __m256i vshift = _mm256_setr_epi32(
+      0,
+      BIT_RATE,
+      2 * BIT_RATE,
+      3 * BIT_RATE,
+      4 * BIT_RATE,
+      5 * BIT_RATE,
+      6 * BIT_RATE,
+      7 * BIT_RATE);
+  const __m256i vmask = _mm256_set1_epi32((1 << BIT_RATE) - 1);
+
+  IndexType dataInd = 0;
+  for (IndexType rangeIndex = 0; rangeIndex < output_size; ++rangeIndex) {
+    float* op = &out[rangeIndex * block_size];
+    TIndex j = 0;
+    for (; j + 8 <= block_size; j += 8) {
+      _mm256_storeu_ps(op + j, _mm256_setzero_ps());
+    }
+    for (; j < block_size; j++) {
+      op[j] = 0.0f;
+    }
+    float bias_sum = 0;
+    for (IndexType start = dataInd; dataInd < start + lengths[rangeIndex];
+         ++dataInd) {
+      const IndexType idx = indices[dataInd];
+      CAFFE_ENFORCE(
+          idx >= 0 && idx < data_size,
+          "Index ",
+          dataInd,
+          " is out of bounds: ",
+          idx,
+          ", range 0 to ",
+          data_size);
+      const uint8_t* ip = &input[idx * fused_block_size];
+      const IndexType next_T0 = (dataInd < index_size - prefdist_T0)
+          ? (dataInd + prefdist_T0)
+          : dataInd;
+      const IndexType idx_pref_T0 = indices[next_T0];
+      CAFFE_ENFORCE(idx_pref_T0 >= 0 && idx_pref_T0 < data_size);
+      const uint8_t* ip_next_T0 = &input[idx_pref_T0 * fused_block_size];
+      for (TIndex b = 0; b < fused_block_size; b += 64) {
+        _mm_prefetch(
+            reinterpret_cast<const char*>(&ip_next_T0[b]), _MM_HINT_T0);
+      }
+
+      uint16_t scale_bias[2];
+      memcpy(scale_bias, ip + fused_block_size - 4, sizeof(scale_bias));
+      const float wgt = weights ? weights[dataInd] : 1.f;
+      const float scale = wgt * _cvtsh_ss(scale_bias[0]);
+      bias_sum += wgt * _cvtsh_ss(scale_bias[1]);
+      const __m256 vscale = _mm256_set1_ps(scale);
+
+      j = 0;
+      for (; j + 8 <= block_size; j += 8) {
+        const __m256i vpacked = _mm256_set1_epi32(
+            LoadPacked8<BIT_RATE>(ip + j / kValuesPerByte));
+        const __m256 vvalues = _mm256_cvtepi32_ps(
+            _mm256_and_si256(_mm256_srlv_epi32(vpacked, vshift), vmask));
+        _mm256_storeu_ps(
+            op + j, _mm256_fmadd_ps(vvalues, vscale, _mm256_loadu_ps(op + j)));
+      }
+      for (; j < block_size; j++) {
+        const int quantized = (ip[j / kValuesPerByte] >>
+                               ((j % kValuesPerByte) * BIT_RATE)) &
+            ((1 << BIT_RATE) - 1);
+        op[j] += quantized * scale;
+      }
+    }
+
+    const __m256 vbias = _mm256_set1_ps(bias_sum);
+    j = 0;
+    for (; j + 8 <= block_size; j += 8) {
+      _mm256_storeu_ps(op + j, _mm256_add_ps(_mm256_loadu_ps(op + j), vbias));
+    }
+    for (; j < block_size; j++) {
+      op[j] += bias_sum;
+    }
+
+    if (normalize_by_lengths && lengths[rangeIndex]) {
+      float len_inv = 1.0f / lengths[rangeIndex];
+      __m256 vlen_inv = _mm256_set1_ps(len_inv);
+      j = 0;
+      for (; j + 8 <= block_size; j += 8) {
+        _mm256_storeu_ps(
+            &op[j], _mm256_mul_ps(_mm256_loadu_ps(&op[j]), vlen_inv));
+      }
+      for (; j < block_size; j++) {
+        op[j] = len_inv * op[j];
+      }
+    }
+  }
+}
+
+} // namespace
+
+#define FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION(IndexType)                \
+  void FusedNBitRowwiseEmbeddingLookup_##IndexType##_uint8_t_float__avx2_fma( \
+      const int bit_rate,                                                     \
+      const TIndex block_size,                                                \
+      const TIndex output_size,                                               \
+      const TIndex index_size,                                                \
+      const TIndex data_size,                                                 \
+      const uint8_t* input,                                                   \
+      const IndexType* indices,                                               \
+      const int* lengths,                                                     \
+      const float* weights,                                                   \
+      bool normalize_by_lengths,                                              \
+      float* out) {                                                           \
+    if (bit_rate == 4) {                                                      \
+      FusedNBitRowwiseEmbeddingLookupAvx2<IndexType, 4>(                      \
+          block_size,                                                         \
+          output_size,                                                        \
+          index_size,                                                         \
+          data_size,                                                          \
+          input,                                                              \
+          indices,                                                            \
+          lengths,                                                            \
+          weights,                                                            \
+          normalize_by_lengths,                                               \
+          out);                                                               \
+    } else {                                                                  \
+      CAFFE_ENFORCE_EQ(bit_rate, 2, "Unsupported bit rate");                  \
+      FusedNBitRowwiseEmbeddingLookupAvx2<IndexType, 2>(                      \
+          block_size,                                                         \
+          output_size,                                                        \
+          index_size,                                                         \
+          data_size,                                                          \
+          input,                                                              \
+          indices,                                                            \
+          lengths,                                                            \
+          weights,                                                            \
+          normalize_by_lengths,                                               \
+          out);                                                               \
+    }                                                                         \
+  }
+
+FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION(int32_t);
+FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION(int64_t);
+
+#undef FUSED_NBIT_ROWWISE_EMBEDDING_SPECIALIZATION
+
+} // namespace caffe2
@@ -7,12 +7,58 @@ import sys
 
 sizeof = {'float': 4, 'float16': 2, 'uint8_t': 1}
 
+# Number of floats in a register, and naming of the vector types, intrinsics
+# and generated functions for every supported instruction set
+isas = {
+    'avx2': {
+        'width': 8, 'vtype': '__m256', 'prefix': '_mm256',
+        'suffix': '__avx2_fma'},
+    'avx512': {
+        'width': 16, 'vtype': '__m512', 'prefix': '_mm512',
+        'suffix': '__avx512'},
+}
+
+# Block sizes with a fully unrolled loop, with their unrolling factor
+unrolled_block_sizes = {
+    'avx2': [(128, 16), (64, 8), (32, 4), (16, 2)],
+    'avx512': [(256, 16), (128, 8), (64, 4), (32, 2), (16, 1)],
+}
+
+
+def weight_index(fused):
+    # Only the fused lookups support positional weights
+    if fused:
+        return "wgt = weights[IS_WEIGHT_POSITIONAL ? (dataInd - start) : dataInd];"
+    return "wgt = weights[dataInd];"
+
 
 def unroll(uf, IndexType, InType, OutType, use_weights, isa, fused):
+    def compute_avx512(regid, InType):
+        if InType == "float":
+            load = "_mm512_loadu_ps(ip + (%d))" % regid
+        elif InType == "float16":
+            load = (
+                "_mm512_cvtph_ps(_mm256_loadu_si256("
+                "reinterpret_cast<const __m256i*>(ip + (%d))))" % regid
+            )
+        elif InType == "uint8_t":
+            load = (
+                "_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128("
+                "reinterpret_cast<const __m128i*>(ip + (%d)))))" % regid
+            )
+        else:
+            assert False
+        acc = "vop%d" % regid
+        if InType == "uint8_t":
+            acc = "_mm512_add_ps(vop%d, vbio)" % regid
+        return "vop%d = _mm512_fmadd_ps(vwgt, %s, %s);" % (regid, load, acc)
+
     def compute(regid, InType, use_weights, isa, prefetch):
         code = []
 
-        if InType == "float":
+        if isa == "avx512":
+            code.append(compute_avx512(regid, InType))
+        elif InType == "float":
             code.append(
                 "vop%d = _mm256_fmadd_ps(vwgt,  \
                   _mm256_loadu_ps(ip + (%d)), vop%d);"
@@ -48,9 +94,13 @@ def unroll(uf, IndexType, InType, OutType, use_weights, isa, fused):
     code.append("for (" + IndexType +
                 " rangeIndex = 0; rangeIndex < output_size; ++rangeIndex) {")
     code.append(OutType + " *op = &out[rangeIndex * block_size];")
+    width = isas[isa]['width']
+    vtype = isas[isa]['vtype']
+    prefix = isas[isa]['prefix']
     for i in range(0, uf):
-        j = 8 * i
-        code.append("__m256 vop" + str(j) + " = _mm256_setzero_ps();")
+        j = width * i
+        code.append(
+            "{} vop{} = {}_setzero_ps();".format(vtype, j, prefix))
 
     # inner loop
     code.append("for (" + IndexType +
@@ -64,27 +114,21 @@ def unroll(uf, IndexType, InType, OutType, use_weights, isa, fused):
         code.append(OutType + " wgt = 1.f;")
         code.append(OutType + " bio;")
         code.append("if (weights) {")
-        code.append(
-            "wgt = weights[IS_WEIGHT_POSITIONAL ? (dataInd - start) : dataInd];")
+        code.append(weight_index(fused))
         code.append("}")
-        if fused:
-            code.append(
-                'const float* scale_bias = reinterpret_cast<'
-                'const float*>(&input[idx * fused_block_size + block_size]);'
-            )
-            code.append("bio = wgt * scale_bias[1];")
-            code.append("wgt = wgt * scale_bias[0];")
-        else:
-            code.append("bio = wgt * scale_bias[2 * idx + 1];")
-            code.append("wgt = wgt * scale_bias[2 * idx];")
-        code.append("__m256 vbio = _mm256_set1_ps(bio);")
+        code.append(
+            'const float* scale_bias = reinterpret_cast<'
+            'const float*>(&input[idx * fused_block_size + block_size]);'
+        )
+        code.append("bio = wgt * scale_bias[1];")
+        code.append("wgt = wgt * scale_bias[0];")
+        code.append("{} vbio = {}_set1_ps(bio);".format(vtype, prefix))
     else:
         code.append(OutType + " wgt = 1.f;")
         code.append("if (weights) {")
-        code.append(
-            "wgt = weights[IS_WEIGHT_POSITIONAL ? (dataInd - start) : dataInd];")
+        code.append(weight_index(fused))
         code.append("}")
-    code.append("__m256 vwgt = _mm256_set1_ps(wgt);")
+    code.append("{} vwgt = {}_set1_ps(wgt);".format(vtype, prefix))
 
     code.append("const {} *ip = &input[idx * fused_block_size];".format(InType))
     code.append(
@@ -101,26 +145,150 @@ def unroll(uf, IndexType, InType, OutType, use_weights, isa, fused):
     )
 
     for i in range(0, uf):
-        j = 8 * i
+        j = width * i
         cachelinesize = 64
         byteoffset = sizeof[InType] * j
         prefetch = (byteoffset % cachelinesize) == 0
         code.extend(compute(j, InType, use_weights, isa, prefetch))
     code.append("}")
 
-    code.append("if (normalize_by_lengths == false) {")
+    # Empty segments store their zeroed accumulators
+    code.append(
+        "if (normalize_by_lengths == false || lengths[rangeIndex] == 0) {")
     for i in range(0, uf):
-        j = 8 * i
-        code.append(
-            "_mm256_storeu_ps(&op[" + str(j) + "], vop" + str(j) + ");")
-    code.append("} else if (lengths[rangeIndex]) {")
+        j = width * i
+        code.append("{}_storeu_ps(&op[{}], vop{});".format(prefix, j, j))
+    code.append("} else {")
     # inv of length
     code.append(
-        "__m256 vlen_inv = _mm256_set1_ps(1.0f / lengths[rangeIndex]);")
+        "{} vlen_inv = {}_set1_ps(1.0f / lengths[rangeIndex]);".format(
+            vtype, prefix))
     for i in range(0, uf):
-        j = 8 * i
+        j = width * i
         code.append(
-            "_mm256_storeu_ps(&op[" + str(j) + "], _mm256_mul_ps(" + "vop" + str(j) + ", vlen_inv));")
+            "{}_storeu_ps(&op[{}], {}_mul_ps(vop{}, vlen_inv));".format(
+                prefix, j, prefix, j))
+    code.append("}")
+
+    code.append("}")
+    return code
+
+
+def generic_avx512(IndexType, InType, OutType, use_weights, fused):
+    # Leftover elements go through masked loads and stores, which do not fault
+    # on the masked off elements past the end of a row
+    def load(InType, ptr, masked):
+        if InType == "float":
+            if masked:
+                return "_mm512_maskz_loadu_ps(tail_mask, %s)" % ptr
+            return "_mm512_loadu_ps(%s)" % ptr
+        elif InType == "float16":
+            if masked:
+                return "_mm512_cvtph_ps(_mm256_maskz_loadu_epi16(tail_mask, %s))" % ptr
+            return (
+                "_mm512_cvtph_ps(_mm256_loadu_si256("
+                "reinterpret_cast<const __m256i*>(%s)))" % ptr
+            )
+        elif InType == "uint8_t":
+            if masked:
+                inner = "_mm_maskz_loadu_epi8(tail_mask, %s)" % ptr
+            else:
+                inner = (
+                    "_mm_loadu_si128(reinterpret_cast<const __m128i*>(%s))" % ptr
+                )
+            return "_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(%s))" % inner
+        else:
+            assert False
+
+    def compute(InType, masked):
+        code = []
+        acc = load("float", "&op[j]", masked)
+        if InType == "uint8_t":
+            acc = "_mm512_add_ps(%s, vbio)" % acc
+        value = "_mm512_fmadd_ps(vwgt, %s, %s)" % (
+            load(InType, "&ip[j]", masked), acc)
+        if masked:
+            code.append("_mm512_mask_storeu_ps(&op[j], tail_mask, %s);" % value)
+        else:
+            code.append("_mm512_storeu_ps(&op[j], %s);" % value)
+            code.append("_mm_prefetch((&ip_next_T0[j]), _MM_HINT_T0);")
+        return code
+
+    code = []
+    code.append(
+        "const __mmask16 tail_mask = "
+        "static_cast<__mmask16>((1 << (block_size % 16)) - 1);")
+    code.append(IndexType + " dataInd = 0;")
+    code.append("for (" + IndexType +
+                " rangeIndex = 0; rangeIndex < output_size; ++rangeIndex) {")
+    code.append(OutType + " *op = &out[rangeIndex * block_size];")
+
+    # initialize to 0
+    code.append("TIndex j = 0;")
+    code.append("for(; j + 16 <= block_size; j += 16) {")
+    code.append("_mm512_storeu_ps(op + j, _mm512_setzero_ps());")
+    code.append("}")
+    code.append("_mm512_mask_storeu_ps(op + j, tail_mask, _mm512_setzero_ps());")
+
+    # inner loop
+    code.append("for (" + IndexType +
+                " start = dataInd; dataInd < start + lengths[rangeIndex]; ++dataInd) {")
+    code.append("const  " + IndexType + " idx = indices[dataInd];")
+    code.append(
+        'CAFFE_ENFORCE(idx >=0 && idx < data_size, "Index ", dataInd, "' +
+        ' is out of bounds: ", idx, ", range 0 to ", data_size);')
+
+    code.append(OutType + " wgt = 1.f;")
+    if InType == "uint8_t":
+        code.append(OutType + " bio;")
+    code.append("if (weights) {")
+    code.append(weight_index(fused))
+    code.append("}")
+    if InType == "uint8_t":
+        code.append(
+            'const float* scale_bias = reinterpret_cast<'
+            'const float*>(&input[idx * fused_block_size + block_size]);'
+        )
+        code.append("bio = wgt * scale_bias[1];")
+        code.append("wgt = wgt * scale_bias[0];")
+        code.append("__m512 vbio = _mm512_set1_ps(bio);")
+    code.append("__m512 vwgt = _mm512_set1_ps(wgt);")
+
+    code.append("const {} *ip = &input[idx * fused_block_size];".format(InType))
+    code.append(
+        'const {} next_T0 = (dataInd < index_size - prefdist_T0)'
+        ' ? (dataInd + prefdist_T0) : dataInd;'.format(IndexType)
+    )
+    code.append("const  " + IndexType + " idx_pref_T0 = indices[next_T0];")
+    code.append(
+        "CAFFE_ENFORCE(idx_pref_T0 >= 0 && idx_pref_T0 < data_size);")
+    code.append(
+        "const {} *ip_next_T0 = &input[idx_pref_T0 * fused_block_size];".
+        format(InType)
+    )
+
+    # compute and store main loop
+    code.append("j = 0;")
+    code.append("for(; j + 16 <= block_size; j += 16) {")
+    code.extend(compute(InType, False))
+    code.append("}")
+    # leftover
+    code.extend(compute(InType, True))
+
+    code.append("}")
+
+    code.append("if (normalize_by_lengths && lengths[rangeIndex]) {")
+    code.append("float len_inv = 1.0f / lengths[rangeIndex];")
+    code.append("__m512 vlen_inv = _mm512_set1_ps(len_inv);")
+    code.append("j = 0;")
+    code.append("for(; j + 16 <= block_size; j += 16) {")
+    code.append(
+        "_mm512_storeu_ps(&op[j], _mm512_mul_ps(_mm512_loadu_ps(&op[j]), vlen_inv));")
+    code.append("}")
+    code.append(
+        "_mm512_mask_storeu_ps(&op[j], tail_mask, "
+        "_mm512_mul_ps(_mm512_maskz_loadu_ps(tail_mask, &op[j]), vlen_inv));")
+
     code.append("}")
 
     code.append("}")
@@ -128,6 +296,8 @@ def unroll(uf, IndexType, InType, OutType, use_weights, isa, fused):
 
 
 def generic(IndexType, InType, OutType, use_weights, isa, fused):
+    if isa == "avx512":
+        return generic_avx512(IndexType, InType, OutType, use_weights, fused)
 
     def compute(InType, use_weights, isa):
         code = []
@@ -186,26 +356,19 @@ def generic(IndexType, InType, OutType, use_weights, isa, fused):
         code.append(OutType + " wgt = 1.f;")
         code.append(OutType + " bio;")
         code.append("if (weights) {")
-        code.append(
-            "wgt = weights[IS_WEIGHT_POSITIONAL ? (dataInd - start) : dataInd];")
+        code.append(weight_index(fused))
         code.append("}")
-        if fused:
-            code.append(
-                'const float* scale_bias = reinterpret_cast<'
-                'const float*>(&input[idx * fused_block_size + block_size]);'
-            )
-            code.append("bio = wgt * scale_bias[1];")
-            code.append("wgt = wgt * scale_bias[0];")
-        else:
-            code.append("assert (scale_bias);")
-            code.append("bio = wgt * scale_bias[2 * idx + 1];")
-            code.append("wgt = wgt * scale_bias[2 * idx];")
+        code.append(
+            'const float* scale_bias = reinterpret_cast<'
+            'const float*>(&input[idx * fused_block_size + block_size]);'
+        )
+        code.append("bio = wgt * scale_bias[1];")
+        code.append("wgt = wgt * scale_bias[0];")
         code.append("__m256 vbio = _mm256_set1_ps(bio);")
     else:
         code.append(OutType + " wgt = 1.f;")
         code.append("if (weights) {")
-        code.append(
-            "wgt = weights[IS_WEIGHT_POSITIONAL ? (dataInd - start) : dataInd];")
+        code.append(weight_index(fused))
         code.append("}")
     code.append("__m256 vwgt = _mm256_set1_ps(wgt);")
 
@@ -268,21 +431,24 @@ def generic(IndexType, InType, OutType, use_weights, isa, fused):
 parser = argparse.ArgumentParser()
 parser.add_argument('-f', '--filename', help="file name")
 parser.add_argument('--fused', action='store_true')
+parser.add_argument('--isa', choices=sorted(isas.keys()), default='avx2')
 opts = parser.parse_args()
 if opts.filename:
     filename = opts.filename
 elif opts.fused:
-    filename = "embedding_lookup_fused_8bit_rowwise_avx2.cc"
+    filename = "embedding_lookup_fused_8bit_rowwise_{}.cc".format(opts.isa)
 else:
-    filename = "embedding_lookup_avx2.cc"
+    filename = "embedding_lookup_{}.cc".format(opts.isa)
 fout = open(filename, 'w')
 
 options = [["int32_t", "float", "float"],
            ["int64_t", "float", "float"],
            ["int32_t", "float16", "float"],
-           ["int64_t", "float16", "float"],
-           ["int32_t", "uint8_t", "float"],
-           ["int64_t", "uint8_t", "float"]]
+           ["int64_t", "float16", "float"]]
+# Only the fused lookups read uint8_t rows, with their scale and bias
+if opts.fused:
+    options += [["int32_t", "uint8_t", "float"],
+                ["int64_t", "uint8_t", "float"]]
 
 code = []
 # includes
@@ -303,12 +469,15 @@ for o in options:
     [IndexType, InType, OutType] = o
 
     prefix = 'Fused8BitRowwise' if opts.fused else ''
-    code.append('template <bool IS_WEIGHT_POSITIONAL>')
     fn_base = '{}EmbeddingLookup_{}_{}_{}'.format(
         prefix, IndexType, InType, OutType
     )
-    suffix = '__avx2_fma'
-    fn = "static void " + fn_base + suffix
+    suffix = isas[opts.isa]['suffix']
+    if opts.fused:
+        code.append('template <bool IS_WEIGHT_POSITIONAL>')
+        fn = "static void " + fn_base + suffix
+    else:
+        fn = "void " + fn_base + suffix
     code.append(fn + "(")
 
     args = []
@@ -320,8 +489,6 @@ for o in options:
     args.append("const " + IndexType + "* indices,")
     args.append("const int* lengths,")
     args.append("const float* weights,")
-    if not opts.fused:
-        args.append("const float* scale_bias,")
     args.append("bool normalize_by_lengths,")
     args.append(OutType + "* out)")
     code += args
@@ -337,52 +504,38 @@ for o in options:
     )
 
     #code.append("printf(\"calling " + fn + "\\n\");");
-    if not opts.fused:
-        if InType != "uint8_t":
-            code.append(
-                'CAFFE_ENFORCE(scale_bias == nullptr,'
-                ' "scale_bias must be nullptr");'
-            )
-        else:
-            code.append(
-                'CAFFE_ENFORCE(scale_bias != nullptr,'
-                ' "scale_bias must not be nullptr");'
-            )
 
-    code.append("if (block_size == 128) {")
-    code += unroll(16, IndexType, InType, OutType, True, "AVX2", opts.fused)
-    code.append("} else if (block_size == 64) {")
-    code += unroll(8, IndexType, InType, OutType, True, "AVX2", opts.fused)
-    code.append("} else if (block_size == 32) {")
-    code += unroll(4, IndexType, InType, OutType, True, "AVX2", opts.fused)
-    code.append("} else if (block_size == 16) {")
-    code += unroll(2, IndexType, InType, OutType, True, "AVX2", opts.fused)
+    for i, (block_size, uf) in enumerate(unrolled_block_sizes[opts.isa]):
+        code.append(
+            "{}if (block_size == {}) {{".format("} else " if i else "",
+                                                 block_size))
+        code += unroll(uf, IndexType, InType, OutType, True, opts.isa,
+                       opts.fused)
     code.append("} else {")
     code.append("// generic code")
-    code += generic(IndexType, InType, OutType, True, "AVX2", opts.fused)
+    code += generic(IndexType, InType, OutType, True, opts.isa, opts.fused)
     code.append("}")
 
     code.append("}")
 
-    for is_weight_positional in ['false', 'true']:
-        code.append(
-            "void " + fn_base + "_" + is_weight_positional + suffix + "(")
-        code += args
-        code.append("{")
-        code.append(fn_base + suffix + "<" + is_weight_positional + ">(")
-        code.append("block_size,")
-        code.append("output_size,")
-        code.append("index_size,")
-        code.append("data_size,")
-        code.append("input,")
-        code.append("indices,")
-        code.append("lengths,")
-        code.append("weights,")
-        if not opts.fused:
-            code.append("scale_bias,")
-        code.append("normalize_by_lengths,")
-        code.append("out);")
-        code.append("}")
+    if opts.fused:
+        for is_weight_positional in ['false', 'true']:
+            code.append(
+                "void " + fn_base + "_" + is_weight_positional + suffix + "(")
+            code += args
+            code.append("{")
+            code.append(fn_base + suffix + "<" + is_weight_positional + ">(")
+            code.append("block_size,")
+            code.append("output_size,")
+            code.append("index_size,")
+            code.append("data_size,")
+            code.append("input,")
+            code.append("indices,")
+            code.append("lengths,")
+            code.append("weights,")
+            code.append("normalize_by_lengths,")
+            code.append("out);")
+            code.append("}")
 
     code.append("\n")
 
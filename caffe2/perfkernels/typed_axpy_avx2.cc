@@ -43,4 +43,27 @@ void TypedAxpy_float16_float__avx2_fma(
   }
 }
 
+void TypedAxpy_uint8_float__avx2_fma(
+    int N,
+    const float a,
+    const uint8_t* x,
+    float* y) {
+  // Converts 8 bytes at a time to 8 floats
+  __m256 mma = _mm256_set1_ps(a);
+  int current = 0;
+
+  for (; current + 8 <= N; current += 8) {
+    __m256i mmx_32i = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + current)));
+    __m256 mmx_32 = _mm256_cvtepi32_ps(mmx_32i);
+    __m256 mmy = _mm256_loadu_ps(y + current);
+    mmy = _mm256_fmadd_ps(mmx_32, mma, mmy);
+    _mm256_storeu_ps(y + current, mmy);
+  }
+
+  for (; current < N; ++current) {
+    y[current] += (float)(x[current]) * a;
+  }
+}
+
 } // namespace caffe2
@@ -5,6 +5,7 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <thread>
 
 #include "caffe2/core/blob_stats.h"
 #include "caffe2/core/logging.h"
@@ -12,6 +13,16 @@
 #include "caffe2/core/tensor.h"
 #include "caffe2/core/workspace.h"
 
+CAFFE2_DEFINE_bool(
+    caffe2_blobs_queue_lock_free,
+    false,
+    "Use the lock free implementation of BlobsQueue");
+CAFFE2_DEFINE_int(
+    caffe2_blobs_queue_spin_iterations,
+    100,
+    "Number of times a reader or writer of an empty or full BlobsQueue polls "
+    "before going to sleep");
+
 namespace caffe2 {
 
 BlobsQueue::BlobsQueue(
@@ -21,7 +32,9 @@ BlobsQueue::BlobsQueue(
     size_t numBlobs,
     bool enforceUniqueName,
     const std::vector<std::string>& fieldNames)
-    : numBlobs_(numBlobs), stats_(queueName) {
+    : lockFree_(FLAGS_caffe2_blobs_queue_lock_free),
+      numBlobs_(numBlobs),
+      stats_(queueName) {
   if (!fieldNames.empty()) {
     CAFFE_ENFORCE_EQ(
         fieldNames.size(), numBlobs, "Wrong number of fieldNames provided.");
@@ -44,12 +57,44 @@ BlobsQueue::BlobsQueue(
     queue_.push_back(blobs);
   }
   DCHECK_EQ(queue_.size(), capacity);
+  sequences_.reset(new std::atomic<int64_t>[capacity]);
+  for (auto i = 0; i < capacity; ++i) {
+    sequences_[i] = i;
+  }
 }
 
 bool BlobsQueue::blockingRead(
     const std::vector<Blob*>& inputs,
     float timeout_secs) {
   auto keeper = this->shared_from_this();
+  if (lockFree_) {
+    CAFFE_EVENT(stats_, queue_balance, -1);
+    int64_t pos;
+    auto claim = [this](int64_t* p) { return tryClaimRead(p); };
+    bool claimed = spinClaim(claim, &pos);
+    if (!claimed) {
+      std::unique_lock<std::mutex> g(mutex_);
+      ++waitingReaders_;
+      // Same as the locked version: readers drain the queue after close
+      auto ready = [&]() { return (claimed = claim(&pos)) || closing_; };
+      if (timeout_secs > 0) {
+        std::chrono::milliseconds timeout_ms(int(timeout_secs * 1000));
+        cv_.wait_for(g, timeout_ms, ready);
+      } else {
+        cv_.wait(g, ready);
+      }
+      --waitingReaders_;
+    }
+    if (!claimed) {
+      if (timeout_secs > 0 && !closing_) {
+        LOG(ERROR) << "DequeueBlobs timed out in " << timeout_secs << " secs";
+      }
+      return false;
+    }
+    doRead(pos, inputs);
+    return true;
+  }
+
   std::unique_lock<std::mutex> g(mutex_);
   auto canRead = [this]() {
     CAFFE_ENFORCE_LE(reader_, writer_);
@@ -86,6 +131,16 @@ bool BlobsQueue::blockingRead(
 
 bool BlobsQueue::tryWrite(const std::vector<Blob*>& inputs) {
   auto keeper = this->shared_from_this();
+  if (lockFree_) {
+    int64_t pos;
+    if (!tryClaimWrite(&pos)) {
+      return false;
+    }
+    CAFFE_EVENT(stats_, queue_balance, 1);
+    doWrite(pos, inputs);
+    return true;
+  }
+
   std::unique_lock<std::mutex> g(mutex_);
   if (!canWrite()) {
     return false;
@@ -98,6 +153,24 @@ bool BlobsQueue::tryWrite(const std::vector<Blob*>& inputs) {
 
 bool BlobsQueue::blockingWrite(const std::vector<Blob*>& inputs) {
   auto keeper = this->shared_from_this();
+  if (lockFree_) {
+    CAFFE_EVENT(stats_, queue_balance, 1);
+    int64_t pos;
+    auto claim = [this](int64_t* p) { return tryClaimWrite(p); };
+    bool claimed = spinClaim(claim, &pos);
+    if (!claimed) {
+      std::unique_lock<std::mutex> g(mutex_);
+      ++waitingWriters_;
+      cv_.wait(g, [&]() { return (claimed = claim(&pos)) || closing_; });
+      --waitingWriters_;
+    }
+    if (!claimed) {
+      return false;
+    }
+    doWrite(pos, inputs);
+    return true;
+  }
+
   std::unique_lock<std::mutex> g(mutex_);
   CAFFE_EVENT(stats_, queue_balance, 1);
   cv_.wait(g, [this]() { return closing_ || canWrite(); });
@@ -135,4 +208,88 @@ void BlobsQueue::doWrite(const std::vector<Blob*>& inputs) {
   cv_.notify_all();
 }
 
+bool BlobsQueue::tryClaimRead(int64_t* pos) {
+  int64_t p = readPos_.load(std::memory_order_relaxed);
+  while (true) {
+    int64_t seq = sequences_[p % queue_.size()];
+    int64_t diff = seq - (p + 1);
+    if (diff == 0) {
+      if (readPos_.compare_exchange_weak(p, p + 1)) {
+        *pos = p;
+        return true;
+      }
+    } else if (diff < 0) {
+      // Slot was not written yet: the queue is empty
+      return false;
+    } else {
+      p = readPos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool BlobsQueue::tryClaimWrite(int64_t* pos) {
+  int64_t p = writePos_.load(std::memory_order_relaxed);
+  while (true) {
+    int64_t seq = sequences_[p % queue_.size()];
+    int64_t diff = seq - p;
+    if (diff == 0) {
+      if (writePos_.compare_exchange_weak(p, p + 1)) {
+        *pos = p;
+        return true;
+      }
+    } else if (diff < 0) {
+      // Slot was not read yet: the queue is full
+      return false;
+    } else {
+      p = writePos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename Claim>
+bool BlobsQueue::spinClaim(Claim claim, int64_t* pos) {
+  for (int i = 0; i < FLAGS_caffe2_blobs_queue_spin_iterations; ++i) {
+    if (claim(pos)) {
+      return true;
+    }
+    std::this_thread::yield();
+  }
+  return claim(pos);
+}
+
+void BlobsQueue::doRead(int64_t pos, const std::vector<Blob*>& inputs) {
+  auto& result = queue_[pos % queue_.size()];
+  CAFFE_ENFORCE(inputs.size() >= result.size());
+  for (auto i = 0; i < result.size(); ++i) {
+    auto bytes = BlobStat::sizeBytes(*result[i]);
+    CAFFE_EVENT(stats_, queue_dequeued_bytes, bytes, i);
+    using std::swap;
+    swap(*(inputs[i]), *(result[i]));
+  }
+  CAFFE_EVENT(stats_, queue_dequeued_records);
+  // Hand the slot over to the writer of the next lap
+  sequences_[pos % queue_.size()] = pos + queue_.size();
+  notifyWaiters(waitingWriters_);
+}
+
+void BlobsQueue::doWrite(int64_t pos, const std::vector<Blob*>& inputs) {
+  auto& result = queue_[pos % queue_.size()];
+  CAFFE_ENFORCE(inputs.size() >= result.size());
+  for (auto i = 0; i < result.size(); ++i) {
+    using std::swap;
+    swap(*(inputs[i]), *(result[i]));
+  }
+  sequences_[pos % queue_.size()] = pos + 1;
+  notifyWaiters(waitingReaders_);
+}
+
+void BlobsQueue::notifyWaiters(const std::atomic<int>& waiters) {
+  // Sequence stores and waiter counters are sequentially consistent: either
+  // a waiter sees the slot in its wait predicate or we see the waiter here
+  if (waiters > 0) {
+    std::lock_guard<std::mutex> g(mutex_);
+    cv_.notify_all();
+  }
+}
+
 } // namespace caffe2
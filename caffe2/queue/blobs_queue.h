@@ -12,6 +12,9 @@
 #include "caffe2/core/tensor.h"
 #include "caffe2/core/workspace.h"
 
+CAFFE2_DECLARE_bool(caffe2_blobs_queue_lock_free);
+CAFFE2_DECLARE_int(caffe2_blobs_queue_spin_iterations);
+
 namespace caffe2 {
 
 // A thread-safe, bounded, blocking queue.
@@ -20,6 +23,13 @@ namespace caffe2 {
 // Containing blobs are owned by the workspace.
 // On read, we swap out the underlying data for the blob passed in for blobs
 
+// With --caffe2_blobs_queue_lock_free (off by default) readers and writers
+// claim slots without locking: every slot has a sequence number telling
+// whether it's ready to be written (sequence == position) or read
+// (sequence == position + 1), and the read and write positions are advanced
+// with CAS. Readers and writers that find the queue empty or full spin for a
+// while and only then block on the condition variable.
+
 class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
  public:
   BlobsQueue(
@@ -48,6 +58,15 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
   bool canWrite();
   void doWrite(const std::vector<Blob*>& inputs);
 
+  bool tryClaimRead(int64_t* pos);
+  bool tryClaimWrite(int64_t* pos);
+  template <typename Claim>
+  bool spinClaim(Claim claim, int64_t* pos);
+  void doRead(int64_t pos, const std::vector<Blob*>& inputs);
+  void doWrite(int64_t pos, const std::vector<Blob*>& inputs);
+  void notifyWaiters(const std::atomic<int>& waiters);
+
+  const bool lockFree_;
   std::atomic<bool> closing_{false};
 
   size_t numBlobs_;
@@ -57,6 +76,17 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
   int64_t writer_{0};
   std::vector<std::vector<Blob*>> queue_;
 
+  // Lock free queue state, mutex_ and cv_ are only used to sleep
+  // Padding keeps readers and writers from bouncing the same cache line
+  std::unique_ptr<std::atomic<int64_t>[]> sequences_;
+  char padding0_[64];
+  std::atomic<int64_t> readPos_{0};
+  char padding1_[64];
+  std::atomic<int64_t> writePos_{0};
+  char padding2_[64];
+  std::atomic<int> waitingReaders_{0};
+  std::atomic<int> waitingWriters_{0};
+
   struct QueueStats {
     CAFFE_STAT_CTOR(QueueStats);
     CAFFE_EXPORTED_STAT(queue_balance);
@@ -0,0 +1,118 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/queue/blobs_queue.h"
+
+namespace caffe2 {
+
+namespace {
+
+class BlobsQueueTest : public ::testing::TestWithParam<bool> {
+ protected:
+  void SetUp() override {
+    old_lock_free_ = FLAGS_caffe2_blobs_queue_lock_free;
+    FLAGS_caffe2_blobs_queue_lock_free = GetParam();
+  }
+  void TearDown() override {
+    FLAGS_caffe2_blobs_queue_lock_free = old_lock_free_;
+  }
+
+  std::shared_ptr<BlobsQueue> createQueue(size_t capacity) {
+    return std::make_shared<BlobsQueue>(
+        &ws_, "queue", capacity, 1, /* enforceUniqueName */ false);
+  }
+
+  Workspace ws_;
+  bool old_lock_free_;
+};
+
+bool writeInt(BlobsQueue* queue, int value, bool blocking = true) {
+  Blob blob;
+  *blob.GetMutable<int>() = value;
+  return blocking ? queue->blockingWrite({&blob}) : queue->tryWrite({&blob});
+}
+
+} // namespace
+
+TEST_P(BlobsQueueTest, ReadsInWriteOrder) {
+  auto queue = createQueue(4);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(writeInt(queue.get(), i, false));
+  }
+  // Full
+  EXPECT_FALSE(writeInt(queue.get(), 4, false));
+  Blob blob;
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue->blockingRead({&blob}));
+    EXPECT_EQ(blob.Get<int>(), i);
+  }
+  // Empty
+  EXPECT_FALSE(queue->blockingRead({&blob}, 0.01));
+}
+
+TEST_P(BlobsQueueTest, CloseWakesUpReaders) {
+  auto queue = createQueue(2);
+  EXPECT_TRUE(writeInt(queue.get(), 1));
+  std::thread reader([&]() {
+    Blob blob;
+    // Items written before close are still read
+    EXPECT_TRUE(queue->blockingRead({&blob}));
+    EXPECT_EQ(blob.Get<int>(), 1);
+    EXPECT_FALSE(queue->blockingRead({&blob}));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  queue->close();
+  reader.join();
+}
+
+TEST_P(BlobsQueueTest, ManyReadersAndWriters) {
+  const int kWriters = 8;
+  const int kReaders = 4;
+  const int kRecordsPerWriter = 2000;
+  auto queue = createQueue(16);
+
+  std::vector<std::atomic<int>> seen(kWriters * kRecordsPerWriter);
+  for (auto& count : seen) {
+    count = 0;
+  }
+  std::vector<std::thread> threads;
+  for (int w = 0; w < kWriters; ++w) {
+    threads.emplace_back([&, w]() {
+      for (int i = 0; i < kRecordsPerWriter; ++i) {
+        EXPECT_TRUE(writeInt(queue.get(), w * kRecordsPerWriter + i));
+      }
+    });
+  }
+  std::atomic<int> read_count(0);
+  for (int r = 0; r < kReaders; ++r) {
+    threads.emplace_back([&]() {
+      Blob blob;
+      while (queue->blockingRead({&blob})) {
+        ++seen[blob.Get<int>()];
+        ++read_count;
+      }
+    });
+  }
+  for (int w = 0; w < kWriters; ++w) {
+    threads[w].join();
+  }
+  while (read_count < kWriters * kRecordsPerWriter) {
+    std::this_thread::yield();
+  }
+  queue->close();
+  for (int r = 0; r < kReaders; ++r) {
+    threads[kWriters + r].join();
+  }
+  for (const auto& count : seen) {
+    EXPECT_EQ(count, 1);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(
+    LockFreeAndLocked,
+    BlobsQueueTest,
+    ::testing::Values(true, false));
+
+} // namespace caffe2
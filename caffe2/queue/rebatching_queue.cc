@@ -1,104 +1,48 @@
 #include "rebatching_queue.h"
-#include "caffe2/utils/smart_tensor_printer.h"
 
-namespace caffe2 {
-
-namespace {
-
-// This concat function will always create a new first dimension to concat
-void concat(
-    CPUContext& context,
-    const std::vector<std::vector<TensorCPU>>& inputs,
-    const std::vector<TensorCPU*>& outputs) {
-  CAFFE_ENFORCE(!inputs.empty());
+#include <algorithm>
+#include <cstring>
 
-  const auto& inputZero = inputs[0];
-  const auto numTensors = inputZero.size();
-  const auto numRows = inputs.size();
-
-  // Precompute the output sizes to avoid resizing
-  std::vector<std::vector<TIndex>> outputDims(numTensors);
-
-  for (int i = 0; i < numTensors; ++i) {
-    SmartTensorPrinter::PrintTensor(inputZero.at(i));
-    outputDims[i] = inputZero.at(i).dims();
-    outputDims[i].insert(outputDims[i].begin(), numRows);
-  }
-
-  // Resize to the final output size
-  std::vector<void*> destinations(numTensors);
-  for (int i = 0; i < numTensors; ++i) {
-    outputs[i]->Resize(outputDims[i]);
-    destinations[i] = outputs[i]->raw_mutable_data(inputZero[i].meta());
-  }
+CAFFE2_DEFINE_int(
+    caffe2_rebatching_queue_copy_threads,
+    4,
+    "Number of threads used to gather the rows of a single dequeue into the "
+    "output tensors");
+CAFFE2_DEFINE_int64(
+    caffe2_rebatching_queue_parallel_copy_bytes,
+    1 << 22,
+    "Dequeues gathering fewer bytes than this are copied on the calling "
+    "thread only");
 
-  for (int i = 0; i < numRows; ++i) {
-    CAFFE_ENFORCE_EQ(inputs[i].size(), numTensors);
-
-    for (int j = 0; j < numTensors; ++j) {
-      const auto& input = inputs[i][j];
-
-      CAFFE_ENFORCE(inputZero[j].meta() == input.meta());
-      CAFFE_ENFORCE_EQ(inputZero[j].itemsize(), input.itemsize());
-      CAFFE_ENFORCE_EQ(inputZero[j].ndim(), input.ndim());
-      for (int k = 0; k < input.ndim(); ++k) {
-        CAFFE_ENFORCE_EQ(input.dims()[k], inputZero[j].dims()[k]);
-      }
-
-      // Skip empty tensors
-      if (input.size() == 0) {
-        continue;
-      }
+namespace caffe2 {
 
-      context.CopyItems<CPUContext, CPUContext>(
-          input.meta(),
-          input.size(),
-          input.raw_data() /* src */,
-          destinations[j] /* dst */
-          );
+namespace {
 
-      destinations[j] =
-          (char*)destinations[j] + input.size() * input.itemsize();
+// Checks that a batch has the same types and row shapes as the reference one
+void checkCompatible(
+    const std::vector<TensorCPU>& reference,
+    const std::vector<TensorCPU>& batch) {
+  CAFFE_ENFORCE_EQ(batch.size(), reference.size());
+  for (int j = 0; j < batch.size(); ++j) {
+    const auto& input = batch[j];
+    CAFFE_ENFORCE(reference[j].meta() == input.meta());
+    CAFFE_ENFORCE_EQ(reference[j].ndim(), input.ndim());
+    for (int k = 1; k < input.ndim(); ++k) {
+      CAFFE_ENFORCE_EQ(input.dims()[k], reference[j].dims()[k]);
     }
   }
 }
 
-std::vector<std::vector<TensorCPU>> split(
-    CPUContext& context,
-    const std::vector<const TensorCPU*>& inputs) {
-  CAFFE_ENFORCE(!inputs.empty());
-
-  const auto outputSize = inputs[0]->dims().at(0);
-  std::vector<std::vector<TensorCPU>> outputs(outputSize);
-
-  for (const auto* inputPtr : inputs) {
-    CAFFE_ENFORCE(inputPtr);
-
-    const auto& input = *inputPtr;
-    const auto innerSize = input.size_from_dim(1);
-    const auto itemSize = input.meta().itemsize();
-
-    auto outputDims = input.dims();
-    CAFFE_ENFORCE(!outputDims.empty());
-    outputDims.erase(outputDims.begin());
-    CAFFE_ENFORCE_EQ(input.dims().at(0), outputSize);
-
-    for (int i = 0; i < outputSize; ++i) {
-      outputs[i].push_back(TensorCPU(outputDims));
-      context.CopyItems<CPUContext, CPUContext>(
-          input.meta(),
-          innerSize,
-          (char*)input.raw_data() + i * innerSize * itemSize /* src */,
-          outputs[i].back().raw_mutable_data(input.meta()) /* dst */);
-    }
-  }
-
-  return outputs;
-}
 } // anonymous namespace
 
-RebatchingQueue::RebatchingQueue(size_t capacity, size_t numBlobs)
-    : capacity_(capacity), numBlobs_(numBlobs), queue_(capacity) {}
+RebatchingQueue::RebatchingQueue(
+    size_t capacity,
+    size_t numBlobs,
+    bool rowViews)
+    : capacity_(capacity),
+      numBlobs_(numBlobs),
+      rowViews_(rowViews),
+      queue_(capacity) {}
 
 RebatchingQueue::~RebatchingQueue() {
   close();
@@ -112,7 +56,7 @@ bool RebatchingQueue::dequeue(
     CPUContext& context,
     size_t numElements,
     const std::vector<TensorCPU*>& outputs) {
-  std::vector<std::vector<TensorCPU>> results;
+  std::vector<RowView> results;
   results.reserve(numElements);
 
   for (;;) {
@@ -146,44 +90,236 @@ bool RebatchingQueue::dequeue(
     return false;
   }
 
-  concat(context, results, outputs);
+  gather(context, results, outputs);
 
   return true;
 }
 
+// This gather will always create a new first dimension to concat. Consecutive
+// rows of the same batch are copied with a single memcpy.
+void RebatchingQueue::gather(
+    CPUContext& context,
+    const std::vector<RowView>& rows,
+    const std::vector<TensorCPU*>& outputs) {
+  CAFFE_ENFORCE(!rows.empty());
+
+  const auto& batchZero = *rows[0].batch;
+  const auto numTensors = batchZero.size();
+  const auto numRows = rows.size();
+  CAFFE_ENFORCE_EQ(outputs.size(), numTensors);
+
+  const Batch* lastChecked = &batchZero;
+  for (const auto& row : rows) {
+    if (row.batch.get() != lastChecked) {
+      checkCompatible(batchZero, *row.batch);
+      lastChecked = row.batch.get();
+    }
+  }
+
+  // Resize to the final output size
+  std::vector<char*> destinations(numTensors);
+  std::vector<size_t> rowBytes(numTensors);
+  for (int j = 0; j < numTensors; ++j) {
+    auto outputDims = batchZero[j].dims();
+    outputDims[0] = numRows;
+    outputs[j]->Resize(outputDims);
+    destinations[j] =
+        static_cast<char*>(outputs[j]->raw_mutable_data(batchZero[j].meta()));
+    rowBytes[j] = batchZero[j].size_from_dim(1) * batchZero[j].itemsize();
+  }
+
+  std::vector<CopyJob> jobs;
+  size_t totalBytes = 0;
+  size_t begin = 0;
+  while (begin < numRows) {
+    // Find the longest run of consecutive rows of the same batch
+    const auto* batch = rows[begin].batch.get();
+    size_t end = begin + 1;
+    while (end < numRows && rows[end].batch.get() == batch &&
+           rows[end].row == rows[end - 1].row + 1) {
+      ++end;
+    }
+    const auto runLength = end - begin;
+
+    for (int j = 0; j < numTensors; ++j) {
+      // Skip empty tensors
+      if (rowBytes[j] == 0) {
+        continue;
+      }
+      const auto& input = (*batch)[j];
+      const auto* src = static_cast<const char*>(input.raw_data()) +
+          rows[begin].row * rowBytes[j];
+      if (input.meta().copy()) {
+        context.CopyItems<CPUContext, CPUContext>(
+            input.meta(),
+            runLength * input.size_from_dim(1),
+            src,
+            destinations[j]);
+      } else {
+        jobs.push_back({src, destinations[j], runLength * rowBytes[j]});
+        totalBytes += runLength * rowBytes[j];
+      }
+      destinations[j] += runLength * rowBytes[j];
+    }
+    begin = end;
+  }
+
+  copyBytes(jobs, totalBytes);
+}
+
+void RebatchingQueue::copyBytes(
+    const std::vector<CopyJob>& jobs,
+    size_t totalBytes) {
+  // Every thread copies at least caffe2_rebatching_queue_parallel_copy_bytes
+  const int64_t minBytes =
+      std::max<int64_t>(FLAGS_caffe2_rebatching_queue_parallel_copy_bytes, 1);
+  const int numThreads = std::max<int64_t>(
+      std::min<int64_t>(
+          FLAGS_caffe2_rebatching_queue_copy_threads, totalBytes / minBytes),
+      1);
+  if (numThreads == 1) {
+    for (const auto& job : jobs) {
+      memcpy(job.dst, job.src, job.nbytes);
+    }
+    return;
+  }
+
+  // Cut the jobs into numThreads shards of (almost) equal byte counts
+  std::vector<std::vector<CopyJob>> shards(numThreads);
+  const size_t shardBytes = (totalBytes + numThreads - 1) / numThreads;
+  size_t shard = 0;
+  size_t shardFill = 0;
+  for (auto job : jobs) {
+    while (job.nbytes > 0) {
+      const auto nbytes = std::min(job.nbytes, shardBytes - shardFill);
+      shards[shard].push_back({job.src, job.dst, nbytes});
+      job.src += nbytes;
+      job.dst += nbytes;
+      job.nbytes -= nbytes;
+      shardFill += nbytes;
+      if (shardFill == shardBytes) {
+        ++shard;
+        shardFill = 0;
+      }
+    }
+  }
+
+  auto runShard = [](const std::vector<CopyJob>& shardJobs) {
+    for (const auto& job : shardJobs) {
+      memcpy(job.dst, job.src, job.nbytes);
+    }
+  };
+
+  std::mutex mutex;
+  std::condition_variable done;
+  int remaining = numThreads - 1;
+  auto* pool = copyPool(FLAGS_caffe2_rebatching_queue_copy_threads - 1);
+  for (int i = 1; i < numThreads; ++i) {
+    pool->run([&, i]() {
+      runShard(shards[i]);
+      // Notify under the lock, the waiting thread owns the condition variable
+      std::lock_guard<std::mutex> g(mutex);
+      if (--remaining == 0) {
+        done.notify_one();
+      }
+    });
+  }
+  runShard(shards[0]);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&remaining] { return remaining == 0; });
+}
+
+TaskThreadPool* RebatchingQueue::copyPool(size_t numThreads) {
+  std::call_once(copyPoolInit_, [this, numThreads] {
+    copyPool_.reset(new TaskThreadPool(numThreads));
+  });
+  return copyPool_.get();
+}
+
 bool RebatchingQueue::canWrite() const {
   return tail_ + capacity() > head_;
 }
 
 bool RebatchingQueue::enqueueOne(
-    CPUContext& /*context*/,
+    CPUContext& context,
     const std::vector<const TensorCPU*>& inputs) {
-  std::vector<std::vector<TensorCPU>> splittedInputs;
-  splittedInputs.emplace_back();
-  auto& tensorVector = splittedInputs.back();
-  tensorVector.reserve(inputs.size());
-  for (const auto* tensorPtr : inputs) {
-    tensorVector.push_back(*tensorPtr);
+  CAFFE_ENFORCE_EQ(numBlobs_, inputs.size());
+
+  // Store the element as a batch with a single row
+  auto batch = std::make_shared<Batch>();
+  batch->reserve(inputs.size());
+  for (const auto* inputPtr : inputs) {
+    CAFFE_ENFORCE(inputPtr);
+    const auto& input = *inputPtr;
+    auto dims = input.dims();
+    dims.insert(dims.begin(), 1);
+    batch->emplace_back(dims);
+    context.CopyItems<CPUContext, CPUContext>(
+        input.meta(),
+        input.size(),
+        input.raw_data() /* src */,
+        batch->back().raw_mutable_data(input.meta()) /* dst */);
   }
 
-  return enqueue(std::move(splittedInputs));
+  std::vector<RowView> rows(1);
+  rows[0].batch = std::move(batch);
+  return enqueue(std::move(rows));
 }
 
 bool RebatchingQueue::enqueueMany(
     CPUContext& context,
     const std::vector<const TensorCPU*>& inputs) {
   CAFFE_ENFORCE_EQ(numBlobs_, inputs.size());
+  CAFFE_ENFORCE(!inputs.empty());
 
-  std::vector<std::vector<TensorCPU>> splittedInputs;
-  splittedInputs = split(context, inputs);
-  return enqueue(std::move(splittedInputs));
+  const auto numRows = inputs[0]->dims().at(0);
+  for (const auto* inputPtr : inputs) {
+    CAFFE_ENFORCE(inputPtr);
+    CAFFE_ENFORCE_EQ(inputPtr->dims().at(0), numRows);
+  }
+
+  std::vector<RowView> rows(numRows);
+  if (rowViews_) {
+    // The producer is free to overwrite its tensors once we return, so take
+    // one snapshot of the whole batch and share it between all of its rows
+    auto batch = std::make_shared<Batch>();
+    batch->reserve(inputs.size());
+    for (const auto* inputPtr : inputs) {
+      batch->emplace_back(*inputPtr, &context);
+    }
+    for (TIndex i = 0; i < numRows; ++i) {
+      rows[i].batch = batch;
+      rows[i].row = i;
+    }
+    return enqueue(std::move(rows));
+  }
+
+  for (TIndex i = 0; i < numRows; ++i) {
+    auto batch = std::make_shared<Batch>();
+    batch->reserve(inputs.size());
+    for (const auto* inputPtr : inputs) {
+      const auto& input = *inputPtr;
+      const auto innerSize = input.size_from_dim(1);
+      auto dims = input.dims();
+      dims[0] = 1;
+      batch->emplace_back(dims);
+      context.CopyItems<CPUContext, CPUContext>(
+          input.meta(),
+          innerSize,
+          static_cast<const char*>(input.raw_data()) +
+              i * innerSize * input.itemsize() /* src */,
+          batch->back().raw_mutable_data(input.meta()) /* dst */);
+    }
+    rows[i].batch = std::move(batch);
+  }
+  return enqueue(std::move(rows));
 }
 
-bool RebatchingQueue::enqueue(
-    std::vector<std::vector<TensorCPU>> splittedInputs) {
+bool RebatchingQueue::enqueue(std::vector<RowView> rows) {
   int idx = 0;
   for (;;) {
-    if (idx >= splittedInputs.size()) {
+    if (idx >= rows.size()) {
       break;
     }
 
@@ -199,8 +335,8 @@ bool RebatchingQueue::enqueue(
       }
 
       do {
-        queue_[head_++ % capacity()] = std::move(splittedInputs[idx++]);
-      } while (canWrite() && idx < splittedInputs.size());
+        queue_[head_++ % capacity()] = std::move(rows[idx++]);
+      } while (canWrite() && idx < rows.size());
     }
 
     cvEmpty_.notify_all();
@@ -217,6 +353,10 @@ size_t RebatchingQueue::numBlobs() const {
   return numBlobs_;
 }
 
+bool RebatchingQueue::rowViews() const {
+  return rowViews_;
+}
+
 bool RebatchingQueue::isClosed() const {
   std::lock_guard<std::mutex> g(mutex_);
   return isClosed_;
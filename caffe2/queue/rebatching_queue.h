@@ -10,6 +10,10 @@
 #include "caffe2/core/operator.h"
 #include "caffe2/core/stats.h"
 #include "caffe2/core/tensor.h"
+#include "caffe2/utils/thread_pool.h"
+
+CAFFE2_DECLARE_int(caffe2_rebatching_queue_copy_threads);
+CAFFE2_DECLARE_int64(caffe2_rebatching_queue_parallel_copy_bytes);
 
 namespace caffe2 {
 
@@ -17,9 +21,14 @@ namespace caffe2 {
 // atomic index + circular queue optimizations or pull something more
 // heavy-weight later
 
+// Every element of the queue is a view of one row of a batch of tensors. With
+// rowViews set, enqueueMany stores a single snapshot of the whole input batch
+// and the rows are only materialized once, when dequeue gathers them into the
+// output tensors. Otherwise every row is copied into a batch of its own, so
+// that a dequeued row does not keep the rest of its batch alive.
 class RebatchingQueue {
  public:
-  RebatchingQueue(size_t capacity, size_t numBlobs);
+  RebatchingQueue(size_t capacity, size_t numBlobs, bool rowViews = false);
 
   ~RebatchingQueue();
 
@@ -40,18 +49,43 @@ class RebatchingQueue {
 
   size_t numBlobs() const;
 
+  bool rowViews() const;
+
   bool isClosed() const;
 
   void close();
 
  private:
-  bool enqueue(std::vector<std::vector<TensorCPU>> splittedInputs);
+  using Batch = std::vector<TensorCPU>;
+
+  struct RowView {
+    std::shared_ptr<const Batch> batch;
+    TIndex row{0};
+  };
+
+  struct CopyJob {
+    const char* src;
+    char* dst;
+    size_t nbytes;
+  };
+
+  bool enqueue(std::vector<RowView> rows);
+
+  void gather(
+      CPUContext& context,
+      const std::vector<RowView>& rows,
+      const std::vector<TensorCPU*>& outputs);
+
+  void copyBytes(const std::vector<CopyJob>& jobs, size_t totalBytes);
+
+  TaskThreadPool* copyPool(size_t numThreads);
 
   bool canWrite() const;
   bool canRead() const;
 
   const size_t capacity_;
   const size_t numBlobs_;
+  const bool rowViews_;
 
   mutable std::mutex mutex_;
 
@@ -63,6 +97,9 @@ class RebatchingQueue {
   std::condition_variable cvEmpty_;
   std::condition_variable cvOverflow_;
 
-  std::vector<std::vector<TensorCPU>> queue_;
+  std::vector<RowView> queue_;
+
+  std::once_flag copyPoolInit_;
+  std::unique_ptr<TaskThreadPool> copyPool_;
 };
 } // caffe2
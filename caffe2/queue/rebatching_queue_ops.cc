@@ -26,7 +26,12 @@ OPERATOR_SCHEMA(CreateRebatchingQueue)
     .Arg("num_blobs", "Number of input tensors the queue will support")
     .Arg(
         "capacity",
-        "Maximal number of elements the queue can hold at any given point");
+        "Maximal number of elements the queue can hold at any given point")
+    .Arg(
+        "row_views",
+        "If set, batches enqueued with enqueue_batch are stored as a whole and "
+        "their rows are copied only once, when dequeued. A batch is released "
+        "when all of its rows have been dequeued.");
 
 OPERATOR_SCHEMA(CloseRebatchingQueue)
     .NumInputs(1)
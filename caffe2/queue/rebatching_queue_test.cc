@@ -0,0 +1,157 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/scope_guard.h"
+#include "caffe2/queue/rebatching_queue.h"
+
+namespace caffe2 {
+
+namespace {
+
+class RebatchingQueueTest : public ::testing::TestWithParam<bool> {
+ protected:
+  std::unique_ptr<RebatchingQueue> createQueue(
+      size_t capacity,
+      size_t numBlobs) {
+    return caffe2::make_unique<RebatchingQueue>(
+        capacity, numBlobs, /* rowViews */ GetParam());
+  }
+
+  CPUContext context_;
+};
+
+// Fills a (rows x cols) float tensor with first + 0, first + 1, ...
+void fillRange(TensorCPU* tensor, TIndex rows, TIndex cols, float first) {
+  tensor->Resize(rows, cols);
+  auto* data = tensor->mutable_data<float>();
+  for (TIndex i = 0; i < rows * cols; ++i) {
+    data[i] = first + i;
+  }
+}
+
+} // namespace
+
+TEST_P(RebatchingQueueTest, RebatchesAcrossBatches) {
+  auto queue = createQueue(16, 2);
+  TensorCPU values;
+  TensorCPU ids;
+  ids.Resize(3);
+  for (int batch = 0; batch < 2; ++batch) {
+    fillRange(&values, 3, 2, batch * 6);
+    for (int i = 0; i < 3; ++i) {
+      ids.mutable_data<int>()[i] = batch * 3 + i;
+    }
+    EXPECT_TRUE(queue->enqueueMany(context_, {&values, &ids}));
+  }
+  // The producer reuses its buffers, rows already enqueued must not change
+  fillRange(&values, 3, 2, -100);
+
+  TensorCPU outValues;
+  TensorCPU outIds;
+  for (int dequeued = 0; dequeued < 6; dequeued += 2) {
+    EXPECT_TRUE(queue->dequeue(context_, 2, {&outValues, &outIds}));
+    EXPECT_EQ(outValues.dims(), (std::vector<TIndex>{2, 2}));
+    EXPECT_EQ(outIds.dims(), (std::vector<TIndex>{2}));
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(outValues.data<float>()[i], dequeued * 2 + i);
+    }
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_EQ(outIds.data<int>()[i], dequeued + i);
+    }
+  }
+}
+
+TEST_P(RebatchingQueueTest, MixesSingleElementsAndBatches) {
+  auto queue = createQueue(8, 1);
+  TensorCPU row;
+  row.Resize(2);
+  row.mutable_data<float>()[0] = 0;
+  row.mutable_data<float>()[1] = 1;
+  EXPECT_TRUE(queue->enqueueOne(context_, {&row}));
+  row.mutable_data<float>()[0] = -1;
+
+  TensorCPU batch;
+  fillRange(&batch, 2, 2, 2);
+  EXPECT_TRUE(queue->enqueueMany(context_, {&batch}));
+
+  TensorCPU output;
+  EXPECT_TRUE(queue->dequeue(context_, 3, {&output}));
+  EXPECT_EQ(output.dims(), (std::vector<TIndex>{3, 2}));
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(output.data<float>()[i], i);
+  }
+}
+
+TEST_P(RebatchingQueueTest, CopiesStrings) {
+  auto queue = createQueue(4, 1);
+  TensorCPU batch;
+  batch.Resize(3);
+  for (int i = 0; i < 3; ++i) {
+    batch.mutable_data<std::string>()[i] = std::string(100, 'a' + i);
+  }
+  EXPECT_TRUE(queue->enqueueMany(context_, {&batch}));
+
+  TensorCPU output;
+  EXPECT_TRUE(queue->dequeue(context_, 3, {&output}));
+  EXPECT_EQ(output.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(output.data<std::string>()[i], std::string(100, 'a' + i));
+  }
+}
+
+TEST_P(RebatchingQueueTest, ParallelGather) {
+  auto oldThreads = FLAGS_caffe2_rebatching_queue_copy_threads;
+  auto oldBytes = FLAGS_caffe2_rebatching_queue_parallel_copy_bytes;
+  FLAGS_caffe2_rebatching_queue_copy_threads = 4;
+  FLAGS_caffe2_rebatching_queue_parallel_copy_bytes = 64;
+  auto guard = MakeGuard([&]() {
+    FLAGS_caffe2_rebatching_queue_copy_threads = oldThreads;
+    FLAGS_caffe2_rebatching_queue_parallel_copy_bytes = oldBytes;
+  });
+
+  const int kRows = 10;
+  const int kCols = 37;
+  auto queue = createQueue(kRows * 4, 1);
+  TensorCPU batch;
+  for (int i = 0; i < 4; ++i) {
+    fillRange(&batch, kRows, kCols, i * kRows * kCols);
+    EXPECT_TRUE(queue->enqueueMany(context_, {&batch}));
+  }
+
+  // Every dequeue spans two input batches and is split across threads
+  TensorCPU output;
+  EXPECT_TRUE(queue->dequeue(context_, 15, {&output}));
+  EXPECT_TRUE(queue->dequeue(context_, 25, {&output}));
+  EXPECT_EQ(output.dims(), (std::vector<TIndex>{25, kCols}));
+  for (int i = 0; i < 25 * kCols; ++i) {
+    EXPECT_EQ(output.data<float>()[i], 15 * kCols + i);
+  }
+}
+
+TEST_P(RebatchingQueueTest, ReturnsRemainderAfterClose) {
+  auto queue = createQueue(8, 1);
+  TensorCPU batch;
+  fillRange(&batch, 3, 1, 0);
+
+  std::thread producer([&]() {
+    EXPECT_TRUE(queue->enqueueMany(context_, {&batch}));
+    queue->close();
+  });
+
+  CPUContext context;
+  TensorCPU output;
+  EXPECT_TRUE(queue->dequeue(context, 5, {&output}));
+  producer.join();
+  EXPECT_EQ(output.size(), 3);
+  EXPECT_FALSE(queue->dequeue(context, 1, {&output}));
+  EXPECT_FALSE(queue->enqueueMany(context, {&batch}));
+}
+
+INSTANTIATE_TEST_CASE_P(
+    RowViews,
+    RebatchingQueueTest,
+    ::testing::Values(false, true));
+
+} // namespace caffe2
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "caffe2/core/operator.h"
+#include "caffe2/core/tensor_delta.h"
 
 namespace caffe2 {
 
@@ -130,6 +131,7 @@ class SparseAdagradOp final : public Operator<Context> {
             &context_);
       }
     }
+    DirtyRowTracker::Get().MarkRows(OperatorBase::Outputs(), indices, n);
     return true;
   }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "caffe2/core/operator.h"
+#include "caffe2/core/tensor_delta.h"
 
 namespace caffe2 {
 
@@ -202,6 +203,7 @@ class SparseAdamOp final : public Operator<Context> {
             &context_);
       }
     }
+    DirtyRowTracker::Get().MarkRows(OperatorBase::Outputs(), indices, n);
     return true;
   }
 
@@ -128,6 +128,7 @@ void SparseFtrlOp<T>::DoRun() {
           &context_);
     }
   }
+  DirtyRowTracker::Get().MarkRows(OperatorBase::Outputs(), idxs, K);
 }
 
 namespace {
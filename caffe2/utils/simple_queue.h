@@ -18,10 +18,13 @@ namespace caffe2 {
 // nothing is in the queue but NoMoreJobs() is not called yet, the pop calls
 // will wait. If NoMoreJobs() has been called, pop calls will return false,
 // which serves as a message to the workers that they should exit.
+//
+// If a capacity is given, Push() waits while the queue holds that many jobs.
 template <typename T>
 class SimpleQueue {
  public:
-  SimpleQueue() : no_more_jobs_(false) {}
+  explicit SimpleQueue(size_t capacity = 0)
+      : capacity_(capacity), no_more_jobs_(false) {}
 
   // Pops a value and writes it to the value pointer. If there is nothing in the
   // queue, this will wait till a value is inserted to the queue. If there are
@@ -31,8 +34,11 @@ class SimpleQueue {
     std::unique_lock<std::mutex> mutex_lock(mutex_);
     while (queue_.size() == 0 && !no_more_jobs_) cv_.wait(mutex_lock);
     if (queue_.size() == 0 && no_more_jobs_) return false;
-    *value = queue_.front();
+    *value = std::move(queue_.front());
     queue_.pop();
+    if (capacity_) {
+      not_full_cv_.notify_one();
+    }
     return true;
   }
 
@@ -43,10 +49,18 @@ class SimpleQueue {
 
   // Push pushes a value to the queue.
   void Push(const T& value) {
+    T copy(value);
+    Push(std::move(copy));
+  }
+
+  void Push(T&& value) {
     {
-      std::lock_guard<std::mutex> mutex_lock(mutex_);
+      std::unique_lock<std::mutex> mutex_lock(mutex_);
+      while (capacity_ && queue_.size() >= capacity_ && !no_more_jobs_) {
+        not_full_cv_.wait(mutex_lock);
+      }
       CAFFE_ENFORCE(!no_more_jobs_, "Cannot push to a closed queue.");
-      queue_.push(value);
+      queue_.push(std::move(value));
     }
     cv_.notify_one();
   }
@@ -63,12 +77,15 @@ class SimpleQueue {
       no_more_jobs_ = true;
     }
     cv_.notify_all();
+    not_full_cv_.notify_all();
   }
 
  private:
   std::mutex mutex_;
   std::condition_variable cv_;
+  std::condition_variable not_full_cv_;
   std::queue<T> queue_;
+  size_t capacity_;
   bool no_more_jobs_;
   // We do not allow copy constructors.
   SimpleQueue(const SimpleQueue& /*src*/) {}
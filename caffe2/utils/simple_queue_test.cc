@@ -1,3 +1,5 @@
+#include <atomic>
+#include <chrono>
 #include <thread>  // NOLINT
 
 #include "caffe2/utils/simple_queue.h"
@@ -59,6 +61,25 @@ TEST(SimpleQueueTest, DoubleProducerDoubleConsumer) {
   consumer1.join();
 }
 
+TEST(SimpleQueueTest, BoundedQueueBlocksProducer) {
+  gQueue.reset(new SimpleQueue<int>(2));
+  gQueue->Push(0);
+  gQueue->Push(1);
+  std::atomic<bool> pushed(false);
+  std::thread producer([&pushed]() {
+    gQueue->Push(2);
+    pushed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(pushed);
+  int value;
+  EXPECT_TRUE(gQueue->Pop(&value));
+  EXPECT_EQ(value, 0);
+  producer.join();
+  EXPECT_TRUE(pushed);
+  EXPECT_EQ(gQueue->size(), 2);
+}
+
 TEST(SimpleQueueDeathTest, CannotAddAfterQueueFinished) {
   gQueue.reset(new SimpleQueue<int>());
   gQueue->Push(0);
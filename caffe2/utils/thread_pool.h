@@ -8,7 +8,24 @@
 #include <thread>
 #include <utility>
 
-class TaskThreadPool{
+#include "caffe2/core/numa.h"
+
+/// @brief Interface shared by the task pools used by the async net executors.
+class TaskThreadPoolBase {
+ public:
+    virtual ~TaskThreadPoolBase() {}
+
+    /// @brief Schedule a task for execution on one of the pool threads.
+    virtual void run(const std::function<void()>& func) = 0;
+
+    /// @brief Number of threads in the pool.
+    virtual std::size_t size() const = 0;
+
+    /// @brief Whether the calling thread is one of the pool threads.
+    virtual bool inThreadPool() const = 0;
+};
+
+class TaskThreadPool : public TaskThreadPoolBase {
  private:
     struct task_element_t {
         bool run_with_id;
@@ -29,12 +46,14 @@ class TaskThreadPool{
     bool complete_;
     std::size_t available_;
     std::size_t total_;
+    int numa_node_id_;
 
  public:
     /// @brief Constructor.
-    explicit TaskThreadPool(std::size_t pool_size)
+    explicit TaskThreadPool(std::size_t pool_size, int numa_node_id = -1)
         :  threads_(pool_size), running_(true), complete_(true),
-           available_(pool_size), total_(pool_size) {
+           available_(pool_size), total_(pool_size),
+           numa_node_id_(numa_node_id) {
         for ( std::size_t i = 0; i < pool_size; ++i ) {
             threads_[i] = std::thread(
                 std::bind(&TaskThreadPool::main_loop, this, i));
@@ -42,7 +61,7 @@ class TaskThreadPool{
     }
 
     /// @brief Destructor.
-    ~TaskThreadPool() {
+    ~TaskThreadPool() override {
         // Set running flag to false then notify all threads.
         {
             std::unique_lock< std::mutex > lock(mutex_);
@@ -71,6 +90,23 @@ class TaskThreadPool{
         condition_.notify_one();
     }
 
+    void run(const std::function<void()>& func) override {
+        runTask(func);
+    }
+
+    std::size_t size() const override {
+        return total_;
+    }
+
+    bool inThreadPool() const override {
+        for (const auto& thread : threads_) {
+            if (thread.get_id() == std::this_thread::get_id()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     template <typename Task>
     void runTaskWithID(Task task) {
       std::unique_lock<std::mutex> lock(mutex_);
@@ -93,6 +129,7 @@ class TaskThreadPool{
  private:
     /// @brief Entry point for pool threads.
     void main_loop(std::size_t index) {
+        caffe2::NUMABind(numa_node_id_);
         while (running_) {
             // Wait on condition variable while the task is empty and
             // the pool is still running.
@@ -0,0 +1,161 @@
+#include "caffe2/utils/work_stealing_thread_pool.h"
+
+#include "caffe2/core/logging.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_work_stealing_spin_iterations,
+    64,
+    "Number of times an idle work stealing pool thread polls for new tasks "
+    "before going to sleep");
+
+namespace caffe2 {
+
+thread_local WorkStealingThreadPool* WorkStealingThreadPool::current_pool_ =
+    nullptr;
+thread_local std::size_t WorkStealingThreadPool::current_index_ = 0;
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    std::size_t pool_size,
+    int numa_node_id)
+    : numa_node_id_(numa_node_id),
+      running_(true),
+      pending_(0),
+      active_(0),
+      sleeping_(0),
+      next_queue_(0) {
+  CAFFE_ENFORCE_GT(pool_size, 0, "Empty work stealing thread pool");
+  queues_.reserve(pool_size);
+  for (std::size_t i = 0; i < pool_size; ++i) {
+    queues_.emplace_back(new WorkerQueue());
+  }
+  threads_.reserve(pool_size);
+  for (std::size_t i = 0; i < pool_size; ++i) {
+    threads_.emplace_back(&WorkStealingThreadPool::main_loop, this, i);
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    running_ = false;
+    sleep_cv_.notify_all();
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkStealingThreadPool::run(const std::function<void()>& func) {
+  std::size_t index;
+  if (current_pool_ == this) {
+    index = current_index_;
+  } else {
+    index = next_queue_++ % queues_.size();
+  }
+
+  ++active_;
+  {
+    auto& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(func);
+    ++pending_;
+  }
+
+  // Pairs with the increment of sleeping_ in main_loop: either the sleeping
+  // worker observes the new pending task or we observe the sleeper
+  if (sleeping_ > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.notify_one();
+  }
+}
+
+bool WorkStealingThreadPool::inThreadPool() const {
+  return current_pool_ == this;
+}
+
+void WorkStealingThreadPool::waitWorkComplete() {
+  std::unique_lock<std::mutex> lock(complete_mutex_);
+  completed_.wait(lock, [this]() { return active_ == 0; });
+}
+
+bool WorkStealingThreadPool::popLocal(
+    std::size_t index,
+    std::function<void()>& task) {
+  auto& queue = *queues_[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) {
+    return false;
+  }
+  task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  --pending_;
+  return true;
+}
+
+bool WorkStealingThreadPool::steal(
+    std::size_t thief_index,
+    std::function<void()>& task) {
+  auto num_queues = queues_.size();
+  for (std::size_t offset = 1; offset < num_queues; ++offset) {
+    auto& queue = *queues_[(thief_index + offset) % num_queues];
+    // Do not wait on a queue that is being used by its owner or another
+    // thief, move on to the next victim instead
+    std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || queue.tasks.empty()) {
+      continue;
+    }
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    --pending_;
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::main_loop(std::size_t index) {
+  current_pool_ = this;
+  current_index_ = index;
+  NUMABind(numa_node_id_);
+
+  while (true) {
+    std::function<void()> task;
+    if (popLocal(index, task) || steal(index, task)) {
+      try {
+        task();
+      }
+      // Suppress all exceptions, same as TaskThreadPool
+      catch (const std::exception&) {
+      }
+      // Destroy the task (and anything it captured) before reporting it done
+      task = nullptr;
+      if (--active_ == 0) {
+        std::lock_guard<std::mutex> lock(complete_mutex_);
+        completed_.notify_all();
+      }
+      continue;
+    }
+
+    bool has_pending = false;
+    for (int spin = 0; spin < FLAGS_caffe2_work_stealing_spin_iterations;
+         ++spin) {
+      if (pending_ > 0) {
+        has_pending = true;
+        break;
+      }
+      std::this_thread::yield();
+    }
+    if (has_pending) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    ++sleeping_;
+    sleep_cv_.wait(lock, [this]() { return pending_ > 0 || !running_; });
+    --sleeping_;
+    if (!running_ && pending_ <= 0) {
+      break;
+    }
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,77 @@
+#ifndef CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+#define CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/utils/thread_pool.h"
+
+namespace caffe2 {
+
+// A task pool with one deque per worker thread. Tasks submitted from a worker
+// thread (e.g. child chains scheduled by the async net executors) are pushed
+// to that worker's own deque and popped in LIFO order, which keeps producer
+// and consumer on the same core and avoids any shared queue. Tasks submitted
+// from outside of the pool are distributed round-robin. Idle workers steal
+// from the opposite (FIFO) end of other workers' deques, spin briefly, and
+// only then go to sleep.
+class WorkStealingThreadPool : public TaskThreadPoolBase {
+ public:
+  explicit WorkStealingThreadPool(std::size_t pool_size, int numa_node_id = -1);
+  ~WorkStealingThreadPool() override;
+
+  void run(const std::function<void()>& func) override;
+
+  std::size_t size() const override {
+    return threads_.size();
+  }
+
+  bool inThreadPool() const override;
+
+  // Blocks until all submitted tasks, including tasks submitted by other
+  // tasks, have finished
+  void waitWorkComplete();
+
+ private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool popLocal(std::size_t index, std::function<void()>& task);
+  bool steal(std::size_t thief_index, std::function<void()>& task);
+  void main_loop(std::size_t index);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> threads_;
+  int numa_node_id_;
+
+  std::atomic<bool> running_;
+  // Number of tasks sitting in the worker deques
+  std::atomic<int> pending_;
+  // Number of submitted tasks that have not finished yet
+  std::atomic<int> active_;
+  std::atomic<int> sleeping_;
+  std::atomic<std::size_t> next_queue_;
+
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  std::mutex complete_mutex_;
+  std::condition_variable completed_;
+
+  static thread_local WorkStealingThreadPool* current_pool_;
+  static thread_local std::size_t current_index_;
+
+  WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+  WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
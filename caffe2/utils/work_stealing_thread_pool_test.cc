@@ -0,0 +1,69 @@
+#include <atomic>
+
+#include "caffe2/utils/work_stealing_thread_pool.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(WorkStealingThreadPoolTest, RunsExternalTasks) {
+  WorkStealingThreadPool pool(4);
+  EXPECT_EQ(pool.size(), 4);
+  EXPECT_FALSE(pool.inThreadPool());
+
+  std::atomic<int> counter(0);
+  for (int i = 0; i < 1000; ++i) {
+    pool.run([&counter]() { ++counter; });
+  }
+  pool.waitWorkComplete();
+  EXPECT_EQ(counter, 1000);
+}
+
+TEST(WorkStealingThreadPoolTest, RunsNestedTasks) {
+  WorkStealingThreadPool pool(4);
+  std::atomic<int> counter(0);
+  std::atomic<int> in_pool(0);
+
+  // Every task spawns its successor from a worker thread, the way async nets
+  // schedule child chains
+  std::function<void(int)> chain;
+  chain = [&](int remaining) {
+    ++counter;
+    if (pool.inThreadPool()) {
+      ++in_pool;
+    }
+    if (remaining > 0) {
+      pool.run([&chain, remaining]() { chain(remaining - 1); });
+    }
+  };
+  for (int i = 0; i < 16; ++i) {
+    pool.run([&chain]() { chain(99); });
+  }
+  pool.waitWorkComplete();
+  EXPECT_EQ(counter, 1600);
+  EXPECT_EQ(in_pool, 1600);
+}
+
+TEST(WorkStealingThreadPoolTest, SingleThread) {
+  WorkStealingThreadPool pool(1);
+  std::atomic<int> counter(0);
+  for (int i = 0; i < 100; ++i) {
+    pool.run([&pool, &counter]() {
+      pool.run([&counter]() { ++counter; });
+    });
+  }
+  pool.waitWorkComplete();
+  EXPECT_EQ(counter, 100);
+}
+
+TEST(WorkStealingThreadPoolTest, DrainsOnDestruction) {
+  std::atomic<int> counter(0);
+  {
+    WorkStealingThreadPool pool(2);
+    for (int i = 0; i < 100; ++i) {
+      pool.run([&counter]() { ++counter; });
+    }
+  }
+  EXPECT_EQ(counter, 100);
+}
+
+} // namespace caffe2
@@ -67,6 +67,27 @@ if (CAFFE2_COMPILER_SUPPORTS_AVX2_EXTENSIONS)
   endif()
 endif()
 
+# ---[ Check if the compiler has AVX-512 support. The perfkernels use
+# AVX-512F, AVX-512BW and AVX-512VL.
+if (NOT MSVC AND CAFFE2_COMPILER_SUPPORTS_AVX2_EXTENSIONS)
+  set(CMAKE_REQUIRED_FLAGS "-mavx512f -mavx512bw -mavx512vl")
+  CHECK_CXX_SOURCE_COMPILES(
+      "#include <immintrin.h>
+       int main() {
+         __m512 a = _mm512_set1_ps(1.f);
+         __m128i b = _mm_maskz_loadu_epi8(0, &a);
+         __m256i c = _mm256_maskz_loadu_epi16(0, &a);
+         a = _mm512_add_ps(a, _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(b)));
+         a = _mm512_add_ps(a, _mm512_cvtph_ps(c));
+         _mm512_mask_storeu_ps(&a, 0, a);
+         return 0;
+       }" CAFFE2_COMPILER_SUPPORTS_AVX512_EXTENSIONS)
+  if (CAFFE2_COMPILER_SUPPORTS_AVX512_EXTENSIONS)
+    message(STATUS "Current compiler supports avx512 extention. Will build avx512 perfkernels.")
+    add_definitions(-DCAFFE2_PERF_WITH_AVX512)
+  endif()
+endif()
+
 # ---[ If we are using msvc, set no warning flags
 # Note(jiayq): if you are going to add a warning flag, check if this is
 # totally necessary, and only add when you see fit. If it is needed due to